@@ -51,11 +51,11 @@ using std::string;
 using std::thread;
 using std::stringstream;
 
-typedef DataProvider<void*, BlockingQueue> DataProviderT;
-typedef OffDataProvider<void*, BlockingQueue> OffDataProviderT;
-typedef OffRunner<void*, BlockingQueue> OffRunnerT;
-typedef ClassOffPostProcessor<void*, BlockingQueue> ClassOffPostProcessorT;
-typedef Pipeline<void*, BlockingQueue> PipelineT;
+typedef DataProvider<void*, LockFreeQueue> DataProviderT;
+typedef OffDataProvider<void*, LockFreeQueue> OffDataProviderT;
+typedef OffRunner<void*, LockFreeQueue> OffRunnerT;
+typedef ClassOffPostProcessor<void*, LockFreeQueue> ClassOffPostProcessorT;
+typedef Pipeline<void*, LockFreeQueue> PipelineT;
 
 int main(int argc, char* argv[]) {
   {
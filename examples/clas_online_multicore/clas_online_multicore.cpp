@@ -47,11 +47,11 @@ using std::string;
 using std::thread;
 using std::stringstream;
 
-typedef DataProvider<float, BlockingQueue> DataProviderT;
-typedef OnDataProvider<float, BlockingQueue> OnDataProviderT;
-typedef OnRunner<float, BlockingQueue> OnRunnerT;
-typedef ClassOnPostProcessor<float, BlockingQueue> ClassOnPostProcessorT;
-typedef Pipeline<float, BlockingQueue> PipelineT;
+typedef DataProvider<float, LockFreeQueue> DataProviderT;
+typedef OnDataProvider<float, LockFreeQueue> OnDataProviderT;
+typedef OnRunner<float, LockFreeQueue> OnRunnerT;
+typedef ClassOnPostProcessor<float, LockFreeQueue> ClassOnPostProcessorT;
+typedef Pipeline<float, LockFreeQueue> PipelineT;
 
 int main(int argc, char* argv[]) {
   {
@@ -46,10 +46,10 @@ using std::string;
 using std::thread;
 using std::stringstream;
 
-typedef OnDataProvider<float, Queue> OnDataProviderT;
-typedef OnRunner<float, Queue> OnRunnerT;
-typedef ClassOnPostProcessor<float, Queue> ClassOnPostProcessorT;
-typedef Pipeline<float, Queue> PipelineT;
+typedef OnDataProvider<float, LockFreeQueue> OnDataProviderT;
+typedef OnRunner<float, LockFreeQueue> OnRunnerT;
+typedef ClassOnPostProcessor<float, LockFreeQueue> ClassOnPostProcessorT;
+typedef Pipeline<float, LockFreeQueue> PipelineT;
 
 int main(int argc, char* argv[]) {
   {
@@ -95,6 +95,58 @@ void DataProvider<Dtype, Qtype>::readOneBatch() {
   this->imageName_.push_back(imageNameVec);
 }
 
+template <typename Dtype, template <typename> class Qtype>
+bool DataProvider<Dtype, Qtype>::claimBatch(vector<string>* files) {
+  files->clear();
+  while (files->size() < this->inNum_ && !this->imageList.empty()) {
+    files->push_back(this->imageList.front());
+    this->imageList.pop();
+  }
+  return !files->empty();
+}
+
+// Same decoding and padding as readOneBatch(), on an already claimed list
+// of files and without touching the provider state.
+template <typename Dtype, template <typename> class Qtype>
+bool DataProvider<Dtype, Qtype>::readBatch(const vector<string>& files,
+                                           vector<cv::Mat>* images,
+                                           vector<string>* names) {
+  images->clear();
+  names->clear();
+  for (auto& file_id : files) {
+    string file = file_id;
+    if (file.find(" ") != string::npos)
+      file = file.substr(0, file.find(" "));
+    cv::Mat img;
+    if (FLAGS_yuv) {
+      img = convertYuv2Mat(file, inGeometry_);
+    } else {
+      img = cv::imread(file, -1);
+    }
+    if (img.data) {
+      names->push_back(file_id);
+      images->push_back(img);
+    } else {
+      LOG(INFO) << "failed to read " << file;
+    }
+  }
+  if (images->empty()) return false;
+  while (images->size() < this->inNum_) {
+    cv::Mat img;
+    images->back().copyTo(img);
+    images->push_back(img);
+    names->push_back("null");
+  }
+  return true;
+}
+
+template <typename Dtype, template <typename> class Qtype>
+bool DataProvider<Dtype, Qtype>::processBatch(const vector<string>& files) {
+  LOG(FATAL) << "This data provider can't run in the stage scheduler, "
+             << "use --workers 0.";
+  return false;
+}
+
 template <typename Dtype, template <typename> class Qtype>
 void DataProvider<Dtype, Qtype>::preRead() {
   while (this->imageList.size()) {
@@ -51,6 +51,9 @@ DEFINE_int32(yuv, 0, "bgr(0) or yuv(1) mode. Default is bgr");
 DEFINE_double(scale, 1, "scale for input data, mobilenet...");
 DEFINE_string(logdir, "", "path to dump log file, to terminal stderr by default");
 DEFINE_int32(fifosize, 2, "set FIFO size of mlu input and output buffer, default is 2");
+DEFINE_int32(workers, 0, "Worker threads sharing the pipeline stages in CPU mode."
+    "Image decoding and preprocessing of several batches then run in parallel"
+    " with the net forward. 0 keeps the serial loop, default is 0");
 DEFINE_string(mludevice, "0",
     "set using mlu device number, set multidevice seperated by ','"
     "eg 0,1 when you use device number 0 and 1, default: 0");
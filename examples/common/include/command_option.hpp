@@ -51,6 +51,7 @@ DECLARE_int32(dump);
 DECLARE_string(mmode);
 DECLARE_string(mcore);
 DECLARE_int32(fifosize);
+DECLARE_int32(workers);
 DECLARE_double(confidencethreshold);
 DECLARE_string(outputdir);
 DECLARE_string(labelmapfile);
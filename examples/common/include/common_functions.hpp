@@ -52,10 +52,12 @@ using std::chrono::high_resolution_clock;
 
 #define INSTANTIATE_OFF_CLASS(classname) \
   template class classname<void*, BlockingQueue>; \
+  template class classname<void*, LockFreeQueue>; \
   template class classname<void*, Queue>;
 
 #define INSTANTIATE_ON_CLASS(classname) \
   template class classname<float, BlockingQueue>; \
+  template class classname<float, LockFreeQueue>; \
   template class classname<float, Queue>;
 
 #define INSTANTIATE_ALL_CLASS(classname) \
@@ -76,6 +76,14 @@ class DataProvider {
   }
   virtual void runParallel() {}
   virtual void runSerial() {}
+  // Batch level entry points for Pipeline::runScheduled(). claimBatch()
+  // is called by one thread at a time; processBatch() runs concurrently
+  // for different batches once initSerial() has been called.
+  bool claimBatch(vector<string>* files);
+  bool readBatch(const vector<string>& files, vector<cv::Mat>* images,
+                 vector<string>* names);
+  virtual void initSerial() {}
+  virtual bool processBatch(const vector<string>& files);
 
   cv::Mat ResizeMethod(cv::Mat sample, int inputDim, int mode);
 
@@ -0,0 +1,105 @@
+/*
+All modification made by Cambricon Corporation: © 2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef EXAMPLES_COMMON_INCLUDE_LOCKFREE_QUEUE_HPP_
+#define EXAMPLES_COMMON_INCLUDE_LOCKFREE_QUEUE_HPP_
+
+#if defined(USE_OPENCV)
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/**
+ * Bounded multi-producer multi-consumer ring queue, usable as the Qtype
+ * of the pipeline stages in place of BlockingQueue.
+ *
+ * Slots carry a sequence number so producers and consumers only contend
+ * on a single compare-and-swap of their own position counter. Blocking
+ * calls spin for a while and then sleep on a futex; the sleeping side is
+ * only woken when a waiter is registered, so the uncontended path never
+ * enters the kernel. push() blocks while the queue is full.
+ */
+template<typename T>
+class LockFreeQueue {
+  public:
+  explicit LockFreeQueue(size_t capacity = 1024);
+  ~LockFreeQueue();
+
+  void push(const T& t);
+
+  bool try_push(const T& t);
+
+  bool try_pop(T* t);
+
+  // This logs a message if the threads needs to be blocked
+  // useful for detecting e.g. when data feeding is too slow
+  T pop(const string& log_on_wait = "");
+
+  // Peeking is only reliable while no other thread is popping.
+  bool try_peek(T* t);
+
+  // Return element without removing it
+  T peek();
+
+  // Approximate under concurrent use.
+  size_t size() const;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  protected:
+  static const size_t kCacheLine = 64;
+
+  struct alignas(kCacheLine) Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  void notify(std::atomic<int>* event, std::atomic<int>* waiters);
+
+  Cell* buffer_;
+  size_t mask_;
+  alignas(kCacheLine) std::atomic<size_t> enqueue_pos_;
+  alignas(kCacheLine) std::atomic<size_t> dequeue_pos_;
+  // Futex words bumped when an element is pushed / popped while someone
+  // is registered as sleeping on the opposite condition.
+  alignas(kCacheLine) std::atomic<int> not_empty_;
+  std::atomic<int> pop_waiters_;
+  alignas(kCacheLine) std::atomic<int> not_full_;
+  std::atomic<int> push_waiters_;
+
+  LockFreeQueue(const LockFreeQueue&);
+  LockFreeQueue& operator=(const LockFreeQueue&);
+};
+
+#endif  // USE_OPENCV
+#endif  // EXAMPLES_COMMON_INCLUDE_LOCKFREE_QUEUE_HPP_
@@ -58,6 +58,8 @@ class OnDataProvider: public DataProvider<Dtype, Qtype>{
   }
   virtual void runParallel();
   virtual void runSerial();
+  virtual void initSerial();
+  virtual bool processBatch(const vector<string>& files);
 
   protected:
   virtual void SetMeanFile();
@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cnrt.h" //NOLINT
 #endif
 #include "blocking_queue.hpp"
+#include "lockfree_queue.hpp"
 #include "queue.hpp"
 #include "caffe/caffe.hpp"
 #include "post_processor.hpp"
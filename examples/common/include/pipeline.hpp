@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "post_processor.hpp"
 #include "command_option.hpp"
 #include "common_functions.hpp"
+#include "stage_scheduler.hpp"
 
 using std::string;
 using std::thread;
@@ -54,6 +55,7 @@ class Pipeline {
   ~Pipeline();
   void runParallel();
   void runSerial();
+  void runScheduled(int workers);
   inline DataProvider<Dtype, Qtype>* dataProvider() { return data_provider_; }
   inline vector<DataProvider<Dtype, Qtype>*> dataProviders() { return data_providers_; }
   inline Runner<Dtype, Qtype>* runner() { return runner_; }
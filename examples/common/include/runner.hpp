@@ -43,6 +43,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cnrt.h" // NOLINT
 #endif
 #include "blocking_queue.hpp"
+#include "lockfree_queue.hpp"
 #include "queue.hpp"
 #include "post_processor.hpp"
 
@@ -104,6 +105,8 @@ class Runner {
   inline void setThreadId(int id) { threadId_ = id; }
   inline void setPostProcessor(PostProcessor<Dtype, Qtype> *p ) { postProcessor_ = p; }
   inline bool simpleFlag() {return simple_flag_;}
+  // Input buffers cycled by runSerial(), see Pipeline::runScheduled()
+  inline int serialBufferNum() { return serialBufferNum_; }
 
   inline int64_t* inputSizeArray() { return inputSizeArray_; }
   inline int64_t* outputSizeArray() { return outputSizeArray_; }
@@ -137,6 +140,7 @@ class Runner {
   int threadId_ = 0;
   int deviceId_;
   int deviceSize_ = 1;
+  int serialBufferNum_ = 1;
   int Parallel_ = 1;
   float runTime_;
   bool initSerialMode;
@@ -0,0 +1,133 @@
+/*
+All modification made by Cambricon Corporation: © 2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef EXAMPLES_COMMON_INCLUDE_STAGE_SCHEDULER_HPP_
+#define EXAMPLES_COMMON_INCLUDE_STAGE_SCHEDULER_HPP_
+#include <atomic>
+#include <condition_variable> // NOLINT
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <thread> // NOLINT
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/**
+ * Runs a chain of pipeline stages on a shared pool of worker threads.
+ *
+ * Every batch flowing through the pipeline becomes one task per stage.
+ * Each worker owns a deque: it pushes the follow-up task of a batch onto
+ * its own deque and pops from the back, so a batch tends to stay on the
+ * core that touched it last, and an idle worker steals the oldest task
+ * from the front of another worker's deque. Stages declare how many of
+ * their tasks may run at once and whether batches must enter the stage
+ * in source order; CPU heavy stages simply declare more parallelism.
+ *
+ * The first stage is the source. It is called for batch 0, 1, 2, ... in
+ * order and returns false once the stream is exhausted. A later stage
+ * returns false to drop its batch. At most max_in_flight batches are
+ * between the source and the end of the last stage at any time, which
+ * bounds the buffers a pipeline needs.
+ */
+class StageScheduler {
+  public:
+  typedef std::function<bool(int64_t batch)> StageFunc;
+
+  explicit StageScheduler(int workers);
+  ~StageScheduler();
+
+  // A parallelism of 0 lets the stage use every worker.
+  void addStage(const string& name, int parallelism, bool ordered,
+                const StageFunc& func);
+  // Blocks until every batch admitted by the source has left the pipeline.
+  void run(int max_in_flight);
+  void printStats() const;
+
+  inline int workers() const { return workers_.size(); }
+  inline int64_t steals() const { return steals_; }
+
+  private:
+  struct Task {
+    int stage;
+    int64_t batch;
+  };
+  struct Stage {
+    string name;
+    int parallelism;
+    bool ordered;
+    StageFunc func;
+    std::mutex mutex;
+    int running;
+    int64_t next_batch;
+    std::set<int64_t> pending;
+    std::set<int64_t> skipped;
+    std::atomic<int64_t> tasks;
+    std::atomic<int64_t> busy_us;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void workerLoop(int id);
+  bool popTask(int id, Task* task);
+  void execute(const Task& task);
+  void submit(int stage, int64_t batch);
+  void skip(int stage, int64_t batch);
+  void takeReady(Stage* stage, vector<int64_t>* ready);
+  void dispatch(const Task& task);
+  void finishBatch(bool end_of_stream);
+
+  vector<Stage*> stages_;
+  vector<Worker*> workers_;
+  std::atomic<int> queued_;
+  std::atomic<int> round_robin_;
+  std::atomic<int64_t> steals_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cond_;
+  bool stop_;
+
+  std::mutex flow_mutex_;
+  std::condition_variable done_cond_;
+  int max_in_flight_;
+  int in_flight_;
+  int64_t next_batch_;
+  std::atomic<bool> source_done_;
+
+  StageScheduler(const StageScheduler&);
+  StageScheduler& operator=(const StageScheduler&);
+};
+
+#endif  // EXAMPLES_COMMON_INCLUDE_STAGE_SCHEDULER_HPP_
@@ -0,0 +1,237 @@
+/*
+All modification made by Cambricon Corporation: © 2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <glog/logging.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+#include "include/lockfree_queue.hpp"
+
+namespace {
+
+// Rounds of polling before a blocking call goes to sleep. Spinning only
+// pays off when the other side can run on another core.
+const int kSpinCount = 1024;
+
+int spin_count() {
+  static const int count =
+      std::thread::hardware_concurrency() > 1 ? kSpinCount : 0;
+  return count;
+}
+
+static_assert(sizeof(std::atomic<int>) == sizeof(int),
+              "futex needs a plain 32-bit word");
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+inline void futex_wait(std::atomic<int>* word, int expected) {
+  syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAIT_PRIVATE,
+          expected, NULL, NULL, 0);
+}
+
+inline void futex_wake(std::atomic<int>* word, int count) {
+  syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE,
+          count, NULL, NULL, 0);
+}
+
+}  // namespace
+
+template<typename T>
+LockFreeQueue<T>::LockFreeQueue(size_t capacity)
+    : enqueue_pos_(0), dequeue_pos_(0), not_empty_(0), pop_waiters_(0),
+      not_full_(0), push_waiters_(0) {
+  CHECK_GT(capacity, 0);
+  // Power of two, and at least two slots so that a full and an empty slot
+  // never carry the same sequence number.
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+  mask_ = size - 1;
+  void* memory = NULL;
+  CHECK_EQ(posix_memalign(&memory, kCacheLine, sizeof(Cell) * size), 0)
+      << "Failed to allocate queue of " << size << " slots";
+  buffer_ = static_cast<Cell*>(memory);
+  for (size_t i = 0; i < size; i++) {
+    new (&buffer_[i]) Cell();
+    buffer_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template<typename T>
+LockFreeQueue<T>::~LockFreeQueue() {
+  for (size_t i = 0; i <= mask_; i++) {
+    buffer_[i].~Cell();
+  }
+  free(buffer_);
+}
+
+template<typename T>
+void LockFreeQueue<T>::notify(std::atomic<int>* event,
+                              std::atomic<int>* waiters) {
+  // Pairs with the fence a waiter issues after registering itself: either
+  // the waiter sees the new element, or we see the waiter. Registrations
+  // are cleared by whoever wakes them, so a burst of pushes against a
+  // sleeping consumer costs one syscall, not one per element.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters->load(std::memory_order_relaxed) > 0 &&
+      waiters->exchange(0, std::memory_order_relaxed) > 0) {
+    event->fetch_add(1, std::memory_order_release);
+    futex_wake(event, INT_MAX);
+  }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::try_push(const T& t) {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+    if (dif == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->data = t;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  notify(&not_empty_, &pop_waiters_);
+  return true;
+}
+
+template<typename T>
+void LockFreeQueue<T>::push(const T& t) {
+  for (int i = 0; i < spin_count(); i++) {
+    if (try_push(t)) return;
+    cpu_relax();
+  }
+  for (;;) {
+    int epoch = not_full_.load(std::memory_order_acquire);
+    push_waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (try_push(t)) return;
+    futex_wait(&not_full_, epoch);
+  }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::try_pop(T* t) {
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  for (;;) {
+    cell = &buffer_[pos & mask_];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t dif =
+        static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+    if (dif == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  *t = std::move(cell->data);
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  notify(&not_full_, &push_waiters_);
+  return true;
+}
+
+template<typename T>
+T LockFreeQueue<T>::pop(const string& log_on_wait) {
+  T t;
+  for (int i = 0; i < spin_count(); i++) {
+    if (try_pop(&t)) return t;
+    cpu_relax();
+  }
+  for (;;) {
+    int epoch = not_empty_.load(std::memory_order_acquire);
+    pop_waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (try_pop(&t)) return t;
+    if (!log_on_wait.empty()) {
+      LOG_EVERY_N(INFO, 1000) << log_on_wait;
+    }
+    futex_wait(&not_empty_, epoch);
+  }
+}
+
+template<typename T>
+bool LockFreeQueue<T>::try_peek(T* t) {
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  const Cell& cell = buffer_[pos & mask_];
+  if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+    return false;
+  }
+  *t = cell.data;
+  return true;
+}
+
+template<typename T>
+T LockFreeQueue<T>::peek() {
+  T t;
+  for (;;) {
+    int epoch = not_empty_.load(std::memory_order_acquire);
+    pop_waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (try_peek(&t)) return t;
+    futex_wait(&not_empty_, epoch);
+  }
+}
+
+template<typename T>
+size_t LockFreeQueue<T>::size() const {
+  size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+  size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+  return head > tail ? head - tail : 0;
+}
+
+template class LockFreeQueue<void**>;
+template class LockFreeQueue<float*>;
+template class LockFreeQueue<vector<string>>;
@@ -149,20 +149,25 @@ void OnDataProvider<Dtype, Qtype>::runParallel() {
 }
 
 template <typename Dtype, template <typename> class Qtype>
-void OnDataProvider<Dtype, Qtype>::runSerial() {
+void OnDataProvider<Dtype, Qtype>::initSerial() {
+  if (this->initSerialMode) return;
   OnRunner<Dtype, Qtype> *runner = static_cast<OnRunner<Dtype, Qtype> *>(this->runner_);
+  this->inNum_ = runner->n();
+  this->inChannel_ = runner->c();
+  this->inHeight_ = runner->h();
+  this->inWidth_ = runner->w();
+  this->inGeometry_ = cv::Size(this->inWidth_, this->inHeight_);
 
-  if (!this->initSerialMode) {
-    this->inNum_ = runner->n();
-    this->inChannel_ = runner->c();
-    this->inHeight_ = runner->h();
-    this->inWidth_ = runner->w();
-    this->inGeometry_ = cv::Size(this->inWidth_, this->inHeight_);
+  this->SetMean();
 
-    this->SetMean();
+  this->initSerialMode = true;
+}
 
-    this->initSerialMode = true;
-  }
+template <typename Dtype, template <typename> class Qtype>
+void OnDataProvider<Dtype, Qtype>::runSerial() {
+  OnRunner<Dtype, Qtype> *runner = static_cast<OnRunner<Dtype, Qtype> *>(this->runner_);
+
+  initSerial();
 
   if (this->imageList.size()) {
     this->inImages_.clear();
@@ -183,6 +188,24 @@ void OnDataProvider<Dtype, Qtype>::runSerial() {
   }
 }
 
+template <typename Dtype, template <typename> class Qtype>
+bool OnDataProvider<Dtype, Qtype>::processBatch(const vector<string>& files) {
+  OnRunner<Dtype, Qtype> *runner = static_cast<OnRunner<Dtype, Qtype> *>(this->runner_);
+  vector<cv::Mat> imgs;
+  vector<string> imgNames;
+  if (!this->readBatch(files, &imgs, &imgNames)) return false;
+
+  // The scheduler keeps no more batches in flight than the runner has
+  // buffers, so this never waits.
+  Dtype* inputMluPtr = runner->popFreeInputData();
+  std::vector<std::vector<cv::Mat> > preprocessedImages;
+  this->WrapInputLayer(&preprocessedImages, inputMluPtr);
+  this->Preprocess(imgs, &preprocessedImages);
+
+  runner->pushValidInputDataAndNames(inputMluPtr, imgNames);
+  return true;
+}
+
 
 template <typename Dtype, template <typename> class Qtype>
 void OnDataProvider<Dtype, Qtype>::SetMeanFile() {
@@ -161,7 +161,15 @@ OnRunner<Dtype, Qtype>::OnRunner(const string& onlinemodel,
   this->outWidth_ = outputBlob->width();
   this->inCounts_.push_back(inputBlob->count());
   this->outCounts_.push_back(outputBlob->count());
-  for (int i = 0; i < 1; i++) {
+  // One buffer per batch the stage scheduler may keep in flight.
+  if (FLAGS_workers > 0) {
+    if (FLAGS_mmode == "CPU") {
+      this->serialBufferNum_ = FLAGS_workers + 1;
+    } else {
+      LOG(WARNING) << "--workers only applies to CPU mode, running serially";
+    }
+  }
+  for (int i = 0; i < this->serialBufferNum_; i++) {
     Dtype* inputCpuPtr = new Dtype[this->inCounts_[0]];
     Dtype* outputCpuPtr = new Dtype[this->outCounts_[0]];
     // save the Malloced memory to delete later
@@ -255,8 +263,10 @@ void OnRunner<Dtype, Qtype>::runParallel() {
 template <typename Dtype, template <typename> class Qtype>
 void OnRunner<Dtype, Qtype>::runSerial() {
   Dtype* inputCpuPtr = this->popValidInputData();
-  auto input_blob = net_->input_blobs()[0];
-  input_blob->set_cpu_data(reinterpret_cast<float*>(inputCpuPtr));
+  const string& input_name =
+      net_->blob_names()[net_->input_blob_indices()[0]];
+  net_->BindBlob(input_name, reinterpret_cast<float*>(inputCpuPtr),
+                 this->inCounts_[0]);
 
 #ifdef DEBUG
   Timer timer;
@@ -288,6 +298,7 @@ void OnRunner<Dtype, Qtype>::runSerial() {
   timer.log("net forward execution time");
 #endif
 
+  net_->UnbindBlob(input_name);
   this->pushFreeInputData(inputCpuPtr);
 #ifdef USE_MLU
   if (caffe::Caffe::mode() != caffe::Caffe::CPU) {
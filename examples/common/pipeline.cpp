@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 #include "include/blocking_queue.hpp"
+#include "include/lockfree_queue.hpp"
 #include "include/queue.hpp"
 #include "include/pipeline.hpp"
 
@@ -158,6 +159,11 @@ void Pipeline<Dtype, Qtype>::runParallel() {
 
 template <typename Dtype, template <typename> class Qtype>
 void Pipeline<Dtype, Qtype>::runSerial() {
+  // Runners only hand out extra buffers when scheduling is supported.
+  if (FLAGS_workers > 0 && runner_->serialBufferNum() > 1) {
+    runScheduled(FLAGS_workers);
+    return;
+  }
   while (!data_provider_->imageIsEmpty()) {
     data_provider_->runSerial();
     runner_->runSerial();
@@ -165,6 +171,32 @@ void Pipeline<Dtype, Qtype>::runSerial() {
   }
 }
 
+// Splits the serial loop into batch tasks: claiming file names is cheap and
+// stays in order, decoding and preprocessing spread over all workers, and
+// the forward pass runs one batch at a time together with post-processing,
+// which reads the net output blobs in place.
+template <typename Dtype, template <typename> class Qtype>
+void Pipeline<Dtype, Qtype>::runScheduled(int workers) {
+  const int window = runner_->serialBufferNum();
+  vector<vector<string> > files(window);
+  data_provider_->initSerial();
+
+  StageScheduler scheduler(workers);
+  scheduler.addStage("claim", 1, true, [&](int64_t batch) {
+    return data_provider_->claimBatch(&files[batch % window]);
+  });
+  scheduler.addStage("preprocess", 0, false, [&](int64_t batch) {
+    return data_provider_->processBatch(files[batch % window]);
+  });
+  scheduler.addStage("forward", 1, false, [&](int64_t batch) {
+    runner_->runSerial();
+    postProcessor_->runSerial();
+    return true;
+  });
+  scheduler.run(window);
+  scheduler.printStats();
+}
+
 template <typename Dtype, template <typename> class Qtype>
 void Pipeline<Dtype, Qtype>::notifyAll() {
   {
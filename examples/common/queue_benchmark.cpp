@@ -0,0 +1,158 @@
+/*
+All modification made by Cambricon Corporation: © 2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#if defined(USE_OPENCV)
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+#include "include/blocking_queue.hpp"
+#include "include/lockfree_queue.hpp"
+
+using std::vector;
+using std::string;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+DEFINE_int32(producers, 2, "number of pushing threads");
+DEFINE_int32(consumers, 2, "number of popping threads");
+DEFINE_int32(items, 1000000, "elements pushed by each producer");
+DEFINE_int32(capacity, 1024, "LockFreeQueue capacity");
+DEFINE_int32(rounds, 3, "repetitions per queue, the best one is reported");
+
+struct BenchResult {
+  double seconds;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+// Elements are 1-based item ids smuggled through the pointer; the push
+// timestamp of each item is kept on the side to measure hand-off latency.
+template <template <typename> class Qtype>
+BenchResult runBench(Qtype<float*>* queue) {
+  const int64_t total = static_cast<int64_t>(FLAGS_producers) * FLAGS_items;
+  vector<int64_t> pushed_at(total + 1);
+  vector<vector<int64_t> > latencies(FLAGS_consumers);
+  // Consumers stop once every item has been claimed; the ones that lose the
+  // race are released by one sentinel each.
+  std::atomic<int64_t> remaining(total);
+  steady_clock::time_point origin = steady_clock::now();
+  vector<std::thread> threads;
+  for (int p = 0; p < FLAGS_producers; p++) {
+    threads.push_back(std::thread([&, p] {
+      for (int64_t i = 0; i < FLAGS_items; i++) {
+        int64_t id = p * static_cast<int64_t>(FLAGS_items) + i + 1;
+        pushed_at[id] = duration_cast<nanoseconds>(
+            steady_clock::now() - origin).count();
+        queue->push(reinterpret_cast<float*>(static_cast<uintptr_t>(id)));
+      }
+    }));
+  }
+  for (int c = 0; c < FLAGS_consumers; c++) {
+    latencies[c].reserve(total / FLAGS_consumers + 1);
+    threads.push_back(std::thread([&, c] {
+      for (;;) {
+        int64_t id = static_cast<int64_t>(
+            reinterpret_cast<uintptr_t>(queue->pop()));
+        if (id == 0) return;
+        int64_t now = duration_cast<nanoseconds>(
+            steady_clock::now() - origin).count();
+        latencies[c].push_back(now - pushed_at[id]);
+        if (--remaining == 0) {
+          for (int s = 1; s < FLAGS_consumers; s++) queue->push(NULL);
+          return;
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+  BenchResult result;
+  result.seconds = duration<double>(steady_clock::now() - origin).count();
+
+  vector<int64_t> all;
+  all.reserve(total);
+  for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+  std::sort(all.begin(), all.end());
+  CHECK_EQ(all.size(), static_cast<size_t>(total));
+  result.p50_us = all[all.size() / 2] / 1e3;
+  result.p99_us = all[all.size() * 99 / 100] / 1e3;
+  result.max_us = all.back() / 1e3;
+  return result;
+}
+
+template <template <typename> class Qtype>
+void report(const string& name, Qtype<float*>* queue) {
+  BenchResult best = runBench(queue);
+  for (int r = 1; r < FLAGS_rounds; r++) {
+    BenchResult result = runBench(queue);
+    if (result.seconds < best.seconds) best = result;
+  }
+  const double total = static_cast<double>(FLAGS_producers) * FLAGS_items;
+  LOG(INFO) << name << ": " << total / best.seconds / 1e6 << " Mops/s, "
+            << "latency p50 " << best.p50_us << " us, p99 " << best.p99_us
+            << " us, max " << best.max_us << " us";
+}
+
+int main(int argc, char* argv[]) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Compare pipeline queue implementations.\n"
+        "Usage:\n"
+        "    queue_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_producers, 0);
+  CHECK_GT(FLAGS_consumers, 0);
+  CHECK_GT(FLAGS_items, 0);
+  LOG(INFO) << FLAGS_producers << " producers, " << FLAGS_consumers
+            << " consumers, " << FLAGS_items << " items each";
+
+  BlockingQueue<float*> blocking;
+  report("BlockingQueue", &blocking);
+  LockFreeQueue<float*> lockfree(FLAGS_capacity);
+  report("LockFreeQueue", &lockfree);
+  return 0;
+}
+#else
+#include <glog/logging.h>
+int main(int argc, char** argv) {
+  LOG(FATAL) << "This program requires OpenCV (USE_OPENCV).";
+  return 0;
+}
+#endif  // USE_OPENCV
@@ -0,0 +1,280 @@
+/*
+All modification made by Cambricon Corporation: © 2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <glog/logging.h>
+#include <chrono>  // NOLINT
+#include <string>
+#include <vector>
+#include "include/stage_scheduler.hpp"
+
+namespace {
+
+// Lets dispatch() find the deque of the worker it runs on.
+thread_local const StageScheduler* tls_scheduler = nullptr;
+thread_local int tls_worker = -1;
+
+}  // namespace
+
+StageScheduler::StageScheduler(int workers)
+    : queued_(0), round_robin_(0), steals_(0), stop_(false),
+      max_in_flight_(0), in_flight_(0), next_batch_(0), source_done_(false) {
+  CHECK_GT(workers, 0) << "StageScheduler needs at least one worker";
+  for (int i = 0; i < workers; i++) {
+    workers_.push_back(new Worker());
+  }
+  for (int i = 0; i < workers; i++) {
+    workers_[i]->thread = std::thread(&StageScheduler::workerLoop, this, i);
+  }
+}
+
+StageScheduler::~StageScheduler() {
+  {
+    std::lock_guard<std::mutex> lk(idle_mutex_);
+    stop_ = true;
+  }
+  idle_cond_.notify_all();
+  // Join every worker before freeing any deque; idle workers still probe
+  // the others for work until they see stop_.
+  for (auto worker : workers_) {
+    worker->thread.join();
+  }
+  for (auto worker : workers_) {
+    delete worker;
+  }
+  for (auto stage : stages_) {
+    delete stage;
+  }
+}
+
+void StageScheduler::addStage(const string& name, int parallelism,
+                              bool ordered, const StageFunc& func) {
+  CHECK_GE(parallelism, 0);
+  Stage* stage = new Stage();
+  stage->name = name;
+  stage->parallelism = parallelism ? parallelism : workers();
+  stage->ordered = ordered;
+  stage->func = func;
+  stage->running = 0;
+  stage->next_batch = 0;
+  stage->tasks = 0;
+  stage->busy_us = 0;
+  stages_.push_back(stage);
+}
+
+void StageScheduler::run(int max_in_flight) {
+  CHECK(!stages_.empty()) << "No stage to run";
+  CHECK_GT(max_in_flight, 0);
+  // The source produces batches one at a time in order.
+  stages_[0]->parallelism = 1;
+  stages_[0]->ordered = true;
+
+  vector<int64_t> admitted;
+  {
+    std::lock_guard<std::mutex> lk(flow_mutex_);
+    max_in_flight_ = max_in_flight;
+    in_flight_ = 0;
+    next_batch_ = 0;
+    source_done_ = false;
+    for (auto stage : stages_) {
+      stage->next_batch = 0;
+      stage->skipped.clear();
+    }
+    while (in_flight_ < max_in_flight_) {
+      admitted.push_back(next_batch_++);
+      in_flight_++;
+    }
+  }
+  for (auto batch : admitted) {
+    submit(0, batch);
+  }
+  std::unique_lock<std::mutex> lk(flow_mutex_);
+  done_cond_.wait(lk, [this]() { return source_done_ && in_flight_ == 0; });
+}
+
+void StageScheduler::printStats() const {
+  for (auto stage : stages_) {
+    LOG(INFO) << "Stage " << stage->name << ": " << stage->tasks
+              << " tasks, busy " << stage->busy_us / 1000.0 << " ms";
+  }
+  LOG(INFO) << "Scheduler: " << workers() << " workers, "
+            << steals_ << " steals";
+}
+
+void StageScheduler::workerLoop(int id) {
+  tls_scheduler = this;
+  tls_worker = id;
+  while (true) {
+    Task task;
+    if (popTask(id, &task)) {
+      execute(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(idle_mutex_);
+    idle_cond_.wait(lk, [this]() { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ == 0) return;
+  }
+}
+
+bool StageScheduler::popTask(int id, Task* task) {
+  {
+    Worker* self = workers_[id];
+    std::lock_guard<std::mutex> lk(self->mutex);
+    if (!self->tasks.empty()) {
+      *task = self->tasks.back();
+      self->tasks.pop_back();
+      queued_--;
+      return true;
+    }
+  }
+  for (int i = 1; i < workers(); i++) {
+    Worker* victim = workers_[(id + i) % workers()];
+    std::lock_guard<std::mutex> lk(victim->mutex);
+    if (!victim->tasks.empty()) {
+      *task = victim->tasks.front();
+      victim->tasks.pop_front();
+      queued_--;
+      steals_++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void StageScheduler::execute(const Task& task) {
+  Stage* stage = stages_[task.stage];
+  bool keep = false;
+  // Batches admitted before the source ran dry are dropped unseen.
+  if (task.stage != 0 || !source_done_) {
+    auto start = std::chrono::steady_clock::now();
+    keep = stage->func(task.batch);
+    stage->busy_us += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    stage->tasks++;
+  }
+
+  vector<int64_t> ready;
+  {
+    std::lock_guard<std::mutex> lk(stage->mutex);
+    stage->running--;
+    takeReady(stage, &ready);
+  }
+  for (auto batch : ready) {
+    dispatch({task.stage, batch});
+  }
+
+  if (keep && task.stage + 1 < stages_.size()) {
+    submit(task.stage + 1, task.batch);
+    return;
+  }
+  if (!keep) {
+    for (int s = task.stage + 1; s < stages_.size(); s++) {
+      skip(s, task.batch);
+    }
+  }
+  finishBatch(!keep && task.stage == 0);
+}
+
+void StageScheduler::submit(int stage_id, int64_t batch) {
+  Stage* stage = stages_[stage_id];
+  vector<int64_t> ready;
+  {
+    std::lock_guard<std::mutex> lk(stage->mutex);
+    stage->pending.insert(batch);
+    takeReady(stage, &ready);
+  }
+  for (auto b : ready) {
+    dispatch({stage_id, b});
+  }
+}
+
+void StageScheduler::skip(int stage_id, int64_t batch) {
+  Stage* stage = stages_[stage_id];
+  if (!stage->ordered) return;
+  vector<int64_t> ready;
+  {
+    std::lock_guard<std::mutex> lk(stage->mutex);
+    stage->skipped.insert(batch);
+    takeReady(stage, &ready);
+  }
+  for (auto b : ready) {
+    dispatch({stage_id, b});
+  }
+}
+
+// Moves the pending batches that may start now out of the stage. Called
+// with the stage mutex held.
+void StageScheduler::takeReady(Stage* stage, vector<int64_t>* ready) {
+  while (stage->running < stage->parallelism && !stage->pending.empty()) {
+    std::set<int64_t>::iterator it = stage->pending.begin();
+    if (stage->ordered) {
+      while (stage->skipped.erase(stage->next_batch)) {
+        stage->next_batch++;
+      }
+      if (*it != stage->next_batch) break;
+      stage->next_batch++;
+    }
+    ready->push_back(*it);
+    stage->pending.erase(it);
+    stage->running++;
+  }
+}
+
+void StageScheduler::dispatch(const Task& task) {
+  int id = tls_scheduler == this ? tls_worker
+                                 : round_robin_++ % workers();
+  {
+    Worker* worker = workers_[id];
+    std::lock_guard<std::mutex> lk(worker->mutex);
+    worker->tasks.push_back(task);
+    queued_++;
+  }
+  {
+    std::lock_guard<std::mutex> lk(idle_mutex_);
+  }
+  idle_cond_.notify_one();
+}
+
+void StageScheduler::finishBatch(bool end_of_stream) {
+  vector<int64_t> admitted;
+  {
+    std::lock_guard<std::mutex> lk(flow_mutex_);
+    if (end_of_stream) source_done_ = true;
+    in_flight_--;
+    while (!source_done_ && in_flight_ < max_in_flight_) {
+      admitted.push_back(next_batch_++);
+      in_flight_++;
+    }
+    // Notified under the lock: run() may return, and the scheduler be
+    // destroyed, as soon as the mutex is released.
+    if (source_done_ && in_flight_ == 0) done_cond_.notify_all();
+  }
+  for (auto batch : admitted) {
+    submit(0, batch);
+  }
+}
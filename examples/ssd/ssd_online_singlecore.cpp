@@ -51,10 +51,10 @@ DEFINE_double(confidencethreshold, 0.5,  "Only keep detections with score equal
                                           "to or higher than the threshold.");
 DEFINE_string(outputdir, ".", "The directory used to save output images and txt.");
 
-typedef OnDataProvider<float, Queue> OnDataProviderT;
-typedef OnRunner<float, Queue> OnRunnerT;
-typedef SsdOnPostProcessor<float, Queue> SsdOnPostProcessorT;
-typedef Pipeline<float, Queue> PipelineT;
+typedef OnDataProvider<float, LockFreeQueue> OnDataProviderT;
+typedef OnRunner<float, LockFreeQueue> OnRunnerT;
+typedef SsdOnPostProcessor<float, LockFreeQueue> SsdOnPostProcessorT;
+typedef Pipeline<float, LockFreeQueue> PipelineT;
 
 int main(int argc, char* argv[]) {
   {
@@ -51,10 +51,10 @@ DEFINE_string(outputdir, ".", "The directoy used to save output images");
 DEFINE_double(confidencethreshold, 0.005,  "Only keep detections with score equal "
                                           "to or higher than the threshold.");
 
-typedef OnDataProvider<float, Queue> OnDataProviderT;
-typedef OnRunner<float, Queue> OnRunnerT;
-typedef YoloV2OnPostProcessor<float, Queue> YoloV2OnPostProcessorT;
-typedef Pipeline<float, Queue> PipelineT;
+typedef OnDataProvider<float, LockFreeQueue> OnDataProviderT;
+typedef OnRunner<float, LockFreeQueue> OnRunnerT;
+typedef YoloV2OnPostProcessor<float, LockFreeQueue> YoloV2OnPostProcessorT;
+typedef Pipeline<float, LockFreeQueue> PipelineT;
 
 int main(int argc, char* argv[]) {
   {
@@ -445,6 +445,25 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+
+  /**
+   * @brief Keep the data in 16 bits, DT_FLOAT16 or DT_BFLOAT16, and release
+   *        its float memory; see util/half.hpp.
+   *
+   * Layers that know about it read half_data() instead of cpu_data(). Reading
+   * cpu_data() converts the data back into float memory once, which is kept
+   * besides; mutable_cpu_data() returns to float storage. Neither conversion
+   * is thread safe, layers shared between threads must read half_data().
+   */
+  void StoreHalf(BaseDataType type);
+  /// @brief The type of the 16 bit data, DT_INVALID when stored in float.
+  inline BaseDataType half_type() const {
+    return half_data_ ? half_type_ : DT_INVALID;
+  }
+  inline const uint16_t* half_data() const {
+    CHECK(half_data_) << "Blob is not stored in 16 bits";
+    return static_cast<const uint16_t*>(half_data_->cpu_data());
+  }
   /**
    * @brief Judge whether the blob's shape is identical to another.
    */
@@ -464,6 +483,8 @@ class Blob {
   shared_ptr<SyncedMemory> data_;
   shared_ptr<SyncedMemory> diff_;
   shared_ptr<SyncedMemory> shape_data_;
+  shared_ptr<SyncedMemory> half_data_;  ///< set by StoreHalf
+  BaseDataType half_type_;
   vector<int> shape_;
   int count_;     ///< the product of all a blob's dimensions.
   int capacity_;  ///< use to check whether to ask for more memory.
@@ -472,6 +493,10 @@ class Blob {
   // MLUTensorDesc mlu_tensor_desc_;
   MLUTensorDesc tensor_desc_;
 #endif
+  private:
+  /// Converts half_data_ into data_ if that holds nothing yet.
+  void ExpandHalf() const;
+
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
 
@@ -48,6 +48,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/device_alternate.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 // Convert macro to string
 #define STRINGIFY(m) #m
@@ -173,6 +174,19 @@ class Caffe {
    */
   enum class ReshapeMode { ALWAYS, SETUPONLY, NONE };
 
+  /**
+   * @brief SplitMode decides how Spliter cuts a network into SubNets in
+   *        Caffe::MFUS mode.
+   *
+   *  1. LINEAR   - walk layers in prototxt order and start a new SubNet
+   *                whenever mfus_supported() flips, default mode.
+   *  2. TOPOLOGY - group supported layers by the dependencies between
+   *                them, so an unsupported side branch does not break the
+   *                fused region. SubNets may hold non-contiguous layers,
+   *                thus it is not compatible with cpu_info segments.
+   */
+  enum class SplitMode { LINEAR, TOPOLOGY };
+
   // Some tools don't utilize real device, so a fake device is enough
   // for them to do their work.
   // When the flag is true, fake device is used.
@@ -256,6 +270,46 @@ class Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+  // The thread local settings of a thread, so that another thread can run
+  // a net with the same ones, see Net::CreateReplica(). The random
+  // generator and the device queues stay with each thread.
+  struct ThreadState {
+    Brew mode;
+    int solver_count;
+    int solver_rank;
+    bool multiprocess;
+#ifdef USE_MLU
+    int core_number;
+    int batchsize;
+    bool simple_flag;
+    BaseDataType top_dtype;
+    cnmlCoreVersion_t core_version;
+    ReshapeMode reshape_mode;
+    SplitMode split_mode;
+    bool detectop_mode;
+    int in_dataorder;
+    int out_dataorder;
+#endif  // USE_MLU
+  };
+  static ThreadState thread_state();
+  static void set_thread_state(const ThreadState& state);
+  // Host memory behind CaffeMallocHost is shared by all threads, so the
+  // allocator is process wide. type is "system" (default) or "pooled";
+  // huge_pages applies to the pooled allocator. Returns false when the
+  // allocator could not be switched, see HostAllocator::Set.
+  inline static bool set_host_allocator(const string& type,
+                                        bool huge_pages = false) {
+    return HostAllocator::Set(type, huge_pages);
+  }
+  inline static HostAllocStats host_alloc_stats() {
+    return HostAllocator::stats();
+  }
+  // Returns the host memory cached by the allocator to the system.
+  inline static void release_host_cache() { HostAllocator::Get()->Release(); }
+  // Sets the number of threads CPU layers split their loops over, shared by
+  // all threads; 1 (default) runs serially, <= 0 uses every hardware thread.
+  static void set_cpu_threads(int num_threads);
+  static int cpu_threads();
 #ifdef USE_MLU
   inline static void set_mlu_device(int dev_id) { Get().setDevice(dev_id); }
 
@@ -336,6 +390,19 @@ class Caffe {
       NOT_IMPLEMENTED << " Caffe::ReshapeMode " << mode;
     }
   }
+  inline static SplitMode splitMode() { return Get().split_mode_; }
+  inline static void setSplitMode(SplitMode mode) {
+    Get().split_mode_ = mode;
+  }
+  inline static void setSplitMode(const string& mode) {
+    if (mode.size() == 0 || boost::iequals(mode, "LINEAR")) {
+      setSplitMode(SplitMode::LINEAR);
+    } else if (boost::iequals(mode, "TOPOLOGY")) {
+      setSplitMode(SplitMode::TOPOLOGY);
+    } else {
+      NOT_IMPLEMENTED << " Caffe::SplitMode " << mode;
+    }
+  }
   inline static void setDetectOpMode(int status) {
     if (status) {
       Get().detectop_mode_ = true;
@@ -435,6 +502,7 @@ static int genModeltoMemory(const string& v,
   cnrtInvokeFuncParam_t compute_forw_param_;
   cnmlCoreVersion_t core_version_;
   ReshapeMode reshape_mode_ = ReshapeMode::SETUPONLY;
+  SplitMode split_mode_ = SplitMode::LINEAR;
   bool detectop_mode_;
   int in_dataorder_;
   int out_dataorder_;
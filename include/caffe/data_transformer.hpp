@@ -55,6 +55,11 @@ class DataTransformer {
    *    transformation.
    */
   void InitRand();
+  /**
+   * @brief Restarts the random stream from seed, e.g. before each item so
+   *        that items transformed in parallel stay reproducible.
+   */
+  void InitRand(unsigned int seed);
 
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -67,8 +72,22 @@ class DataTransformer {
    *    set_cpu_data() is used. See data_layer.cpp for an example.
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
+  /**
+   * @brief As above for a datum that isn't encoded, whose uint8 values are
+   *        read from pixels rather than its data, NULL for its float_data.
+   *        See ParseDatumInPlace().
+   */
+  void Transform(const Datum& datum, const char* pixels,
+                 Blob<Dtype>* transformed_blob);
 
   void VideoTransform(const VolumeDatum& datum, Blob<Dtype>* transformed_blob);
+  /**
+   * @brief As above for a datum that only carries the shape, with its uint8
+   *        values read from pixels, which VideoDataLayer decodes into a
+   *        buffer it reuses.
+   */
+  void VideoTransform(const VolumeDatum& datum, const char* pixels,
+                      Blob<Dtype>* transformed_blob);
 
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -253,6 +272,9 @@ class DataTransformer {
                  NormalizedBBox* crop_bbox, bool* do_mirror);
   void Transform(const Datum& datum, Dtype* transformed_data);
   void VideoTransform(const VolumeDatum& datum, Dtype* transformed_data);
+  // As above with the uint8 values in pixels, NULL for the float_data.
+  void VideoTransform(const VolumeDatum& datum, const char* pixels,
+                      Dtype* transformed_data);
 
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -260,6 +282,13 @@ class DataTransformer {
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob,
                  NormalizedBBox* crop_bbox, bool* do_mirror);
+  // As above with the uint8 values of a datum that isn't encoded in pixels.
+  void Transform(const Datum& datum, const char* pixels,
+                 Dtype* transformed_data, NormalizedBBox* crop_bbox,
+                 bool* do_mirror);
+  void Transform(const Datum& datum, const char* pixels,
+                 Blob<Dtype>* transformed_blob, NormalizedBBox* crop_bbox,
+                 bool* do_mirror);
 
   // Tranformation parameters
   TransformationParameter param_;
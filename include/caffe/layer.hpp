@@ -107,6 +107,9 @@ class Layer {
 #else
     Reshape(bottom, top);
 #endif
+    if (layer_param_.has_fused_activation()) {
+      SetUpFusedActivation(top);
+    }
     SetLossWeights(top);
   }
 
@@ -419,6 +422,23 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether Forward_cpu reads the weights, blobs_[0], through
+   *        Blob::half_data() when they are stored in 16 bits.
+   *
+   * The Net only stores the weights of such layers in 16 bits, see
+   * NetParameter cpu_weight_dtype.
+   */
+  virtual inline bool ReadsHalfWeights() const { return false; }
+
+  /**
+   * @brief Return whether Forward_cpu makes every top blob share the data of
+   *        bottom[0] (see Blob::ShareData) instead of writing its own.
+   *
+   * Net::PlanMemory treats such layers like in-place ones.
+   */
+  virtual inline bool ForwardSharesData() const { return false; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -623,6 +643,23 @@ class Layer {
     }
   }
 
+  /**
+   * Called by SetUp for a layer with an activation fused into it by the graph
+   * optimization passes (see LayerParameter fused_activation): adds the
+   * parameter blob of a fused PReLU.
+   */
+  void SetUpFusedActivation(const vector<Blob<Dtype>*>& top);
+  /// The slopes of a fused PReLU, NULL for any other activation.
+  const Dtype* fused_slope() const;
+  /**
+   * Applies the fused activation in place to the count values of top starting
+   * at its element offset, data pointing to the first of them. Forward_cpu
+   * calls it on the values it just wrote, slope is fused_slope() and read
+   * outside of any threads. Does nothing without a fused activation.
+   */
+  void ForwardFusedActivation(const Blob<Dtype>& top, const Dtype* slope,
+                              int offset, int count, Dtype* data) const;
+
   private:
   DISABLE_COPY_AND_ASSIGN(Layer);
 };  // class Layer
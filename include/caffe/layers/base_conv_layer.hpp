@@ -36,6 +36,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/int8_gemm.hpp"
 
 namespace caffe {
 
@@ -66,6 +67,12 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights, Dtype* output,
                         bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // forward_cpu_gemm and forward_cpu_bias in int8 (see util/int8_gemm.hpp);
+  // the weights are quantized on the first call. bias may be NULL.
+  void forward_cpu_gemm_int8(const Dtype* input, const Dtype* bias,
+                             Dtype* output);
+  // forward_cpu_gemm with the weights stored in 16 bits.
+  void forward_cpu_gemm_half(const Dtype* input, Dtype* output);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
                          Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype* weights);
@@ -124,6 +131,13 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool conv_first_;
   bool yuv_input_;
   bool use_pad_same_;
+  /// @brief Whether the forward runs in int8 on CPU, see UseCpuInt8().
+  bool int8_;
+  Int8Weights int8_weights_;
+  /// The weight memory and version int8_weights_ was packed from, so that
+  /// loading or sharing new weights repacks them.
+  shared_ptr<SyncedMemory> int8_weights_src_;
+  uint64_t int8_weights_version_;
 
   private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -197,6 +211,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int output_offset_;
 
   Blob<Dtype> bias_multiplier_;
+  vector<uint8_t> int8_col_buffer_;
 
   protected:  // accessed by subclass
   int conv_out_channels_;
@@ -47,6 +47,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  * This layer is a special case of ConvolutionLayer and MLUConvolutionLayer.
  * Refer to those two layers for more details.
+ *
+ * On CPU, 2D layers with group equal to the input channels run a direct
+ * depthwise kernel (see util/depthwise_conv.hpp) instead of im2col + GEMM;
+ * other configurations keep the GEMM path. Both run in int8 when
+ * UseCpuInt8() holds for the layer.
  */
 
 namespace caffe {
@@ -55,7 +60,7 @@ template <typename Dtype>
 class ConvolutionDepthwiseLayer : public BaseConvolutionLayer<Dtype> {
   public:
   explicit ConvolutionDepthwiseLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), direct_(false) {}
 
   virtual inline const char* type() const { return "ConvolutionDepthwise"; }
 
@@ -64,12 +69,26 @@ class ConvolutionDepthwiseLayer : public BaseConvolutionLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  // The direct kernel in int8.
+  void Forward_cpu_int8(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
                        const vector<Blob<Dtype>*>& top);
+
+  /// @brief Whether Forward_cpu/Backward_cpu use the direct kernel.
+  bool direct_;
+  /// @brief Filters and input of the int8 direct kernel, and its int32 sums.
+  vector<int8_t> int8_weight_;
+  vector<float> int8_step_;
+  /// The weight memory and version int8_weight_ was quantized from.
+  shared_ptr<SyncedMemory> int8_weight_src_;
+  uint64_t int8_weight_version_;
+  vector<int8_t> int8_input_;
+  vector<int32_t> int8_output_;
 };
 
 }  // namespace caffe
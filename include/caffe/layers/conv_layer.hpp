@@ -94,6 +94,7 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       : BaseConvolutionLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "Convolution"; }
+  virtual inline bool ReadsHalfWeights() const { return !this->int8_; }
 
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -30,6 +30,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef INCLUDE_CAFFE_LAYERS_DATA_LAYER_HPP_
 #define INCLUDE_CAFFE_LAYERS_DATA_LAYER_HPP_
 
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -39,9 +43,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+/// @brief Work of a DataLayer so far, times in microseconds.
+struct DataLoadStats {
+  uint64_t batches;
+  uint64_t items;
+  uint64_t read_us;       // reading the records from the db
+  uint64_t transform_us;  // parsing, decoding and transforming, all threads
+  uint64_t batch_us;      // load_batch from start to end
+};
+
 template <typename Dtype>
 class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   public:
@@ -53,15 +67,37 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 0; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline int MaxTopBlobs() const { return 2; }
+  /// @brief Safe to call while the prefetch thread runs.
+  DataLoadStats load_stats() const;
 
   protected:
   void Next();
   bool Skip();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Parses and transforms items [begin, end) of records_ into the batch.
+  void TransformItems(int thread, int begin, int end, Dtype* top_data,
+                      Dtype* top_label);
 
-  shared_ptr<db::DB> db_;
-  shared_ptr<db::Cursor> cursor_;
+  // One database per shard, read in turn from shard_.
+  vector<shared_ptr<db::DB> > dbs_;
+  vector<shared_ptr<db::Cursor> > cursors_;
+  int shard_;
   uint64_t offset_;
+  // The records of the batch being loaded, in place in the db when the
+  // cursor allows it and copied to values_ otherwise, and the seeds of their
+  // random streams, drawn in order so the batch doesn't depend on threads.
+  vector<std::pair<const char*, size_t> > records_;
+  vector<string> values_;
+  vector<unsigned int> seeds_;
+  shared_ptr<ThreadPool> decode_pool_;
+  // One transformer and one view into the batch per decode thread.
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  vector<shared_ptr<Blob<Dtype> > > transformed_;
+  std::atomic<uint64_t> batches_;
+  std::atomic<uint64_t> items_;
+  std::atomic<uint64_t> read_us_;
+  std::atomic<uint64_t> transform_us_;
+  std::atomic<uint64_t> batch_us_;
 };
 
 }  // namespace caffe
@@ -36,23 +36,37 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/// @brief Rows of one file read by HDF5DataLayer, one blob per top.
+template <typename Dtype>
+struct HDF5Chunk {
+  vector<shared_ptr<Blob<Dtype> > > blobs;
+  vector<unsigned int> permutation;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * Whole files are loaded at once, unless chunk_rows is set: then a
+ * background thread streams chunks of that many rows into one buffer while
+ * Forward reads from the other.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
   public:
   explicit HDF5DataLayer(const LayerParameter& param)
-      : Layer<Dtype>(param), offset_() {}
+      : Layer<Dtype>(param), offset_(), chunk_rows_(0), current_chunk_(-1),
+        stream_file_id_(-1), next_chunk_(0) {}
   virtual ~HDF5DataLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
@@ -79,6 +93,12 @@ class HDF5DataLayer : public Layer<Dtype> {
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom) {}
   virtual void LoadHDF5FileData(const char* filename);
+  // Streaming: the background thread fills chunks from chunk_free_ and hands
+  // them over through chunk_full_, Next moves on to the next full chunk.
+  virtual void InternalThreadEntry();
+  void LoadChunk(HDF5Chunk<Dtype>* chunk);
+  void OpenStreamFile(const string& filename);
+  void NextChunk();
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
@@ -88,6 +108,19 @@ class HDF5DataLayer : public Layer<Dtype> {
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
   uint64_t offset_;
+
+  int chunk_rows_;
+  vector<shared_ptr<HDF5Chunk<Dtype> > > chunks_;
+  BlockingQueue<int> chunk_free_;
+  BlockingQueue<int> chunk_full_;
+  int current_chunk_;
+  // State of the background thread: the open file, the shape of each top's
+  // dataset in it and the first rows of its chunks, in reading order.
+  hid_t stream_file_id_;
+  string stream_filename_;
+  vector<vector<int> > stream_shapes_;
+  vector<int> chunk_starts_;
+  int next_chunk_;
 };
 
 }  // namespace caffe
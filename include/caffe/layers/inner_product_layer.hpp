@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/int8_gemm.hpp"
 
 namespace caffe {
 
@@ -56,6 +57,9 @@ namespace caffe {
  * If transpose == true, any operations will be performed on the transpose
  * of the weight matrix. The weight matrix itself is not going to be transposed
  * but rather the transfer flag of operations will be toggled accordingly.
+ *
+ * The CPU forward runs in int8 when UseCpuInt8() holds for the layer, see
+ * util/int8_gemm.hpp, and reads weights stored in 16 bits block by block.
  */
 
 template <typename Dtype>
@@ -71,12 +75,15 @@ class InnerProductLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "InnerProduct"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool ReadsHalfWeights() const { return !int8_; }
 
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  // The gemm of Forward_cpu with the weights stored in 16 bits.
+  void Forward_cpu_half(const Dtype* bottom_data, Dtype* top_data);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
@@ -88,6 +95,13 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  bool int8_;       ///< if true, the CPU forward runs in int8
+  Int8Weights int8_weights_;
+  /// The weight memory and version int8_weights_ was packed from.
+  shared_ptr<SyncedMemory> int8_weights_src_;
+  uint64_t int8_weights_version_;
+  vector<uint8_t> int8_input_;
+  vector<Dtype> half_buffer_;  ///< see Forward_cpu_half
 };
 
 }  // namespace caffe
@@ -61,6 +61,7 @@ class PermuteLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Permute"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline bool ForwardSharesData() const { return !need_permute_; }
 
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -119,8 +120,11 @@ void reorg_cpu(const Dtype *bottom_data, const int b_w, const int b_h,
   int t_c = b_c / (stride * stride);
   int t_w = b_w * stride;
   int t_h = b_h * stride;
-  for (int n = 0; n < b_n; n++) {
-    for (int c = 0; c < b_c; c++) {
+  // Every (n, c) plane moves to its own place, planes are split over threads.
+  caffe_parallel_for(b_n * b_c, b_h * b_w, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      const int n = i / b_c;
+      const int c = i % b_c;
       for (int h = 0; h < b_h; h++) {
         for (int w = 0; w < b_w; w++) {
           int bottom_index = w + b_w * (h + b_h * (c + b_c * n));
@@ -136,7 +140,7 @@ void reorg_cpu(const Dtype *bottom_data, const int b_w, const int b_h,
         }
       }
     }
-  }
+  });
 }
 
 }  // namespace caffe
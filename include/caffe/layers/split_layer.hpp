@@ -55,6 +55,7 @@ class SplitLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Split"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline bool ForwardSharesData() const { return true; }
 
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -40,9 +40,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+class VideoClipReader;
+
 /**
  * @brief Provides data to the Net from image files.
  *
@@ -72,6 +75,35 @@ class VideoDataLayer : public BasePrefetchingDataLayer<Dtype> {
   vector<vector<int> > multiple_label_list_;
   vector<int> shuffle_index_;
   int lines_id_;
+
+  // A clip of the batch being loaded with the random draws it needs, taken
+  // in order so that the batch doesn't depend on the number of threads.
+  struct Clip {
+    int id;             // index into file_list_
+    int start_frm;      // < 0 draws the start of a video from rand
+    int sampling_rate;
+    unsigned int rand;
+    unsigned int seed;  // of the transformer
+    bool ok;
+  };
+  // Takes the clip at lines_id_ and moves on.
+  void NextClip(Clip* clip);
+  // Decodes clips_[items[i]] for i in [begin, end) into slabs_.
+  void ReadClips(int thread, const vector<int>& items, int begin, int end);
+  // Transforms items [begin, end) of slabs_ into the batch.
+  void TransformClips(int thread, int begin, int end, Dtype* top_data);
+
+  vector<Clip> clips_;
+  // The decoded frames of each item, reused from batch to batch, and their
+  // shape.
+  vector<vector<char> > slabs_;
+  vector<VolumeDatum> slab_shapes_;
+  shared_ptr<ThreadPool> decode_pool_;
+  // One reader, which keeps its video open, transformer and view into the
+  // batch per decode thread.
+  vector<shared_ptr<VideoClipReader> > readers_;
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  vector<shared_ptr<Blob<Dtype> > > transformed_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,117 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_LAYERS_WINOGRAD_CONV_LAYER_HPP_
+#define INCLUDE_CAFFE_LAYERS_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer with faster CPU forward algorithms, selected by
+ *        ConvolutionParameter engine WINOGRAD.
+ *
+ *   The algorithm is picked per input shape in Reshape and kept until the
+ *   shape changes:
+ *   - 3x3, stride 1, dilation 1 with at least kWinogradMinChannels input
+ *     channels per group: Winograd F(4x4, 3x3) when both output sides are at
+ *     least kWinogradLargeTile, F(2x2, 3x3) otherwise
+ *     (see util/winograd.hpp).
+ *   - 1x1 without padding: GEMM straight on the input, subsampled first when
+ *     strided, with no column buffer.
+ *   - anything else, and any layer running in int8 (see UseCpuInt8()): the
+ *     im2col + GEMM path of ConvolutionLayer.
+ *   Transformed filters are cached and rebuilt only when the weights change.
+ *   Backward always uses the im2col path; its column buffer is allocated on
+ *   the first Backward, so inference never pays for it.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+  public:
+  enum Algorithm {
+    GEMM,
+    DIRECT_1X1,
+    WINOGRAD_2X2,
+    WINOGRAD_4X4
+  };
+
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), algorithm_(GEMM),
+        col_buffer_ready_(false), weight_tf_version_(0),
+        weight_tf_tile_(0) {}
+
+  /// The Winograd and direct kernels read the float weights, storing them in
+  /// 16 bits would only add a second copy.
+  virtual inline bool ReadsHalfWeights() const { return false; }
+
+  /// @brief The algorithm selected for the current input shape.
+  inline Algorithm algorithm() const { return algorithm_; }
+
+  protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+                       const vector<Blob<Dtype>*>& top);
+
+  Algorithm SelectAlgorithm() const;
+  /// @brief Rebuilds weight_tf_ if the filters changed since the last call.
+  void UpdateTransformedWeight(int tile);
+  void Forward1x1(const Dtype* input, const Dtype* weight, Dtype* output);
+
+  static const int kWinogradMinChannels = 8;
+  static const int kWinogradLargeTile = 8;
+
+  Algorithm algorithm_;
+  /// @brief Input shape algorithm_ was selected for.
+  vector<int> selected_shape_;
+  bool col_buffer_ready_;
+  /// @brief Winograd-domain filters, and the memory and version of the
+  /// filters they came from.
+  Blob<Dtype> weight_tf_;
+  shared_ptr<SyncedMemory> weight_tf_src_;
+  uint64_t weight_tf_version_;
+  int weight_tf_tile_;
+  /// @brief Per-image workspace: transformed input (or the subsampled 1x1
+  /// input) and transformed output.
+  Blob<Dtype> input_tf_;
+  Blob<Dtype> output_tf_;
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_LAYERS_WINOGRAD_CONV_LAYER_HPP_
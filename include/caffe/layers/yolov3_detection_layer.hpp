@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/nms.hpp"
 
 namespace caffe {
 
@@ -68,6 +69,16 @@ class Yolov3DetectionLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom);
+  // Decodes the boxes of image n at scale whose objectness passes the
+  // confidence threshold into boxes_, from that image's slice of the bottom.
+  void DecodeBoxes(const Dtype* data, const int hw, const int grid_w,
+                   const Dtype* anchors, const int n, const int scale);
+  // Runs NMS on the decoded boxes of image n scoring above the threshold for
+  // class k and marks the kept ones in kept_. The other arguments are
+  // scratch space reused across calls.
+  void SuppressClass(const int n, const int k, NMSBoxes* boxes,
+                     vector<float>* scores, vector<int>* candidates,
+                     vector<int>* kept);
   // four blobs are saved const data about shape
   Blob<Dtype> c_arr_blob_;
   Blob<Dtype> h_arr_blob_;
@@ -79,7 +90,15 @@ class Yolov3DetectionLayer : public Layer<Dtype> {
   int im_h_, im_w_;
   float confidence_threshold_;
   float nms_threshold_;
-  vector<Dtype> x_y_offsets_;
+  // rows_offset_[i] is the first box row of bottom i within an image, the
+  // last entry the number of rows of an image. Row r of image n holds
+  // x1, y1, x2, y2 and the class probabilities at boxes_[(n * rows + r) *
+  // (4 + num_classes_)]; only the first boxes_count_[n * bottoms + i] rows
+  // of each bottom are decoded.
+  vector<int> rows_offset_;
+  vector<Dtype> boxes_;
+  vector<int> boxes_count_;
+  vector<char> kept_;
 };
 
 }  // namespace caffe
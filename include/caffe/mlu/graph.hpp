@@ -31,6 +31,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INCLUDE_CAFFE_MLU_GRAPH_HPP_
 #ifdef USE_MLU
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -79,6 +80,15 @@ class Graph {
                     unordered_set<Blob<Dtype>*>* one_side_bottoms,
                     unordered_set<Blob<Dtype>*>* one_side_tops);
 
+  /**
+   * @brief Get the execution order constraints between layers.
+   *        Unlike edges, "in place" blobs are resolved by layer index:
+   *        a layer depends on the last writer of each of its bottoms, and
+   *        a writer depends on every reader of the value it overwrites.
+   *        Thus every successor has a larger index than its predecessor.
+   */
+  void getDependencies(unordered_map<int, unordered_set<int> >* successors);
+
   inline bool empty() { return nodes_.empty(); }
 
   inline int nodes_num() { return nodes_.size(); }
@@ -208,6 +218,41 @@ void Graph<Dtype>::getNeighbors(int layer_index,
   }
 }
 
+template <typename Dtype>
+void Graph<Dtype>::getDependencies(
+    unordered_map<int, unordered_set<int> >* successors) {
+  vector<int> indexes;
+  for (auto node_pair : nodes_) {
+    indexes.push_back(node_pair.first);
+  }
+  std::sort(indexes.begin(), indexes.end());
+
+  unordered_map<Blob<Dtype>*, int> last_writer;
+  unordered_map<Blob<Dtype>*, vector<int> > readers;
+  auto depend = [successors](int from, int to) {
+    if (from != to) (*successors)[from].insert(to);
+  };
+  for (int index : indexes) {
+    (*successors)[index];
+    for (auto blob : nodes_[index]->bottom()) {
+      if (last_writer.find(blob) != last_writer.end()) {
+        depend(last_writer[blob], index);
+      }
+      readers[blob].push_back(index);
+    }
+    for (auto blob : nodes_[index]->top()) {
+      if (last_writer.find(blob) != last_writer.end()) {
+        depend(last_writer[blob], index);
+      }
+      for (int reader : readers[blob]) {
+        depend(reader, index);
+      }
+      readers[blob].clear();
+      last_writer[blob] = index;
+    }
+  }
+}
+
 template <typename Dtype>
 inline void Graph<Dtype>::init(const vector<int>& layers_index,
                                const vector<shared_ptr<Layer<Dtype> > >& layers,
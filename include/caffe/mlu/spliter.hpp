@@ -32,6 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef USE_MLU
 
 #include <algorithm>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -45,6 +46,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace caffe {
 
+/**
+ * @brief SplitStats describes the quality of a partition: the fewer SubNets
+ *        and bytes crossing SubNet boundaries, the fewer host round-trips.
+ */
+struct SplitStats {
+  int subnets = 0;
+  int mfus_subnets = 0;
+  int boundary_blobs = 0;
+  size_t boundary_bytes = 0;
+};
+
 /**
  * @brief Spliter splits a neural network into several SubNets according to
  *        whether these SubNet is supported by MLU.
@@ -52,6 +64,8 @@ namespace caffe {
  * During the process, the input/output Blobs of the SubNet are also drawed.
  * After spliting, the Reshape/Forward/Backward is conducted inside every
  * SubNets with the layer index of SubNet in a incremental order.
+ *
+ * How layers are grouped is decided by Caffe::splitMode(), see SplitMode.
  */
 template <typename Dtype>
 class Spliter {
@@ -60,28 +74,52 @@ class Spliter {
   explicit Spliter(shared_ptr<NetData<Dtype> > net) : net_(net) {
     CHECK(Caffe::mode() == Caffe::MFUS);
   }
+  /**
+   * @brief Build a Spliter with mocked mfus_supported() flags, one for each
+   *        layer. No MLU is involved, so partitions can be evaluated in
+   *        Caffe::CPU mode.
+   */
+  explicit Spliter(shared_ptr<NetData<Dtype> > net,
+                   const vector<bool>& mfus_supported)
+      : net_(net), mocked_supported_(mfus_supported) {
+    CHECK_EQ(mocked_supported_.size(), net_->size());
+  }
 
   void split(vector<shared_ptr<SubNet<Dtype> > >* subnets);
+  SplitStats stats(const vector<shared_ptr<SubNet<Dtype> > >& subnets);
   ~Spliter() {}
 
   private:
   shared_ptr<NetData<Dtype> > net_;
+  vector<bool> mocked_supported_;
 
   void findSubNet(vector<shared_ptr<SubNet<Dtype> > >* subnets);
+  void findSubNetByTopology(Graph<Dtype>* graph,
+                            vector<shared_ptr<SubNet<Dtype> > >* subnets);
+  void schedule(const unordered_map<int, unordered_set<int> >& successors,
+                bool start_supported, vector<vector<int> >* groups);
+  SplitStats groupStats(const vector<vector<int> >& groups);
   void buildSubNet(Graph<Dtype>* graph, shared_ptr<SubNet<Dtype> > subnet);
-  bool isMfusSupported(int i) { return net_->layers(i)->mfus_supported(); }
+  bool isMfusSupported(int i) {
+    if (!mocked_supported_.empty()) return mocked_supported_[i];
+    return net_->layers(i)->mfus_supported();
+  }
   int filterBlob(Blob<Dtype>* blob, shared_ptr<SubNet<Dtype> > subnet,
                  shared_ptr<NetData<Dtype> > net);
 };
 
 template <typename Dtype>
 void Spliter<Dtype>::split(vector<shared_ptr<SubNet<Dtype> > >* subnets) {
-  CHECK(Caffe::mode() == Caffe::MFUS);
+  CHECK(!mocked_supported_.empty() || Caffe::mode() == Caffe::MFUS);
   CHECK_EQ(subnets->size(), 0);
 
   Graph<Dtype> graph(net_->layers(), net_->bottom_vecs(), net_->top_vecs());
 
-  findSubNet(subnets);
+  if (Caffe::splitMode() == Caffe::SplitMode::TOPOLOGY) {
+    findSubNetByTopology(&graph, subnets);
+  } else {
+    findSubNet(subnets);
+  }
   for (auto &subnet : *subnets) {
     buildSubNet(&graph, subnet);
   }
@@ -113,6 +151,116 @@ void Spliter<Dtype>::findSubNet(vector<shared_ptr<SubNet<Dtype> > >* subnets) {
   }
 }
 
+/**
+ * @brief Group layers into SubNets following the dependency DAG.
+ *
+ * Layers are scheduled in a topological order that keeps emitting layers
+ * with the same mfus_supported() flag as long as any of them is ready, and
+ * only switches to the other flag when it has to. Every SubNet is then a
+ * contiguous run of that order, which makes it convex(no path leaves and
+ * re-enters it), and SubNets themselves are in a valid execution order.
+ * Both starting flags are tried and the partition with fewer SubNets, then
+ * fewer boundary bytes, wins.
+ */
+template <typename Dtype>
+void Spliter<Dtype>::findSubNetByTopology(
+    Graph<Dtype>* graph, vector<shared_ptr<SubNet<Dtype> > >* subnets) {
+  unordered_map<int, unordered_set<int> > successors;
+  graph->getDependencies(&successors);
+
+  vector<vector<int> > best;
+  SplitStats best_stats;
+  for (bool start_supported : {true, false}) {
+    vector<vector<int> > groups;
+    schedule(successors, start_supported, &groups);
+    SplitStats groups_stats = groupStats(groups);
+    if (best.empty() || groups_stats.subnets < best_stats.subnets ||
+        (groups_stats.subnets == best_stats.subnets &&
+         groups_stats.boundary_bytes < best_stats.boundary_bytes)) {
+      best.swap(groups);
+      best_stats = groups_stats;
+    }
+  }
+
+  for (int i = 0; i < best.size(); i++) {
+    shared_ptr<SubNet<Dtype> > subnet(new SubNet<Dtype>(
+        isMfusSupported(best[i][0]), net_, best[i], i));
+    subnets->push_back(subnet);
+  }
+}
+
+template <typename Dtype>
+void Spliter<Dtype>::schedule(
+    const unordered_map<int, unordered_set<int> >& successors,
+    bool start_supported, vector<vector<int> >* groups) {
+  unordered_map<int, int> indegree;
+  for (auto& node : successors) {
+    indegree[node.first];
+    for (int next : node.second) {
+      indegree[next]++;
+    }
+  }
+  // ready[flag] keeps layers whose predecessors are all scheduled, ordered
+  // by index so that the result is deterministic.
+  set<int> ready[2];
+  for (auto& node : indegree) {
+    if (node.second == 0) {
+      ready[isMfusSupported(node.first)].insert(node.first);
+    }
+  }
+
+  bool current = start_supported;
+  while (!ready[0].empty() || !ready[1].empty()) {
+    if (ready[current].empty()) current = !current;
+    vector<int> group;
+    while (!ready[current].empty()) {
+      int index = *ready[current].begin();
+      ready[current].erase(ready[current].begin());
+      group.push_back(index);
+      for (int next : successors.at(index)) {
+        if (--indegree[next] == 0) {
+          ready[isMfusSupported(next)].insert(next);
+        }
+      }
+    }
+    // layer index order is a valid topological order as well.
+    std::sort(group.begin(), group.end());
+    groups->push_back(group);
+  }
+}
+
+template <typename Dtype>
+SplitStats Spliter<Dtype>::groupStats(const vector<vector<int> >& groups) {
+  SplitStats split_stats;
+  unordered_map<Blob<Dtype>*, unordered_set<int> > blob_groups;
+  for (int i = 0; i < groups.size(); i++) {
+    split_stats.subnets++;
+    if (isMfusSupported(groups[i][0])) split_stats.mfus_subnets++;
+    for (int layer : groups[i]) {
+      for (auto blob : net_->bottom_vecs(layer)) blob_groups[blob].insert(i);
+      for (auto blob : net_->top_vecs(layer)) blob_groups[blob].insert(i);
+    }
+  }
+  // a blob touched by k SubNets is handed over k - 1 times.
+  for (auto& blob_group : blob_groups) {
+    if (blob_group.second.size() < 2) continue;
+    split_stats.boundary_blobs++;
+    split_stats.boundary_bytes += (blob_group.second.size() - 1) *
+        blob_group.first->count() * sizeof(Dtype);
+  }
+  return split_stats;
+}
+
+template <typename Dtype>
+SplitStats Spliter<Dtype>::stats(
+    const vector<shared_ptr<SubNet<Dtype> > >& subnets) {
+  vector<vector<int> > groups;
+  for (auto& subnet : subnets) {
+    groups.push_back(subnet->layers());
+  }
+  return groupStats(groups);
+}
+
 template <typename Dtype>
 int Spliter<Dtype>::filterBlob(Blob<Dtype>* blob,
                                shared_ptr<SubNet<Dtype> > subnet,
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef INCLUDE_CAFFE_NET_HPP_
 #define INCLUDE_CAFFE_NET_HPP_
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
@@ -41,6 +42,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/compile.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/memory_planner.hpp"
 
 #ifdef USE_MLU
 #include "caffe/mlu/reshape_helper.hpp"
@@ -168,6 +172,40 @@ class Net {
    */
   void Reshape();
 
+  /**
+   * @brief Share one arena among intermediate activations whose lifetimes
+   *        do not overlap. Only for TEST phase nets in CPU mode.
+   *
+   * Lifetimes come from bottom_vecs_/top_vecs_ in layer order. Blobs sharing
+   * a SyncedMemory (in-place layers, ShareData) are planned as one buffer.
+   * Net inputs, net outputs and tops of layers without bottoms keep their
+   * own memory. Called by Init when NetParameter.plan_memory is set, and
+   * again by Reshape.
+   */
+  void PlanMemory();
+  /// @brief returns the activation memory plan, NULL when not planned
+  inline const shared_ptr<MemoryPlanner>& memory_plan() const {
+    return memory_plan_;
+  }
+
+  /**
+   * @brief Use caller-owned memory as the host data of a blob, so that
+   *        feeding or reading it costs no copy.
+   *
+   * Only blobs visible outside of Forward can be bound: net inputs, net
+   * outputs and tops of layers without bottoms. data must hold at least
+   * count elements, be aligned to sizeof(Dtype) (64 bytes suits vectorized
+   * layers best) and stay valid until the blob is unbound. Forward checks
+   * that no Reshape has replaced or outgrown a bound buffer.
+   */
+  void BindBlob(const string& blob_name, Dtype* data, size_t count);
+  /// @brief Stop using a bound buffer; the blob gets fresh memory on use.
+  void UnbindBlob(const string& blob_name);
+  void UnbindBlobs();
+  inline bool is_bound(const string& blob_name) const {
+    return bound_blobs_.count(blob_name) > 0;
+  }
+
   Dtype ForwardBackward() {
     Dtype loss;
     Forward(&loss);
@@ -188,8 +226,26 @@ class Net {
   /**
    * @brief For an already initialized net, implicitly copies (i.e., using no
    *        additional memory) the pre-trained layers from another Net.
+   *        Mapped weights files of other stay mapped as long as this net
+   *        lives.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief Creates a TEST net of the same model that shares this net's
+   *        parameter blobs and owns only its activations, so that several
+   *        threads can each serve a replica of one model held in memory once.
+   *
+   * The replica is set up with the Caffe settings of the thread that created
+   * this net; a thread running a replica first calls
+   * Caffe::set_thread_state(replica->thread_state()). The weights are shared
+   * read-only: they must not be changed while replicas are running. Weights
+   * kept in 16 bits that a layer reads as float are expanded beforehand.
+   */
+  shared_ptr<Net<Dtype>> CreateReplica() const;
+  /// @brief The Caffe settings of the thread that created the net.
+  inline const Caffe::ThreadState& thread_state() const {
+    return thread_state_;
+  }
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -202,6 +258,12 @@ class Net {
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(void* buffer, int buffer_size);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Points the float weights at a mapped weights file instead of
+   *        copying them, see util/mapped_weights.hpp. CopyTrainedLayersFrom()
+   *        recognizes such files.
+   */
+  void CopyTrainedLayersFromMapped(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -308,6 +370,19 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /**
+   * @brief The parameter the layers were built from: the input after
+   *        filtering and, for a TEST net on CPU or GPU with opt_level > 0,
+   *        after the graph optimization passes of util/net_optimizer.hpp.
+   */
+  inline const NetParameter& optimized_param() const {
+    return optimized_param_;
+  }
+  /// @brief The mapped weights files the weights of the net point into.
+  inline const vector<shared_ptr<MappedWeights> >& mapped_weights() const {
+    return mapped_weights_;
+  }
+
   inline const NetParameter net_param_without_weights() {
     return net_param_without_weights_;
   }
@@ -331,6 +406,8 @@ class Net {
   class Callback {
     protected:
     virtual void run(int layer) = 0;
+    // Invoked around each SubNet in MFUS mode, whose layers run fused.
+    virtual void run_subnet(int subnet) {}
 
     template <typename T>
     friend class Net;
@@ -339,6 +416,14 @@ class Net {
   void add_before_forward(Callback* value) { before_forward_.push_back(value); }
   const vector<Callback*>& after_forward() const { return after_forward_; }
   void add_after_forward(Callback* value) { after_forward_.push_back(value); }
+  /// @brief Unregister a callback added by add_before_forward or
+  ///        add_after_forward.
+  void remove_forward_callback(Callback* value) {
+    before_forward_.erase(std::remove(before_forward_.begin(),
+        before_forward_.end(), value), before_forward_.end());
+    after_forward_.erase(std::remove(after_forward_.begin(),
+        after_forward_.end(), value), after_forward_.end());
+  }
   const vector<Callback*>& before_backward() const { return before_backward_; }
   void add_before_backward(Callback* value) {
     before_backward_.push_back(value);
@@ -350,17 +435,19 @@ class Net {
   void set_dump_top_idx(set<int> idx) { dump_top_idx_ = idx; }
 
 #ifdef USE_MLU
-  // @breif offline net execute
+  // @breif offline net execute, cpuData[0] holds data_count input elements
   void OfflineNetRun(const SegmentInfo& seg_info,
                      const cnrtModel_t& model,
                      const cnrtDataType_t& dtype,
-                     void** cpuData);
+                     void** cpuData, size_t data_count);
 
   // @breif destroy offline resource
   void OfflineDestroy();
 
   // @breif control if append cpu info into offlinemodel file
   inline void set_cpu_info_flag(bool flag) { set_cpu_info_ = flag; }
+  /// @brief SubNets run by ForwardFromTo_mfus, in execution order.
+  const vector<shared_ptr<SubNet<Dtype>>>& subnets() const { return subnets_; }
   void RecalculateWeightsInt8Info(shared_ptr<Blob<Dtype>> weights_blob,
     const LayerParameter& param);
 #endif
@@ -409,12 +496,18 @@ class Net {
   void OfflineMluSubnetRun(const cnrtModel_t& model,
                            const cnrtDataType_t& dtype,
                            const SegmentInfoUnit& unit_info,
-                           void** cpuData);
+                           void** cpuData, size_t data_count);
 
   // @breif cpu subnet execute
   void OfflineCpuSubnetRun(const SegmentInfoUnit& unit_info);
 
 #endif
+  /// @brief Builds a replica of source, see CreateReplica().
+  Net(const NetParameter& param, const Net* source);
+  /// The net whose parameters Init() shares while building a replica.
+  const Net* replica_source_;
+  /// The Caffe settings Init() ran with.
+  Caffe::ThreadState thread_state_;
   /// @brief The network name
   string name_;
   /// @brief The phase: TRAIN or TEST
@@ -481,6 +574,33 @@ class Net {
   set<int> dump_top_idx_;
 
   NetParameter net_param_without_weights_;
+  NetParameter optimized_param_;
+  /// Whether trained weights are folded by FoldTrainedWeights() before they
+  /// are copied, see optimized_param().
+  bool fold_trained_weights_;
+  void CopyTrainedLayers(const NetParameter& param);
+  /// The 16 bit type of the weights of layers that read them so, DT_INVALID
+  /// for float; see NetParameter cpu_weight_dtype.
+  BaseDataType half_weights_;
+  void StoreHalfWeights();
+  /// The files the weights point into, see CopyTrainedLayersFromMapped().
+  vector<shared_ptr<MappedWeights> > mapped_weights_;
+  /// Activation memory planning, see PlanMemory()
+  bool plan_memory_;
+  shared_ptr<MemoryPlanner> memory_plan_;
+  shared_ptr<SyncedMemory> memory_arena_;
+  /// The buffers memory_plan_ placed and their sizes, kept to notice when
+  /// a Reshape() grew any of them.
+  vector<shared_ptr<SyncedMemory> > planned_mems_;
+  vector<size_t> planned_sizes_;
+  /// Caller-owned buffers, see BindBlob()
+  struct BoundBlob {
+    Blob<Dtype>* blob;
+    SyncedMemory* memory;
+    size_t count;
+  };
+  map<string, BoundBlob> bound_blobs_;
+  void CheckBoundBlobs() const;
 #ifdef USE_MLU
   shared_ptr<NetData<Dtype>> net_data_;
   shared_ptr<ReshapeHelper<Dtype>> reshape_helper_;
@@ -33,12 +33,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cstdlib>
 #include <vector>
 
-#ifdef USE_MKL
-  #include "mkl.h"
-#endif
-
 #include "caffe/common.hpp"
 #include "caffe/mlu/tensor.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 namespace caffe {
 
@@ -47,6 +44,8 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
+// Otherwise the memory comes from the active HostAllocator, see
+// Caffe::set_host_allocator.
 inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
 #ifdef USE_CUDA
   if (Caffe::mode() == Caffe::GPU) {
@@ -55,11 +54,7 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  *ptr = mkl_malloc(size ? size:1, 64);
-#else
-  *ptr = malloc(size);
-#endif
+  *ptr = HostAllocator::Get()->Allocate(size);
   *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
@@ -71,13 +66,16 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  mkl_free(ptr);
-#else
-  free(ptr);
-#endif
+  HostAllocator::Get()->Free(ptr);
 }
 
+/// @brief Process-wide host<->device copies made by SyncedMemory.
+struct MemorySyncStats {
+  uint64_t host_to_device;
+  uint64_t device_to_host;
+  uint64_t host_to_device_bytes;
+  uint64_t device_to_host_bytes;
+};
 
 /**
  * @brief Manages memory allocation and synchronization between the host (CPU)
@@ -104,6 +102,10 @@ class SyncedMemory {
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
+  // Forget a buffer given to set_cpu_data(). If the host copy is the newest
+  // one it is copied into owned memory, otherwise the in-sync device copy is
+  // kept and the host memory is reallocated on the next access.
+  void reset_cpu_data();
   const void* gpu_data();
   void set_gpu_data(void* data);
   void* mutable_cpu_data();
@@ -119,6 +121,12 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, HEAD_AT_MLU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /// @brief Bumped whenever the contents may change, i.e. on every mutable
+  ///        access or new buffer, so that caches derived from the data can
+  ///        tell they are stale.
+  inline uint64_t version() const { return version_; }
+  /// @brief Copies made by every SyncedMemory so far, for profiling.
+  static MemorySyncStats sync_stats();
 
 #ifdef USE_CUDA
   void async_gpu_push(const cudaStream_t& stream);
@@ -133,6 +141,7 @@ class SyncedMemory {
   void* gpu_ptr_;
   size_t size_;
   SyncedHead head_;
+  uint64_t version_;
 
 #ifdef USE_MLU
   void* mlu_ptr_;
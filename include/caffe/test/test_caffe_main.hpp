@@ -49,6 +49,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
   getenv("TEST_SOURCE_PATH") == nullptr ? \
   "src/caffe/test/test_data/" : getenv("TEST_SOURCE_PATH")
 #endif
+// Prefix of repo files read by tests, set by the CMake test target; other
+// builds run the tests from the repo root.
+#ifndef CMAKE_SOURCE_DIR
+#define CMAKE_SOURCE_DIR ""
+#endif
 #define core_version getenv("GTEST_CORE_VERSION")
 
 #define OUTPUT(message, value) \
@@ -0,0 +1,130 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_BATCHING_SERVER_HPP_
+#define INCLUDE_CAFFE_UTIL_BATCHING_SERVER_HPP_
+
+#include <stdint.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <future>  // NOLINT(build/c++11)
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/// @brief Counters of one BatchingServer, see BatchingServer::stats.
+struct BatchingStats {
+  uint64_t requests;      // requests answered
+  uint64_t batches;       // forward passes run
+  uint64_t full_batches;  // batches sent full rather than at the deadline
+  int max_batch;
+  double p50_ms;          // median latency from Submit() to the result
+  double p99_ms;          // 99th percentile of the same
+
+  /// @brief Requests per forward pass.
+  inline double mean_batch() const {
+    return batches ? static_cast<double>(requests) / batches : 0;
+  }
+  /// @brief Fraction of the max_batch slots the batches filled.
+  inline double batch_fill() const { return mean_batch() / max_batch; }
+};
+
+/**
+ * @brief Groups single sample requests into batches for a TEST net.
+ *
+ * Submit() queues one sample per net input and returns a future of the
+ * sample's rows of every net output. A worker sends the waiting requests
+ * once max_batch of them are queued or the oldest one has waited
+ * max_delay_ms: it reshapes the first axis of the inputs to the batch size,
+ * runs one forward pass and hands every request its rows back. Each net
+ * gets its own worker thread, so several replicas of one model, see
+ * Net::CreateReplica(), serve one queue. The nets must take their inputs
+ * from Input layers, batched along the first axis; the outputs must be
+ * batched along the first axis as well. Submit() and stats() are thread
+ * safe.
+ */
+template <typename Dtype>
+class BatchingServer {
+  public:
+  /// One vector per net input or output, holding one sample.
+  typedef vector<vector<Dtype> > Sample;
+
+  BatchingServer(const vector<Net<Dtype>*>& nets, int max_batch,
+                 double max_delay_ms);
+  ~BatchingServer();
+
+  std::future<Sample> Submit(Sample inputs);
+  /// @brief The counters, with the latency percentiles taken over the most
+  ///        recent requests.
+  BatchingStats stats();
+  /// @brief Resets the counters and the latency window.
+  void ResetStats();
+
+  /// @brief Number of values of one sample of each net input.
+  inline const vector<int>& input_counts() const { return input_counts_; }
+
+  private:
+  typedef std::chrono::steady_clock Clock;
+  struct Request {
+    Sample inputs;
+    std::promise<Sample> result;
+    Clock::time_point arrival;
+  };
+
+  void Work(Net<Dtype>* net);
+  void Forward(Net<Dtype>* net, vector<Request>* batch);
+
+  const int max_batch_;
+  const Clock::duration max_delay_;
+  vector<int> input_counts_;
+  vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Request> queue_;
+  bool stop_;
+
+  std::mutex stats_mutex_;
+  BatchingStats stats_;
+  vector<double> latencies_ms_;  // ring of the most recent latencies
+  size_t next_latency_;
+
+  DISABLE_COPY_AND_ASSIGN(BatchingServer);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_BATCHING_SERVER_HPP_
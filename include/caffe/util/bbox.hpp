@@ -42,6 +42,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include "glog/logging.h"
 #include "caffe/caffe.hpp"
+#include "caffe/util/nms.hpp"
 
 namespace caffe {
 
@@ -229,53 +230,39 @@ void get_region_box(Dtype* x, PredictionResult<Dtype>* predict,
 template <typename Dtype>
 void ApplyNms(vector<PredictionResult<Dtype> >* boxes, vector<int>* idxes,
               Dtype threshold, vector< vector<float>>* result, int b, int num_classes_) {
-  float fScale = 1.0;
+  NMSParam param;
+  param.overlap_threshold = threshold;
+  param.suppress_equal = true;
   for (int k = 0; k < num_classes_; k++) {
-    vector<PredictionResult<Dtype>> cur_boxes;
+    vector<int> cur_boxes;
+    NMSBoxes nms_boxes;
+    vector<float> scores;
     for (int i = 0; i < (*boxes).size(); i++) {
-      if ((*boxes)[i].classType == k) {
-        cur_boxes.push_back((*boxes)[i]);
+      const PredictionResult<Dtype>& box = (*boxes)[i];
+      if (box.classType == k) {
+        NormalizedBBox bbox;
+        setNormalizedBBox(&bbox, box.x, box.y, box.w, box.h);
+        nms_boxes.push_back(bbox.xmin(), bbox.ymin(), bbox.xmax(), bbox.ymax(),
+                            bbox.size());
+        scores.push_back(box.confidence);
+        cur_boxes.push_back(i);
       }
     }
     if (cur_boxes.empty()) continue;
-    std::sort(cur_boxes.begin(), cur_boxes.end(),
-        [](const PredictionResult<Dtype>& pa, const PredictionResult<Dtype>& pb){
-          float diff = pa.confidence - pb.confidence;
-          if (diff > 0) return 1;
-          return 0;
-        });
+    vector<int> kept;
+    NonMaxSuppression(nms_boxes, scores.data(), param, &kept);
 
-    map<int, int> idx_map;
-    for (int i = 0; i < cur_boxes.size() - 1; ++i) {
-      if (idx_map.find(i) != idx_map.end()) continue;
-      for (int j = i + 1; j < cur_boxes.size(); ++j) {
-        if (idx_map.find(j) != idx_map.end()) continue;
-        NormalizedBBox Bbox1, Bbox2;
-        setNormalizedBBox(&Bbox1, cur_boxes[i].x,
-            cur_boxes[i].y, cur_boxes[i].w*fScale, cur_boxes[i].h*fScale);
-        setNormalizedBBox(&Bbox2, cur_boxes[j].x,
-            cur_boxes[j].y, cur_boxes[j].w*fScale, cur_boxes[j].h*fScale);
-        float overlap = JaccardOverlap(Bbox1, Bbox2, true);
-        if (overlap >= threshold) {
-          if (cur_boxes[i].confidence > cur_boxes[j].confidence) idx_map[j] = 1;
-          else
-            idx_map[i] = 1;
-        }
-      }
-    }
-
-    for (int i = 0; i < cur_boxes.size(); ++i) {
-      if (idx_map.find(i) == idx_map.end()) {
-        std::vector<float> tmp;
-        tmp.push_back(b);
-        tmp.push_back(cur_boxes[i].classType);
-        tmp.push_back(cur_boxes[i].confidence);
-        tmp.push_back(cur_boxes[i].x);
-        tmp.push_back(cur_boxes[i].y);
-        tmp.push_back(cur_boxes[i].w);
-        tmp.push_back(cur_boxes[i].h);
-        (*result).push_back(tmp);
-      }
+    for (int i = 0; i < kept.size(); ++i) {
+      const PredictionResult<Dtype>& box = (*boxes)[cur_boxes[kept[i]]];
+      std::vector<float> tmp;
+      tmp.push_back(b);
+      tmp.push_back(box.classType);
+      tmp.push_back(box.confidence);
+      tmp.push_back(box.x);
+      tmp.push_back(box.y);
+      tmp.push_back(box.w);
+      tmp.push_back(box.h);
+      (*result).push_back(tmp);
     }
   }
 }
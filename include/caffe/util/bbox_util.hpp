@@ -46,6 +46,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "glog/logging.h"
 
 #include "caffe/caffe.hpp"
+#include "caffe/util/nms.hpp"
 
 namespace caffe {
 
@@ -274,10 +275,8 @@ void GetMaxScoreIndex(const vector<float>& scores, const float threshold,
 //    scores: a set of corresponding confidences.
 //    threshold: the threshold used in non maximu suppression.
 //    top_k: if not -1, keep at most top_k picked indices.
-//    reuse_overlaps: if true, use and update overlaps; otherwise, always
-//      compute overlap.
-//    overlaps: a temp place to optionally store the overlaps between pairs of
-//      bboxes if reuse_overlaps is true.
+//    reuse_overlaps, overlaps: unused, the overlaps of NonMaxSuppression are
+//      cheaper to recompute than to look up.
 //    indices: the kept indices of bboxes after nms.
 void ApplyNMS(const vector<NormalizedBBox>& bboxes, const vector<float>& scores,
               const float threshold, const int top_k, const bool reuse_overlaps,
@@ -299,6 +298,10 @@ void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
                   const float nms_threshold, const int top_k,
                   vector<int>* indices);
 
+// Copies bboxes into the structure-of-arrays layout of NonMaxSuppression,
+// keeping the size of bboxes that have one as BBoxSize does.
+void GetNMSBoxes(const vector<NormalizedBBox>& bboxes, NMSBoxes* boxes);
+
 // Compute cumsum of a set of pairs.
 void CumSum(const vector<pair<float, int> >& pairs, vector<int>* cumsum);
 
@@ -47,6 +47,13 @@ class Cursor {
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  /**
+   * @brief Points data at the value without copying it when the backend
+   *        can, which keeps it valid and unchanged while the cursor lives.
+   */
+  virtual bool value_in_place(const char** data, size_t* size) {
+    return false;
+  }
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
@@ -77,6 +84,12 @@ class DB {
 DB* GetDB(DataParameter::DB backend);
 DB* GetDB(const string& backend);
 
+/**
+ * @brief The database of shard shard of a set of shards written to source,
+ *        source itself when there is only one. See DataParameter shards.
+ */
+string ShardSource(const string& source, int shard, int shards);
+
 }  // namespace db
 }  // namespace caffe
 
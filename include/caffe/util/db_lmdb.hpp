@@ -64,6 +64,12 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
                   mdb_value_.mv_size);
   }
+  // The pages of a read-only transaction stay mapped until it ends.
+  virtual bool value_in_place(const char** data, size_t* size) {
+    *data = static_cast<const char*>(mdb_value_.mv_data);
+    *size = mdb_value_.mv_size;
+    return true;
+  }
   virtual bool valid() { return valid_; }
 
   private:
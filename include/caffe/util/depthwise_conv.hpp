@@ -0,0 +1,90 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_DEPTHWISE_CONV_HPP_
+#define INCLUDE_CAFFE_UTIL_DEPTHWISE_CONV_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/*
+ * Direct depthwise convolution of one image, without im2col. Output channel
+ * c * multiplier + m reads input channel c with its own kernel_h x kernel_w
+ * filter. Only the top and left pads are needed: the bottom and right ones
+ * are implied by output_h and output_w, so asymmetric pads work as computed
+ * in ConvolutionDepthwiseLayer::compute_output_shape.
+ *
+ * The float forward uses AVX-512 or AVX2 for stride 1 and 2 when the CPU
+ * supports it, everything else runs a scalar loop.
+ */
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* data_im, const int channels,
+    const int multiplier, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const Dtype* weight, const Dtype* bias,
+    Dtype* data_out);
+
+// depthwise_conv_cpu on int8 inputs and filters, without bias; the int32
+// sums are left for the caller to scale.
+void depthwise_conv_int8_cpu(const int8_t* data_im, const int channels,
+    const int multiplier, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const int8_t* weight, int32_t* data_out);
+
+// Gradient w.r.t. the input, overwrites data_im_diff.
+template <typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* top_diff,
+    const int channels, const int multiplier, const int height,
+    const int width, const int kernel_h, const int kernel_w,
+    const int pad_htop, const int pad_wleft, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, const Dtype* weight,
+    Dtype* data_im_diff);
+
+// Gradient w.r.t. the filters, accumulated into weight_diff.
+template <typename Dtype>
+void depthwise_conv_backward_weight_cpu(const Dtype* top_diff,
+    const Dtype* data_im, const int channels, const int multiplier,
+    const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_htop, const int pad_wleft,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    Dtype* weight_diff);
+
+// Instruction set used by the float forward: "avx512", "avx2" or "scalar".
+const char* depthwise_conv_isa();
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_DEPTHWISE_CONV_HPP_
@@ -0,0 +1,89 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_HALF_HPP_
+#define INCLUDE_CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/*
+ * 16 bit storage of floating point values on CPU: DT_FLOAT16 is IEEE half
+ * precision, DT_BFLOAT16 the upper half of a float, which keeps its range
+ * but only 8 bits of precision. Both round to nearest even and keep
+ * infinities and NaNs. Float arrays convert with F16C and AVX2 when the CPU
+ * has them, everything else runs a scalar loop.
+ */
+
+/// @brief Whether type is DT_FLOAT16 or DT_BFLOAT16.
+inline bool IsHalfType(const BaseDataType type) {
+  return type == DT_FLOAT16 || type == DT_BFLOAT16;
+}
+
+template <typename Dtype>
+void caffe_cpu_to_half(const int n, const Dtype* x, const BaseDataType type,
+    uint16_t* y);
+
+template <typename Dtype>
+void caffe_cpu_from_half(const int n, const uint16_t* x,
+    const BaseDataType type, Dtype* y);
+
+/// Instruction set used by the float conversions: "avx2" or "scalar".
+const char* half_conversion_isa();
+
+/**
+ * @brief Calls fn(begin, end, rows) for consecutive blocks of rows of the
+ *        rows x cols matrix x stored in type, where rows holds the rows
+ *        [begin, end) converted to Dtype. A block has about a million values,
+ *        enough rows for an efficient GEMM while the converted copy stays
+ *        small next to the whole matrix.
+ */
+template <typename Dtype, typename Fn>
+void caffe_cpu_half_row_blocks(const uint16_t* x, const BaseDataType type,
+    const int rows, const int cols, Fn fn) {
+  const int block = std::max(1, (1 << 20) / std::max(1, cols));
+  // One buffer per thread, shared by all the layers it runs.
+  static thread_local std::vector<Dtype> buffer;
+  for (int begin = 0; begin < rows; begin += block) {
+    const int end = std::min(rows, begin + block);
+    buffer.resize(static_cast<size_t>(end - begin) * cols);
+    caffe_cpu_from_half(static_cast<int>(buffer.size()),
+        x + static_cast<size_t>(begin) * cols, type, buffer.data());
+    fn(begin, end, buffer.data());
+  }
+}
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_HALF_HPP_
@@ -31,7 +31,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INCLUDE_CAFFE_UTIL_HDF5_HPP_
 #ifdef USE_HDF5
 
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
+#include <vector>
 
 #include "hdf5.h"     // NOLINT
 #include "hdf5_hl.h"  // NOLINT
@@ -49,6 +51,26 @@ template <typename Dtype>
 void hdf5_load_nd_dataset(hid_t file_id, const char* dataset_name_, int min_dim,
                           int max_dim, Blob<Dtype>* blob, bool reshape = false);
 
+/// @brief Verifies a dataset as hdf5_load_nd_dataset does and returns its
+///        shape without reading it.
+vector<int> hdf5_get_nd_dataset_shape(hid_t file_id, const char* dataset_name_,
+                                      int min_dim, int max_dim);
+
+/// @brief Reads rows [start, start + rows) along the first axis of a dataset
+///        of the given shape into blob, reshaped to fit.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(hid_t file_id, const char* dataset_name_,
+                               const vector<int>& shape, int start, int rows,
+                               Blob<Dtype>* blob);
+
+/**
+ * @brief Guards every call into HDF5, since the library is usually built
+ *        without thread safety and HDF5DataLayer may read on a background
+ *        thread while the net or solver snapshots. The helpers above do not
+ *        lock, their callers hold it around the whole file access.
+ */
+std::mutex& hdf5_mutex();
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(const hid_t file_id, const string& dataset_name,
                           const Blob<Dtype>& blob, bool write_diff = false);
@@ -0,0 +1,124 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace caffe {
+
+/// @brief Counters shared by every host allocator, see Caffe::host_alloc_stats.
+struct HostAllocStats {
+  uint64_t allocations;         // CaffeMallocHost calls
+  uint64_t frees;               // CaffeFreeHost calls
+  uint64_t system_allocations;  // allocations that reached the system
+  uint64_t system_frees;        // frees that reached the system
+  uint64_t bytes_in_use;        // bytes held by live allocations
+  uint64_t bytes_cached;        // bytes kept by the pool for reuse
+};
+
+/**
+ * @brief Source of all host memory handed out by CaffeMallocHost.
+ *
+ * One allocator is active for the whole process. The built-in allocators
+ * release each other's blocks, so switching between them is always safe;
+ * any other allocator can only take over or hand over while no host block
+ * is alive, e.g. before any net is created.
+ */
+class HostAllocator {
+  public:
+  virtual ~HostAllocator() {}
+  /// @brief Returns a block of at least size bytes aligned to kAlignment.
+  virtual void* Allocate(size_t size) = 0;
+  virtual void Free(void* ptr) = 0;
+  /// @brief Returns cached blocks to the system; no-op when nothing is cached.
+  virtual void Release() {}
+  virtual const char* type() const = 0;
+
+  static const size_t kAlignment = 64;
+
+  /// @brief The active allocator.
+  static HostAllocator* Get();
+  /// @brief Makes allocator active, which must outlive every block. Returns
+  ///        false and keeps the active one when blocks alive rule it out.
+  static bool Set(HostAllocator* allocator);
+  /// @brief Makes one of the built-in allocators active: "system" or "pooled".
+  static bool Set(const std::string& type, bool huge_pages = false);
+  static HostAllocStats stats();
+};
+
+/// @brief Aligned malloc/free (mkl_malloc under USE_MKL), nothing cached.
+class SystemHostAllocator : public HostAllocator {
+  public:
+  virtual void* Allocate(size_t size);
+  virtual void Free(void* ptr);
+  virtual const char* type() const { return "system"; }
+};
+
+/**
+ * @brief Caches freed blocks in size classes so that a steady state of
+ *        allocations, such as repeated forward passes, never reaches the
+ *        system allocator.
+ *
+ * Sizes up to 1 KB are rounded to 64 bytes, larger ones to a quarter of
+ * their power of two, which bounds the waste to 25%. Every thread keeps a
+ * small cache of its own and spills to a global pool guarded by a mutex, so
+ * blocks freed on a different thread than the one allocating them are still
+ * reused. Every allocator has pools of its own, blocks are always returned to
+ * the pools of the allocator that made them. Blocks above the largest class
+ * go straight to the system. With huge_pages, blocks of 2 MB and more are
+ * 2 MB aligned and advised as transparent huge pages.
+ */
+class PooledHostAllocator : public HostAllocator {
+  public:
+  explicit PooledHostAllocator(bool huge_pages = false);
+  /// Returns the cached blocks; blocks still cached by other threads are
+  /// returned when those threads exit.
+  virtual ~PooledHostAllocator();
+  virtual void* Allocate(size_t size);
+  virtual void Free(void* ptr);
+  virtual void Release();
+  virtual const char* type() const { return "pooled"; }
+  inline bool huge_pages() const { return huge_pages_; }
+
+  /// @brief Returns the class of size and its rounded size, -1 when unpooled.
+  static int SizeClass(size_t size, size_t* class_size);
+  static const int kNumClasses = 88;
+
+  private:
+  bool huge_pages_;
+  void* pool_;  // GlobalPool of host_allocator.cpp
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
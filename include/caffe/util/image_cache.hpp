@@ -0,0 +1,142 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_IMAGE_CACHE_HPP_
+#define INCLUDE_CAFFE_UTIL_IMAGE_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <list>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <unordered_map>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief Counters of one ImageCache, see ImageCache::stats.
+struct ImageCacheStats {
+  uint64_t hits;             // lookups served from memory or the spill file
+  uint64_t spill_hits;       // hits served from the spill file
+  uint64_t misses;           // lookups that had to decode
+  uint64_t evictions;        // images dropped from memory
+  uint64_t spills;           // images written to the spill file
+  uint64_t bytes_in_memory;  // decoded pixels held in memory
+  uint64_t bytes_spilled;    // decoded pixels written to the spill file
+
+  /// @brief Fraction of lookups that skipped decoding.
+  inline double hit_rate() const {
+    return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+  }
+};
+
+/// @brief Decoded 8 bit pixels, rows x cols x channels interleaved.
+struct CachedImage {
+  int rows;
+  int cols;
+  int channels;
+  const uint8_t* data;
+  /// Keeps data alive once the image is evicted or the cache cleared.
+  shared_ptr<void> holder;
+};
+
+/**
+ * @brief Bounded store of decoded images, so that epochs after the first
+ *        skip decoding and resizing images seen before.
+ *
+ * Images are kept in memory up to memory_bytes and evicted least recently
+ * used first. With a spill file, an evicted image is copied once into the
+ * mapped file, where later lookups read it in place until the process ends;
+ * once the file is full evicted images are dropped. Spilled images are not
+ * promoted back to memory. All methods are thread safe.
+ */
+class ImageCache {
+  public:
+  explicit ImageCache(size_t memory_bytes = 0,
+                      const string& spill_file = "", size_t spill_bytes = 0);
+  ~ImageCache();
+
+  /// @brief The cache shared by every layer of the process.
+  static ImageCache* Get();
+  /// @brief Key of filename decoded as ReadImageToCVMat(filename, height,
+  ///        width, is_color) would.
+  static string Key(const string& filename, int height, int width,
+                    bool is_color);
+  /// @brief Whether param asks for any caching at all.
+  static bool Enabled(const ImageCacheParameter& param);
+
+  /// @brief Raises the bounds to those of param. The spill file can only be
+  ///        set once; later files are ignored.
+  void Configure(const ImageCacheParameter& param);
+  /// @brief Fills image and returns true when key is cached.
+  bool Lookup(const string& key, CachedImage* image);
+  /// @brief Copies the pixels of key in, unless they are already cached.
+  void Insert(const string& key, int rows, int cols, int channels,
+              const uint8_t* data);
+  /// @brief Drops every image and resets the counters; keeps the bounds.
+  void Clear();
+  ImageCacheStats stats();
+
+  inline size_t memory_bytes() const { return memory_bytes_; }
+  inline size_t spill_bytes() const { return spill_bytes_; }
+
+  private:
+  struct Entry {
+    int rows;
+    int cols;
+    int channels;
+    shared_ptr<vector<uint8_t> > pixels;  // NULL once evicted from memory
+    int64_t spill_offset;                 // -1 until spilled
+    std::list<string>::iterator lru;      // valid while pixels is set
+  };
+  class SpillFile;
+
+  void OpenSpill(const string& filename, size_t bytes);
+  void EvictLocked();
+  bool SpillLocked(Entry* entry);
+
+  std::mutex mutex_;
+  size_t memory_bytes_;
+  size_t spill_bytes_;
+  size_t spill_used_;
+  string spill_file_;
+  shared_ptr<SpillFile> spill_;
+  std::unordered_map<string, Entry> entries_;
+  std::list<string> lru_;  // in memory keys, most recently used first
+  ImageCacheStats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(ImageCache);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_IMAGE_CACHE_HPP_
@@ -31,6 +31,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INCLUDE_CAFFE_UTIL_IMAGE_IO_HPP_
 
 #include <string>
+#include <vector>
 
 #include "caffe/proto/caffe.pb.h"
 #include "google/protobuf/message.h"
@@ -96,6 +97,47 @@ inline bool ReadImageSequenceToVolumeDatum(const char* img_dir,
                                         sampling_rate, datum);
 }
 
+/**
+ * @brief Decodes clips into buffers reused from clip to clip, in the layout
+ *        of VolumeDatum: channels x length x height x width.
+ *
+ * The capture of the last video stays open, so that a clip starting shortly
+ * after the previous clip of the same video ended is read on without
+ * reopening and seeking. Not thread safe, use one reader per thread.
+ */
+class VideoClipReader {
+  public:
+  VideoClipReader() : position_(0), num_frames_(0) {}
+
+  /**
+   * @brief Reads length frames, one every sampling_rate, from start_frm on,
+   *        resized to height x width when both are positive. A negative
+   *        start_frm starts at rand % (frames - length * sampling_rate + 1).
+   *        Sets the shape of datum, without data, and resizes data to fit.
+   */
+  bool ReadVideo(const string& filename, int start_frm, unsigned int rand,
+                 int length, int height, int width, int sampling_rate,
+                 VolumeDatum* datum, vector<char>* data);
+  /// @brief As above from the files img_dir/%06d.jpg.
+  bool ReadImageSequence(const string& img_dir, int start_frm, int length,
+                         int height, int width, int sampling_rate,
+                         VolumeDatum* datum, vector<char>* data);
+
+  private:
+  bool Open(const string& filename);
+  bool ReadFrames(int start_frm, int length, int height, int width,
+                  int sampling_rate, VolumeDatum* datum, vector<char>* data);
+  bool AddFrame(const cv::Mat& frame, int index, int length, int height,
+                int width, VolumeDatum* datum, vector<char>* data);
+
+  cv::VideoCapture cap_;
+  string filename_;
+  int position_;  // index of the next frame cap_ reads
+  int num_frames_;
+  cv::Mat frame_;
+  cv::Mat resized_;
+};
+
 template <typename Dtype>
 bool load_blob_from_binary(const string fn_blob, Blob<Dtype>* blob);
 
@@ -0,0 +1,80 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_IMAGE_TRANSFORM_HPP_
+#define INCLUDE_CAFFE_UTIL_IMAGE_TRANSFORM_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/*
+ * Conversion of 8 bit images to net inputs for DataTransformer: crop, mean
+ * subtraction, scale and mirror in one pass. The kernel is chosen once per
+ * row from the layout, mean and mirror, so nothing branches per pixel. Float
+ * rows of planar or 3 channel interleaved pixels run AVX2 when the CPU has
+ * it; the results are the same bits as the scalar loop.
+ */
+
+/// An 8 bit image window and how to transform it, see
+/// caffe_cpu_transform_image().
+template <typename Dtype>
+struct ImageTransform {
+  const uint8_t* src;   // first pixel of the window
+  bool interleaved;     // HWC like cv::Mat rather than CHW like Datum
+  int channels;
+  int rows;
+  int cols;
+  int row_step;         // bytes between the rows of src
+  int plane_step;       // bytes between the channels of CHW src
+  const Dtype* mean;    // per pixel CHW mean at the window, or NULL
+  int mean_row_step;
+  int mean_plane_step;
+  const Dtype* mean_values;  // one per channel, or NULL
+  Dtype scale;
+  bool mirror;          // reverse the columns
+  bool mean_at_dst;     // read mean at the destination column, see below
+};
+
+/**
+ * @brief Writes the channels x rows x cols planes
+ *        dst(c, h, w) = (src(c, h, w') - mean(c, h, m)) * scale, where w'
+ *        is cols - 1 - w when mirror and w otherwise, and m is w when
+ *        mean_at_dst and w' otherwise. The Datum path reads the mean at the
+ *        source pixel, the cv::Mat path at the destination one.
+ */
+template <typename Dtype>
+void caffe_cpu_transform_image(const ImageTransform<Dtype>& t, Dtype* dst);
+
+/// Instruction set used for float images: "avx2" or "scalar".
+const char* image_transform_isa();
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_IMAGE_TRANSFORM_HPP_
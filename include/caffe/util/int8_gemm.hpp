@@ -0,0 +1,112 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_INT8_GEMM_HPP_
+#define INCLUDE_CAFFE_UTIL_INT8_GEMM_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+using std::vector;
+
+/*
+ * Int8 matrix products with int32 sums for quantized inference on CPU. They
+ * use the quantization written by generate_quantized_pt for the MLU: a
+ * BlobDataType with position p and scale s (1 when absent) stands for the
+ * real values q * 2^p / s of the int8 q, so the CPU computes what the
+ * accelerator would.
+ *
+ * Weights are packed once, one row per output with the inner dimension
+ * padded to a multiple of 32. Activations are quantized into rows of the same
+ * layout, offset by 128 to unsigned bytes so that the AVX-512 VNNI dot product
+ * (unsigned x signed bytes) applies directly; the offset is taken back out
+ * with the row sums of the weights. Without VNNI the bytes are widened to 16
+ * bits for AVX2, and without AVX2 a scalar loop runs.
+ */
+
+/// @brief Whether a layer runs in int8 on CPU: LayerParameter cpu_int8 is set,
+///        its weights are DT_INT8 and unfolded, and its bottom 0 has a
+///        position.
+bool UseCpuInt8(const LayerParameter& param);
+
+/// @brief The real value of one int8 step of channel i, 2^position / scale;
+///        a single position or scale applies to every channel.
+float Int8Step(const BlobDataType& dtype, int channel = 0);
+
+/// Weights quantized for int8_gemm().
+struct Int8Weights {
+  Int8Weights() : rows(0), cols(0), stride(0) {}
+
+  int rows;
+  int cols;
+  int stride;               // cols rounded up to 32
+  vector<int8_t> data;      // rows x stride, zero padded
+  vector<int32_t> offset;   // 128 times the sum of each row
+  vector<float> step;       // the step of each row
+};
+
+/// @brief Quantize the rows x cols matrix whose (r, c) is
+///        w[r * row_stride + c * col_stride], row r with Int8Step(dtype, r).
+template <typename Dtype>
+void int8_pack_weights(const Dtype* w, const int rows, const int cols,
+    const int row_stride, const int col_stride, const BlobDataType& dtype,
+    Int8Weights* packed);
+
+/// @brief Quantize to nearest with saturation, q = x / step in [-128, 127].
+template <typename Dtype>
+void int8_quantize(const int n, const Dtype* x, const float step, int8_t* q);
+
+/// @brief Quantize the n x k matrix whose (j, c) is
+///        x[j * row_stride + c * col_stride] into n rows of stride bytes,
+///        each value offset by 128.
+template <typename Dtype>
+void int8_quantize_rows(const Dtype* x, const int n, const int k,
+    const int row_stride, const int col_stride, const float step,
+    const int stride, uint8_t* q);
+
+/**
+ * @brief y(r, j) = dot(row r of w, row j of x) * w.step[r] * x_step + bias[r]
+ *        for the weight rows [row_begin, row_end) and the n rows of x, stored
+ *        at y[r * y_row_stride + j * y_col_stride]. bias may be NULL.
+ */
+template <typename Dtype>
+void int8_gemm(const Int8Weights& w, const int row_begin, const int row_end,
+    const uint8_t* x, const int n, const float x_step, const Dtype* bias,
+    Dtype* y, const int y_row_stride, const int y_col_stride);
+
+/// Instruction set used by int8_gemm: "avx512_vnni", "avx2" or "scalar".
+const char* int8_gemm_isa();
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_INT8_GEMM_HPP_
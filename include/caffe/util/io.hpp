@@ -41,6 +41,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/format.hpp"
+#include "caffe/util/image_cache.hpp"
 
 #ifndef CAFFE_TMP_DIR_RETRIES
 #define CAFFE_TMP_DIR_RETRIES 100
@@ -215,6 +216,14 @@ inline bool ReadImageToDatum(const string& filename, const int label,
   return ReadImageToDatum(filename, label, 0, 0, true, encoding, datum);
 }
 
+/**
+ * @brief Parses a serialized Datum except for its data, which stays in
+ *        buffer: *pixels points at it, or is NULL if there is none. Saves
+ *        copying the values of records read straight from db pages.
+ */
+bool ParseDatumInPlace(const char* buffer, size_t size, Datum* datum,
+                       const char** pixels, size_t* pixels_size);
+
 bool DecodeDatumNative(Datum* datum);
 bool DecodeDatum(Datum* datum, bool is_color);
 
@@ -307,6 +316,15 @@ cv::Mat ReadImageToCVMat(const string& filename, const bool is_color);
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
+/**
+ * @brief ReadImageToCVMat(filename, height, width, is_color) served from
+ *        cache when the same image was decoded before, and added to it
+ *        otherwise. A cached result points into *image, which must outlive it.
+ */
+cv::Mat ReadImageToCVMat(const string& filename, const int height,
+                         const int width, const bool is_color,
+                         ImageCache* cache, CachedImage* image);
+
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
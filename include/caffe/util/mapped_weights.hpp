@@ -0,0 +1,87 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <stdint.h>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/*
+ * Trained weights laid out to be memory mapped instead of parsed: a 64 byte
+ * header, the float values of every blob aligned to 64 bytes, then a
+ * MappedWeightsIndex telling where each blob is. A net loading such a file
+ * points its blobs at the mapped pages (Net::CopyTrainedLayersFrom), so the
+ * processes of a host share one copy of the weights in the page cache and
+ * nothing is read or copied up front. The mapping is private: a process
+ * writing its weights gets its own copies of the pages it writes.
+ *
+ * Values are stored in the byte order of the host that wrote the file, which
+ * the loader checks. tools/caffemodel_to_mapped converts a caffemodel.
+ */
+
+/// @brief Write the blobs of the layers of param as mapped weights.
+void WriteMappedWeights(const NetParameter& param, const string& filename);
+
+/// @brief Whether filename starts like a mapped weights file.
+bool IsMappedWeightsFile(const string& filename);
+
+/// A mapped weights file, unmapped on destruction.
+class MappedWeights {
+  public:
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  const MappedWeightsIndex& index() const { return index_; }
+  /// The values of tensor, valid as long as this object lives.
+  float* data(const MappedWeightsIndex::Tensor& tensor) const;
+  /// @brief Whether p points into the mapped file.
+  bool Contains(const void* p) const;
+  /// @brief Copy the weights into the blobs of the layers of param.
+  void ToProto(NetParameter* param) const;
+  void ToProto(const MappedWeightsIndex::Tensor& tensor,
+               BlobProto* proto) const;
+
+  private:
+  string filename_;
+  void* map_;
+  size_t size_;
+  MappedWeightsIndex index_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
@@ -0,0 +1,84 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_MEMORY_PLANNER_HPP_
+#define INCLUDE_CAFFE_UTIL_MEMORY_PLANNER_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace caffe {
+
+/**
+ * @brief MemoryPlanner places buffers with known lifetimes into one shared
+ *        arena, so that buffers alive at the same time never overlap while
+ *        buffers with disjoint lifetimes reuse the same bytes.
+ *
+ * Lifetimes are inclusive ranges of steps, e.g. the index of the first and
+ * the last layer touching a blob. Buffers are placed greedily by decreasing
+ * size, each at the lowest aligned offset that does not collide with an
+ * already placed buffer whose lifetime intersects its own.
+ */
+class MemoryPlanner {
+  public:
+  explicit MemoryPlanner(size_t alignment = 64);
+
+  /// @brief Add a buffer alive in steps [first, last], returns its id.
+  int Add(size_t size, int first, int last);
+  /// @brief Assign offsets to all buffers added so far.
+  void Plan();
+
+  inline int size() const { return buffers_.size(); }
+  inline size_t buffer_size(int id) const { return buffers_[id].size; }
+  inline int first(int id) const { return buffers_[id].first; }
+  inline int last(int id) const { return buffers_[id].last; }
+  size_t offset(int id) const;
+  /// @brief Bytes needed by the arena, i.e. the planned peak.
+  inline size_t arena_size() const { return arena_size_; }
+  /// @brief Bytes needed when every buffer has its own memory.
+  inline size_t naive_size() const { return naive_size_; }
+
+  private:
+  struct Buffer {
+    size_t size;
+    int first;
+    int last;
+    size_t offset;
+  };
+
+  size_t alignment_;
+  bool planned_;
+  size_t arena_size_;
+  size_t naive_size_;
+  std::vector<Buffer> buffers_;
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_MEMORY_PLANNER_HPP_
@@ -0,0 +1,101 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_NET_OPTIMIZER_HPP_
+#define INCLUDE_CAFFE_UTIL_NET_OPTIMIZER_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief NetOptimizer rewrites the NetParameter of an inference (TEST phase)
+ *        net before its layers are created, independent of the device.
+ *
+ * Every pass is a function rewriting the layers in place and returning
+ * whether it changed anything. The passes keep the outputs of the net and
+ * their values; blobs that only carried intermediate results may disappear
+ * or be shared. Layers whose trained parameters change are marked in the
+ * LayerParameter (folded_layer, fused_layer) and FoldTrainedWeights() applies
+ * the same rewrite to the weights before they are copied into the net.
+ */
+class NetOptimizer {
+  public:
+  typedef bool (*Pass)(NetParameter* param);
+
+  /// @brief An optimizer with no passes.
+  NetOptimizer() {}
+  /**
+   * @brief The default passes for an opt_level: 1 removes Dropout and Split,
+   *        fuses activations and makes layers in place, 2 also folds
+   *        BatchNorm and Scale into the layer before them.
+   *
+   * Fused activations are only applied by the CPU implementations, nets for
+   * other devices pass fuse_activation false.
+   */
+  explicit NetOptimizer(int opt_level, bool fuse_activation = true);
+
+  void AddPass(const std::string& name, Pass pass);
+  /// @brief Run the passes in the order they were added, returns whether
+  ///        any of them changed the net.
+  bool Run(NetParameter* param) const;
+
+  inline int size() const { return passes_.size(); }
+
+  private:
+  std::vector<std::pair<std::string, Pass> > passes_;
+};
+
+/// @brief Drop Dropout (an identity at test time) and Split layers, reading
+///        their bottom instead of their tops.
+bool RemoveIdentityLayers(NetParameter* param);
+/// @brief Fold a BatchNorm and/or channel Scale following a Convolution or
+///        InnerProduct into its weights and bias.
+bool FoldBatchNormScale(NetParameter* param);
+/// @brief Fuse a ReLU or PReLU into the Convolution, InnerProduct or Eltwise
+///        before it, see LayerParameter fused_activation.
+bool FuseActivation(NetParameter* param);
+/// @brief Let element-wise layers write their top over their bottom when no
+///        later layer reads the bottom.
+bool MakeInPlace(NetParameter* param);
+
+/**
+ * @brief Apply to trained weights the folds recorded in an optimized net:
+ *        BatchNorm and Scale parameters are folded into the layer they follow
+ *        and PReLU slopes are appended to the layer they were fused into.
+ */
+void FoldTrainedWeights(const NetParameter& optimized, NetParameter* weights);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_NET_OPTIMIZER_HPP_
@@ -0,0 +1,137 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_NET_PROFILER_HPP_
+#define INCLUDE_CAFFE_UTIL_NET_PROFILER_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records the forward pass of a Net layer by layer, or SubNet by
+ *        SubNet in MFUS mode, through its before_forward/after_forward
+ *        callbacks.
+ *
+ * Every span holds the wall time, the bytes of the blobs the layer reads and
+ * writes (bottoms, tops and parameters), the host memory allocated while it
+ * ran (see HostAllocator::stats) and the host<->device copies SyncedMemory
+ * made meanwhile. WriteChromeTrace() dumps the spans in the Chrome trace
+ * event format, loadable in chrome://tracing or Perfetto; WriteCsv() writes
+ * one summary row per layer or SubNet.
+ *
+ * The profiler unregisters its callbacks when destroyed, so it must not
+ * outlive the net. set_enabled(false) pauses it.
+ */
+template <typename Dtype>
+class NetProfiler {
+  public:
+  struct Span {
+    int id;  // layer or SubNet index
+    bool subnet;
+    int64_t start_ns;  // since the profiler was created
+    int64_t duration_ns;
+    uint64_t bytes_touched;
+    int64_t alloc_bytes;  // growth of the host bytes in use
+    uint64_t allocations;
+    uint64_t host_bytes_in_use;  // after the span
+    uint64_t host_to_device;
+    uint64_t device_to_host;
+    uint64_t sync_bytes;
+  };
+  struct Summary {
+    int calls;
+    int64_t total_ns;
+    int64_t min_ns;
+    int64_t max_ns;
+    uint64_t bytes_touched;
+    int64_t alloc_bytes;
+    uint64_t allocations;
+    uint64_t host_to_device;
+    uint64_t device_to_host;
+    uint64_t sync_bytes;
+  };
+
+  /// @brief Hooks into net. At most max_spans spans are kept for the trace,
+  ///        the summaries cover every call.
+  explicit NetProfiler(Net<Dtype>* net, size_t max_spans = 1 << 20);
+  ~NetProfiler();
+
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+  bool enabled() const { return enabled_; }
+  /// @brief Drops the recorded spans and summaries.
+  void Clear();
+
+  const std::vector<Span>& spans() const { return spans_; }
+  const Summary& layer_summary(int layer) const {
+    return layer_summaries_[layer];
+  }
+  /// @brief Empty unless the net ran in MFUS mode.
+  const std::vector<Summary>& subnet_summaries() const {
+    return subnet_summaries_;
+  }
+
+  void WriteChromeTrace(const std::string& filename) const;
+  void WriteCsv(const std::string& filename) const;
+
+  private:
+  class Hook;
+
+  void Begin();
+  void End(int id, bool subnet);
+  uint64_t BytesTouched(int layer) const;
+  std::string SpanName(int id, bool subnet) const;
+
+  Net<Dtype>* net_;
+  size_t max_spans_;
+  bool spans_dropped_;
+  bool enabled_;
+  int tid_;
+  Hook* before_;
+  Hook* after_;
+  int64_t origin_ns_;
+  // State captured by Begin() for the running span.
+  int64_t begin_ns_;
+  uint64_t begin_in_use_;
+  uint64_t begin_allocations_;
+  MemorySyncStats begin_sync_;
+  std::vector<Span> spans_;
+  std::vector<Summary> layer_summaries_;
+  std::vector<Summary> subnet_summaries_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_NET_PROFILER_HPP_
@@ -0,0 +1,124 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_NMS_HPP_
+#define INCLUDE_CAFFE_UTIL_NMS_HPP_
+
+#include <vector>
+
+namespace caffe {
+
+using std::vector;
+
+/*
+ * Non maximum suppression shared by the CPU detection layers. Boxes are kept
+ * as structure-of-arrays so that the overlap of one candidate against every
+ * box kept so far is a single loop, run eight boxes at a time with AVX2 when
+ * the CPU has it.
+ * Candidates are drawn lazily from a heap, highest score first with ties
+ * going to the lower index (the order of a stable sort), so only as many of
+ * them are ordered as the suppression actually visits.
+ */
+struct NMSBoxes {
+  // normalized boxes measure width as xmax - xmin, pixel boxes as
+  // xmax - xmin + 1, like BBoxSize and JaccardOverlap in bbox_util.
+  explicit NMSBoxes(bool normalized = true) : normalized(normalized) {}
+
+  inline int size() const { return x1.size(); }
+  void clear();
+  void reserve(int n);
+  // Appends a box whose area is computed from its corners; inverted boxes
+  // get an area of 0.
+  void push_back(float xmin, float ymin, float xmax, float ymax);
+  void push_back(float xmin, float ymin, float xmax, float ymax, float area);
+
+  vector<float> x1;
+  vector<float> y1;
+  vector<float> x2;
+  vector<float> y2;
+  vector<float> area;
+  bool normalized;
+};
+
+enum NMSMethod {
+  NMS_HARD,          // drop boxes overlapping a kept box
+  NMS_SOFT_LINEAR,   // scale their score by 1 - overlap
+  NMS_SOFT_GAUSSIAN  // scale their score by exp(-overlap^2 / sigma)
+};
+
+struct NMSParam {
+  NMSParam()
+      : score_threshold(-1e30f), overlap_threshold(0.5f),
+        suppress_equal(false), top_k(-1), keep_top_k(-1), min_area(-1),
+        method(NMS_HARD), sigma(0.5f) {}
+
+  // Only boxes scoring strictly above score_threshold are candidates. Soft
+  // NMS also drops boxes whose decayed score falls to or below it.
+  float score_threshold;
+  // A box is suppressed by a kept box overlapping it by more than
+  // overlap_threshold, or by exactly as much when suppress_equal is set.
+  // Soft linear NMS only decays boxes above the threshold.
+  float overlap_threshold;
+  bool suppress_equal;
+  // If not -1, only the top_k highest scoring candidates are considered and
+  // at most keep_top_k boxes are kept.
+  int top_k;
+  int keep_top_k;
+  // Boxes with a smaller area are neither kept nor suppress others.
+  float min_area;
+  NMSMethod method;
+  float sigma;
+};
+
+// Runs NMS over boxes scored by scores (boxes.size() entries). indices gets
+// the kept boxes in descending score order; kept_scores, if not NULL, their
+// scores after soft NMS decay (the original scores for NMS_HARD).
+void NonMaxSuppression(const NMSBoxes& boxes, const float* scores,
+    const NMSParam& param, vector<int>* indices,
+    vector<float>* kept_scores = NULL);
+
+// Hard NMS visiting the candidates in the given order instead of by score,
+// for callers that already ranked them. score_threshold and top_k are
+// ignored.
+void NonMaxSuppressionOrdered(const NMSBoxes& boxes, const vector<int>& order,
+    const NMSParam& param, vector<int>* indices);
+
+// Runs NonMaxSuppression once per entry of scores over the same boxes, e.g.
+// one score array per class of a detector sharing box locations. NULL
+// entries produce no indices. Classes run on the intra-op thread pool;
+// each one is independent, so the result does not depend on the number of
+// threads.
+void NonMaxSuppressionBatched(const NMSBoxes& boxes,
+    const vector<const float*>& scores, const NMSParam& param,
+    vector<vector<int> >* indices,
+    vector<vector<float> >* kept_scores = NULL);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_NMS_HPP_
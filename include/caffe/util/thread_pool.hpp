@@ -0,0 +1,96 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
+#define INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <functional>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads running the tasks of one job at a
+ *        time, the calling thread included.
+ *
+ * Run() is not reentrant: calls made from inside a task, or while another
+ * thread owns the pool, execute all their tasks on the calling thread.
+ */
+class ThreadPool {
+  public:
+  /// @brief num_threads counts the calling thread, so 1 starts no worker.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  inline int num_threads() const { return workers_.size() + 1; }
+  /// @brief Runs fn(0) ... fn(tasks - 1) and returns once all have finished.
+  void Run(int tasks, const std::function<void(int)>& fn);
+
+  private:
+  void Work();
+  void RunTasks(const std::function<void(int)>& fn, int tasks);
+
+  std::vector<std::thread> workers_;
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(int)>* fn_;
+  int tasks_;
+  std::atomic<int> next_;
+  std::atomic<int> pending_;
+  int active_;
+  unsigned long long generation_;  // NOLINT(runtime/int)
+  bool stop_;
+};
+
+/// @brief Sets the size of the intra-op pool, <= 0 uses every hardware thread.
+void caffe_set_cpu_threads(int num_threads);
+int caffe_cpu_threads();
+
+/**
+ * @brief Splits [0, n) into contiguous ranges, one per thread of the
+ *        intra-op pool, and runs fn(begin, end) on each.
+ *
+ * work is the rough number of elements touched per item; loops whose total
+ * work is too small to amortize waking the pool run on the calling thread.
+ * Every item must be independent of the others, which keeps the result
+ * identical to the serial loop whatever the number of threads.
+ */
+void caffe_parallel_for(int n, size_t work,
+                        const std::function<void(int, int)>& fn);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
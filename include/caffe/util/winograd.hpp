@@ -0,0 +1,75 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_WINOGRAD_HPP_
+#define INCLUDE_CAFFE_UTIL_WINOGRAD_HPP_
+
+namespace caffe {
+
+/*
+ * Winograd F(m x m, 3 x 3) convolution for stride 1, dilation 1 and 3x3
+ * kernels, with m = 2 or 4 (tile). The image is cut into output tiles of
+ * m x m; every tile reads an (m + 2) x (m + 2) input patch, so the per-image
+ * workspace is (m + 2)^2 / m^2 times the input instead of the 9x of im2col.
+ * F(4x4) does 4x fewer multiplications than direct convolution but is less
+ * accurate than F(2x2), which does 2.25x fewer.
+ */
+
+// Number of tiles of size tile covering output_size outputs.
+inline int winograd_tiles(const int output_size, const int tile) {
+  return (output_size + tile - 1) / tile;
+}
+
+// Transforms num_output x (channels / group) x 3 x 3 filters into
+// group x (tile + 2)^2 x (num_output / group) x (channels / group)
+// matrices, the left operands of the per-frequency GEMMs.
+template <typename Dtype>
+void winograd_transform_weight_cpu(const int tile, const Dtype* weight,
+    const int num_output, const int channels, const int group,
+    Dtype* weight_tf);
+
+/*
+ * Convolves one image with filters transformed by
+ * winograd_transform_weight_cpu. Only the top and left pads are needed, as in
+ * depthwise_conv_cpu. input_tf holds (tile + 2)^2 * channels * T and
+ * output_tf (tile + 2)^2 * num_output * T elements, where T is
+ * winograd_tiles(output_h, tile) * winograd_tiles(output_w, tile). bias may
+ * be NULL.
+ */
+template <typename Dtype>
+void winograd_conv_cpu(const int tile, const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const int pad_htop, const int pad_wleft, const int num_output,
+    const int group, const int output_h, const int output_w,
+    const Dtype* weight_tf, const Dtype* bias, Dtype* input_tf,
+    Dtype* output_tf, Dtype* data_out);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_WINOGRAD_HPP_
@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/mlu/util.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -110,6 +111,10 @@ void Blob<Dtype>::Reshape(const int num, const int channels, const int height,
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const vector<int>& shape) {
   CHECK_LE(shape.size(), kMaxBlobAxes);
+  if (half_data_ && shape != shape_) {
+    ExpandHalf();
+    half_data_.reset();
+  }
   count_ = 1;
   shape_.resize(shape.size());
   if (!shape_data_ || shape_data_->size() < shape.size() * sizeof(int)) {
@@ -185,6 +190,9 @@ const int* Blob<Dtype>::gpu_shape() const {
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK(data_);
+  if (half_data_) {
+    ExpandHalf();
+  }
 #ifdef USE_MLU
   return (const Dtype*)data_->cpu_data(tensor_desc_);
 #else
@@ -195,6 +203,7 @@ const Dtype* Blob<Dtype>::cpu_data() const {
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  half_data_.reset();
   size_t size = count_ * sizeof(Dtype);
   if (data_->size() != size) {
     data_.reset(new SyncedMemory(size));
@@ -271,6 +280,10 @@ const Dtype* Blob<Dtype>::gpu_diff() const {
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_data() {
   CHECK(data_);
+  if (half_data_) {
+    ExpandHalf();
+    half_data_.reset();
+  }
 #ifdef USE_MLU
   return static_cast<Dtype*>(data_->mutable_cpu_data(tensor_desc_));
 #else
@@ -300,6 +313,8 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  half_data_ = other.half_data_;
+  half_type_ = other.half_type_;
 }
 
 template <typename Dtype>
@@ -308,6 +323,47 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+// 16 bit storage is for the float and double weights of a Net as well.
+template <>
+void Blob<unsigned int>::StoreHalf(BaseDataType type) {
+  NOT_IMPLEMENTED;
+}
+template <>
+void Blob<int>::StoreHalf(BaseDataType type) {
+  NOT_IMPLEMENTED;
+}
+template <>
+void Blob<unsigned int>::ExpandHalf() const {
+  NOT_IMPLEMENTED;
+}
+template <>
+void Blob<int>::ExpandHalf() const {
+  NOT_IMPLEMENTED;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::StoreHalf(BaseDataType type) {
+  CHECK(IsHalfType(type)) << "Not a 16 bit type: " << BaseDataType_Name(type);
+  if (half_type() == type) {
+    return;
+  }
+  shared_ptr<SyncedMemory> half(new SyncedMemory(count_ * sizeof(uint16_t)));
+  caffe_cpu_to_half(count_, cpu_data(), type,
+                    static_cast<uint16_t*>(half->mutable_cpu_data()));
+  half_data_ = half;
+  half_type_ = type;
+  // Nothing is allocated until cpu_data() asks for the float values again.
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ExpandHalf() const {
+  if (data_->head() == SyncedMemory::UNINITIALIZED) {
+    caffe_cpu_from_half(count_, half_data(), half_type_,
+                        static_cast<Dtype*>(data_->mutable_cpu_data()));
+  }
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -35,6 +35,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <memory>
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/net.hpp"
 
 
@@ -129,6 +130,56 @@ Caffe::~Caffe() {
 #endif
 }
 
+Caffe::ThreadState Caffe::thread_state() {
+  const Caffe& caffe = Get();
+  ThreadState state;
+  state.mode = caffe.mode_;
+  state.solver_count = caffe.solver_count_;
+  state.solver_rank = caffe.solver_rank_;
+  state.multiprocess = caffe.multiprocess_;
+#ifdef USE_MLU
+  state.core_number = caffe.core_number_;
+  state.batchsize = caffe.batchsize_;
+  state.simple_flag = caffe.simpleFlag_;
+  state.top_dtype = caffe.top_dtype_;
+  state.core_version = caffe.core_version_;
+  state.reshape_mode = caffe.reshape_mode_;
+  state.split_mode = caffe.split_mode_;
+  state.detectop_mode = caffe.detectop_mode_;
+  state.in_dataorder = caffe.in_dataorder_;
+  state.out_dataorder = caffe.out_dataorder_;
+#endif  // USE_MLU
+  return state;
+}
+
+void Caffe::set_thread_state(const ThreadState& state) {
+  Caffe& caffe = Get();
+  caffe.mode_ = state.mode;
+  caffe.solver_count_ = state.solver_count;
+  caffe.solver_rank_ = state.solver_rank;
+  caffe.multiprocess_ = state.multiprocess;
+#ifdef USE_MLU
+  caffe.core_number_ = state.core_number;
+  caffe.batchsize_ = state.batchsize;
+  caffe.simpleFlag_ = state.simple_flag;
+  caffe.top_dtype_ = state.top_dtype;
+  caffe.core_version_ = state.core_version;
+  caffe.reshape_mode_ = state.reshape_mode;
+  caffe.split_mode_ = state.split_mode;
+  caffe.detectop_mode_ = state.detectop_mode;
+  caffe.in_dataorder_ = state.in_dataorder;
+  caffe.out_dataorder_ = state.out_dataorder;
+#endif  // USE_MLU
+}
+
+void Caffe::set_cpu_threads(int num_threads) {
+  caffe_set_cpu_threads(num_threads);
+}
+
+int Caffe::cpu_threads() {
+  return caffe_cpu_threads();
+}
+
 void Caffe::set_random_seed(const unsigned int seed) {
 #ifdef USE_CUDA
   // Curand seed
@@ -38,6 +38,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/data_transformer.hpp"
 #include "caffe/util/bbox_util.hpp"
+#include "caffe/util/image_transform.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
@@ -75,7 +76,15 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data,
                                        NormalizedBBox* crop_bbox,
                                        bool* do_mirror) {
-  const string& data = datum.data();
+  Transform(datum, datum.data().empty() ? NULL : datum.data().data(),
+            transformed_data, crop_bbox, do_mirror);
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* data,
+                                       Dtype* transformed_data,
+                                       NormalizedBBox* crop_bbox,
+                                       bool* do_mirror) {
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
   const int datum_width = datum.width();
@@ -84,7 +93,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   const Dtype scale = param_.scale();
   *do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = data != NULL;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
@@ -134,6 +143,27 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   crop_bbox->set_xmax(Dtype(w_off + width) / datum_width);
   crop_bbox->set_ymax(Dtype(h_off + height) / datum_height);
 
+  if (has_uint8) {
+    ImageTransform<Dtype> t;
+    t.src = reinterpret_cast<const uint8_t*>(data) + h_off * datum_width +
+            w_off;
+    t.interleaved = false;
+    t.channels = datum_channels;
+    t.rows = height;
+    t.cols = width;
+    t.row_step = datum_width;
+    t.plane_step = datum_height * datum_width;
+    t.mean = has_mean_file ? mean + h_off * datum_width + w_off : NULL;
+    t.mean_row_step = datum_width;
+    t.mean_plane_step = datum_height * datum_width;
+    t.mean_values = has_mean_values ? &mean_values_[0] : NULL;
+    t.scale = scale;
+    t.mirror = *do_mirror;
+    t.mean_at_dst = false;
+    caffe_cpu_transform_image(t, transformed_data);
+    return;
+  }
+
   Dtype datum_element;
   int top_index, data_index;
   for (int c = 0; c < datum_channels; ++c) {
@@ -170,7 +200,14 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 template <typename Dtype>
 void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
                                             Dtype* transformed_data) {
-  const string& data = datum.data();
+  VideoTransform(datum, datum.data().size() ? datum.data().data() : NULL,
+                 transformed_data);
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
+                                            const char* pixels,
+                                            Dtype* transformed_data) {
   const int datum_channels = datum.channels();
   const int datum_length = datum.length();
   const int datum_height = datum.height();
@@ -180,7 +217,7 @@ void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = pixels != NULL;
   const bool has_mean_values = mean_values_.size() > 0;
 
   /*LOG(INFO) << datum_channels << " channels "
@@ -248,7 +285,7 @@ void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
           }
           if (has_uint8) {
             datum_element =
-                static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
+                static_cast<Dtype>(static_cast<uint8_t>(pixels[data_index]));
           } else {
             datum_element = datum.float_data(data_index);
           }
@@ -304,7 +341,16 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
       LOG(ERROR) << "force_color and force_gray only for encoded datum";
     }
   }
+  Transform(datum, datum.data().empty() ? NULL : datum.data().data(),
+            transformed_blob, crop_bbox, do_mirror);
+}
 
+template <typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* pixels,
+                                       Blob<Dtype>* transformed_blob,
+                                       NormalizedBBox* crop_bbox,
+                                       bool* do_mirror) {
+  CHECK(!datum.encoded()) << "Encoded datums are decoded from their data";
   const int crop_size = param_.crop_size();
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
@@ -330,7 +376,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data, crop_bbox, do_mirror);
+  Transform(datum, pixels, transformed_data, crop_bbox, do_mirror);
 }
 
 template <typename Dtype>
@@ -341,6 +387,14 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   Transform(datum, transformed_blob, &crop_bbox, &do_mirror);
 }
 
+template <typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* pixels,
+                                       Blob<Dtype>* transformed_blob) {
+  NormalizedBBox crop_bbox;
+  bool do_mirror;
+  Transform(datum, pixels, transformed_blob, &crop_bbox, &do_mirror);
+}
+
 template <typename Dtype>
 void DataTransformer<Dtype>::Transform(const vector<Datum>& datum_vector,
                                        Blob<Dtype>* transformed_blob) {
@@ -454,6 +508,14 @@ void DataTransformer<Dtype>::TransformAnnotation(
 template <typename Dtype>
 void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
                                             Blob<Dtype>* transformed_blob) {
+  VideoTransform(datum, datum.data().size() ? datum.data().data() : NULL,
+                 transformed_blob);
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
+                                            const char* pixels,
+                                            Blob<Dtype>* transformed_blob) {
   const int crop_size = param_.crop_size();
   const int datum_channels = datum.channels();
   const int datum_length = datum.length();
@@ -482,7 +544,7 @@ void DataTransformer<Dtype>::VideoTransform(const VolumeDatum& datum,
   }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  VideoTransform(datum, transformed_data);
+  VideoTransform(datum, pixels, transformed_data);
 }
 
 template <typename Dtype>
@@ -690,36 +752,22 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   }
   CHECK(cv_cropped_image.data);
 
-  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
-  for (int h = 0; h < height; ++h) {
-    const uchar* ptr = cv_cropped_image.ptr<uchar>(h);
-    int img_index = 0;
-    int h_idx = h;
-    for (int w = 0; w < width; ++w) {
-      int w_idx = w;
-      if (*do_mirror) {
-        w_idx = (width - 1 - w);
-      }
-      int h_idx_real = h_idx;
-      int w_idx_real = w_idx;
-      for (int c = 0; c < img_channels; ++c) {
-        top_index = (c * height + h_idx_real) * width + w_idx_real;
-        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-        if (has_mean_file) {
-          int mean_index = (c * img_height + h_off + h_idx_real) * img_width +
-                           w_off + w_idx_real;
-          transformed_data[top_index] = (pixel - mean[mean_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] = (pixel - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = pixel * scale;
-          }
-        }
-      }
-    }
-  }
+  ImageTransform<Dtype> t;
+  t.src = cv_cropped_image.ptr<uint8_t>(0);
+  t.interleaved = true;
+  t.channels = img_channels;
+  t.rows = height;
+  t.cols = width;
+  t.row_step = cv_cropped_image.step[0];
+  t.plane_step = 0;
+  t.mean = has_mean_file ? mean + h_off * img_width + w_off : NULL;
+  t.mean_row_step = img_width;
+  t.mean_plane_step = img_height * img_width;
+  t.mean_values = has_mean_values ? &mean_values_[0] : NULL;
+  t.scale = scale;
+  t.mirror = *do_mirror;
+  t.mean_at_dst = true;
+  caffe_cpu_transform_image(t, transformed_blob->mutable_cpu_data());
 }
 
 template <typename Dtype>
@@ -1088,6 +1136,13 @@ void DataTransformer<Dtype>::InitRand() {
   }
 }
 
+template <typename Dtype>
+void DataTransformer<Dtype>::InitRand(unsigned int seed) {
+  if (param_.mirror() || (phase_ == TRAIN && param_.crop_size())) {
+    rng_.reset(new Caffe::RNG(seed));
+  }
+}
+
 template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
   CHECK(rng_);
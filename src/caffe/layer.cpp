@@ -27,10 +27,83 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <vector>
+
+#include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+void Layer<Dtype>::SetUpFusedActivation(const vector<Blob<Dtype>*>& top) {
+  const string& type = layer_param_.fused_activation();
+  CHECK(Caffe::mode() == Caffe::CPU)
+      << "Fused activation of layer " << layer_param_.name()
+      << " is only supported in CPU mode";
+  if (type == "ReLU") {
+    return;
+  }
+  CHECK_EQ(type, "PReLU") << "Unknown fused activation of layer "
+                          << layer_param_.name();
+  CHECK_GE(top[0]->num_axes(), 2)
+      << "Fused PReLU of layer " << layer_param_.name()
+      << " needs a top with channels";
+  const PReLUParameter& prelu_param = layer_param_.prelu_param();
+  vector<int> slope_shape;
+  if (!prelu_param.channel_shared()) {
+    slope_shape.push_back(top[0]->shape(1));
+  }
+  blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(slope_shape)));
+  FillerParameter filler_param;
+  if (prelu_param.has_filler()) {
+    filler_param = prelu_param.filler();
+  } else {
+    filler_param.set_type("constant");
+    filler_param.set_value(0.25);
+  }
+  shared_ptr<Filler<Dtype> > filler(GetFiller<Dtype>(filler_param));
+  filler->Fill(blobs_.back().get());
+  param_propagate_down_.resize(blobs_.size(), false);
+}
+
+template <typename Dtype>
+const Dtype* Layer<Dtype>::fused_slope() const {
+  if (layer_param_.fused_activation() != "PReLU") {
+    return NULL;
+  }
+  return blobs_.back()->cpu_data();
+}
+
+template <typename Dtype>
+void Layer<Dtype>::ForwardFusedActivation(const Blob<Dtype>& top,
+    const Dtype* slope, int offset, int count, Dtype* data) const {
+  if (!layer_param_.has_fused_activation()) {
+    return;
+  }
+  if (!slope) {
+    // Same arithmetic as ReLULayer::Forward_cpu.
+    const Dtype negative_slope = layer_param_.relu_param().negative_slope();
+    const int upper_limit = layer_param_.relu_param().upper_limit();
+    for (int i = 0; i < count; ++i) {
+      Dtype value = std::max(data[i], Dtype(0)) +
+                    negative_slope * std::min(data[i], Dtype(0));
+      data[i] = upper_limit ? std::min(value, Dtype(upper_limit)) : value;
+    }
+    return;
+  }
+  // Same arithmetic as PReLULayer::Forward_cpu.
+  const int channels = top.shape(1);
+  const int dim = top.count(2);
+  const int div_factor = layer_param_.prelu_param().channel_shared() ?
+      channels : 1;
+  for (int i = 0; i < count; ++i) {
+    const int c = (offset + i) / dim % channels / div_factor;
+    data[i] = std::max(data[i], Dtype(0)) +
+              slope[c] * std::min(data[i], Dtype(0));
+  }
+}
+
 INSTANTIATE_CLASS(Layer);
 
 }  // namespace caffe
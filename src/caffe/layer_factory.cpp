@@ -94,6 +94,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layers/unpooling_layer.hpp"
 #include "caffe/layers/upsample_layer.hpp"
 #include "caffe/layers/threshold_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/layers/yolov3_detection_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #ifdef USE_CUDNN
@@ -803,6 +804,14 @@ shared_ptr<Layer<Dtype>> GetConvolutionLayer(const LayerParameter& param) {
     }
   }
 #endif
+  if (conv_param.engine() == ConvolutionParameter_Engine_WINOGRAD) {
+#ifdef USE_MLU
+    if (Caffe::mode() == Caffe::MLU || Caffe::mode() == Caffe::MFUS)
+      return shared_ptr<Layer<Dtype>>(new MLUConvolutionLayer<Dtype>(param));
+#endif
+    return shared_ptr<Layer<Dtype>>(
+        new WinogradConvolutionLayer<Dtype>(param));
+  }
   if (engine == Engine::DEFAULT) {
     engine = Engine::CAFFE;
 #ifdef USE_CUDNN
@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -228,6 +229,10 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  int8_ = !reverse_dimensions() && UseCpuInt8(this->layer_param_);
+  int8_weights_ = Int8Weights();
+  int8_weights_src_.reset();
+  int8_weights_version_ = 0;
 
 #ifdef USE_MLU
   SetMean(bottom, top);
@@ -422,6 +427,66 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_int8(const Dtype* input,
+                                                        const Dtype* bias,
+                                                        Dtype* output) {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (int8_weights_src_ != weights.data() ||
+      int8_weights_version_ != weights.data()->version()) {
+    int8_weights_src_ = weights.data();
+    int8_pack_weights(weights.cpu_data(), conv_out_channels_,
+                      kernel_dim_, kernel_dim_, 1,
+                      this->layer_param_.blobs_dtype(0), &int8_weights_);
+    int8_weights_version_ = int8_weights_src_->version();
+  }
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    col_buff = col_buffer_.cpu_data();
+  }
+  const float step = Int8Step(this->layer_param_.bottom_mlu_dtype(0));
+  const int stride = int8_weights_.stride;
+  int8_col_buffer_.resize(
+      static_cast<size_t>(conv_out_spatial_dim_) * stride);
+  const int rows = conv_out_channels_ / group_;
+  for (int g = 0; g < group_; ++g) {
+    // The column buffer is kernel_dim_ x conv_out_spatial_dim_, each output
+    // position reads one of its columns.
+    int8_quantize_rows(col_buff + col_offset_ * g, conv_out_spatial_dim_,
+                       kernel_dim_, 1, conv_out_spatial_dim_, step, stride,
+                       &int8_col_buffer_[0]);
+    // Rows of the packed weights are output channels, so group g writes
+    // output rows [rows * g, rows * (g + 1)) of output itself.
+    int8_gemm(int8_weights_, rows * g, rows * (g + 1), &int8_col_buffer_[0],
+              conv_out_spatial_dim_, step, bias, output,
+              conv_out_spatial_dim_, 1);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_half(const Dtype* input,
+                                                        Dtype* output) {
+  const Dtype* col_buff = input;
+  if (!is_1x1_) {
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    col_buff = col_buffer_.cpu_data();
+  }
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_half_row_blocks<Dtype>(
+        weights.half_data() + weight_offset_ * g, weights.half_type(),
+        conv_out_channels_ / group_, kernel_dim_,
+        [&](int begin, int end, const Dtype* weight_rows) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, end - begin,
+                            conv_out_spatial_dim_, kernel_dim_, (Dtype)1.,
+                            weight_rows, col_buff + col_offset_ * g, (Dtype)0.,
+                            output + output_offset_ * g +
+                            begin * conv_out_spatial_dim_);
+    });
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
                                                    const Dtype* bias) {
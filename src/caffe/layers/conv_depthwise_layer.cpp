@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 #include "caffe/layers/conv_depthwise_layer.hpp"
+#include "caffe/util/depthwise_conv.hpp"
 
 namespace caffe {
 
@@ -37,13 +38,21 @@ template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   BaseConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  int8_weight_.clear();
+  int8_weight_src_.reset();
+  int8_weight_version_ = 0;
 }
 
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
   BaseConvolutionLayer<Dtype>::Reshape(bottom, top);
-  BaseConvolutionLayer<Dtype>::SetupColBuf();
+  direct_ = this->num_spatial_axes_ == 2 && this->group_ > 1 &&
+            this->group_ == this->channels_;
+  // The direct kernel needs no im2col buffer.
+  if (!direct_) {
+    BaseConvolutionLayer<Dtype>::SetupColBuf();
+  }
 }
 
 template <typename Dtype>
@@ -67,11 +76,43 @@ void ConvolutionDepthwiseLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (direct_ && this->int8_) {
+    Forward_cpu_int8(bottom, top);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (direct_) {
+    const int* kernel_shape = this->kernel_shape_.cpu_data();
+    const int* pad = this->pad_.cpu_data();
+    const int* stride = this->stride_.cpu_data();
+    const int* dilation = this->dilation_.cpu_data();
+    const Dtype* bias =
+        this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    for (int i = 0; i < bottom.size(); ++i) {
+      const Dtype* bottom_data = bottom[i]->cpu_data();
+      Dtype* top_data = top[i]->mutable_cpu_data();
+      for (int n = 0; n < this->num_; ++n) {
+        depthwise_conv_cpu(bottom_data + n * this->bottom_dim_,
+            this->channels_, this->num_output_ / this->group_,
+            this->input_shape(1), this->input_shape(2), kernel_shape[0],
+            kernel_shape[1], pad[0], pad[1], stride[0], stride[1],
+            dilation[0], dilation[1], this->output_shape_[0],
+            this->output_shape_[1], weight, bias,
+            top_data + n * this->top_dim_);
+      }
+    }
+    return;
+  }
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
+      if (this->int8_) {
+        this->forward_cpu_gemm_int8(bottom_data + n * this->bottom_dim_,
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+            top_data + n * this->top_dim_);
+        continue;
+      }
       this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
                              top_data + n * this->top_dim_);
       if (this->bias_term_) {
@@ -82,6 +123,59 @@ void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
   }
 }
 
+template <typename Dtype>
+void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu_int8(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int kernel_dim = this->kernel_dim_;
+  const BlobDataType& weight_dtype = this->layer_param_.blobs_dtype(0);
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (int8_weight_src_ != weights.data() ||
+      int8_weight_version_ != weights.data()->version()) {
+    int8_weight_src_ = weights.data();
+    const Dtype* weight = weights.cpu_data();
+    int8_weight_.resize(this->num_output_ * kernel_dim);
+    int8_step_.resize(this->num_output_);
+    for (int c = 0; c < this->num_output_; ++c) {
+      int8_step_[c] = Int8Step(weight_dtype, c);
+      int8_quantize(kernel_dim, weight + c * kernel_dim, int8_step_[c],
+                    &int8_weight_[c * kernel_dim]);
+    }
+    int8_weight_version_ = int8_weight_src_->version();
+  }
+  const float step = Int8Step(this->layer_param_.bottom_mlu_dtype(0));
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const int output_dim = this->top_dim_ / this->num_output_;
+  int8_input_.resize(this->bottom_dim_);
+  int8_output_.resize(this->top_dim_);
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      int8_quantize(this->bottom_dim_, bottom_data + n * this->bottom_dim_,
+                    step, &int8_input_[0]);
+      depthwise_conv_int8_cpu(&int8_input_[0], this->channels_,
+          this->num_output_ / this->group_, this->input_shape(1),
+          this->input_shape(2), kernel_shape[0], kernel_shape[1], pad[0],
+          pad[1], stride[0], stride[1], dilation[0], dilation[1],
+          this->output_shape_[0], this->output_shape_[1], &int8_weight_[0],
+          &int8_output_[0]);
+      Dtype* out = top_data + n * this->top_dim_;
+      for (int c = 0; c < this->num_output_; ++c) {
+        const Dtype scale = int8_step_[c] * step;
+        const Dtype b = bias ? bias[c] : Dtype(0);
+        const int32_t* sums = &int8_output_[c * output_dim];
+        for (int j = 0; j < output_dim; ++j) {
+          out[c * output_dim + j] = sums[j] * scale + b;
+        }
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
@@ -99,7 +193,33 @@ void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu(
         this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
       }
     }
-    if (this->param_propagate_down_[0] || propagate_down[i]) {
+    if (direct_ && (this->param_propagate_down_[0] || propagate_down[i])) {
+      const int* kernel_shape = this->kernel_shape_.cpu_data();
+      const int* pad = this->pad_.cpu_data();
+      const int* stride = this->stride_.cpu_data();
+      const int* dilation = this->dilation_.cpu_data();
+      const int multiplier = this->num_output_ / this->group_;
+      for (int n = 0; n < this->num_; ++n) {
+        // gradient w.r.t. weight. Note that we will accumulate diffs.
+        if (this->param_propagate_down_[0]) {
+          depthwise_conv_backward_weight_cpu(top_diff + n * this->top_dim_,
+              bottom_data + n * this->bottom_dim_, this->channels_,
+              multiplier, this->input_shape(1), this->input_shape(2),
+              kernel_shape[0], kernel_shape[1], pad[0], pad[1], stride[0],
+              stride[1], dilation[0], dilation[1], this->output_shape_[0],
+              this->output_shape_[1], weight_diff);
+        }
+        // gradient w.r.t. bottom data, if necessary.
+        if (propagate_down[i]) {
+          depthwise_conv_backward_data_cpu(top_diff + n * this->top_dim_,
+              this->channels_, multiplier, this->input_shape(1),
+              this->input_shape(2), kernel_shape[0], kernel_shape[1],
+              pad[0], pad[1], stride[0], stride[1], dilation[0],
+              dilation[1], this->output_shape_[0], this->output_shape_[1],
+              weight, bottom_diff + n * this->bottom_dim_);
+        }
+      }
+    } else if (this->param_propagate_down_[0] || propagate_down[i]) {
       for (int n = 0; n < this->num_; ++n) {
         // gradient w.r.t. weight. Note that we will accumulate diffs.
         if (this->param_propagate_down_[0]) {
@@ -88,17 +88,33 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 #endif
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const bool half = this->blobs_[0]->half_type() != DT_INVALID;
+  const Dtype* weight = half ? NULL : this->blobs_[0]->cpu_data();
+  const Dtype* slope = this->fused_slope();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-                             top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      if (this->int8_) {
+        this->forward_cpu_gemm_int8(bottom_data + n * this->bottom_dim_,
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+            top_data + n * this->top_dim_);
+      } else {
+        if (half) {
+          this->forward_cpu_gemm_half(bottom_data + n * this->bottom_dim_,
+                                      top_data + n * this->top_dim_);
+        } else {
+          this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+                                 top_data + n * this->top_dim_);
+        }
+        if (this->bias_term_) {
+          const Dtype* bias = this->blobs_[1]->cpu_data();
+          this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+        }
       }
+      // The image's output is still in cache, apply a fused activation now.
+      this->ForwardFusedActivation(*top[i], slope, n * this->top_dim_,
+          this->top_dim_, top_data + n * this->top_dim_);
     }
   }
 }
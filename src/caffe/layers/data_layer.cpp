@@ -32,21 +32,32 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <algorithm>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
 DataLayer<Dtype>::DataLayer(const LayerParameter& param)
   : BasePrefetchingDataLayer<Dtype>(param),
-    offset_() {
-  db_.reset(db::GetDB(param.data_param().backend()));
-  db_->Open(param.data_param().source(), db::READ);
-  cursor_.reset(db_->NewCursor());
+    shard_(0), offset_(), batches_(0), items_(0), read_us_(0),
+    transform_us_(0), batch_us_(0) {
+  const DataParameter& data_param = param.data_param();
+  const int shards = data_param.shards();
+  CHECK_GE(shards, 1) << "A data source needs at least one shard";
+  for (int i = 0; i < shards; ++i) {
+    shared_ptr<db::DB> db(db::GetDB(data_param.backend()));
+    db->Open(db::ShardSource(data_param.source(), i, shards), db::READ);
+    dbs_.push_back(db);
+    cursors_.push_back(shared_ptr<db::Cursor>(db->NewCursor()));
+  }
 }
 
 template <typename Dtype>
@@ -59,8 +70,10 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.data_param().batch_size();
   // Read a data point, and use it to initialize the top blob.
+  CHECK(cursors_[shard_]->valid()) << "No data in "
+      << this->layer_param_.data_param().source();
   Datum datum;
-  datum.ParseFromString(cursor_->value());
+  datum.ParseFromString(cursors_[shard_]->value());
 
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
@@ -83,6 +96,34 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       this->prefetch_[i]->label_.Reshape(label_shape);
     }
   }
+  int threads = this->layer_param_.data_param().decode_threads();
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, batch_size);
+  decode_pool_.reset(new ThreadPool(threads));
+  transformers_.resize(threads);
+  transformed_.resize(threads);
+  for (int i = 0; i < threads; ++i) {
+    transformers_[i] = i == 0 ? this->data_transformer_ :
+        shared_ptr<DataTransformer<Dtype> >(new DataTransformer<Dtype>(
+            this->transform_param_, this->phase_));
+    transformed_[i].reset(new Blob<Dtype>());
+  }
+  records_.resize(batch_size);
+  values_.resize(batch_size);
+  seeds_.resize(batch_size);
+}
+
+template <typename Dtype>
+DataLoadStats DataLayer<Dtype>::load_stats() const {
+  DataLoadStats stats;
+  stats.batches = batches_;
+  stats.items = items_;
+  stats.read_us = read_us_;
+  stats.transform_us = transform_us_;
+  stats.batch_us = batch_us_;
+  return stats;
 }
 
 template <typename Dtype>
@@ -97,13 +138,23 @@ bool DataLayer<Dtype>::Skip() {
 
 template<typename Dtype>
 void DataLayer<Dtype>::Next() {
-  cursor_->Next();
-  if (!cursor_->valid()) {
-    LOG_IF(INFO, Caffe::root_solver())
-        << "Restarting data prefetching from start.";
-    cursor_->SeekToFirst();
-  }
+  cursors_[shard_]->Next();
   offset_++;
+  // Shards hold every shards-th line of the list, but convert_imageset skips
+  // the images it cannot read, so they may end at different points. The pass
+  // goes on over the others and ends once all of them are out.
+  for (int i = 0; i < cursors_.size(); ++i) {
+    shard_ = (shard_ + 1) % cursors_.size();
+    if (cursors_[shard_]->valid()) {
+      return;
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Restarting data prefetching from start.";
+  for (int i = 0; i < cursors_.size(); ++i) {
+    cursors_[i]->SeekToFirst();
+  }
+  shard_ = 0;
 }
 
 // This function is called on prefetch thread
@@ -111,52 +162,100 @@ template<typename Dtype>
 void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
   batch_timer.Start();
-  double read_time = 0;
-  double trans_time = 0;
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
   const int batch_size = this->layer_param_.data_param().batch_size();
 
-  Datum datum;
+  // Records are read in order on this thread, together with the seeds of
+  // their random streams.
+  timer.Start();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
     while (Skip()) {
       Next();
     }
-    datum.ParseFromString(cursor_->value());
-    read_time += timer.MicroSeconds();
-
-    if (item_id == 0) {
-      // Reshape according to the first datum of each batch
-      // on single input batches allows for inputs of varying dimension.
-      // Use data_transformer to infer the expected blob shape from datum.
-      vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
-      this->transformed_data_.Reshape(top_shape);
-      // Reshape batch according to the batch_size.
-      top_shape[0] = batch_size;
-      batch->data_.Reshape(top_shape);
+    const char* data;
+    size_t size;
+    db::Cursor* cursor = cursors_[shard_].get();
+    if (!cursor->value_in_place(&data, &size)) {
+      values_[item_id] = cursor->value();
+      data = values_[item_id].data();
+      size = values_[item_id].size();
     }
+    records_[item_id] = std::make_pair(data, size);
+    seeds_[item_id] = caffe_rng_rand();
+    Next();
+  }
+  read_us_ += timer.MicroSeconds();
 
+  // Reshape according to the first datum of each batch
+  // on single input batches allows for inputs of varying dimension.
+  // Use data_transformer to infer the expected blob shape from datum.
+  Datum datum;
+  const char* pixels;
+  size_t pixels_size;
+  CHECK(ParseDatumInPlace(records_[0].first, records_[0].second, &datum,
+                          &pixels, &pixels_size)) << "Failed to parse datum";
+  if (datum.encoded()) {
+    datum.set_data(pixels, pixels_size);
+  }
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(top_shape);
+  for (int i = 0; i < transformed_.size(); ++i) {
+    transformed_[i]->Reshape(top_shape);
+  }
+  // Reshape batch according to the batch_size.
+  top_shape[0] = batch_size;
+  batch->data_.Reshape(top_shape);
+  // The threads write disjoint items of the batch through these pointers.
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  Dtype* top_label = this->output_labels_ ?
+      batch->label_.mutable_cpu_data() : NULL;
+
+  const int threads = transformers_.size();
+  decode_pool_->Run(threads, [&](int thread) {
+    TransformItems(thread, batch_size * thread / threads,
+                   batch_size * (thread + 1) / threads, top_data, top_label);
+  });
+  batch_timer.Stop();
+  batches_ += 1;
+  items_ += batch_size;
+  batch_us_ += batch_timer.MicroSeconds();
+}
+
+template<typename Dtype>
+void DataLayer<Dtype>::TransformItems(int thread, int begin, int end,
+                                      Dtype* top_data, Dtype* top_label) {
+  CPUTimer timer;
+  timer.Start();
+  DataTransformer<Dtype>* transformer = transformers_[thread].get();
+  Blob<Dtype>* transformed = transformed_[thread].get();
+  Datum datum;
+  const char* pixels;
+  size_t pixels_size;
+  for (int item_id = begin; item_id < end; ++item_id) {
+    // The values of raw datums are transformed straight from the record.
+    CHECK(ParseDatumInPlace(records_[item_id].first, records_[item_id].second,
+                            &datum, &pixels, &pixels_size))
+        << "Failed to parse datum";
     // Apply data transformations (mirror, scale, crop...)
-    timer.Start();
-    int offset = batch->data_.offset(item_id);
-    Dtype* top_data = batch->data_.mutable_cpu_data();
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
+    transformer->InitRand(seeds_[item_id]);
+    transformed->set_cpu_data(top_data + item_id * transformed->count());
+    if (datum.encoded()) {
+      datum.set_data(pixels, pixels_size);
+      transformer->Transform(datum, transformed);
+    } else {
+      CHECK(!pixels || pixels_size ==
+            static_cast<size_t>(datum.channels()) * datum.height() *
+            datum.width()) << "Datum data size mismatch";
+      transformer->Transform(datum, pixels, transformed);
+    }
     // Copy label.
-    if (this->output_labels_) {
-      Dtype* top_label = batch->label_.mutable_cpu_data();
+    if (top_label) {
       top_label[item_id] = datum.label();
     }
-    trans_time += timer.MicroSeconds();
-    Next();
   }
-  timer.Stop();
-  batch_timer.Stop();
-  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  transform_us_ += timer.MicroSeconds();
 }
 
 INSTANTIATE_CLASS(DataLayer);
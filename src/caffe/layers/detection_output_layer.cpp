@@ -215,6 +215,11 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
     const map<int, vector<float> >& conf_scores = all_conf_scores[i];
     map<int, vector<int> > indices;
     int num_det = 0;
+    // With shared locations every class runs NMS over the same boxes, so
+    // they are converted once and the classes batched together.
+    NMSBoxes shared_boxes;
+    vector<const float*> class_scores(num_classes_,
+                                      static_cast<const float*>(NULL));
     for (int c = 0; c < num_classes_; ++c) {
       if (c == background_label_id_) {
         // Ignore background class.
@@ -232,10 +237,34 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
         continue;
       }
       const vector<NormalizedBBox>& bboxes = decode_bboxes.find(label)->second;
+      if (share_location_) {
+        CHECK_EQ(bboxes.size(), scores.size())
+            << "bboxes and scores have different size.";
+        if (shared_boxes.size() == 0) {
+          GetNMSBoxes(bboxes, &shared_boxes);
+        }
+        class_scores[c] = scores.data();
+        continue;
+      }
       ApplyNMSFast(bboxes, scores, confidence_threshold_, nms_threshold_,
           top_k_, &(indices[c]));
       num_det += indices[c].size();
     }
+    if (share_location_) {
+      NMSParam param;
+      param.score_threshold = confidence_threshold_;
+      param.overlap_threshold = nms_threshold_;
+      param.top_k = top_k_;
+      vector<vector<int> > class_indices;
+      NonMaxSuppressionBatched(shared_boxes, class_scores, param,
+                               &class_indices);
+      for (int c = 0; c < num_classes_; ++c) {
+        if (class_scores[c]) {
+          indices[c].swap(class_indices[c]);
+          num_det += indices[c].size();
+        }
+      }
+    }
     if (keep_top_k_ > -1 && num_det > keep_top_k_) {
       vector<pair<float, pair<int, int> > > score_index_pairs;
       for (map<int, vector<int> >::iterator it = indices.begin();
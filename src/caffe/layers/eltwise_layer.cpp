@@ -27,11 +27,13 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
 #include <cfloat>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -76,55 +78,70 @@ template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                       const vector<Blob<Dtype>*>& top) {
   int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  switch (op_) {
-  case EltwiseParameter_EltwiseOp_PROD:
-    caffe_mul(count, bottom[0]->cpu_data(), bottom[1]->cpu_data(), top_data);
-    for (int i = 2; i < bottom.size(); ++i) {
-      caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
-    for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
-    }
-    break;
-  case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
+  if (op_ == EltwiseParameter_EltwiseOp_MAX) {
     mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
-    // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
+  }
+  // Blob accessors may sync memory, so they are not called from the threads.
+  vector<const Dtype*> bottom_data(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_data[i] = bottom[i]->cpu_data();
+  }
+  const Dtype* slope = this->fused_slope();
+  // Split the elements over the intra-op threads in blocks of kBlock, which
+  // keeps every block starting at the same alignment as the serial loop.
+  const int kBlock = 4096;
+  const int blocks = (count + kBlock - 1) / kBlock;
+  caffe_parallel_for(blocks, kBlock * bottom.size(), [&](int first, int last) {
+    const int begin = first * kBlock;
+    const int n = std::min(count, last * kBlock) - begin;
+    Dtype* top_block = top_data + begin;
+    switch (op_) {
+    case EltwiseParameter_EltwiseOp_PROD:
+      caffe_mul(n, bottom_data[0] + begin, bottom_data[1] + begin, top_block);
+      for (int i = 2; i < bottom.size(); ++i) {
+        caffe_mul(n, top_block, bottom_data[i] + begin, top_block);
       }
-    }
-    // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
+      break;
+    case EltwiseParameter_EltwiseOp_SUM:
+      caffe_set(n, Dtype(0), top_block);
+      // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
+      for (int i = 0; i < bottom.size(); ++i) {
+        caffe_axpy(n, coeffs_[i], bottom_data[i] + begin, top_block);
+      }
+      break;
+    case EltwiseParameter_EltwiseOp_MAX: {
+      int* mask_block = mask + begin;
+      // bottom 0 & 1
+      const Dtype* bottom_data_a = bottom_data[0] + begin;
+      const Dtype* bottom_data_b = bottom_data[1] + begin;
+      for (int idx = 0; idx < n; ++idx) {
+        if (bottom_data_a[idx] > bottom_data_b[idx]) {
+          top_block[idx] = bottom_data_a[idx];  // maxval
+          mask_block[idx] = 0;  // maxid
+        } else {
+          top_block[idx] = bottom_data_b[idx];  // maxval
+          mask_block[idx] = 1;  // maxid
         }
       }
+      // bottom 2++
+      for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
+        bottom_data_b = bottom_data[blob_idx] + begin;
+        for (int idx = 0; idx < n; ++idx) {
+          if (bottom_data_b[idx] > top_block[idx]) {
+            top_block[idx] = bottom_data_b[idx];  // maxval
+            mask_block[idx] = blob_idx;  // maxid
+          }
+        }
+      }
+      break;
     }
-    break;
-  default:
-    LOG(FATAL) << "Unknown elementwise operation.";
-  }
+    default:
+      LOG(FATAL) << "Unknown elementwise operation.";
+    }
+    this->ForwardFusedActivation(*top[0], slope, begin, n, top_block);
+  });
 }
 
 template <typename Dtype>
@@ -36,6 +36,8 @@ TODO:
   :: don't forget to update hdf5_daa_layer.cu accordingly
 - add ability to shuffle filenames if flag is set
 */
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <memory>  // NOLINT
 #include <string>
@@ -47,16 +49,24 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {}
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+  if (stream_file_id_ >= 0) {
+    std::lock_guard<std::mutex> lock(hdf5_mutex());
+    H5Fclose(stream_file_id_);
+  }
+}
 
 // Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
   DLOG(INFO) << "Loading HDF5 file: " << filename;
+  std::unique_lock<std::mutex> lock(hdf5_mutex());
   hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
@@ -77,6 +87,7 @@ void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
 
   herr_t status = H5Fclose(file_id);
   CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  lock.unlock();
 
   // MinTopBlobs==1 guarantees at least one top blob
   CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
@@ -137,8 +148,25 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  chunk_rows_ = this->layer_param_.hdf5_data_param().chunk_rows();
+  if (chunk_rows_ > 0) {
+    // Two chunks, one read by Forward while the thread fills the other.
+    const int top_size = this->layer_param_.top_size();
+    chunks_.resize(2);
+    for (int i = 0; i < chunks_.size(); ++i) {
+      chunks_[i].reset(new HDF5Chunk<Dtype>());
+      chunks_[i]->blobs.resize(top_size);
+      for (int j = 0; j < top_size; ++j) {
+        chunks_[i]->blobs[j].reset(new Blob<Dtype>());
+      }
+      chunk_free_.push(i);
+    }
+    this->StartInternalThread();
+    NextChunk();
+  } else {
+    // Load the first HDF5 file and initialize the line counter.
+    LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  }
   current_row_ = 0;
 
   // Reshape blobs.
@@ -167,7 +195,11 @@ bool HDF5DataLayer<Dtype>::Skip() {
 
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
-  if (++current_row_ == hdf_blobs_[0]->shape(0)) {
+  if (++current_row_ == hdf_blobs_[0]->shape(0) && chunk_rows_ > 0) {
+    // Streamed chunks come shuffled from the background thread.
+    NextChunk();
+    current_row_ = 0;
+  } else if (current_row_ == hdf_blobs_[0]->shape(0)) {
     if (num_files_ > 1) {
       ++current_file_;
       if (current_file_ == num_files_) {
@@ -207,6 +239,99 @@ void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::NextChunk() {
+  if (current_chunk_ >= 0) {
+    chunk_free_.push(current_chunk_);
+  }
+  current_chunk_ = chunk_full_.pop("Waiting for HDF5 data");
+  hdf_blobs_ = chunks_[current_chunk_]->blobs;
+  data_permutation_ = chunks_[current_chunk_]->permutation;
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      const int chunk = chunk_free_.pop();
+      LoadChunk(chunks_[chunk].get());
+      chunk_full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+// Called on the background thread.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::LoadChunk(HDF5Chunk<Dtype>* chunk) {
+  const bool shuffle = this->layer_param_.hdf5_data_param().shuffle();
+  if (next_chunk_ == chunk_starts_.size()) {
+    // Every chunk of the open file was read, move on to the next file.
+    if (stream_file_id_ >= 0 && ++current_file_ == num_files_) {
+      current_file_ = 0;
+      if (shuffle) {
+        caffe::shuffle(file_permutation_.begin(), file_permutation_.end());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+    OpenStreamFile(hdf_filenames_[file_permutation_[current_file_]]);
+  }
+  const int start = chunk_starts_[next_chunk_++];
+  const int rows = std::min(chunk_rows_, stream_shapes_[0][0] - start);
+  {
+    std::lock_guard<std::mutex> lock(hdf5_mutex());
+    for (int i = 0; i < chunk->blobs.size(); ++i) {
+      hdf5_load_nd_dataset_rows(stream_file_id_,
+                                this->layer_param_.top(i).c_str(),
+                                stream_shapes_[i], start, rows,
+                                chunk->blobs[i].get());
+    }
+  }
+  chunk->permutation.resize(rows);
+  for (int i = 0; i < rows; ++i) {
+    chunk->permutation[i] = i;
+  }
+  if (shuffle) {
+    caffe::shuffle(chunk->permutation.begin(), chunk->permutation.end());
+  }
+}
+
+// Called on the background thread.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::OpenStreamFile(const string& filename) {
+  std::lock_guard<std::mutex> lock(hdf5_mutex());
+  if (filename != stream_filename_) {
+    if (stream_file_id_ >= 0) {
+      herr_t status = H5Fclose(stream_file_id_);
+      CHECK_GE(status, 0) << "Failed to close HDF5 file: " << stream_filename_;
+    }
+    DLOG(INFO) << "Streaming HDF5 file: " << filename;
+    stream_file_id_ = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (stream_file_id_ < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    stream_filename_ = filename;
+    const int top_size = this->layer_param_.top_size();
+    stream_shapes_.resize(top_size);
+    for (int i = 0; i < top_size; ++i) {
+      stream_shapes_[i] = hdf5_get_nd_dataset_shape(stream_file_id_,
+          this->layer_param_.top(i).c_str(), 1, INT_MAX);
+      CHECK_EQ(stream_shapes_[i][0], stream_shapes_[0][0]);
+    }
+  }
+  const int num = stream_shapes_[0][0];
+  CHECK_GT(num, 0) << "No rows in HDF5 file: " << filename;
+  chunk_starts_.clear();
+  for (int start = 0; start < num; start += chunk_rows_) {
+    chunk_starts_.push_back(start);
+  }
+  if (this->layer_param_.hdf5_data_param().shuffle()) {
+    caffe::shuffle(chunk_starts_.begin(), chunk_starts_.end());
+  }
+  next_chunk_ = 0;
+}
+
 #ifndef USE_CUDA
 STUB_GPU_FORWARD(HDF5DataLayer, Forward);
 #endif
@@ -56,8 +56,6 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int new_height = this->layer_param_.image_data_param().new_height();
   const int new_width  = this->layer_param_.image_data_param().new_width();
-  const bool is_color  = this->layer_param_.image_data_param().is_color();
-  string root_folder = this->layer_param_.image_data_param().root_folder();
   iter_  = this->layer_param_.image_data_param().iterations();
 
   CHECK((new_height == 0 && new_width == 0) ||
@@ -91,6 +89,10 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }
   LOG(INFO) << "A total of " << lines_.size() << " images.";
+  if (ImageCache::Enabled(this->layer_param_.image_data_param().cache())) {
+    cache_ = ImageCache::Get();
+    cache_->Configure(this->layer_param_.image_data_param().cache());
+  }
 
   lines_id_ = 0;
   // Check if we would need to randomly skip a few data points
@@ -102,8 +104,8 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     lines_id_ = skip;
   }
   // Read an image, and use it to initialize the top blob.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-                                    new_height, new_width, is_color);
+  CachedImage image;
+  cv::Mat cv_img = ReadImage(&image);
   CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
@@ -147,15 +149,11 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   ImageDataParameter image_data_param = this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
-  string root_folder = image_data_param.root_folder();
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
+  CachedImage image;
+  cv::Mat cv_img = ReadImage(&image);
   CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
   // Use data_transformer to infer the expected blob shape from a cv_img.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
@@ -173,8 +171,8 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     // get a blob
     timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
+    CachedImage item_image;
+    cv::Mat cv_img = ReadImage(&item_image);
     CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
     read_time += timer.MicroSeconds();
     timer.Start();
@@ -200,6 +198,21 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch : " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time : " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time : " << trans_time / 1000 << " ms.";
+  if (cache_) {
+    DLOG(INFO) << "Cache hit rate : " << cache_->stats().hit_rate();
+  }
+}
+
+template <typename Dtype>
+cv::Mat ImageDataLayer<Dtype>::ReadImage(CachedImage* image) {
+  const ImageDataParameter& param = this->layer_param_.image_data_param();
+  const string filename = param.root_folder() + lines_[lines_id_].first;
+  if (cache_) {
+    return ReadImageToCVMat(filename, param.new_height(), param.new_width(),
+                            param.is_color(), cache_, image);
+  }
+  return ReadImageToCVMat(filename, param.new_height(), param.new_width(),
+                          param.is_color());
 }
 
 INSTANTIATE_CLASS(ImageDataLayer);
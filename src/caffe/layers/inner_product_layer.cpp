@@ -31,6 +31,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -81,6 +82,10 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  int8_ = UseCpuInt8(this->layer_param_);
+  int8_weights_ = Int8Weights();
+  int8_weights_src_.reset();
+  int8_weights_version_ = 0;
 }
 
 template <typename Dtype>
@@ -114,15 +119,81 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (int8_) {
+    const Blob<Dtype>& weights = *this->blobs_[0];
+    if (int8_weights_src_ != weights.data() ||
+        int8_weights_version_ != weights.data()->version()) {
+      // One packed row per output, whichever way the weights are stored.
+      int8_weights_src_ = weights.data();
+      int8_pack_weights(weights.cpu_data(), N_, K_,
+                        transpose_ ? 1 : K_, transpose_ ? N_ : 1,
+                        this->layer_param_.blobs_dtype(0), &int8_weights_);
+      int8_weights_version_ = int8_weights_src_->version();
+    }
+    const float step = Int8Step(this->layer_param_.bottom_mlu_dtype(0));
+    int8_input_.resize(static_cast<size_t>(M_) * int8_weights_.stride);
+    int8_quantize_rows(bottom_data, M_, K_, K_, 1, step,
+                       int8_weights_.stride, &int8_input_[0]);
+    int8_gemm(int8_weights_, 0, N_, &int8_input_[0], M_, step,
+              bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data, 1,
+              N_);
+    this->ForwardFusedActivation(*top[0], this->fused_slope(), 0, M_ * N_,
+                                 top_data);
+    return;
+  }
+  if (this->blobs_[0]->half_type() != DT_INVALID) {
+    Forward_cpu_half(bottom_data, top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, this->blobs_[0]->cpu_data(), (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
         this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
   }
+  this->ForwardFusedActivation(*top[0], this->fused_slope(), 0, M_ * N_,
+                               top_data);
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::Forward_cpu_half(const Dtype* bottom_data,
+    Dtype* top_data) {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  // Without transpose_ a block of weight rows gives a block of outputs,
+  // with it a block of inputs adds to all of them.
+  caffe_cpu_half_row_blocks<Dtype>(weights.half_data(), weights.half_type(),
+      transpose_ ? K_ : N_, transpose_ ? N_ : K_,
+      [&](int begin, int end, const Dtype* weight_rows) {
+    const int rows = end - begin;
+    if (!transpose_) {
+      if (M_ == 1) {
+        caffe_cpu_gemv<Dtype>(CblasNoTrans, rows, K_, (Dtype)1., weight_rows,
+            bottom_data, (Dtype)0., top_data + begin);
+        return;
+      }
+      half_buffer_.resize(M_ * rows);
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, rows, K_, (Dtype)1.,
+          bottom_data, weight_rows, (Dtype)0., &half_buffer_[0]);
+      for (int m = 0; m < M_; ++m) {
+        caffe_copy(rows, &half_buffer_[m * rows], top_data + m * N_ + begin);
+      }
+    } else {
+      const Dtype* bottom_cols = bottom_data + begin;
+      if (M_ > 1) {
+        half_buffer_.resize(M_ * rows);
+        for (int m = 0; m < M_; ++m) {
+          caffe_copy(rows, bottom_data + m * K_ + begin,
+                     &half_buffer_[m * rows]);
+        }
+        bottom_cols = &half_buffer_[0];
+      }
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, rows,
+          (Dtype)1., bottom_cols, weight_rows, (Dtype)(begin == 0 ? 0 : 1),
+          top_data);
+    }
+  });
 }
 
 template <typename Dtype>
@@ -32,6 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layers/interp_layer.hpp"
 #include "caffe/util/interp.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -92,22 +93,29 @@ void InterpLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void InterpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                      const vector<Blob<Dtype>*>& top) {
-  caffe_cpu_interp2<Dtype>(num_ * channels_,
-                           bottom[0]->cpu_data(),
-                           - pad_beg_,
-                           - pad_beg_,
-                           height_in_eff_,
-                           width_in_eff_,
-                           height_in_,
-                           width_in_,
-                           top[0]->mutable_cpu_data(),
-                           0,
-                           0,
-                           height_out_,
-                           width_out_,
-                           height_out_,
-                           width_out_,
-                           false);
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int bottom_dim = height_in_ * width_in_;
+  const int top_dim = height_out_ * width_out_;
+  // Channels are interpolated independently, split them over threads.
+  caffe_parallel_for(num_ * channels_, top_dim, [&](int begin, int end) {
+    caffe_cpu_interp2<Dtype>(end - begin,
+                             bottom_data + begin * bottom_dim,
+                             - pad_beg_,
+                             - pad_beg_,
+                             height_in_eff_,
+                             width_in_eff_,
+                             height_in_,
+                             width_in_,
+                             top_data + begin * top_dim,
+                             0,
+                             0,
+                             height_out_,
+                             width_out_,
+                             height_out_,
+                             width_out_,
+                             false);
+  });
 }
 
 template <typename Dtype>
@@ -31,6 +31,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -140,45 +141,50 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(const vector<Blob<Dtype>*>& bottom
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
   Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
+  // Images are independent, each chunk of them pads its own squares.
+  caffe_parallel_for(num_, 2 * scale_.count(1), [&](int begin, int end) {
+    // start with the constant value
+    caffe_set((end - begin) * scale_.count(1), k_,
+              scale_data + scale_.offset(begin));
+    Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
+    Dtype* padded_square_data = padded_square.mutable_cpu_data();
+    caffe_set(padded_square.count(), Dtype(0), padded_square_data);
+    // go through the images
+    for (int n = begin; n < end; ++n) {
+      // compute the padded square
+      caffe_sqr(channels_ * height_ * width_,
+          bottom_data + bottom[0]->offset(n),
+          padded_square_data + padded_square.offset(0, pre_pad_));
+      // Create the first channel scale
+      for (int c = 0; c < size_; ++c) {
+        caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
+            padded_square_data + padded_square.offset(0, c),
+            scale_data + scale_.offset(n, 0));
+      }
+      for (int c = 1; c < channels_; ++c) {
+        // copy previous scale
+        caffe_copy<Dtype>(height_ * width_,
+            scale_data + scale_.offset(n, c - 1),
+            scale_data + scale_.offset(n, c));
+        // add head
+        caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
+            padded_square_data + padded_square.offset(0, c + size_ - 1),
+            scale_data + scale_.offset(n, c));
+        // subtract tail
+        caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
+            padded_square_data + padded_square.offset(0, c - 1),
+            scale_data + scale_.offset(n, c));
+      }
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
-    }
-  }
 
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+    // In the end, compute output
+    const int offset = scale_.offset(begin);
+    const int count = (end - begin) * scale_.count(1);
+    caffe_powx<Dtype>(count, scale_data + offset, -beta_, top_data + offset);
+    caffe_mul<Dtype>(count, top_data + offset, bottom_data + offset,
+                     top_data + offset);
+  });
 }
 
 template <typename Dtype>
@@ -32,6 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/normalize_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -121,7 +122,6 @@ void NormalizeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* scale = this->blobs_[0]->cpu_data();
-  Dtype* buffer_data = buffer_.mutable_cpu_data();
   Dtype* norm_data = norm_.mutable_cpu_data();
   // add eps to avoid overflow
   caffe_set<Dtype>(norm_.count(), Dtype(eps_), norm_data);
@@ -131,45 +131,51 @@ void NormalizeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int dim = bottom[0]->count() / num;
   int spatial_dim = bottom[0]->height() * bottom[0]->width();
   int channels = bottom[0]->channels();
-  for (int n = 0; n < num; ++n) {
-    caffe_sqr<Dtype>(dim, bottom_data, buffer_data);
-    if (across_spatial_) {
-      // add eps to avoid overflow
-      norm_data[n] = pow(caffe_cpu_asum<Dtype>(dim, buffer_data)+eps_,
-                         Dtype(0.5));
-      caffe_cpu_scale<Dtype>(dim, Dtype(1.0 / norm_data[n]), bottom_data,
-                             top_data);
-    } else {
-      caffe_cpu_gemv<Dtype>(CblasTrans, channels, spatial_dim, Dtype(1),
-                            buffer_data, sum_channel_multiplier, Dtype(1),
-                            norm_data);
-      // compute norm
-      caffe_powx<Dtype>(spatial_dim, norm_data, Dtype(0.5), norm_data);
-      // LOG(INFO) << "after sqrt " << norm_data[0];
-      // scale the layer
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                            1, Dtype(1), sum_channel_multiplier, norm_data,
-                            Dtype(0), buffer_data);
-      // LOG(INFO) << "after gemm1 " << buffer_data[0];
-      caffe_div<Dtype>(dim, bottom_data, buffer_data, top_data);
-      // LOG(INFO) << "after div " << top_data[0];
-      norm_data += spatial_dim;
+  // Images are normalized independently; the first chunk works in buffer_,
+  // the others in a buffer of their own.
+  Dtype* first_buffer_data = buffer_.mutable_cpu_data();
+  caffe_parallel_for(num, 3 * dim, [&](int begin, int end) {
+    Blob<Dtype> chunk_buffer;
+    Dtype* buffer_data = first_buffer_data;
+    if (begin > 0) {
+      chunk_buffer.ReshapeLike(buffer_);
+      buffer_data = chunk_buffer.mutable_cpu_data();
     }
-    // scale the output
-    if (channel_shared_) {
-      caffe_scal<Dtype>(dim, scale[0], top_data);
-    } else {
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                            1, Dtype(1), scale, sum_spatial_multiplier,
-                            Dtype(0),
-                            buffer_data);
-      // LOG(INFO) << "after gemm2 " << buffer_data[0];
-      caffe_mul<Dtype>(dim, top_data, buffer_data, top_data);
-      // LOG(INFO) << "after mul " << top_data[0];
+    for (int n = begin; n < end; ++n) {
+      const Dtype* bottom_n = bottom_data + n * dim;
+      Dtype* top_n = top_data + n * dim;
+      caffe_sqr<Dtype>(dim, bottom_n, buffer_data);
+      if (across_spatial_) {
+        // add eps to avoid overflow
+        norm_data[n] = pow(caffe_cpu_asum<Dtype>(dim, buffer_data)+eps_,
+                           Dtype(0.5));
+        caffe_cpu_scale<Dtype>(dim, Dtype(1.0 / norm_data[n]), bottom_n,
+                               top_n);
+      } else {
+        Dtype* norm_n = norm_data + n * spatial_dim;
+        caffe_cpu_gemv<Dtype>(CblasTrans, channels, spatial_dim, Dtype(1),
+                              buffer_data, sum_channel_multiplier, Dtype(1),
+                              norm_n);
+        // compute norm
+        caffe_powx<Dtype>(spatial_dim, norm_n, Dtype(0.5), norm_n);
+        // scale the layer
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels,
+                              spatial_dim, 1, Dtype(1), sum_channel_multiplier,
+                              norm_n, Dtype(0), buffer_data);
+        caffe_div<Dtype>(dim, bottom_n, buffer_data, top_n);
+      }
+      // scale the output
+      if (channel_shared_) {
+        caffe_scal<Dtype>(dim, scale[0], top_n);
+      } else {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels,
+                              spatial_dim, 1, Dtype(1), scale,
+                              sum_spatial_multiplier, Dtype(0),
+                              buffer_data);
+        caffe_mul<Dtype>(dim, top_n, buffer_data, top_n);
+      }
     }
-    bottom_data += dim;
-    top_data += dim;
-  }
+  });
 }
 
 template <typename Dtype>
@@ -27,18 +27,21 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/permute_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Permutes the top elements in [begin, end).
 template <typename Dtype>
-void Permute(const int count, Dtype* bottom_data, const bool forward,
-    const int* permute_order, const int* old_steps, const int* new_steps,
-    const int num_axes, Dtype* top_data) {
-    for (int i = 0; i < count; ++i) {
+static void PermuteRange(const int begin, const int end, Dtype* bottom_data,
+    const bool forward, const int* permute_order, const int* old_steps,
+    const int* new_steps, const int num_axes, Dtype* top_data) {
+    for (int i = begin; i < end; ++i) {
       int old_idx = 0;
       int idx = i;
       for (int j = 0; j < num_axes; ++j) {
@@ -54,6 +57,14 @@ void Permute(const int count, Dtype* bottom_data, const bool forward,
     }
 }
 
+template <typename Dtype>
+void Permute(const int count, Dtype* bottom_data, const bool forward,
+    const int* permute_order, const int* old_steps, const int* new_steps,
+    const int num_axes, Dtype* top_data) {
+  PermuteRange(0, count, bottom_data, forward, permute_order, old_steps,
+               new_steps, num_axes, top_data);
+}
+
 template <typename Dtype>
 void PermuteLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -134,8 +145,15 @@ void PermuteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const int* old_steps = old_steps_.cpu_data();
     const int* new_steps = new_steps_.cpu_data();
     bool forward = true;
-    Permute(top_count, bottom_data, forward, permute_order, old_steps,
-            new_steps, num_axes_, top_data);
+    // Each output element is gathered on its own, split them over threads.
+    const int kBlock = 4096;
+    caffe_parallel_for((top_count + kBlock - 1) / kBlock, kBlock,
+        [&](int first, int last) {
+      const int begin = first * kBlock;
+      const int end = std::min(top_count, last * kBlock);
+      PermuteRange(begin, end, bottom_data, forward, permute_order,
+                   old_steps, new_steps, num_axes_, top_data);
+    });
   } else {
     // If there is no need to permute, we share data to save memory.
     top[0]->ShareData(*bottom[0]);
@@ -33,6 +33,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -165,27 +166,40 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
   Dtype* top_mask = NULL;
+  // Every (n, c) plane is pooled independently, so planes are split over the
+  // intra-op threads.
+  const int planes = bottom[0]->num() * channels_;
+  const int bottom_dim = bottom[0]->offset(0, 1);
+  const int top_dim = top[0]->offset(0, 1);
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
     } else {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
     }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
+    caffe_parallel_for(planes, bottom_dim + top_dim, [&](int begin, int end) {
+      // Initialize
+      if (use_top_mask) {
+        caffe_set((end - begin) * top_dim, Dtype(-1),
+                  top_mask + begin * top_dim);
+      } else {
+        caffe_set((end - begin) * top_dim, -1, mask + begin * top_dim);
+      }
+      caffe_set((end - begin) * top_dim, Dtype(-FLT_MAX),
+                top_data + begin * top_dim);
+      // The main loop
+      for (int i = begin; i < end; ++i) {
+        const Dtype* plane_bottom = bottom_data + i * bottom_dim;
+        Dtype* plane_top = top_data + i * top_dim;
+        Dtype* plane_top_mask = use_top_mask ? top_mask + i * top_dim : NULL;
+        int* plane_mask = use_top_mask ? NULL : mask + i * top_dim;
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             int hstart = ph * stride_h_ - pad_h_;
@@ -198,36 +212,30 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
             for (int h = hstart; h < hend; ++h) {
               for (int w = wstart; w < wend; ++w) {
                 const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
+                if (plane_bottom[index] > plane_top[pool_index]) {
+                  plane_top[pool_index] = plane_bottom[index];
                   if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
+                    plane_top_mask[pool_index] = static_cast<Dtype>(index);
                   } else {
-                    mask[pool_index] = index;
+                    plane_mask[pool_index] = index;
                   }
                 }
               }
             }
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
       }
-    }
+    });
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
+    caffe_parallel_for(planes, bottom_dim + top_dim, [&](int begin, int end) {
+      for (int i = begin * top_dim; i < end * top_dim; ++i) {
+        top_data[i] = 0;
+      }
+      // The main loop
+      for (int i = begin; i < end; ++i) {
+        const Dtype* plane_bottom = bottom_data + i * bottom_dim;
+        Dtype* plane_top = top_data + i * top_dim;
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             int hstart = ph * stride_h_ - pad_h_;
@@ -241,18 +249,15 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
             wend = min(wend, width_);
             for (int h = hstart; h < hend; ++h) {
               for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
+                plane_top[ph * pooled_width_ + pw] +=
+                    plane_bottom[h * width_ + w];
               }
             }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
+            plane_top[ph * pooled_width_ + pw] /= pool_size;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
       }
-    }
+    });
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string>
 #include <vector>
 #include "caffe/layers/proposal_layer.hpp"
+#include "caffe/util/nms.hpp"
 #define SIZE 1000
 
 #define ROUND(x) ((int)((x) + (Dtype)0.5))  // NOLINT
@@ -259,33 +260,25 @@ void ProposalLayer<Dtype>::GetNewScoresByKeep(const Dtype* scores,
 template <typename Dtype>
 void ProposalLayer<Dtype>::NMS(const vector<Dtype>& box, vector<int>* id,
                                int* id_size, Dtype THRESH, int MAX_NUM) {
-  vector<bool> is_used(*id_size, true);
-  vector<Dtype> area(*id_size);
+  // The ids are already ranked by score.
+  NMSBoxes boxes(false);
+  boxes.reserve(*id_size);
+  vector<int> order(*id_size);
   for (int i = 0; i < *id_size; i++) {
-    area[i] = (box[(*id)[i] * 4 + 2] - box[(*id)[i] * 4 + 0] + 1) *
-              (box[(*id)[i] * 4 + 3] - box[(*id)[i] * 4 + 1] + 1);
+    const Dtype* b = &box[(*id)[i] * 4];
+    boxes.push_back(b[0], b[1], b[2], b[3],
+                    (b[2] - b[0] + 1) * (b[3] - b[1] + 1));
+    order[i] = i;
   }
-  int j = 0;
-  for (int i = 0; i < *id_size; i++) {
-    if (is_used[i]) {
-      (*id)[j] = (*id)[i];
-      for (int k = i + 1; k < *id_size; k++) {
-        if (is_used[k]) {
-          Dtype inter_x1 = max(box[(*id)[i] * 4 + 0], box[(*id)[k] * 4 + 0]);
-          Dtype inter_y1 = max(box[(*id)[i] * 4 + 1], box[(*id)[k] * 4 + 1]);
-          Dtype inter_x2 = min(box[(*id)[i] * 4 + 2], box[(*id)[k] * 4 + 2]);
-          Dtype inter_y2 = min(box[(*id)[i] * 4 + 3], box[(*id)[k] * 4 + 3]);
-          Dtype inter_area = max((Dtype)0, inter_x2 - inter_x1 + 1) *
-                             max((Dtype)0, inter_y2 - inter_y1 + 1);
-          Dtype over = inter_area / (area[i] + area[k] - inter_area);
-          if (over > THRESH) is_used[k] = false;
-        }
-      }
-      j = j + 1;
-      if (j >= MAX_NUM) break;
-    }
+  NMSParam param;
+  param.overlap_threshold = THRESH;
+  param.keep_top_k = MAX_NUM;
+  vector<int> keep;
+  NonMaxSuppressionOrdered(boxes, order, param, &keep);
+  for (int j = 0; j < keep.size(); j++) {
+    (*id)[j] = (*id)[keep[j]];
   }
-  *id_size = j;
+  *id_size = keep.size();
 }
 
 template <typename Dtype>
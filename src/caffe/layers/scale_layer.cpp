@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/scale_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -157,14 +158,15 @@ void ScaleLayer<Dtype>::Forward_cpu(
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < outer_dim_; ++n) {
-    for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
-      bottom_data += inner_dim_;
-      top_data += inner_dim_;
+  // Rows of inner_dim_ elements are scaled independently.
+  caffe_parallel_for(outer_dim_ * scale_dim_, inner_dim_,
+      [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const Dtype factor = scale_data[i % scale_dim_];
+      caffe_cpu_scale(inner_dim_, factor, bottom_data + i * inner_dim_,
+                      top_data + i * inner_dim_);
     }
-  }
+  });
   if (bias_layer_) {
     bias_layer_->Forward(bias_bottom_vec_, top);
   }
@@ -32,6 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -60,32 +61,40 @@ void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* scale_data = scale_.mutable_cpu_data();
   int channels = bottom[0]->shape(softmax_axis_);
   int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
+  const Dtype* sum_multiplier = sum_multiplier_.cpu_data();
+  // Outer slices are independent and each one has its own scale_ slice, so
+  // they are split over the intra-op threads.
+  caffe_parallel_for(outer_num_, 3 * dim, [&](int begin, int end) {
+    caffe_copy((end - begin) * dim, bottom_data + begin * dim,
+               top_data + begin * dim);
+    // We need to subtract the max to avoid numerical issues, compute the exp,
+    // and then normalize.
+    for (int i = begin; i < end; ++i) {
+      Dtype* top_slice = top_data + i * dim;
+      Dtype* scale_slice = scale_data + i * inner_num_;
+      // initialize scale_data to the first plane
+      caffe_copy(inner_num_, bottom_data + i * dim, scale_slice);
+      for (int j = 0; j < channels; j++) {
+        for (int k = 0; k < inner_num_; k++) {
+          scale_slice[k] = std::max(scale_slice[k],
+              bottom_data[i * dim + j * inner_num_ + k]);
+        }
+      }
+      // subtraction
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
+          1, -1., sum_multiplier, scale_slice, 1., top_slice);
+      // exponentiation
+      caffe_exp<Dtype>(dim, top_slice, top_slice);
+      // sum after exp
+      caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
+          top_slice, sum_multiplier, 0., scale_slice);
+      // division
+      for (int j = 0; j < channels; j++) {
+        caffe_div(inner_num_, top_slice, scale_slice, top_slice);
+        top_slice += inner_num_;
       }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
-    }
-  }
+  });
 }
 
 template <typename Dtype>
@@ -30,9 +30,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 
+#include <algorithm>
 #include <fstream>   // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -163,34 +165,53 @@ void VideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     lines_id_ = skip;
   }
 
+  const int batch_size = this->layer_param_.video_data_param().batch_size();
+  CHECK_GT(batch_size, 0) << "Positive batch size required";
+  int threads = this->layer_param_.video_data_param().decode_threads();
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, batch_size);
+  decode_pool_.reset(new ThreadPool(threads));
+  readers_.resize(threads);
+  transformers_.resize(threads);
+  transformed_.resize(threads);
+  for (int i = 0; i < threads; ++i) {
+    readers_[i].reset(new VideoClipReader());
+    transformers_[i] = i == 0 ? this->data_transformer_ :
+        shared_ptr<DataTransformer<Dtype> >(new DataTransformer<Dtype>(
+            this->transform_param_, this->phase_));
+    transformed_[i].reset(new Blob<Dtype>());
+  }
+  clips_.resize(batch_size);
+  slabs_.resize(batch_size);
+  slab_shapes_.resize(batch_size);
+
   // Read a data point, and use it to initialize the top blob.
-  VolumeDatum datum;
   int id = shuffle_index_[lines_id_];
+  const string clip_file = root_folder + file_list_[id];
   if (!use_image) {
-    if (use_temporal_jitter) {
-      CHECK(ReadVideoToVolumeDatum((root_folder + file_list_[0]).c_str(), 0,
-                                   label_list_[0], new_length, new_height,
-                                   new_width, sampling_rate, &datum));
-    } else {
-      CHECK(ReadVideoToVolumeDatum((root_folder + file_list_[id]).c_str(),
-                                   start_frm_list_[id], label_list_[id],
-                                   new_length, new_height, new_width,
-                                   sampling_rate, &datum));
-    }
+    CHECK(readers_[0]->ReadVideo(clip_file,
+                                 use_temporal_jitter ? 0 : start_frm_list_[id],
+                                 0, new_length, new_height, new_width,
+                                 sampling_rate, &slab_shapes_[0], &slabs_[0]))
+        << "Could not read " << clip_file;
   } else {
-    CHECK(ReadImageSequenceToVolumeDatum((root_folder + file_list_[id]).c_str(),
-                                         start_frm_list_[id], label_list_[id],
-                                         new_length, new_height, new_width,
-                                         sampling_rate, &datum));
+    // With temporal jitter start_frm_list_ holds the number of frames.
+    CHECK(readers_[0]->ReadImageSequence(clip_file,
+                                         use_temporal_jitter ? 1 :
+                                         start_frm_list_[id], new_length,
+                                         new_height, new_width, sampling_rate,
+                                         &slab_shapes_[0], &slabs_[0]))
+        << "Could not read " << clip_file;
   }
+  const VolumeDatum& datum = slab_shapes_[0];
 
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
   this->transformed_data_.Reshape(top_shape);
 
   // Reshape prefetch_data and top[0] according to the batch_size.
-  const int batch_size = this->layer_param_.video_data_param().batch_size();
-  CHECK_GT(batch_size, 0) << "Positive batch size required";
   top_shape[0] = batch_size;
   for (int i = 0; i < this->prefetch_.size(); ++i) {
     this->prefetch_[i]->data_.Reshape(top_shape);
@@ -219,6 +240,88 @@ void VideoDataLayer<Dtype>::ShuffleClips() {
   shuffle(shuffle_index_.begin(), shuffle_index_.end(), prefetch_rng);
 }
 
+template <typename Dtype>
+void VideoDataLayer<Dtype>::NextClip(Clip* clip) {
+  const VideoDataParameter& param = this->layer_param_.video_data_param();
+  const int new_length = param.new_length();
+  const int dataset_size = shuffle_index_.size();
+  CHECK_GT(dataset_size, lines_id_);
+  clip->id = shuffle_index_[lines_id_];
+  clip->sampling_rate = param.use_sampling_rate_jitter() ?
+      caffe_rng_rand() % param.max_sampling_rate() + 1 :
+      param.sampling_rate();
+  clip->start_frm = start_frm_list_.empty() ? -1 : start_frm_list_[clip->id];
+  clip->rand = 0;
+  if (param.use_temporal_jitter()) {
+    if (!param.use_image()) {
+      clip->start_frm = -1;
+      clip->rand = caffe_rng_rand();
+    } else {
+      // start_frm_list_ holds the number of frames, numbered from 1.
+      const int num_of_frames = start_frm_list_[clip->id];
+      const int span = new_length * clip->sampling_rate;
+      if (num_of_frames < span) {
+        LOG(INFO) << "not enough frames; having " << num_of_frames;
+        clip->start_frm = -1;
+      } else if (this->phase_ == TRAIN) {
+        clip->start_frm = caffe_rng_rand() % (num_of_frames - span + 1) + 1;
+      } else {
+        clip->start_frm = 0;
+      }
+    }
+  }
+  clip->seed = caffe_rng_rand();
+  clip->ok = false;
+  // go to the next iter
+  lines_id_++;
+  if (lines_id_ >= dataset_size) {
+    // We have reached the end. Restart from the first.
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    lines_id_ = 0;
+    if (param.shuffle()) {
+      ShuffleClips();
+    }
+  }
+}
+
+template <typename Dtype>
+void VideoDataLayer<Dtype>::ReadClips(int thread, const vector<int>& items,
+                                      int begin, int end) {
+  const VideoDataParameter& param = this->layer_param_.video_data_param();
+  VideoClipReader* reader = readers_[thread].get();
+  for (int i = begin; i < end; ++i) {
+    const int item_id = items[i];
+    Clip& clip = clips_[item_id];
+    const string filename = param.root_folder() + file_list_[clip.id];
+    if (!param.use_image()) {
+      clip.ok = reader->ReadVideo(filename, clip.start_frm, clip.rand,
+                                  param.new_length(), param.new_height(),
+                                  param.new_width(), clip.sampling_rate,
+                                  &slab_shapes_[item_id], &slabs_[item_id]);
+    } else {
+      clip.ok = clip.start_frm >= 0 &&
+          reader->ReadImageSequence(filename, clip.start_frm,
+                                    param.new_length(), param.new_height(),
+                                    param.new_width(), clip.sampling_rate,
+                                    &slab_shapes_[item_id], &slabs_[item_id]);
+    }
+  }
+}
+
+template <typename Dtype>
+void VideoDataLayer<Dtype>::TransformClips(int thread, int begin, int end,
+                                           Dtype* top_data) {
+  DataTransformer<Dtype>* transformer = transformers_[thread].get();
+  Blob<Dtype>* transformed = transformed_[thread].get();
+  for (int item_id = begin; item_id < end; ++item_id) {
+    // Apply transformations (mirror, crop...) to the video
+    transformer->InitRand(clips_[item_id].seed);
+    transformed->set_cpu_data(top_data + item_id * transformed->count());
+    transformer->VideoTransform(slab_shapes_[item_id], slabs_[item_id].data(),
+                                transformed);
+  }
+}
+
 // This function is called on prefetch thread
 template <typename Dtype>
 void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
@@ -229,145 +332,65 @@ void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
-  VideoDataParameter video_data_param = this->layer_param_.video_data_param();
+  const VideoDataParameter& video_data_param =
+      this->layer_param_.video_data_param();
   const int batch_size = video_data_param.batch_size();
-  const int new_length = video_data_param.new_length();
-  const int new_height = video_data_param.new_height();
-  const int new_width = video_data_param.new_width();
-  string root_folder = video_data_param.root_folder();
-  const bool use_image = video_data_param.use_image();
-  const bool use_temporal_jitter = video_data_param.use_temporal_jitter();
-  int sampling_rate = video_data_param.sampling_rate();
-  const int max_sampling_rate = video_data_param.max_sampling_rate();
-  const bool use_sampling_rate_jitter =
-      video_data_param.use_sampling_rate_jitter();
   const bool show_data = video_data_param.show_data();
-
-  const bool use_multiple_label =
-      this->layer_param_.video_data_param().use_multiple_label();
-  if (use_multiple_label) {
-    CHECK(this->layer_param_.video_data_param().has_num_of_labels())
-        << "number of labels must be set together with use multiple labels";
+  const bool use_multiple_label = video_data_param.use_multiple_label();
+  const int num_of_labels = video_data_param.num_of_labels();
+  const int threads = readers_.size();
+
+  // Clips are drawn in order on this thread and decoded on all of them.
+  // Those that fail are replaced by the next ones until the batch is full.
+  timer.Start();
+  vector<int> pending(batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    NextClip(&clips_[item_id]);
+    pending[item_id] = item_id;
   }
-  const int num_of_labels =
-      this->layer_param_.video_data_param().num_of_labels();
-
-  // Reshape according to the first image of each batch
-  // on single input batches allows for inputs of varying dimension.
-  // Read a data point, and use it to initialize the top blob.
-  VolumeDatum datum;
-  int id = shuffle_index_[lines_id_];
-  if (!use_image) {
-    if (use_temporal_jitter) {
-      ReadVideoToVolumeDatum((root_folder + file_list_[0]).c_str(), 0,
-                             label_list_[0], new_length, new_height, new_width,
-                             sampling_rate, &datum);
-    } else {
-      ReadVideoToVolumeDatum((root_folder + file_list_[id]).c_str(),
-                             start_frm_list_[id], label_list_[id], new_length,
-                             new_height, new_width, sampling_rate, &datum);
+  while (!pending.empty()) {
+    const int n = pending.size();
+    decode_pool_->Run(threads, [&](int thread) {
+      ReadClips(thread, pending, n * thread / threads,
+                n * (thread + 1) / threads);
+    });
+    vector<int> failed;
+    for (int i = 0; i < n; ++i) {
+      if (!clips_[pending[i]].ok) {
+        CHECK_NE(this->phase_, TEST) << "Testing must not miss any example";
+        NextClip(&clips_[pending[i]]);
+        failed.push_back(pending[i]);
+      }
     }
-  } else {
-    // LOG(INFO) << "read video from " << file_list_[id].c_str();
-    CHECK(ReadImageSequenceToVolumeDatum((root_folder + file_list_[id]).c_str(),
-                                         start_frm_list_[id], label_list_[id],
-                                         new_length, new_height, new_width,
-                                         sampling_rate, &datum));
+    pending.swap(failed);
   }
+  read_time += timer.MicroSeconds();
 
-  // Use data_transformer to infer the expected blob shape from a cv_img.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  // Reshape according to the first clip of each batch
+  // on single input batches allows for inputs of varying dimension.
+  timer.Start();
+  vector<int> top_shape =
+      this->data_transformer_->InferBlobShape(slab_shapes_[0]);
   this->transformed_data_.Reshape(top_shape);
-
+  for (int i = 0; i < transformed_.size(); ++i) {
+    transformed_[i]->Reshape(top_shape);
+  }
   // Reshape batch according to the batch_size.
   top_shape[0] = batch_size;
   batch->data_.Reshape(top_shape);
-
+  // The threads write disjoint items of the batch through this pointer.
   Dtype* prefetch_data = batch->data_.mutable_cpu_data();
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
+  decode_pool_->Run(threads, [&](int thread) {
+    TransformClips(thread, batch_size * thread / threads,
+                   batch_size * (thread + 1) / threads, prefetch_data);
+  });
+  trans_time += timer.MicroSeconds();
 
-  // datum scales
-  const int dataset_size = shuffle_index_.size();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a blob
-    if (use_sampling_rate_jitter) {
-      sampling_rate = caffe::caffe_rng_rand() % (max_sampling_rate) + 1;
-    }
-    timer.Start();
-    CHECK_GT(dataset_size, lines_id_);
-    bool read_status;
-    int id = this->shuffle_index_[this->lines_id_];
-    if (!use_image) {
-      if (!use_temporal_jitter) {
-        read_status = ReadVideoToVolumeDatum(
-            (root_folder + this->file_list_[id]).c_str(),
-            this->start_frm_list_[id], this->label_list_[id], new_length,
-            new_height, new_width, sampling_rate, &datum);
-      } else {
-        read_status = ReadVideoToVolumeDatum(
-            (root_folder + this->file_list_[id]).c_str(), -1,
-            this->label_list_[id], new_length, new_height, new_width,
-            sampling_rate, &datum);
-      }
-    } else {
-      if (!use_temporal_jitter) {
-        read_status = ReadImageSequenceToVolumeDatum(
-            (root_folder + this->file_list_[id]).c_str(),
-            this->start_frm_list_[id], this->label_list_[id], new_length,
-            new_height, new_width, sampling_rate, &datum);
-      } else {
-        int num_of_frames = this->start_frm_list_[id];
-        int use_start_frame;
-        if (num_of_frames < new_length * sampling_rate) {
-          LOG(INFO) << "not enough frames; having " << num_of_frames;
-          read_status = false;
-        } else {
-          if (this->phase_ == TRAIN)
-            use_start_frame =
-                caffe_rng_rand() %
-                    (num_of_frames - new_length * sampling_rate + 1) +
-                1;
-          else
-            use_start_frame = 0;
-          read_status = ReadImageSequenceToVolumeDatum(
-              (root_folder + this->file_list_[id]).c_str(), use_start_frame,
-              this->label_list_[id], new_length, new_height, new_width,
-              sampling_rate, &datum);
-          LOG(INFO) << "huangyaling status = " << read_status;
-        }
-      }
-    }
-
-    if (this->phase_ == TEST) {
-      CHECK(read_status) << "Testing must not miss any example";
-    }
-
-    if (!read_status) {
-      this->lines_id_++;
-      if (this->lines_id_ >= dataset_size) {
-        // We have reached the end. Restart from the first.
-        DLOG(INFO) << "Restarting data prefetching from start.";
-        this->lines_id_ = 0;
-        if (this->layer_param_.video_data_param().shuffle()) {
-          ShuffleClips();
-        }
-      }
-      item_id--;
-      continue;
-    }
-    read_time += timer.MicroSeconds();
-    timer.Start();
-
-    // Apply transformations (mirror, crop...) to the video
-    vector<int> shape_vec(5, 0);
-    shape_vec[0] = item_id;
-    int offset = batch->data_.offset(shape_vec);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->VideoTransform(datum, &(this->transformed_data_));
-    trans_time += timer.MicroSeconds();
-
+    const int id = clips_[item_id].id;
     if (!use_multiple_label) {
-      prefetch_label[item_id] = datum.label();
+      prefetch_label[item_id] = this->label_list_[id];
     } else {
       caffe_set<Dtype>(num_of_labels, Dtype(0),
                        prefetch_label + item_id * num_of_labels);
@@ -380,7 +403,8 @@ void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 
     // Show visualization
     if (show_data) {
-      const Dtype* data_buffer = reinterpret_cast<Dtype*>(prefetch_data + offset);
+      const Dtype* data_buffer =
+          prefetch_data + item_id * this->transformed_data_.count();
       int image_size, channel_size;
       image_size = top_shape[3] * top_shape[4];
       channel_size = top_shape[2] * image_size;
@@ -397,17 +421,6 @@ void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
         cv::waitKey(100);
       }
     }
-
-    // go to the next iter
-    this->lines_id_++;
-    if (lines_id_ >= dataset_size) {
-      // We have reached the end. Restart from the first.
-      DLOG(INFO) << "Restarting data prefetching from start.";
-      lines_id_ = 0;
-      if (this->layer_param_.video_data_param().shuffle()) {
-        ShuffleClips();
-      }
-    }
   }
 
   batch_timer.Stop();
@@ -92,6 +92,12 @@ void WindowDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << this->layer_param_.window_data_param().root_folder();
 
   cache_images_ = this->layer_param_.window_data_param().cache_images();
+  if (ImageCache::Enabled(this->layer_param_.window_data_param().cache())) {
+    // Decoded images make the encoded copies of cache_images redundant.
+    cache_ = ImageCache::Get();
+    cache_->Configure(this->layer_param_.window_data_param().cache());
+    cache_images_ = false;
+  }
   string root_folder = this->layer_param_.window_data_param().root_folder();
 
   const bool prefetch_needs_rand =
@@ -314,7 +320,14 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
           image_database_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]];
 
       cv::Mat cv_img;
-      if (this->cache_images_) {
+      CachedImage cached;
+      if (cache_) {
+        cv_img = ReadImageToCVMat(image.first, 0, 0, true, cache_, &cached);
+        if (!cv_img.data) {
+          LOG(ERROR) << "Could not open or find file " << image.first;
+          return;
+        }
+      } else if (this->cache_images_) {
         pair<std::string, Datum> image_cached =
           image_database_cache_[window[WindowDataLayer<Dtype>::IMAGE_INDEX]];
         cv_img = DecodeDatumToCVMat(image_cached.second, true);
@@ -418,9 +431,11 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
         }
       }
 
+      // Resize into a buffer of its own, the flip below must not write
+      // into cv_img, which may be shared with the image cache.
       cv::Rect roi(x1, y1, x2-x1+1, y2-y1+1);
-      cv::Mat cv_cropped_img = cv_img(roi);
-      cv::resize(cv_cropped_img, cv_cropped_img,
+      cv::Mat cv_cropped_img;
+      cv::resize(cv_img(roi), cv_cropped_img,
           cv_crop_size, 0, 0, cv::INTER_LINEAR);
 
       // horizontal flip at random
@@ -496,6 +511,9 @@ void WindowDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  if (cache_) {
+    DLOG(INFO) << "Cache hit rate: " << cache_->stats().hit_rate();
+  }
 }
 
 INSTANTIATE_CLASS(WindowDataLayer);
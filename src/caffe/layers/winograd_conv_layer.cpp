@@ -0,0 +1,208 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  BaseConvolutionLayer<Dtype>::Reshape(bottom, top);
+  // Layer::Forward reshapes on every call; only a new shape reselects.
+  if (bottom[0]->shape() != selected_shape_) {
+    selected_shape_ = bottom[0]->shape();
+    algorithm_ = SelectAlgorithm();
+    col_buffer_ready_ = false;
+    const int* stride = this->stride_.cpu_data();
+    const int out_dim = this->output_shape_[0] * this->output_shape_[1];
+    if (algorithm_ == WINOGRAD_2X2 || algorithm_ == WINOGRAD_4X4) {
+      const int tile = algorithm_ == WINOGRAD_4X4 ? 4 : 2;
+      const int tiles = (tile + 2) * (tile + 2) *
+          winograd_tiles(this->output_shape_[0], tile) *
+          winograd_tiles(this->output_shape_[1], tile);
+      input_tf_.Reshape(vector<int>(1, tiles * this->channels_));
+      output_tf_.Reshape(vector<int>(1, tiles * this->num_output_));
+    } else if (algorithm_ == DIRECT_1X1 &&
+               (stride[0] != 1 || stride[1] != 1)) {
+      // Strided 1x1 gathers its input into input_tf_ first.
+      input_tf_.Reshape(vector<int>(1, this->channels_ * out_dim));
+    }
+  }
+  if (algorithm_ == GEMM && !col_buffer_ready_) {
+    this->SetupColBuf();
+    col_buffer_ready_ = true;
+  }
+}
+
+template <typename Dtype>
+typename WinogradConvolutionLayer<Dtype>::Algorithm
+WinogradConvolutionLayer<Dtype>::SelectAlgorithm() const {
+  if (this->num_spatial_axes_ != 2 || this->force_nd_im2col_) {
+    return GEMM;
+  }
+  // Only the GEMM path runs in int8.
+  if (this->int8_) {
+    return GEMM;
+  }
+#ifdef USE_MLU
+  // The mean/std preprocessing of the first layer lives in the GEMM path.
+  if (this->conv_first_) {
+    return GEMM;
+  }
+#endif
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  if (dilation[0] != 1 || dilation[1] != 1) {
+    return GEMM;
+  }
+  if (kernel[0] == 1 && kernel[1] == 1 &&
+      pad[0] == 0 && pad[1] == 0 && pad[2] == 0 && pad[3] == 0) {
+    return DIRECT_1X1;
+  }
+  // With few channels the GEMMs are too thin to win back the transforms.
+  if (kernel[0] == 3 && kernel[1] == 3 && stride[0] == 1 && stride[1] == 1 &&
+      this->channels_ / this->group_ >= kWinogradMinChannels) {
+    if (this->output_shape_[0] >= kWinogradLargeTile &&
+        this->output_shape_[1] >= kWinogradLargeTile) {
+      return WINOGRAD_4X4;
+    }
+    return WINOGRAD_2X2;
+  }
+  return GEMM;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::UpdateTransformedWeight(int tile) {
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  if (weight_tf_tile_ == tile && weight_tf_src_ == weight.data() &&
+      weight_tf_version_ == weight.data()->version()) {
+    return;
+  }
+  weight_tf_src_ = weight.data();
+  weight_tf_.Reshape(vector<int>(1, (tile + 2) * (tile + 2) *
+      this->num_output_ * (this->channels_ / this->group_)));
+  winograd_transform_weight_cpu(tile, weight.cpu_data(), this->num_output_,
+      this->channels_, this->group_, weight_tf_.mutable_cpu_data());
+  weight_tf_version_ = weight_tf_src_->version();
+  weight_tf_tile_ = tile;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward1x1(const Dtype* input,
+    const Dtype* weight, Dtype* output) {
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int out_dim = output_h * output_w;
+  const int* stride = this->stride_.cpu_data();
+  const Dtype* col = input;
+  if (stride[0] != 1 || stride[1] != 1) {
+    const int height = this->input_shape(1);
+    const int width = this->input_shape(2);
+    Dtype* sub = input_tf_.mutable_cpu_data();
+    for (int c = 0; c < this->channels_; ++c) {
+      for (int oh = 0; oh < output_h; ++oh) {
+        const Dtype* row = input + (c * height + oh * stride[0]) * width;
+        Dtype* dst = sub + (c * output_h + oh) * output_w;
+        for (int ow = 0; ow < output_w; ++ow) {
+          dst[ow] = row[ow * stride[1]];
+        }
+      }
+    }
+    col = sub;
+  }
+  const int out_per_group = this->num_output_ / this->group_;
+  const int in_per_group = this->channels_ / this->group_;
+  for (int g = 0; g < this->group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_per_group, out_dim,
+        in_per_group, (Dtype)1., weight + g * out_per_group * in_per_group,
+        col + g * in_per_group * out_dim, (Dtype)0.,
+        output + g * out_per_group * out_dim);
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (algorithm_ == GEMM) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const int tile = algorithm_ == WINOGRAD_4X4 ? 4 : 2;
+  if (algorithm_ != DIRECT_1X1) {
+    UpdateTransformedWeight(tile);
+  }
+  const int* pad = this->pad_.cpu_data();
+  const Dtype* slope = this->fused_slope();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      const Dtype* input = bottom_data + n * this->bottom_dim_;
+      Dtype* output = top_data + n * this->top_dim_;
+      if (algorithm_ == DIRECT_1X1) {
+        Forward1x1(input, weight, output);
+        if (this->bias_term_) {
+          this->forward_cpu_bias(output, bias);
+        }
+      } else {
+        winograd_conv_cpu(tile, input, this->channels_, this->input_shape(1),
+            this->input_shape(2), pad[0], pad[1], this->num_output_,
+            this->group_, this->output_shape_[0], this->output_shape_[1],
+            weight_tf_.cpu_data(), bias, input_tf_.mutable_cpu_data(),
+            output_tf_.mutable_cpu_data(), output);
+      }
+      this->ForwardFusedActivation(*top[i], slope, n * this->top_dim_,
+                                   this->top_dim_, output);
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!col_buffer_ready_) {
+    this->SetupColBuf();
+    col_buffer_ready_ = true;
+  }
+  ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -27,329 +27,25 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
 #include "caffe/layers/yolov3_detection_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/nms.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
-// transpose data order to 255*169->169*255
-template <typename Dtype>
-void transpose(Blob<Dtype>* bot, int pos0, int pos1) {
-  int batch = bot->num();
-  // count is single batch size
-  int count = bot->count(1);
-  int channels = bot->shape(pos0);
-  int hw = bot->shape(pos1);
-  CHECK_EQ(count, hw * channels) << "count should equal to channels* hw";
-  Dtype* tmp_data = new Dtype[count]();
-  Dtype* bot_data = bot->mutable_cpu_data();
-  for (int n = 0; n < batch; n++) {
-    // transpose the bot data every batch
-    Dtype* bot_buffer = bot_data + n * count;
-    caffe_copy(count, bot_buffer, tmp_data);
-    int nr = 0;
-    for (int i = 0; i < hw; i++) {
-      for (int j = 0; j < channels; j++) {
-        bot_buffer[nr++] = tmp_data[j * hw + i];
-      }
-    }
-  }
-  free(tmp_data);
-}
+namespace {
 
 template <typename Dtype>
-void xy_add_mul(Blob<Dtype>* bot, const vector<Dtype>& xy_offsets, int stride) {
-  int step = bot->width();
-  int batch = bot->num();
-  int count = bot->count(1);
-  Dtype* bot_data = bot->mutable_cpu_data();
-  for (int n = 0; n < batch; n++) {
-    Dtype* bot_buffer = bot_data + n * count;
-    int temp_index = 0;
-    for (int i = 0; i < count; i += step) {
-      bot_buffer[i] = stride * (bot_buffer[i] + xy_offsets[temp_index++]);
-      bot_buffer[i + 1] =
-          stride * (bot_buffer[i + 1] + xy_offsets[temp_index++]);
-    }
-  }
+inline Dtype sigmoid(Dtype x) {
+  return 1 / (1 + std::exp(-x));
 }
 
-// sigmoid vectors
-template <typename Dtype>
-void sigmoid(Blob<Dtype>* bot, int colsLeft, int colsRight) {
-  Dtype* bot_data = bot->mutable_cpu_data();
-  int step = bot->width();
-  int batch = bot->num();
-  int count = bot->count() / batch;
-  for (int n = 0; n < batch; n++) {
-    Dtype* bot_buffer = bot_data + n * count;
-    for (int i = 0; i < count; i += step) {
-      for (int j = colsLeft; j < colsRight; j++) {
-        bot_buffer[i + j] = 1 / (1 + std::exp(-bot_buffer[i + j]));
-      }
-    }
-  }
-}
-
-template <typename Dtype>
-void anchor_mul(Blob<Dtype>* bot, const Dtype* anchor, int im_h, int im_w) {
-  Dtype* bot_data = bot->mutable_cpu_data();
-  int step = bot->width();
-  int batch = bot->num();
-  int count = bot->count(1);
-  for (int n = 0; n < batch; n++) {
-    Dtype* bot_buffer = bot_data + n * count;
-    int temp_index = 0;
-    for (int i = 0; i < count; i += step) {
-      bot_buffer[i + 2] =
-          std::exp(bot_buffer[i + 2]) * anchor[(temp_index++) % 6];
-      bot_buffer[i + 3] =
-          std::exp(bot_buffer[i + 3]) * anchor[(temp_index++) % 6];
-    }
-  }
-}
-
-template <typename Dtype>
-void concatenate(Blob<Dtype>* concat_bot, const vector<Blob<Dtype>*>& bottom) {
-  int batch = bottom[0]->num();
-  int top_batch_count = 0;
-  for (int i = 0; i < bottom.size(); i++) {
-    top_batch_count += bottom[i]->count(1);
-  }
-  Dtype* concat_data = concat_bot->mutable_cpu_data();
-  for (int n = 0; n < batch; n++) {
-    int top_step_count = 0;
-    for (int i = 0; i < bottom.size(); i++) {
-      const Dtype* bot_data = bottom[i]->cpu_data();
-      int bot_batch_count = bottom[i]->count();
-      int bot_channel_count = bottom[i]->count(1);
-      caffe_copy(bot_channel_count, bot_data + n * bot_batch_count,
-                 concat_data + n * top_batch_count + top_step_count);
-      top_step_count += bot_channel_count;
-    }
-  }
-}
-
-template <typename Dtype>
-void fill_zeros(Blob<Dtype>* bot, int cols, float confidence) {
-  Dtype* bot_data = bot->mutable_cpu_data();
-  int step = bot->width();
-  int count = bot->count();
-  for (int i = 0; i < count; i += step) {
-    if (bot_data[i + cols] > confidence)
-      continue;
-    else
-      bot_data[i + cols] = 0;
-  }
-}
-
-template <typename Dtype>
-void conf_filter(Blob<Dtype>* bot, float confidence, int num_classes,
-                 vector<vector<vector<Dtype>>>* detections) {
-  const Dtype* bot_data = bot->cpu_data();
-  int batch = bot->num();
-  int step = bot->width();
-  int count = bot->count(1);
-
-  for (int n = 0; n < batch; ++n) {
-    int num_boxes = 0;
-    const Dtype* batch_data = bot_data + n * count;
-    for (int i = 0; i < count; i += step) {
-      if (batch_data[i + 4] > confidence) {
-        ++num_boxes;
-      }
-    }
-    // add current class
-    detections->push_back(vector<vector<Dtype>>(
-        num_boxes, vector<Dtype>(5 + num_classes + 1, 0)));
-  }
-  for (int n = 0; n < batch; ++n) {
-    int box_count = 0;
-    const Dtype* batch_data = bot_data + n * count;
-    for (int i = 0; i < count; i += step) {
-      if (batch_data[i + 4] <= confidence) {
-        continue;
-      } else {
-        (*detections)[n][box_count][0] =
-            batch_data[i + 0] - batch_data[i + 2] / 2;
-        (*detections)[n][box_count][2] =
-            batch_data[i + 0] + batch_data[i + 2] / 2;
-        (*detections)[n][box_count][1] =
-            batch_data[i + 1] - batch_data[i + 3] / 2;
-        (*detections)[n][box_count][3] =
-            batch_data[i + 1] + batch_data[i + 3] / 2;
-
-        (*detections)[n][box_count][4] = batch_data[i + 4];
-        Dtype objectness = bot_data[i + 4];
-        for (int j = 0; j < num_classes; ++j) {
-          Dtype prob = objectness * batch_data[i + 5 + j];
-          (*detections)[n][box_count][5 + j] = (prob > confidence) ? prob : 0;
-        }
-        // current class
-        (*detections)[n][box_count][num_classes + 5] = -1;
-        ++box_count;
-      }
-    }
-  }
-}
-
-template <typename Dtype>
-Dtype box_iou(int box1_id, int box2_id,
-              const vector<vector<Dtype>>& detections) {
-  Dtype inter_x1 = std::max(detections[box1_id][0], detections[box2_id][0]);
-  Dtype inter_y1 = std::max(detections[box1_id][1], detections[box2_id][1]);
-  Dtype inter_x2 = std::min(detections[box1_id][2], detections[box2_id][2]);
-  Dtype inter_y2 = std::min(detections[box1_id][3], detections[box2_id][3]);
-  Dtype inter_area, first_area, next_area, union_area, iou;
-  if ((inter_x2 - inter_x1 + 1 > 0) && (inter_y2 - inter_y1 + 1 > 0))
-    inter_area = (inter_x2 - inter_x1 + 1) * (inter_y2 - inter_y1 + 1);
-  else
-    inter_area = 0;
-  first_area = (detections[box1_id][2] - detections[box1_id][0] + 1) *
-               (detections[box1_id][3] - detections[box1_id][1] + 1);
-  next_area = (detections[box2_id][2] - detections[box2_id][0] + 1) *
-              (detections[box2_id][3] - detections[box2_id][1] + 1);
-  union_area = first_area + next_area - inter_area;
-  iou = inter_area / union_area;
-  return iou;
-}
-
-template <typename Dtype>
-void do_nms_sort(vector<Blob<Dtype>*> top, Blob<Dtype>* bot, int num_classes,
-    int im_h, int im_w, float confidence, float nms_thresh, int num_box) {
-  int batch = bot->num();
-  Dtype* top_buffer = top[0]->mutable_cpu_data();
-  caffe_set(top[0]->count(), Dtype(-1), top_buffer);
-  int box_size = 0;
-
-  vector<vector<vector<Dtype>>> detections;
-  conf_filter(bot, confidence, num_classes, &detections);
-  for (int n = 0; n < batch; ++n) {
-    for (int k = 0; k < num_classes; ++k) {
-      for (int idx = 0; idx < detections[n].size(); ++idx) {
-        detections[n][idx][num_classes + 5] = k;
-      }
-      std::sort(
-          detections[n].begin(), detections[n].end(),
-          [](const vector<Dtype>& pa, const vector<Dtype>& pb) {
-            return (pa[pa[pa.size() - 1] + 5] > pb[pb[pb.size() - 1] + 5]);
-          });
-      for (int i = 0; i < detections[n].size(); ++i) {
-        if (detections[n][i][5 + k] == 0) {
-          continue;
-        }
-        int box1_id = i;
-        for (int j = i + 1; j < detections[n].size(); ++j) {
-          int box2_id = j;
-          if (box_iou(box1_id, box2_id, detections[n]) > nms_thresh) {
-            detections[n][j][5 + k] = 0;
-          }
-        }
-      }
-    }
-    for (int i = 0; i < detections[n].size(); ++i) {
-      for (int j = 0; j < num_classes; ++j) {
-        if (detections[n][i][j + 5] > confidence) {
-          top_buffer[64 + box_size * 7 + 0] = n;
-          top_buffer[64 + box_size * 7 + 1] = j;
-          top_buffer[64 + box_size * 7 + 2] = detections[n][i][j + 5];
-          top_buffer[64 + box_size * 7 + 3] = detections[n][i][0] / im_w;
-          top_buffer[64 + box_size * 7 + 4] = detections[n][i][1] / im_h;
-          top_buffer[64 + box_size * 7 + 5] = detections[n][i][2] / im_w;
-          top_buffer[64 + box_size * 7 + 6] = detections[n][i][3] / im_h;
-          ++box_size;
-        }
-      }
-    }
-  }
-  top_buffer[0] = box_size;
-}
-
-template <typename Dtype>
-vector<vector<Dtype>> filter_boxes(vector<vector<Dtype>>* all_boxes,
-                                   vector<Dtype>* max_class_score,
-                                   vector<Dtype>* max_class_idx) {
-  vector<vector<Dtype>> temp(all_boxes->size(), vector<Dtype>(5 + 2, 0));
-  for (int i = 0; i < all_boxes->size(); i++) {
-    for (int j = 0; j < 7; j++) {
-      if (j < 5)
-        temp[i][j] = (*all_boxes)[i][j];
-      else if (j == 5)
-        temp[i][j] = (*max_class_score)[i];
-      else if (j == 6)
-        temp[i][j] = (*max_class_idx)[i];
-    }
-  }
-  vector<vector<Dtype>> vec;
-  for (int m = 0; m < temp.size(); m++) {
-    if (temp[m][4] == 0)
-      continue;
-    else
-      vec.push_back(temp[m]);
-  }
-  return vec;
-}
-
-template <typename Dtype>
-void unique_vector(vector<vector<Dtype>>* input_vector,
-                   vector<Dtype>* output_vector) {
-  // (*input_vector)[i][6] means label index
-  for (int i = 0; i < input_vector->size(); i++) {
-    (*output_vector).push_back((*input_vector)[i][6]);
-  }
-  sort((*output_vector).begin(), (*output_vector).end());
-  auto new_end = unique((*output_vector).begin(), (*output_vector).end());
-  (*output_vector).erase(new_end, (*output_vector).end());
-}
-
-template <typename Dtype>
-Dtype findMax(vector<Dtype> vec) {
-  Dtype max = -999;
-  for (auto v : vec) {
-    if (max < v) max = v;
-  }
-  return max;
-}
-
-template <typename Dtype>
-int getPositionOfMax(vector<Dtype> vec, float max) {
-  auto distance = find(vec.begin(), vec.end(), max);
-  return distance - vec.begin();
-}
-
-template <typename Dtype>
-void nms_by_classes(vector<vector<Dtype>> sort_boxes, vector<Dtype>* ious,
-                    int start) {
-  for (int i = start + 1; i < sort_boxes.size(); i++) {
-    float first_x1 = sort_boxes[start][0];
-    float first_y1 = sort_boxes[start][1];
-    float first_x2 = sort_boxes[start][2];
-    float first_y2 = sort_boxes[start][3];
-
-    float next_x1 = sort_boxes[i][0];
-    float next_y1 = sort_boxes[i][1];
-    float next_x2 = sort_boxes[i][2];
-    float next_y2 = sort_boxes[i][3];
-
-    float inter_x1 = std::max(first_x1, next_x1);
-    float inter_y1 = std::max(first_y1, next_y1);
-    float inter_x2 = std::min(first_x2, next_x2);
-    float inter_y2 = std::min(first_y2, next_y2);
-    float inter_area, first_area, next_area, union_area, iou;
-    if ((inter_x2 - inter_x1 + 1 > 0) && (inter_y2 - inter_y1 + 1 > 0))
-      inter_area = (inter_x2 - inter_x1 + 1) * (inter_y2 - inter_y1 + 1);
-    else
-      inter_area = 0;
-    first_area = (first_x2 - first_x1 + 1) * (first_y2 - first_y1 + 1);
-    next_area = (next_x2 - next_x1 + 1) * (next_y2 - next_y1 + 1);
-    union_area = first_area + next_area - inter_area;
-    iou = inter_area / union_area;
-    (*ious).push_back(iou);
-  }
-}
+}  // namespace
 
 template <typename Dtype>
 void Yolov3DetectionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
@@ -392,62 +88,168 @@ void Yolov3DetectionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top_shape[0] = 1;
   top_shape[1] = bottom[0]->num() * (7 * this->num_box_ + 64);
   top[0]->Reshape(top_shape);
+  rows_offset_.resize(bottom.size() + 1);
+  rows_offset_[0] = 0;
   for (int i = 0; i < bottom.size(); i++) {
+    CHECK_EQ(bottom[i]->channels(), anchor_num_ * (5 + num_classes_))
+        << "Every anchor needs x, y, w, h, objectness and class scores.";
     vector<int> bottom_shape(4, 1);
     bottom_shape[0] = bottom[i]->num();
     bottom_shape[1] = bottom[i]->channels();
     bottom_shape[3] = bottom[i]->height() * bottom[i]->width();
     bottom[i]->Reshape(bottom_shape);
+    rows_offset_[i + 1] = rows_offset_[i] + anchor_num_ * bottom_shape[3];
+  }
+  const int rows = bottom[0]->num() * rows_offset_.back();
+  boxes_.resize(rows * (4 + num_classes_));
+  kept_.resize(rows * num_classes_);
+  boxes_count_.resize(bottom[0]->num() * bottom.size());
+}
+
+template <typename Dtype>
+void Yolov3DetectionLayer<Dtype>::DecodeBoxes(const Dtype* data, const int hw,
+    const int grid_w, const Dtype* anchors, const int n, const int scale) {
+  // use im_w as input dim because im_w == im_h
+  const int stride = im_w_ / std::sqrt(hw);
+  const int box_dim = 4 + num_classes_;
+  const int first = n * rows_offset_.back() + rows_offset_[scale];
+  Dtype* box = &boxes_[first * box_dim];
+  int count = 0;
+  // Boxes are numbered cell by cell, then anchor by anchor within a cell;
+  // attribute t of anchor a at cell c is data[(a * (5 + classes) + t) * hw + c].
+  for (int c = 0; c < hw; ++c) {
+    for (int a = 0; a < anchor_num_; ++a) {
+      const Dtype* attr = data + a * (5 + num_classes_) * hw + c;
+      const Dtype objectness = sigmoid(attr[4 * hw]);
+      if (objectness <= confidence_threshold_) {
+        continue;
+      }
+      const Dtype x = stride * (sigmoid(attr[0]) + c % grid_w);
+      const Dtype y = stride * (sigmoid(attr[hw]) + c / grid_w);
+      const Dtype w = std::exp(attr[2 * hw]) * anchors[2 * a];
+      const Dtype h = std::exp(attr[3 * hw]) * anchors[2 * a + 1];
+      box[0] = x - w / 2;
+      box[1] = y - h / 2;
+      box[2] = x + w / 2;
+      box[3] = y + h / 2;
+      for (int k = 0; k < num_classes_; ++k) {
+        const Dtype prob = objectness * sigmoid(attr[(5 + k) * hw]);
+        box[4 + k] = prob > confidence_threshold_ ? prob : 0;
+      }
+      box += box_dim;
+      ++count;
+    }
+  }
+  boxes_count_[n * (rows_offset_.size() - 1) + scale] = count;
+  std::fill(kept_.begin() + first * num_classes_,
+            kept_.begin() + (first + count) * num_classes_, 0);
+}
+
+template <typename Dtype>
+void Yolov3DetectionLayer<Dtype>::SuppressClass(const int n, const int k,
+    NMSBoxes* boxes, vector<float>* scores, vector<int>* candidates,
+    vector<int>* kept) {
+  const int box_dim = 4 + num_classes_;
+  const int scales = rows_offset_.size() - 1;
+  const int image = n * rows_offset_.back();
+  boxes->clear();
+  scores->clear();
+  candidates->clear();
+  for (int s = 0; s < scales; ++s) {
+    const int first = image + rows_offset_[s];
+    const int count = boxes_count_[n * scales + s];
+    for (int b = first; b < first + count; ++b) {
+      const Dtype* box = &boxes_[b * box_dim];
+      if (box[4 + k] > confidence_threshold_) {
+        boxes->push_back(box[0], box[1], box[2], box[3],
+                         (box[2] - box[0] + 1) * (box[3] - box[1] + 1));
+        scores->push_back(box[4 + k]);
+        candidates->push_back(b);
+      }
+    }
+  }
+  if (candidates->empty()) {
+    return;
+  }
+  NMSParam param;
+  param.overlap_threshold = nms_threshold_;
+  NonMaxSuppression(*boxes, scores->data(), param, kept);
+  for (int i = 0; i < kept->size(); ++i) {
+    kept_[(*candidates)[(*kept)[i]] * num_classes_ + k] = 1;
   }
 }
 
 template <typename Dtype>
 void Yolov3DetectionLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const int* w_arr_ = reinterpret_cast<const int*>(w_arr_blob_.cpu_data());
-  // transpose the bottom data and cacculate boxes coordanates
-  const Dtype* biases_ = biases_blob_.cpu_data();
-  int bbox_attrs = 5 + num_classes_;
-  for (int i = 0; i < bottom.size(); i++) {
-    // hw looks like grid count in the input data
-    int hw = bottom[i]->width();
-    // use im_w as input dim because im_w == im_h
-    int stride = im_w_ / std::sqrt(hw);
-    x_y_offsets_.clear();
-    // 255*169->169*255
-    transpose(bottom[i], 1, 3);
-    // bottom[i]->shape(3) == hw, now shape looks like 507*85
-    bottom[i]->Reshape(bottom[i]->num(), hw * anchor_num_, 1, bbox_attrs);
-    for (int k = 0; k < bottom[i]->channels() / anchor_num_; k++) {
-      for (int j = 0; j < anchor_num_; j++) {
-        x_y_offsets_.push_back(k % w_arr_[i]);
-        x_y_offsets_.push_back(k / w_arr_[i]);
+  const int batch = bottom[0]->num();
+  const int scales = bottom.size();
+  const int rows = rows_offset_.back();
+  // Decode every (image, scale) into its own region of boxes_, keeping only
+  // the boxes whose objectness passes the threshold.
+  const int* w_arr = reinterpret_cast<const int*>(w_arr_blob_.cpu_data());
+  const Dtype* biases = biases_blob_.cpu_data();
+  vector<const Dtype*> bottom_data(scales);
+  for (int s = 0; s < scales; ++s) {
+    bottom_data[s] = bottom[s]->cpu_data();
+  }
+  caffe_parallel_for(batch * scales, rows * (5 + num_classes_) / scales,
+                     [&](int begin, int end) {
+    for (int t = begin; t < end; ++t) {
+      const int n = t / scales;
+      const int s = t % scales;
+      DecodeBoxes(bottom_data[s] + n * bottom[s]->count(1),
+                  bottom[s]->count(2), w_arr[s],
+                  biases + 2 * anchor_num_ * s, n, s);
+    }
+  });
+  // NMS of each (image, class) over the boxes scoring above the threshold
+  // for that class, marking the survivors in kept_.
+  caffe_parallel_for(batch * num_classes_, rows, [&](int begin, int end) {
+    NMSBoxes boxes(false);
+    vector<float> scores;
+    vector<int> candidates, kept;
+    for (int t = begin; t < end; ++t) {
+      SuppressClass(t / num_classes_, t % num_classes_, &boxes, &scores,
+                    &candidates, &kept);
+    }
+  });
+
+  // A single 64 element header, whose first element is the number of
+  // detections in the whole batch, is followed by the detections of all
+  // images as 7-tuples (image, class, score, x1, y1, x2, y2) with
+  // coordinates relative to the input image.
+  Dtype* top_buffer = top[0]->mutable_cpu_data();
+  caffe_set(top[0]->count(), Dtype(-1), top_buffer);
+  const int max_boxes = (top[0]->count() - 64) / 7;
+  const int box_dim = 4 + num_classes_;
+  int box_size = 0;
+  for (int n = 0; n < batch; ++n) {
+    for (int s = 0; s < scales; ++s) {
+      const int first = n * rows + rows_offset_[s];
+      const int count = boxes_count_[n * scales + s];
+      for (int b = first; b < first + count; ++b) {
+        const Dtype* box = &boxes_[b * box_dim];
+        for (int k = 0; k < num_classes_; ++k) {
+          if (!kept_[b * num_classes_ + k] || box_size == max_boxes) {
+            continue;
+          }
+          Dtype* det = top_buffer + 64 + box_size * 7;
+          det[0] = n;
+          det[1] = k;
+          det[2] = box[4 + k];
+          det[3] = box[0] / im_w_;
+          det[4] = box[1] / im_h_;
+          det[5] = box[2] / im_w_;
+          det[6] = box[3] / im_h_;
+          ++box_size;
+        }
       }
     }
-    // sigmoid 0,1 means only sigmoid position 0
-    sigmoid(bottom[i], 0, 1);
-    sigmoid(bottom[i], 1, 2);
-    xy_add_mul(bottom[i], x_y_offsets_, stride);
-    anchor_mul(bottom[i], &biases_[6 * i], im_h_, im_w_);
-    sigmoid(bottom[i], 4, 5);
-    sigmoid(bottom[i], 5, bbox_attrs);
   }
-  vector<vector<float>> all_boxes, tmp_boxes;
-  vector<vector<vector<float>>> final_boxes;
-  Blob<Dtype> concat_bot;
-  vector<int> concat_shape(4, 0);
-  concat_shape[0] = bottom[0]->num();
-  for (int i = 0; i < bottom.size(); i++) {
-    concat_shape[1] += bottom[i]->channels();
-  }
-  concat_shape[2] = 1;
-  concat_shape[3] = bbox_attrs;
-  concat_bot.Reshape(concat_shape);
-  // 10647*85
-  concatenate(&concat_bot, bottom);
-  do_nms_sort(top, &concat_bot, num_classes_, im_h_, im_w_,
-              confidence_threshold_, nms_threshold_, this->num_box_);
+  top_buffer[0] = box_size;
 }
+
 #ifndef USE_CUDA
 STUB_GPU(Yolov3DetectionLayer);
 #endif
@@ -46,10 +46,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/net_optimizer.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/util/format.hpp"
@@ -65,14 +67,16 @@ int forward_iteration;
 namespace caffe {
 
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param) {
+Net<Dtype>::Net(const NetParameter& param)
+    : replica_source_(NULL) {
   Init(param);
   blob_info();
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const int level,
-                const vector<string>* stages) {
+                const vector<string>* stages)
+    : replica_source_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
@@ -87,7 +91,8 @@ Net<Dtype>::Net(const string& param_file, Phase phase, const int level,
   blob_info();
 }
 template <typename Dtype>
-Net<Dtype>::Net(void* buffer, int buffer_size, Phase phase) {
+Net<Dtype>::Net(void* buffer, int buffer_size, Phase phase)
+    : replica_source_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextMemOrDie(buffer, buffer_size, &param);
   param.mutable_state()->set_phase(phase);
@@ -97,10 +102,21 @@ Net<Dtype>::Net(void* buffer, int buffer_size, Phase phase) {
   LOG(INFO) << "net init finished" << std::endl;
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net* source)
+    : replica_source_(source) {
+  Init(param);
+  replica_source_ = NULL;
+  // Keep the files mapped weights point into alive.
+  mapped_weights_ = source->mapped_weights_;
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   // Set phase from the state.
   phase_ = in_param.state().phase();
+  thread_state_ = Caffe::thread_state();
+  plan_memory_ = false;
   // Filter layers based on their include/exclude rules and
   // the current NetState.
   NetParameter filtered_param;
@@ -140,6 +156,34 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         param.DebugString();
   }
 #endif
+  // Device independent graph passes for inference on CPU and GPU, the MLU
+  // and MFUS modes run their own above.
+  fold_trained_weights_ = false;
+  if (phase_ == TEST && in_param.opt_level() > 0 &&
+      (Caffe::mode() == Caffe::CPU || Caffe::mode() == Caffe::GPU)) {
+    // Only the CPU layers apply a fused activation.
+    const NetOptimizer optimizer(in_param.opt_level(),
+                                 Caffe::mode() == Caffe::CPU);
+    if (optimizer.Run(&param)) {
+      LOG_IF(INFO, Caffe::root_solver())
+          << "[opt_level set] optimized parameter: " << std::endl
+          << param.DebugString();
+    }
+  }
+  // A dumped optimized net needs its weights folded as well.
+  for (int i = 0; i < param.layer_size(); ++i) {
+    fold_trained_weights_ |= param.layer(i).folded_layer_size() > 0 ||
+                             param.layer(i).fused_activation() == "PReLU";
+  }
+  optimized_param_ = param;
+  const BaseDataType weight_dtype = in_param.cpu_weight_dtype();
+  CHECK(weight_dtype == DT_FLOAT32 || IsHalfType(weight_dtype))
+      << "cpu_weight_dtype must be DT_FLOAT32, DT_FLOAT16 or DT_BFLOAT16";
+  half_weights_ = DT_INVALID;
+  if (IsHalfType(weight_dtype) && phase_ == TEST &&
+      Caffe::mode() == Caffe::CPU) {
+    half_weights_ = weight_dtype;
+  }
 
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
@@ -157,6 +201,11 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     // Inherit phase from net if unset.
     if (!param.layer(layer_id).has_phase())
       param.mutable_layer(layer_id)->set_phase(phase_);
+    // Int8 on CPU is for inference only.
+    if (in_param.cpu_int8() && phase_ == TEST &&
+        Caffe::mode() == Caffe::CPU) {
+      param.mutable_layer(layer_id)->set_cpu_int8(true);
+    }
 #ifdef USE_MLU
     if (param.layer(layer_id).blobs_dtype_size() &&
         (param.layer(layer_id).blobs_dtype(0).type() == DT_INT8)) {
@@ -185,6 +234,14 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
           << "either 0 or bottom_size times ";
     }
     layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+    if (replica_source_) {
+      // Layers skip filling the parameter blobs they are handed.
+      CHECK_LT(layer_id, replica_source_->layers_.size());
+      CHECK_EQ(replica_source_->layer_names_[layer_id], layer_param.name())
+          << "A replica must build the same layers as its source";
+      layers_[layer_id]->blobs() =
+          replica_source_->layers_[layer_id]->blobs();
+    }
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver()) << "Creating Layer "
                                        << layer_param.name();
@@ -225,6 +282,20 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
     LOG_IF(INFO, Caffe::root_solver()) << "Setting up "
                                        << layer_names_[layer_id];
+    if (replica_source_) {
+      // Layers that build their parameter blobs anyway, e.g. Recurrent,
+      // point them at the source's.
+      const vector<shared_ptr<Blob<Dtype>>>& source_blobs =
+          replica_source_->layers_[layer_id]->blobs();
+      vector<shared_ptr<Blob<Dtype>>>& blobs = layers_[layer_id]->blobs();
+      CHECK_EQ(blobs.size(), source_blobs.size())
+          << "Incompatible number of blobs for layer " << layer_param.name();
+      for (int j = 0; j < blobs.size(); ++j) {
+        if (blobs[j] != source_blobs[j]) {
+          blobs[j]->ShareData(*source_blobs[j]);
+        }
+      }
+    }
 
 #ifdef USE_MLU
     auto layer_type = static_cast<string>(layers_[layer_id]->type());
@@ -390,6 +461,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  StoreHalfWeights();
   debug_info_ = in_param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 
@@ -399,9 +471,162 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   InitSubnet();
 #endif  // USE_MLU
 
+  if (in_param.plan_memory()) {
+    plan_memory_ = true;
+    PlanMemory();
+  }
+
   set_net_param_without_weights(in_param);
 }
 
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  if (phase_ != TEST || Caffe::mode() != Caffe::CPU) {
+    LOG(WARNING) << "Memory planning is only supported for TEST phase nets "
+                 << "in CPU mode, skipped.";
+    return;
+  }
+  // Blobs sharing one SyncedMemory are planned as one buffer, whose
+  // lifetime spans from the first to the last layer touching any of them.
+  // Tops that only get shared with their bottom in Forward already count
+  // as that bottom's memory, see Layer::ForwardSharesData.
+  map<const Blob<Dtype>*, shared_ptr<SyncedMemory> > shared_data;
+  auto data_of = [&](const Blob<Dtype>* blob) {
+    auto it = shared_data.find(blob);
+    return it == shared_data.end() ? blob->data() : it->second;
+  };
+  map<SyncedMemory*, int> mem_ids;
+  vector<shared_ptr<SyncedMemory> > mems;
+  vector<int> first;
+  vector<int> last;
+  auto touch = [&](Blob<Dtype>* blob, int layer_id) {
+    shared_ptr<SyncedMemory> mem = data_of(blob);
+    if (mem_ids.find(mem.get()) == mem_ids.end()) {
+      mem_ids[mem.get()] = mems.size();
+      mems.push_back(mem);
+      first.push_back(layer_id);
+      last.push_back(layer_id);
+    }
+    int id = mem_ids[mem.get()];
+    first[id] = std::min(first[id], layer_id);
+    last[id] = std::max(last[id], layer_id);
+  };
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (auto blob : bottom_vecs_[layer_id]) touch(blob, layer_id);
+    if (layers_[layer_id]->ForwardSharesData()) {
+      for (auto blob : top_vecs_[layer_id]) {
+        shared_data[blob] = data_of(bottom_vecs_[layer_id][0]);
+      }
+    }
+    for (auto blob : top_vecs_[layer_id]) touch(blob, layer_id);
+  }
+
+  // Memory visible outside of Forward keeps its own storage.
+  set<SyncedMemory*> pinned;
+  for (auto blob : net_input_blobs_) pinned.insert(data_of(blob).get());
+  for (auto blob : net_output_blobs_) pinned.insert(data_of(blob).get());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    if (bottom_vecs_[layer_id].size() > 0) continue;
+    for (auto blob : top_vecs_[layer_id]) pinned.insert(data_of(blob).get());
+  }
+
+  vector<int> planned;
+  vector<shared_ptr<SyncedMemory> > planned_mems;
+  vector<size_t> planned_sizes;
+  for (int id = 0; id < mems.size(); ++id) {
+    if (pinned.count(mems[id].get()) || mems[id]->size() == 0) continue;
+    planned.push_back(id);
+    planned_mems.push_back(mems[id]);
+    planned_sizes.push_back(mems[id]->size());
+  }
+  // Nothing grew since the last plan, the arena still holds every buffer.
+  if (memory_plan_ && planned_mems == planned_mems_ &&
+      planned_sizes == planned_sizes_) {
+    return;
+  }
+  shared_ptr<MemoryPlanner> plan(new MemoryPlanner());
+  for (int i = 0; i < planned.size(); ++i) {
+    plan->Add(planned_sizes[i], first[planned[i]], last[planned[i]]);
+  }
+  plan->Plan();
+
+  shared_ptr<SyncedMemory> arena;
+  if (plan->arena_size() > 0) {
+    arena.reset(new SyncedMemory(plan->arena_size()));
+    char* base = static_cast<char*>(arena->mutable_cpu_data());
+    for (int i = 0; i < planned.size(); ++i) {
+      mems[planned[i]]->set_cpu_data(base + plan->offset(i));
+    }
+  }
+  // Buffers leaving the plan must not point into the arena released below.
+  set<SyncedMemory*> still_planned;
+  for (auto mem : planned_mems) still_planned.insert(mem.get());
+  for (auto mem : planned_mems_) {
+    if (!still_planned.count(mem.get())) mem->reset_cpu_data();
+  }
+  memory_arena_ = arena;
+  memory_plan_ = plan;
+  planned_mems_.swap(planned_mems);
+  planned_sizes_.swap(planned_sizes);
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory planned for " << plan->size() << " activations: "
+      << plan->naive_size() << " bytes -> " << plan->arena_size() << " bytes";
+}
+
+template <typename Dtype>
+void Net<Dtype>::BindBlob(const string& blob_name, Dtype* data,
+                          size_t count) {
+  CHECK(has_blob(blob_name)) << "Unknown blob " << blob_name;
+  Blob<Dtype>* blob = blob_by_name(blob_name).get();
+  // Same set of blobs as the ones PlanMemory leaves alone.
+  bool external =
+      std::count(net_input_blobs_.begin(), net_input_blobs_.end(), blob) ||
+      std::count(net_output_blobs_.begin(), net_output_blobs_.end(), blob);
+  for (int layer_id = 0; layer_id < layers_.size() && !external; ++layer_id) {
+    if (bottom_vecs_[layer_id].size() > 0) continue;
+    external = std::count(top_vecs_[layer_id].begin(),
+                          top_vecs_[layer_id].end(), blob);
+  }
+  CHECK(external) << "Only net inputs, net outputs and tops of layers "
+                  << "without bottoms can be bound, not " << blob_name;
+  CHECK(data) << "Null buffer bound to " << blob_name;
+  CHECK_EQ(reinterpret_cast<uintptr_t>(data) % sizeof(Dtype), 0)
+      << "Misaligned buffer bound to " << blob_name;
+  CHECK_GE(count, blob->count()) << "Buffer bound to " << blob_name
+      << " is smaller than the blob " << blob->shape_string();
+  blob->set_cpu_data(data);
+  BoundBlob bound = {blob, blob->data().get(), count};
+  bound_blobs_[blob_name] = bound;
+}
+
+template <typename Dtype>
+void Net<Dtype>::UnbindBlob(const string& blob_name) {
+  typename map<string, BoundBlob>::iterator it = bound_blobs_.find(blob_name);
+  CHECK(it != bound_blobs_.end()) << "Blob " << blob_name << " is not bound";
+  if (it->second.blob->data().get() == it->second.memory) {
+    it->second.memory->reset_cpu_data();
+  }
+  bound_blobs_.erase(it);
+}
+
+template <typename Dtype>
+void Net<Dtype>::UnbindBlobs() {
+  while (!bound_blobs_.empty()) {
+    UnbindBlob(bound_blobs_.begin()->first);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckBoundBlobs() const {
+  for (typename map<string, BoundBlob>::const_iterator it =
+       bound_blobs_.begin(); it != bound_blobs_.end(); ++it) {
+    CHECK(it->second.blob->data().get() == it->second.memory)
+        << "Blob " << it->first << " was reallocated after being bound";
+    CHECK_LE(it->second.blob->count(), it->second.count)
+        << "Blob " << it->first << " outgrew its bound buffer";
+  }
+}
+
 #ifdef USE_MLU
 
 template <typename Dtype>
@@ -973,20 +1198,23 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   // Reshape logic is pelt from Forward in layers. Now, it's handled
   // by Net here to reduce reshaping which could be unneeded.
   Reshape();
+  CheckBoundBlobs();
 
+  Dtype loss = 0;
   switch (Caffe::mode()) {
     case Caffe::CPU:
     case Caffe::MLU:
-      return ForwardFromTo_default(start, end);
+      loss = ForwardFromTo_default(start, end);
       break;
     case Caffe::MFUS:
-      return ForwardFromTo_mfus(start, end);
+      loss = ForwardFromTo_mfus(start, end);
       break;
     default:
       NOT_IMPLEMENTED;
       break;
   }
-  return 0;
+  CheckBoundBlobs();
+  return loss;
 }
 
 // caffe's original implementation of ForwardFromTo
@@ -1048,11 +1276,17 @@ Dtype Net<Dtype>::ForwardFromTo_mfus(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
 
-  for (auto subnet : subnets_) {
+  for (int s = 0; s < subnets_.size(); ++s) {
+    for (int c = 0; c < before_forward_.size(); ++c) {
+      before_forward_[c]->run_subnet(s);
+    }
     if (Caffe::reshapeMode() == Caffe::ReshapeMode::ALWAYS) {
-      subnet->Reshape();
+      subnets_[s]->Reshape();
+    }
+    subnets_[s]->Forward(start, end);
+    for (int c = 0; c < after_forward_.size(); ++c) {
+      after_forward_[c]->run_subnet(s);
     }
-    subnet->Forward(start, end);
   }
 
   return 0;
@@ -1064,6 +1298,7 @@ template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  CheckBoundBlobs();
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
     for (int c = 0; c < before_forward_.size(); ++c) {
@@ -1078,6 +1313,7 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
       after_forward_[c]->run(i);
     }
   }
+  CheckBoundBlobs();
   return loss;
 }
 
@@ -1221,6 +1457,9 @@ template <typename Dtype>
 void Net<Dtype>::AppendCpuInfo(
     const string& file, const vector<vector<string>>& input_blob_array,
     const vector<vector<string>>& output_blob_array) {
+  CHECK(Caffe::splitMode() == Caffe::SplitMode::LINEAR)
+      << "cpu_info segments require SubNets of contiguous layers, "
+      << "use SplitMode LINEAR to generate them.";
   FILE* offline_fp = fopen(file.c_str(), "ab");
   fseek(offline_fp, 0, SEEK_END);
 
@@ -1343,7 +1582,7 @@ template <typename Dtype>
 void Net<Dtype>::OfflineMluSubnetRun(const cnrtModel_t& model,
                                      const cnrtDataType_t& dtype,
                                      const SegmentInfoUnit& unit_info,
-                                     void** cpuData) {
+                                     void** cpuData, size_t data_count) {
   void** inputMluPtrS;
   void** outputMluPtrS;
   void** inputCpuPtrS;
@@ -1365,18 +1604,21 @@ void Net<Dtype>::OfflineMluSubnetRun(const cnrtModel_t& model,
     name_to_cnrt_queue_[func_name] = cnrt_queue;
   }
 
-  inputCpuPtrS = reinterpret_cast<void**>(malloc(sizeof(void**) * input_num));
-  outputCpuPtrS = reinterpret_cast<void**>(malloc(sizeof(void**) * output_num));
-
   CNRT_CHECK(cnrtGetInputDataSize(&inputSizeArray, &input_num,
                                   name_to_cnrt_func_[func_name]));
   CNRT_CHECK(cnrtGetOutputDataSize(&outputSizeArray, &output_num,
                                    name_to_cnrt_func_[func_name]));
+  inputCpuPtrS = reinterpret_cast<void**>(malloc(sizeof(void*) * input_num));
+  outputCpuPtrS = reinterpret_cast<void**>(malloc(sizeof(void*) * output_num));
+  inputMluPtrS = reinterpret_cast<void**>(malloc(sizeof(void*) * input_num));
+  outputMluPtrS = reinterpret_cast<void**>(malloc(sizeof(void*) * output_num));
+
   for (int i = 0; i < input_num; i++) {
     Blob<Dtype>* blob = name_to_data_.at(unit_info.bottom(i));
     if ("subnet0" == func_name) {
-      caffe_copy(inputSizeArray[i], reinterpret_cast<Dtype*>(cpuData[0]),
-                 blob->mutable_cpu_data());
+      // The caller's buffer becomes the blob storage; no host copy.
+      BindBlob(unit_info.bottom(i), reinterpret_cast<Dtype*>(cpuData[0]),
+               data_count);
     }
     inputCpuPtrS[i] = reinterpret_cast<void*>(blob->mutable_cpu_data());
   }
@@ -1432,6 +1674,8 @@ void Net<Dtype>::OfflineMluSubnetRun(const cnrtModel_t& model,
   free(param);
   cnrtFreeArray(inputMluPtrS, input_num);
   cnrtFreeArray(outputMluPtrS, output_num);
+  free(inputMluPtrS);
+  free(outputMluPtrS);
 }
 
 template <typename Dtype>
@@ -1445,7 +1689,7 @@ template <typename Dtype>
 void Net<Dtype>::OfflineNetRun(const SegmentInfo& seg_info,
                                const cnrtModel_t& model,
                                const cnrtDataType_t& dtype,
-                               void** cpuData) {
+                               void** cpuData, size_t data_count) {
   if (!offline_init_flag_) OfflineRunInit(seg_info);
   for (int i = 0; i < seg_info.unit_size(); i++) {
     const SegmentInfoUnit& seg_unit = seg_info.unit(i);
@@ -1454,10 +1698,17 @@ void Net<Dtype>::OfflineNetRun(const SegmentInfo& seg_info,
         OfflineCpuSubnetRun(seg_unit);
         break;
       case SegmentInfoUnit_TYPE_MLU:
-        OfflineMluSubnetRun(model, dtype, seg_unit, cpuData);
+        OfflineMluSubnetRun(model, dtype, seg_unit, cpuData, data_count);
         break;
     }
   }
+  for (int i = 0; i < seg_info.unit_size(); i++) {
+    const SegmentInfoUnit& seg_unit = seg_info.unit(i);
+    if (seg_unit.name() != "subnet0") continue;
+    for (int j = 0; j < seg_unit.bottom_size(); j++) {
+      if (is_bound(seg_unit.bottom(j))) UnbindBlob(seg_unit.bottom(j));
+    }
+  }
 }
 
 template <typename Dtype>
@@ -1505,6 +1756,37 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  // Shared blobs may point into the files other mapped.
+  mapped_weights_.insert(mapped_weights_.end(), other->mapped_weights_.begin(),
+                         other->mapped_weights_.end());
+}
+
+template <typename Dtype>
+shared_ptr<Net<Dtype>> Net<Dtype>::CreateReplica() const {
+  CHECK_EQ(phase_, TEST) << "Only TEST nets can be replicated";
+  CHECK_EQ(thread_state_.mode, Caffe::CPU) << "Replicas run in CPU mode";
+  // The weights come from this net rather than from the parameter.
+  NetParameter param = net_param_without_weights_;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    param.mutable_layer(i)->clear_blobs();
+  }
+  // Replicas only read 16 bit weights safely through half_data(), expand
+  // those some layer reads as float once here rather than racing on it.
+  for (int i = 0; i < layers_.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype>>>& blobs = layers_[i]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      if (blobs[j]->half_type() != DT_INVALID &&
+          (j > 0 || !layers_[i]->ReadsHalfWeights())) {
+        blobs[j]->cpu_data();
+      }
+    }
+  }
+  // Build the same layers as this net whichever thread asks.
+  const Caffe::ThreadState state = Caffe::thread_state();
+  Caffe::set_thread_state(thread_state_);
+  shared_ptr<Net> replica(new Net(param, this));
+  Caffe::set_thread_state(state);
+  return replica;
 }
 
 template <typename Dtype>
@@ -1563,10 +1845,25 @@ void Net<Dtype>::Reshape() {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
 #endif  // USE_MLU
+  // Blobs grown by reshaping get their own memory again, plan them anew.
+  if (plan_memory_) {
+    PlanMemory();
+  }
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
+  if (!fold_trained_weights_) {
+    CopyTrainedLayers(param);
+    return;
+  }
+  NetParameter folded(param);
+  FoldTrainedWeights(optimized_param_, &folded);
+  CopyTrainedLayers(folded);
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayers(const NetParameter& param) {
   int num_source_layers = param.layer_size();
   vector<string> tmp_layers;
   for (int i = 0; i < layer_names_.size(); i++) {
@@ -1629,12 +1926,43 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       LOG(ERROR) << "weights of " << it << " are not initialized from caffemodel";
     }
   }
+  StoreHalfWeights();
+}
+
+template <typename Dtype>
+void Net<Dtype>::StoreHalfWeights() {
+  if (half_weights_ == DT_INVALID) {
+    return;
+  }
+  size_t saved = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (layers_[i]->blobs().empty() || !layers_[i]->ReadsHalfWeights()) {
+      continue;
+    }
+    Blob<Dtype>* weights = layers_[i]->blobs()[0].get();
+    if (weights->half_type() != half_weights_) {
+      weights->StoreHalf(half_weights_);
+      saved += weights->count() * (sizeof(Dtype) - sizeof(uint16_t));
+    }
+  }
+  LOG_IF(INFO, saved > 0 && Caffe::root_solver())
+      << "Weights stored in " << BaseDataType_Name(half_weights_) << ", "
+      << saved / 1048576. << " MB saved";
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
+  if (IsMappedWeightsFile(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename);
+    return;
+  }
 #ifdef USE_HDF5
-  if (H5Fis_hdf5(trained_filename.c_str())) {
+  htri_t is_hdf5;
+  {
+    std::lock_guard<std::mutex> lock(hdf5_mutex());
+    is_hdf5 = H5Fis_hdf5(trained_filename.c_str());
+  }
+  if (is_hdf5) {
     CopyTrainedLayersFromHDF5(trained_filename);
   } else {
 #else
@@ -1653,7 +1981,10 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
       , opt_level_, &net_param_without_weights_
 #endif
       );  //NOLINT
-  CopyTrainedLayersFrom(param);
+  if (fold_trained_weights_) {
+    FoldTrainedWeights(optimized_param_, &param);
+  }
+  CopyTrainedLayers(param);
 }
 
 template <typename Dtype>
@@ -1666,12 +1997,88 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(void* buffer,
                                                   int buffer_size) {
   NetParameter param;
   ReadNetParamsFromBinaryMemOrDie(buffer, buffer_size, &param);
-  CopyTrainedLayersFrom(param);
+  if (fold_trained_weights_) {
+    FoldTrainedWeights(optimized_param_, &param);
+  }
+  CopyTrainedLayers(param);
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string trained_filename) {
+  shared_ptr<MappedWeights> mapped(new MappedWeights(trained_filename));
+  if (fold_trained_weights_ || sizeof(Dtype) != sizeof(float)) {
+    // Folded weights are computed, and double blobs cannot point at floats.
+    NetParameter param;
+    mapped->ToProto(&param);
+    CopyTrainedLayersFrom(param);
+    return;
+  }
+  const MappedWeightsIndex& index = mapped->index();
+  vector<string> tmp_layers;
+  for (int i = 0; i < layer_names_.size(); i++) {
+    if (layers_[i]->layer_param().type() == "Convolution" ||
+        layers_[i]->layer_param().type() == "InnerProduct")
+      tmp_layers.push_back(layers_[i]->layer_param().name());
+  }
+  map<string, int> num_tensors;
+  for (int i = 0; i < index.tensor_size(); ++i) {
+    ++num_tensors[index.tensor(i).layer()];
+  }
+  size_t mapped_bytes = 0;
+  for (int i = 0; i < index.tensor_size(); ++i) {
+    const MappedWeightsIndex::Tensor& tensor = index.tensor(i);
+    if (!has_layer(tensor.layer())) {
+      LOG_IF(INFO, tensor.blob() == 0)
+          << "Ignoring source layer " << tensor.layer();
+      continue;
+    }
+    const int target_layer_id = layer_names_index_[tensor.layer()];
+    vector<shared_ptr<Blob<Dtype>>>& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), num_tensors[tensor.layer()])
+        << "Incompatible number of blobs for layer " << tensor.layer();
+    CHECK_LT(tensor.blob(), target_blobs.size())
+        << "Incompatible number of blobs for layer " << tensor.layer();
+    tmp_layers.erase(std::remove(tmp_layers.begin(), tmp_layers.end(),
+                                 tensor.layer()), tmp_layers.end());
+    Blob<Dtype>* target = target_blobs[tensor.blob()].get();
+    BlobProto proto;
+    proto.mutable_shape()->CopyFrom(tensor.shape());
+    if (target->CountEquals(proto)) {
+      target->set_cpu_data(reinterpret_cast<Dtype*>(mapped->data(tensor)));
+      mapped_bytes += target->count() * sizeof(Dtype);
+    } else {
+      // Counts differing the way CopyTrainedLayers() allows need a copy.
+      mapped->ToProto(tensor, &proto);
+      CHECK(target->CountGE3(proto))
+          << "Cannot copy param " << tensor.blob() << " weights from layer '"
+          << tensor.layer() << "'; shape mismatch.";
+      target->FromProto(proto, false);
+    }
+#ifdef USE_MLU
+    if (opt_level_ == -2 && tensor.blob() == 0 &&
+        layers_[target_layer_id]->layer_param().blobs_dtype().size()) {
+      RecalculateWeightsInt8Info(target_blobs[0],
+          layers_[target_layer_id]->layer_param());
+    }
+#endif
+  }
+  for (auto it : tmp_layers) {
+    LOG(ERROR) << "weights of " << it << " are not initialized from caffemodel";
+  }
+  mapped_weights_.push_back(mapped);
+  LOG_IF(INFO, Caffe::root_solver()) << "Mapped " << mapped_bytes / 1048576.
+      << " MB of weights from " << trained_filename;
+  StoreHalfWeights();
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
 #ifdef USE_HDF5
+  CHECK(!fold_trained_weights_)
+      << "HDF5 weights cannot be folded into the layers rewritten by the "
+      << "graph optimization passes, load a binary proto or use opt_level 0";
+  std::lock_guard<std::mutex> lock(hdf5_mutex());
   hid_t file_hid =
       H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -1717,6 +2124,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  StoreHalfWeights();
 #endif
 }
 
@@ -1735,6 +2143,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 #ifdef USE_HDF5
+  std::lock_guard<std::mutex> lock(hdf5_mutex());
   hid_t file_hid =
       H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << filename << " to save weights.";
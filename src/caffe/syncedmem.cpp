@@ -27,6 +27,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <atomic>
 #include <vector>
 
 #include "caffe/common.hpp"
@@ -36,6 +37,36 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace caffe {
 
+namespace {
+
+std::atomic<uint64_t> host_to_device_count(0);
+std::atomic<uint64_t> device_to_host_count(0);
+std::atomic<uint64_t> host_to_device_bytes(0);
+std::atomic<uint64_t> device_to_host_bytes(0);
+
+inline void count_sync(bool to_device, size_t bytes) {
+  if (to_device) {
+    host_to_device_count.fetch_add(1, std::memory_order_relaxed);
+    host_to_device_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  } else {
+    device_to_host_count.fetch_add(1, std::memory_order_relaxed);
+    device_to_host_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+MemorySyncStats SyncedMemory::sync_stats() {
+  MemorySyncStats stats;
+  stats.host_to_device = host_to_device_count.load(std::memory_order_relaxed);
+  stats.device_to_host = device_to_host_count.load(std::memory_order_relaxed);
+  stats.host_to_device_bytes =
+      host_to_device_bytes.load(std::memory_order_relaxed);
+  stats.device_to_host_bytes =
+      device_to_host_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
 static inline void cast_data_type(void* src_addr, void* dst_addr,
    cnrtMemTransDir_t dir, const MLUTensorDesc& mlu_tensor_desc) {
   cnrtDataType_t src_data_type, dst_data_type;
@@ -88,7 +119,7 @@ static inline void cast_data_type(void* src_addr, void* dst_addr,
 
   // castDataType
   int cast_size = mlu_tensor_desc.data_num() * cnrtDataTypeSize(dst_data_type);
-  void* cast_ptr = malloc(cast_size);
+  void* cast_ptr = HostAllocator::Get()->Allocate(cast_size);
   if (src_data_type != dst_data_type) {
      cnrtCastDataType(src_addr, src_data_type, cast_ptr, dst_data_type,
          mlu_tensor_desc.data_num(), param);
@@ -102,7 +133,7 @@ static inline void cast_data_type(void* src_addr, void* dst_addr,
   bool add_stride = mlu_tensor_desc.has_dim_strides() &&
     dir == CNRT_MEM_TRANS_DIR_HOST2DEV;
   if (add_stride) {
-     stride_ptr = malloc(size);
+     stride_ptr = HostAllocator::Get()->Allocate(size);
      cnrtAddDataStride(cast_ptr, dst_data_type, stride_ptr, shape_dim,
         mlu_tensor_desc.cpu_shape().data(), mlu_tensor_desc.dim_strides().data());
      for (int i = 0; i < mlu_tensor_desc.shape_dim(); i++) {
@@ -113,22 +144,23 @@ static inline void cast_data_type(void* src_addr, void* dst_addr,
   // transDataOrder
   if (!mlu_tensor_desc.is_preprocess()) {
     memcpy(dst_addr, cast_ptr, cast_size);
-    return;
+  } else {
+    cnrtTransDataOrder(add_stride? stride_ptr: cast_ptr,
+                       dst_data_type, dst_addr, shape_dim,
+                       dim_value_for_trans.data(), dim_order.data());
   }
-  cnrtTransDataOrder(add_stride? stride_ptr: cast_ptr,
-                     dst_data_type, dst_addr, shape_dim,
-                     dim_value_for_trans.data(), dim_order.data());
 
   // free
   if (param) {
     CNRT_CHECK(cnrtDestroyQuantizedParam(param));
   }
-  if (cast_ptr != nullptr) free(cast_ptr);
-  if (stride_ptr != nullptr) free(stride_ptr);
+  HostAllocator::Get()->Free(cast_ptr);
+  HostAllocator::Get()->Free(stride_ptr);
 }
 
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
+    version_(0),
 #ifdef USE_MLU
     mlu_ptr_(nullptr), sync_ptr_(NULL),
 #endif
@@ -147,6 +179,7 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+    version_(0),
 #ifdef USE_MLU
     mlu_ptr_(nullptr), sync_ptr_(NULL),
 #endif
@@ -201,6 +234,7 @@ inline void SyncedMemory::to_cpu() {
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
+    count_sync(false, size_);
     head_ = SYNCED;
 #else
     NO_GPU;
@@ -235,6 +269,7 @@ inline void SyncedMemory::to_gpu() {
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
+    count_sync(true, size_);
     head_ = SYNCED;
     break;
   case HEAD_AT_MLU:
@@ -266,6 +301,37 @@ void SyncedMemory::set_cpu_data(void* data) {
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
+}
+
+void SyncedMemory::reset_cpu_data() {
+  check_device();
+  if (own_cpu_data_ || cpu_ptr_ == NULL) {
+    return;
+  }
+  if (head_ == HEAD_AT_CPU) {
+    // The bound buffer holds the only current copy, keep it in owned memory.
+    void* bound = cpu_ptr_;
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    memcpy(cpu_ptr_, bound, size_);
+    own_cpu_data_ = true;
+    return;
+  }
+  cpu_ptr_ = NULL;
+  if (head_ == SYNCED) {
+    // Keep the device memory, to_cpu() copies it back when needed.
+#ifdef USE_MLU
+    if (mlu_ptr_) {
+      head_ = HEAD_AT_MLU;
+      return;
+    }
+#endif
+    if (gpu_ptr_) {
+      head_ = HEAD_AT_GPU;
+      return;
+    }
+    head_ = UNINITIALIZED;
+  }
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -289,6 +355,7 @@ void SyncedMemory::set_gpu_data(void* data) {
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -298,6 +365,7 @@ void* SyncedMemory::mutable_cpu_data() {
   check_device();
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -306,6 +374,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifdef USE_CUDA
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -366,12 +435,14 @@ void SyncedMemory::set_mlu_data(void* data) {
   mlu_ptr_ = data;
   head_ = HEAD_AT_MLU;
   own_mlu_data_ = false;
+  ++version_;
 }
 
 void* SyncedMemory::mutable_cpu_data(const MLUTensorDesc& mlu_tensor_desc) {
   check_device();
   to_cpu(mlu_tensor_desc);
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -397,6 +468,7 @@ inline void SyncedMemory::to_cpu(const MLUTensorDesc& mlu_tensor_desc) {
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
+    count_sync(false, size_);
     head_ = SYNCED;
 #else
     NO_GPU;
@@ -415,6 +487,7 @@ inline void SyncedMemory::to_cpu(const MLUTensorDesc& mlu_tensor_desc) {
     }
     CNRT_CHECK(cnrtMemcpy(sync_ptr_, mlu_ptr_, cpu_sync_size,
           CNRT_MEM_TRANS_DIR_DEV2HOST));
+    count_sync(false, cpu_sync_size);
     cast_data_type(sync_ptr_, cpu_ptr_, CNRT_MEM_TRANS_DIR_DEV2HOST, mlu_tensor_desc);
     head_ = SYNCED;
     break;
@@ -455,6 +528,7 @@ inline void SyncedMemory::to_mlu(const MLUTensorDesc& mlu_tensor_desc) {
     cast_data_type(cpu_ptr_, sync_ptr_, CNRT_MEM_TRANS_DIR_HOST2DEV, mlu_tensor_desc);
     CNRT_CHECK(cnrtMemcpy(mlu_ptr_, sync_ptr_, mlu_cpu_size,
           CNRT_MEM_TRANS_DIR_HOST2DEV));
+    count_sync(true, mlu_cpu_size);
     head_ = SYNCED;
     own_mlu_data_ = true;
     break;
@@ -469,6 +543,7 @@ inline void SyncedMemory::to_mlu(const MLUTensorDesc& mlu_tensor_desc) {
 void* SyncedMemory::mutable_mlu_data(const MLUTensorDesc& mlu_tensor_desc) {
   to_mlu(mlu_tensor_desc);
   head_ = HEAD_AT_MLU;
+  ++version_;
   return mlu_ptr_;
 }
 
@@ -490,6 +565,7 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
   CUDA_CHECK(cudaMemcpyAsync(gpu_ptr_, cpu_ptr_, size_, put, stream));
+  count_sync(true, size_);
   // Assume caller will synchronize on the stream before use
   head_ = SYNCED;
 }
@@ -0,0 +1,205 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <future>  // NOLINT(build/c++11)
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/batching_server.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BatchingServerTest : public CPUDeviceTest<TypeParam> {
+  typedef TypeParam Dtype;
+  typedef typename BatchingServer<Dtype>::Sample Sample;
+
+  protected:
+  // Every output of a sample is the sum of its 3 inputs.
+  virtual void SetUp() {
+    const string proto =
+        "name: 'SumNet' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 1 dim: 3 } } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'sum' "
+        "  inner_product_param { "
+        "    num_output: 2 "
+        "    weight_filler { type: 'constant' value: 1 } "
+        "    bias_filler { type: 'constant' value: 0 } "
+        "  } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  Sample MakeSample(int i) {
+    Sample sample(1, vector<Dtype>(3));
+    sample[0][0] = i;
+    sample[0][1] = 2 * i;
+    sample[0][2] = 1;
+    return sample;
+  }
+
+  void ExpectResult(int i, const Sample& result) {
+    ASSERT_EQ(1, result.size());
+    ASSERT_EQ(2, result[0].size());
+    EXPECT_EQ(Dtype(3 * i + 1), result[0][0]);
+    EXPECT_EQ(Dtype(3 * i + 1), result[0][1]);
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(BatchingServerTest, TestDtypes);
+
+TYPED_TEST(BatchingServerTest, TestFullBatches) {
+  typedef typename BatchingServer<TypeParam>::Sample Sample;
+  // The deadline is far away, so only full batches are sent.
+  BatchingServer<TypeParam> server(
+      vector<Net<TypeParam>*>(1, this->net_.get()), 4, 60000);
+  EXPECT_EQ(vector<int>(1, 3), server.input_counts());
+  vector<std::future<Sample> > results;
+  for (int i = 0; i < 8; ++i) {
+    results.push_back(server.Submit(this->MakeSample(i)));
+  }
+  for (int i = 0; i < 8; ++i) {
+    this->ExpectResult(i, results[i].get());
+  }
+  BatchingStats stats = server.stats();
+  EXPECT_EQ(8, stats.requests);
+  EXPECT_EQ(2, stats.batches);
+  EXPECT_EQ(2, stats.full_batches);
+  EXPECT_EQ(1, stats.batch_fill());
+  EXPECT_LE(stats.p50_ms, stats.p99_ms);
+}
+
+TYPED_TEST(BatchingServerTest, TestPlannedMemory) {
+  typedef TypeParam Dtype;
+  typedef typename BatchingServer<Dtype>::Sample Sample;
+  // The copy in between is planned; a batch of 4 must re-plan it.
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "state { phase: TEST } "
+      "plan_memory: true "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape: { dim: 1 dim: 3 } } } "
+      "layer { name: 'copy' type: 'Power' bottom: 'data' top: 'copy' } "
+      "layer { name: 'sum' type: 'InnerProduct' bottom: 'copy' top: 'sum' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'constant' value: 1 } "
+      "    bias_filler { type: 'constant' value: 0 } } } ",
+      &param));
+  Net<Dtype> net(param);
+  ASSERT_TRUE(net.memory_plan());
+  EXPECT_EQ(3 * sizeof(Dtype), net.memory_plan()->naive_size());
+  BatchingServer<Dtype> server(vector<Net<Dtype>*>(1, &net), 4, 60000);
+  vector<std::future<Sample> > results;
+  for (int i = 0; i < 4; ++i) {
+    results.push_back(server.Submit(this->MakeSample(i)));
+  }
+  for (int i = 0; i < 4; ++i) {
+    this->ExpectResult(i, results[i].get());
+  }
+  ASSERT_TRUE(net.memory_plan());
+  EXPECT_EQ(4 * 3 * sizeof(Dtype), net.memory_plan()->naive_size());
+}
+
+TYPED_TEST(BatchingServerTest, TestDeadline) {
+  typedef typename BatchingServer<TypeParam>::Sample Sample;
+  BatchingServer<TypeParam> server(
+      vector<Net<TypeParam>*>(1, this->net_.get()), 8, 1);
+  // A lone request leaves once it is due.
+  this->ExpectResult(5, server.Submit(this->MakeSample(5)).get());
+  BatchingStats stats = server.stats();
+  EXPECT_EQ(1, stats.requests);
+  EXPECT_EQ(1, stats.batches);
+  EXPECT_EQ(0, stats.full_batches);
+  EXPECT_EQ(0.125, stats.batch_fill());
+  EXPECT_GE(stats.p50_ms, 1);
+  server.ResetStats();
+  EXPECT_EQ(0, server.stats().requests);
+  EXPECT_EQ(0, server.stats().p99_ms);
+  // Requests still queued are answered before the server goes away.
+  std::future<Sample> result;
+  {
+    BatchingServer<TypeParam> slow(
+        vector<Net<TypeParam>*>(1, this->net_.get()), 8, 60000);
+    result = slow.Submit(this->MakeSample(7));
+  }
+  this->ExpectResult(7, result.get());
+}
+
+TYPED_TEST(BatchingServerTest, TestReplicas) {
+  typedef typename BatchingServer<TypeParam>::Sample Sample;
+  shared_ptr<Net<TypeParam> > replica = this->net_->CreateReplica();
+  vector<Net<TypeParam>*> nets;
+  nets.push_back(this->net_.get());
+  nets.push_back(replica.get());
+  BatchingServer<TypeParam> server(nets, 4, 1);
+  const int kClients = 8;
+  const int kRequests = 25;
+  vector<std::thread> clients;
+  for (int c = 0; c < kClients; ++c) {
+    clients.push_back(std::thread([&, c]() {
+      for (int i = 0; i < kRequests; ++i) {
+        const int id = c * kRequests + i;
+        Sample result = server.Submit(this->MakeSample(id)).get();
+        EXPECT_EQ(TypeParam(3 * id + 1), result[0][0]);
+      }
+    }));
+  }
+  for (int c = 0; c < kClients; ++c) {
+    clients[c].join();
+  }
+  BatchingStats stats = server.stats();
+  EXPECT_EQ(kClients * kRequests, stats.requests);
+  EXPECT_GE(stats.batches, kClients * kRequests / 4);
+  EXPECT_LE(stats.p50_ms, stats.p99_ms);
+}
+
+}  // namespace caffe
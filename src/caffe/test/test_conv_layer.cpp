@@ -35,7 +35,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 /*#include "caffe/mlu/util.hpp"*/
 #include "caffe/layers/mlu_conv_layer.hpp"
 #ifdef USE_CUDNN
@@ -734,6 +736,187 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
                                   this->blob_top_vec_);
 }
 
+template <typename Dtype>
+class WinogradConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+  protected:
+  WinogradConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 8, 11, 10)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_value(1.);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~WinogradConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  ConvolutionParameter* MakeParam(LayerParameter* layer_param, int kernel,
+                                  int stride, int pad, int num_output) {
+    ConvolutionParameter* convolution_param =
+        layer_param->mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel);
+    convolution_param->add_stride(stride);
+    convolution_param->add_pad(pad);
+    convolution_param->set_num_output(num_output);
+    convolution_param->set_engine(ConvolutionParameter_Engine_WINOGRAD);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    return convolution_param;
+  }
+
+  // Runs the layer, checks the selected algorithm and compares the output
+  // with caffe_conv.
+  void CheckAgainstReference(LayerParameter* layer_param,
+      typename WinogradConvolutionLayer<Dtype>::Algorithm algorithm,
+      Dtype tolerance) {
+    WinogradConvolutionLayer<Dtype> layer(*layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(algorithm, layer.algorithm());
+    Blob<Dtype> other_weights;
+    other_weights.ReshapeLike(*layer.blobs()[0]);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&other_weights);
+    for (int iter = 0; iter < 3; ++iter) {
+      // Changed or replaced filters must not reuse the cached transform.
+      if (iter == 1) {
+        caffe_scal(layer.blobs()[0]->count(), Dtype(-0.5),
+                   layer.blobs()[0]->mutable_cpu_data());
+      } else if (iter == 2) {
+        layer.blobs()[0]->ShareData(other_weights);
+      }
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      Blob<Dtype> ref_top;
+      ref_top.ReshapeLike(*blob_top_);
+      caffe_conv(blob_bottom_, layer_param->mutable_convolution_param(),
+                 layer.blobs(), &ref_top);
+      const Dtype* top_data = blob_top_->cpu_data();
+      const Dtype* ref_top_data = ref_top.cpu_data();
+      for (int i = 0; i < blob_top_->count(); ++i) {
+        EXPECT_NEAR(top_data[i], ref_top_data[i], tolerance);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(WinogradConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestFactory) {
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  this->MakeParam(&layer_param, 3, 1, 1, 4);
+  shared_ptr<Layer<TypeParam> > layer =
+      LayerRegistry<TypeParam>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<WinogradConvolutionLayer<TypeParam>*>(
+      layer.get()) != NULL);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestSelection) {
+  typedef WinogradConvolutionLayer<TypeParam> WinogradLayer;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      this->MakeParam(&layer_param, 3, 1, 1, 4);
+  shared_ptr<WinogradLayer> layer(new WinogradLayer(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(WinogradLayer::WINOGRAD_4X4, layer->algorithm());
+  // Small outputs waste most of a 4x4 tile.
+  this->blob_bottom_->Reshape(2, 8, 6, 10);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(WinogradLayer::WINOGRAD_2X2, layer->algorithm());
+  // Too few channels per group for the transforms to pay off.
+  convolution_param->set_group(2);
+  layer.reset(new WinogradLayer(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(WinogradLayer::GEMM, layer->algorithm());
+  convolution_param->set_group(1);
+  convolution_param->set_stride(0, 2);
+  layer.reset(new WinogradLayer(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(WinogradLayer::GEMM, layer->algorithm());
+  convolution_param->set_kernel_size(0, 1);
+  convolution_param->set_pad(0, 0);
+  layer.reset(new WinogradLayer(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(WinogradLayer::DIRECT_1X1, layer->algorithm());
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWinograd4x4) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 3, 1, 1, 6);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::WINOGRAD_4X4, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWinograd4x4NoPad) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 3, 1, 0, 6);
+  this->blob_bottom_->Reshape(1, 8, 13, 10);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::WINOGRAD_4X4, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWinograd2x2) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 3, 1, 1, 6);
+  this->blob_bottom_->Reshape(2, 8, 7, 5);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::WINOGRAD_2X2, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWinogradGroup) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 3, 1, 1, 6)->set_group(2);
+  this->blob_bottom_->Reshape(2, 16, 9, 12);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::WINOGRAD_4X4, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, Test1x1) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 1, 1, 0, 5);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::DIRECT_1X1, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, Test1x1Stride) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 1, 2, 0, 6)->set_group(2);
+  this->CheckAgainstReference(&layer_param,
+      WinogradConvolutionLayer<TypeParam>::DIRECT_1X1, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestGradient) {
+  LayerParameter layer_param;
+  this->MakeParam(&layer_param, 3, 1, 1, 2);
+  this->blob_bottom_->Reshape(1, 8, 5, 4);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  WinogradConvolutionLayer<TypeParam> layer(layer_param);
+  GradientChecker<TypeParam> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                  this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
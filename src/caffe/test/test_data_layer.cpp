@@ -40,6 +40,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -391,6 +392,88 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // Spreads records datums over shards databases the way convert_imageset
+  // does, leaving out line missing (-1 for none) like an unreadable image,
+  // then checks that a batch size that wraps reads them back as order.
+  void TestReadShards(const int shards, const int records, const int missing,
+                      const vector<int>& order) {
+    for (int s = 0; s < shards; ++s) {
+      scoped_ptr<db::DB> db(db::GetDB(backend_));
+      db->Open(db::ShardSource(*filename_, s, shards), db::NEW);
+      scoped_ptr<db::Transaction> txn(db->NewTransaction());
+      for (int i = s; i < records; i += shards) {
+        if (i == missing) {
+          continue;
+        }
+        Datum datum;
+        datum.set_label(i);
+        datum.set_channels(1);
+        datum.set_height(1);
+        datum.set_width(1);
+        datum.mutable_data()->push_back(static_cast<uint8_t>(i));
+        string out;
+        CHECK(datum.SerializeToString(&out));
+        txn->Put(format_int(i, 8), out);
+      }
+      txn->Commit();
+    }
+    LayerParameter param;
+    param.set_phase(TEST);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(3);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shards(shards);
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    int index = 0;
+    for (int iter = 0; iter < 4; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(order[index], blob_top_label_->cpu_data()[i]);
+        EXPECT_EQ(order[index], blob_top_data_->cpu_data()[i]);
+        index = (index + 1) % order.size();
+      }
+    }
+  }
+
+  void TestDecodeThreads() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_crop_size(1);
+    transform_param->set_mirror(true);
+
+    // The batches must not depend on the number of decode threads.
+    vector<vector<Dtype> > batches[2];
+    for (int run = 0; run < 2; ++run) {
+      data_param->set_decode_threads(run == 0 ? 1 : 3);
+      Caffe::set_random_seed(seed_);
+      DataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 3; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        for (int i = 0; i < 5; ++i) {
+          EXPECT_EQ(i, blob_top_label_->cpu_data()[i]);
+        }
+        batches[run].push_back(vector<Dtype>(blob_top_data_->cpu_data(),
+            blob_top_data_->cpu_data() + blob_top_data_->count()));
+      }
+      const DataLoadStats stats = layer.load_stats();
+      EXPECT_GE(stats.batches, 3);
+      EXPECT_EQ(stats.batches * 5, stats.items);
+    }
+    for (int iter = 0; iter < 3; ++iter) {
+      EXPECT_EQ(batches[0][iter], batches[1][iter]) << "iter " << iter;
+    }
+  }
+
   virtual ~DataLayerTest() { delete blob_top_data_; delete blob_top_label_; }
 
   DataParameter_DB backend_;
@@ -493,6 +576,26 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLMDB) {
   this->TestReadCrop(TEST);
 }
 
+TYPED_TEST(DataLayerTest, TestReadShardsLMDB) {
+  this->backend_ = DataParameter_DB_LMDB;
+  const int order[] = {0, 1, 2, 3, 4};
+  this->TestReadShards(2, 5, -1, vector<int>(order, order + 5));
+}
+
+TYPED_TEST(DataLayerTest, TestReadUnevenShardsLMDB) {
+  this->backend_ = DataParameter_DB_LMDB;
+  // Without line 1, shard 1 only holds 4 and runs out first; the tail of
+  // the others is still read in every pass.
+  const int order[] = {0, 4, 2, 3, 5, 6};
+  this->TestReadShards(3, 7, 1, vector<int>(order, order + 6));
+}
+
+TYPED_TEST(DataLayerTest, TestDecodeThreadsLMDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestDecodeThreads();
+}
+
 #endif  // USE_LMDB
 }  // namespace caffe
 #endif  // USE_OPENCV
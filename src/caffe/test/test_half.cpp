@@ -0,0 +1,276 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/half.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(HalfTest, TestFloat16) {
+  const float x[] = {0.f, -0.f, 1.f, -2.5f, 65504.f, 65520.f, 1.f / 3,
+      5.96046448e-8f, std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::quiet_NaN()};
+  const uint16_t expected[] = {0x0000, 0x8000, 0x3C00, 0xC100, 0x7BFF, 0x7C00,
+      0x3555, 0x0001, 0x7C00, 0x7E00};
+  const int n = sizeof(x) / sizeof(x[0]);
+  uint16_t h[n];
+  caffe_cpu_to_half(n, x, DT_FLOAT16, h);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(expected[i], h[i]) << x[i];
+  }
+  float y[n];
+  caffe_cpu_from_half(n, h, DT_FLOAT16, y);
+  EXPECT_EQ(65504.f, y[4]);
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), y[5]);
+  EXPECT_NEAR(1.f / 3, y[6], 1e-4);
+  EXPECT_EQ(5.96046448e-8f, y[7]);
+  EXPECT_TRUE(std::isnan(y[9]));
+}
+
+TEST(HalfTest, TestRoundTrip) {
+  // Every 16 bit value but the NaNs survives a round trip through float,
+  // in both the vector and the scalar (double) conversions.
+  const BaseDataType types[] = {DT_FLOAT16, DT_BFLOAT16};
+  for (int t = 0; t < 2; ++t) {
+    vector<uint16_t> h(65536), back(65536);
+    for (int i = 0; i < 65536; ++i) {
+      h[i] = i;
+    }
+    vector<float> f(65536);
+    vector<double> d(65536);
+    caffe_cpu_from_half(65536, &h[0], types[t], &f[0]);
+    caffe_cpu_from_half(65536, &h[0], types[t], &d[0]);
+    caffe_cpu_to_half(65536, &f[0], types[t], &back[0]);
+    for (int i = 0; i < 65536; ++i) {
+      if (std::isnan(f[i])) {
+        EXPECT_TRUE(std::isnan(d[i]));
+        continue;
+      }
+      EXPECT_EQ(h[i], back[i]);
+      EXPECT_EQ(f[i], d[i]);
+    }
+  }
+}
+
+TEST(HalfTest, TestBFloat16Rounding) {
+  // 1 + 2^-8 is halfway between two bfloat16 values, it rounds to even.
+  const float x[] = {1.f + 1.f / 256, 1.f + 3.f / 256, 1.f + 1.f / 255, 3e38f};
+  const uint16_t expected[] = {0x3F80, 0x3F82, 0x3F81, 0x7F62};
+  uint16_t h[4];
+  caffe_cpu_to_half(4, x, DT_BFLOAT16, h);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(expected[i], h[i]) << x[i];
+  }
+}
+
+template <typename TypeParam>
+class HalfBlobTest : public ::testing::Test {
+  protected:
+  HalfBlobTest() : blob_(new Blob<TypeParam>(2, 3, 4, 5)) {}
+  virtual ~HalfBlobTest() { delete blob_; }
+  Blob<TypeParam>* const blob_;
+};
+
+TYPED_TEST_CASE(HalfBlobTest, TestDtypes);
+
+TYPED_TEST(HalfBlobTest, TestStoreHalf) {
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_);
+  Blob<TypeParam> original;
+  original.CopyFrom(*this->blob_, false, true);
+  EXPECT_EQ(DT_INVALID, this->blob_->half_type());
+  this->blob_->StoreHalf(DT_BFLOAT16);
+  EXPECT_EQ(DT_BFLOAT16, this->blob_->half_type());
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, this->blob_->data()->head());
+  // cpu_data() converts back, keeping the 16 bit data.
+  const TypeParam* data = this->blob_->cpu_data();
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    EXPECT_NEAR(original.cpu_data()[i], data[i],
+                std::fabs(original.cpu_data()[i]) / 128);
+  }
+  EXPECT_EQ(DT_BFLOAT16, this->blob_->half_type());
+  // A blob sharing the data shares the 16 bit data too.
+  Blob<TypeParam> shared(2, 3, 4, 5);
+  shared.ShareData(*this->blob_);
+  EXPECT_EQ(DT_BFLOAT16, shared.half_type());
+  EXPECT_EQ(this->blob_->half_data(), shared.half_data());
+  // Writing returns to float storage.
+  this->blob_->mutable_cpu_data()[0] = 7;
+  EXPECT_EQ(DT_INVALID, this->blob_->half_type());
+  EXPECT_EQ(7, this->blob_->cpu_data()[0]);
+}
+
+template <typename Dtype>
+class HalfLayerTest : public CPUDeviceTest<Dtype> {
+  protected:
+  HalfLayerTest()
+      : blob_bottom_(new Blob<Dtype>(3, 4, 6, 5)),
+        blob_top_(new Blob<Dtype>()),
+        ref_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ref_top_vec_.push_back(ref_top_);
+  }
+  virtual ~HalfLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete ref_top_;
+  }
+
+  // Checks that layer with weights stored in type computes what it does in
+  // float with the same rounded weights.
+  template <typename LayerType>
+  void TestHalf(const LayerParameter& param, const BaseDataType type) {
+    LayerType layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    ASSERT_TRUE(layer.ReadsHalfWeights());
+    Blob<Dtype>* weights = layer.blobs()[0].get();
+    weights->StoreHalf(type);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(type, weights->half_type());
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, weights->data()->head());
+
+    LayerType ref_layer(param);
+    ref_layer.blobs() = layer.blobs();
+    ref_layer.blobs()[0].reset(new Blob<Dtype>());
+    ref_layer.blobs()[0]->CopyFrom(*weights, false, true);
+    ref_layer.SetUp(blob_bottom_vec_, ref_top_vec_);
+    ref_layer.Forward(blob_bottom_vec_, ref_top_vec_);
+    ASSERT_EQ(ref_top_->shape(), blob_top_->shape());
+    for (int i = 0; i < ref_top_->count(); ++i) {
+      EXPECT_NEAR(ref_top_->cpu_data()[i], blob_top_->cpu_data()[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const ref_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> ref_top_vec_;
+};
+
+TYPED_TEST_CASE(HalfLayerTest, TestDtypes);
+
+TYPED_TEST(HalfLayerTest, TestConvolution) {
+  LayerParameter param;
+  ConvolutionParameter* conv = param.mutable_convolution_param();
+  conv->set_num_output(6);
+  conv->add_kernel_size(3);
+  conv->set_group(2);
+  conv->mutable_weight_filler()->set_type("gaussian");
+  conv->mutable_bias_filler()->set_type("gaussian");
+  this->template TestHalf<ConvolutionLayer<TypeParam> >(param, DT_FLOAT16);
+}
+
+TYPED_TEST(HalfLayerTest, TestInnerProduct) {
+  LayerParameter param;
+  InnerProductParameter* ip = param.mutable_inner_product_param();
+  ip->set_num_output(10);
+  ip->mutable_weight_filler()->set_type("gaussian");
+  ip->mutable_bias_filler()->set_type("gaussian");
+  this->template TestHalf<InnerProductLayer<TypeParam> >(param, DT_BFLOAT16);
+}
+
+TYPED_TEST(HalfLayerTest, TestInnerProductTranspose) {
+  LayerParameter param;
+  InnerProductParameter* ip = param.mutable_inner_product_param();
+  ip->set_num_output(10);
+  ip->set_transpose(true);
+  ip->mutable_weight_filler()->set_type("gaussian");
+  this->template TestHalf<InnerProductLayer<TypeParam> >(param, DT_FLOAT16);
+}
+
+TYPED_TEST(HalfLayerTest, TestInnerProductSingle) {
+  vector<int> shape(2, 1);
+  shape[1] = 120;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter param;
+  InnerProductParameter* ip = param.mutable_inner_product_param();
+  ip->set_num_output(7);
+  ip->mutable_weight_filler()->set_type("gaussian");
+  this->template TestHalf<InnerProductLayer<TypeParam> >(param, DT_FLOAT16);
+}
+
+TYPED_TEST(HalfLayerTest, TestNetSkipsWinograd) {
+  typedef TypeParam Dtype;
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "cpu_weight_dtype: DT_FLOAT16 "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 1 dim: 4 dim: 8 dim: 8 } } } "
+      "layer { name: 'winograd' type: 'Convolution' bottom: 'data' "
+      "  top: 'winograd' convolution_param { num_output: 4 kernel_size: 3 "
+      "  pad: 1 engine: WINOGRAD weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'winograd' "
+      "  top: 'conv' engine: CAFFE convolution_param { num_output: 4 "
+      "  kernel_size: 3 weight_filler { type: 'gaussian' } } } ",
+      &param));
+  Net<Dtype> net(param);
+  Layer<Dtype>* winograd = net.layer_by_name("winograd").get();
+  ASSERT_TRUE(dynamic_cast<WinogradConvolutionLayer<Dtype>*>(winograd));
+  EXPECT_FALSE(winograd->ReadsHalfWeights());
+  // Only the layer reading half_data() has its weights in 16 bits, the
+  // Winograd ones keep a single float copy through the forward.
+  Blob<Dtype>* winograd_weights = winograd->blobs()[0].get();
+  Blob<Dtype>* conv_weights = net.layer_by_name("conv")->blobs()[0].get();
+  EXPECT_EQ(DT_FLOAT16, conv_weights->half_type());
+  EXPECT_EQ(DT_INVALID, winograd_weights->half_type());
+  const Dtype* weights_data = winograd_weights->cpu_data();
+  net.Forward();
+  EXPECT_EQ(DT_INVALID, winograd_weights->half_type());
+  EXPECT_EQ(weights_data, winograd_weights->cpu_data());
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, conv_weights->data()->head());
+}
+
+}  // namespace caffe
@@ -28,6 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #ifdef USE_HDF5
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
@@ -39,6 +41,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -71,6 +75,54 @@ class HDF5DataLayerTest : public MultiDeviceTest<TypeParam> {
     delete filename;
   }
 
+  // Writes two files of 7 and 5 rows, row r of file f labelled 100 * f + r
+  // with data 10 * label + k, k < 6, and returns the list of the files.
+  string WriteStreamFiles() {
+    string dir;
+    MakeTempDir(&dir);
+    string list = dir + "/list.txt";
+    std::ofstream list_file(list.c_str());
+    const int rows[2] = {7, 5};
+    for (int f = 0; f < 2; ++f) {
+      vector<int> shape(3);
+      shape[0] = rows[f];
+      shape[1] = 2;
+      shape[2] = 3;
+      Blob<Dtype> data(shape);
+      shape.resize(2);
+      shape[1] = 1;
+      Blob<Dtype> label(shape);
+      for (int r = 0; r < rows[f]; ++r) {
+        label.mutable_cpu_data()[r] = 100 * f + r;
+        for (int k = 0; k < 6; ++k) {
+          data.mutable_cpu_data()[r * 6 + k] = 10 * (100 * f + r) + k;
+        }
+      }
+      const string name = dir + "/" + format_int(f) + ".h5";
+      hid_t file_id = H5Fcreate(name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+                                H5P_DEFAULT);
+      hdf5_save_nd_dataset(file_id, "data", data);
+      hdf5_save_nd_dataset(file_id, "label", label);
+      H5Fclose(file_id);
+      list_file << name << std::endl;
+    }
+    return list;
+  }
+
+  // Checks that each row of the batch holds the data of its label and
+  // returns the labels.
+  vector<int> StreamLabels(const vector<Blob<Dtype>*>& top) {
+    vector<int> labels;
+    for (int i = 0; i < top[1]->count(); ++i) {
+      const int label = top[1]->cpu_data()[i];
+      for (int k = 0; k < 6; ++k) {
+        EXPECT_EQ(10 * label + k, top[0]->cpu_data()[i * 6 + k]);
+      }
+      labels.push_back(label);
+    }
+    return labels;
+  }
+
   string* filename;
   Blob<Dtype>* const blob_top_data_;
   Blob<Dtype>* const blob_top_label_;
@@ -192,5 +244,67 @@ TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   Caffe::set_solver_rank(0);
 }
 */
+
+TYPED_TEST(HDF5DataLayerTest, TestStreamRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  hdf5_data_param->set_batch_size(4);
+  hdf5_data_param->set_source(this->WriteStreamFiles());
+  hdf5_data_param->set_chunk_rows(3);
+  vector<Blob<Dtype>*> top(this->blob_top_vec_.begin(),
+                           this->blob_top_vec_.begin() + 2);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, top);
+  EXPECT_EQ(4, top[0]->shape(0));
+  EXPECT_EQ(2, top[0]->shape(1));
+  EXPECT_EQ(3, top[0]->shape(2));
+  EXPECT_EQ(4, top[1]->shape(0));
+  EXPECT_EQ(1, top[1]->shape(1));
+  // Rows come in file order across chunks, files and epochs.
+  vector<int> expected;
+  for (int r = 0; r < 7; ++r) expected.push_back(r);
+  for (int r = 0; r < 5; ++r) expected.push_back(100 + r);
+  for (int iter = 0; iter < 6; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, top);
+    vector<int> labels = this->StreamLabels(top);
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(expected[(iter * 4 + i) % 12], labels[i]) << "iter " << iter;
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestStreamShuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  hdf5_data_param->set_batch_size(4);
+  hdf5_data_param->set_source(this->WriteStreamFiles());
+  hdf5_data_param->set_chunk_rows(3);
+  hdf5_data_param->set_shuffle(true);
+  vector<Blob<Dtype>*> top(this->blob_top_vec_.begin(),
+                           this->blob_top_vec_.begin() + 2);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, top);
+  vector<int> expected;
+  for (int r = 0; r < 7; ++r) expected.push_back(r);
+  for (int r = 0; r < 5; ++r) expected.push_back(100 + r);
+  // Every epoch of 3 batches holds each row once.
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    vector<int> labels;
+    for (int iter = 0; iter < 3; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, top);
+      vector<int> batch = this->StreamLabels(top);
+      labels.insert(labels.end(), batch.begin(), batch.end());
+    }
+    std::sort(labels.begin(), labels.end());
+    EXPECT_EQ(expected, labels) << "epoch " << epoch;
+  }
+}
+
 }  // namespace caffe
 #endif
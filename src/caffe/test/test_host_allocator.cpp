@@ -0,0 +1,189 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <boost/thread.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+  protected:
+  // Pooled blocks may be left in the caches by earlier tests, so these only
+  // look at counter deltas.
+  uint64_t system_allocations() {
+    return HostAllocator::stats().system_allocations;
+  }
+};
+
+TEST_F(HostAllocatorTest, TestSizeClass) {
+  size_t class_size;
+  EXPECT_EQ(PooledHostAllocator::SizeClass(0, &class_size), 0);
+  EXPECT_EQ(class_size, 64);
+  EXPECT_EQ(PooledHostAllocator::SizeClass(65, &class_size), 1);
+  EXPECT_EQ(class_size, 128);
+  EXPECT_EQ(PooledHostAllocator::SizeClass(1024, &class_size), 15);
+  EXPECT_EQ(class_size, 1024);
+  EXPECT_EQ(PooledHostAllocator::SizeClass(1025, &class_size), 16);
+  EXPECT_EQ(class_size, 1280);
+  EXPECT_EQ(PooledHostAllocator::SizeClass(2048, &class_size), 19);
+  EXPECT_EQ(class_size, 2048);
+  EXPECT_EQ(PooledHostAllocator::SizeClass(1 << 28, &class_size),
+            PooledHostAllocator::kNumClasses - 1);
+  EXPECT_EQ(class_size, 1 << 28);
+  EXPECT_EQ(PooledHostAllocator::SizeClass((1 << 28) + 1, &class_size), -1);
+  // Classes never waste more than a quarter of the request.
+  for (size_t size = 1025; size < (1 << 20); size = size * 5 / 4 + 7) {
+    PooledHostAllocator::SizeClass(size, &class_size);
+    EXPECT_GE(class_size, size);
+    EXPECT_LE(class_size, size + size / 4);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  SystemHostAllocator system;
+  PooledHostAllocator pooled;
+  for (size_t size = 1; size < (1 << 16); size = size * 3 + 1) {
+    void* a = system.Allocate(size);
+    void* b = pooled.Allocate(size);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % HostAllocator::kAlignment, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % HostAllocator::kAlignment, 0);
+    system.Free(a);
+    pooled.Free(b);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  PooledHostAllocator pooled;
+  void* a = pooled.Allocate(3000);
+  pooled.Free(a);
+  const uint64_t before = system_allocations();
+  pooled.Free(pooled.Allocate(3000));
+  EXPECT_EQ(system_allocations(), before);
+  pooled.Release();
+  EXPECT_EQ(HostAllocator::stats().bytes_cached, 0);
+}
+
+static void* AllocateOnThread(PooledHostAllocator* pooled, size_t size) {
+  void* ptr = NULL;
+  boost::thread thread([&]() { ptr = pooled->Allocate(size); });
+  thread.join();
+  return ptr;
+}
+
+TEST_F(HostAllocatorTest, TestCrossThread) {
+  PooledHostAllocator pooled;
+  // A block freed by another thread than the allocating one is reused.
+  void* a = AllocateOnThread(&pooled, 5000);
+  pooled.Free(a);
+  uint64_t before = system_allocations();
+  pooled.Free(pooled.Allocate(5000));
+  EXPECT_EQ(system_allocations(), before);
+  // Blocks cached by an exiting thread move to the global pool.
+  boost::thread thread([&]() { pooled.Free(pooled.Allocate(7000)); });
+  thread.join();
+  before = system_allocations();
+  pooled.Free(AllocateOnThread(&pooled, 7000));
+  EXPECT_EQ(system_allocations(), before);
+  pooled.Release();
+}
+
+TEST_F(HostAllocatorTest, TestSeparatePools) {
+  PooledHostAllocator small_pages(false);
+  PooledHostAllocator huge_pages(true);
+  // A block freed through one allocator is only reused by the one that
+  // made it, whichever allocator frees it.
+  void* a = huge_pages.Allocate(3 << 20);
+  small_pages.Free(a);
+  uint64_t before = system_allocations();
+  void* b = small_pages.Allocate(3 << 20);
+  EXPECT_EQ(system_allocations(), before + 1);
+  void* c = huge_pages.Allocate(3 << 20);
+  EXPECT_EQ(system_allocations(), before + 1);
+  EXPECT_EQ(a, c);
+  small_pages.Free(b);
+  huge_pages.Free(c);
+  small_pages.Release();
+  huge_pages.Release();
+}
+
+// Not built in, so it only takes over while no block is alive.
+class CountingHostAllocator : public SystemHostAllocator {
+  public:
+  virtual const char* type() const { return "counting"; }
+};
+
+TEST_F(HostAllocatorTest, TestSetWithLiveBlocks) {
+  // Built-in allocators can switch with blocks alive.
+  void* a = HostAllocator::Get()->Allocate(100);
+  EXPECT_TRUE(Caffe::set_host_allocator("pooled"));
+  HostAllocator::Get()->Free(a);
+  a = HostAllocator::Get()->Allocate(100);
+  EXPECT_TRUE(Caffe::set_host_allocator("system"));
+  // Any other one is refused while they are.
+  static CountingHostAllocator counting;
+  EXPECT_FALSE(HostAllocator::Set(&counting));
+  EXPECT_STREQ("system", HostAllocator::Get()->type());
+  HostAllocator::Get()->Free(a);
+  Caffe::set_host_allocator("pooled");
+  Caffe::release_host_cache();
+  Caffe::set_host_allocator("system");
+}
+
+TEST_F(HostAllocatorTest, TestSteadyState) {
+  Caffe::set_host_allocator("pooled");
+  vector<int> shape(4, 3);
+  for (int i = 0; i < 2; ++i) {
+    const uint64_t before = system_allocations();
+    {
+      Blob<float> a(shape), b(shape);
+      a.mutable_cpu_data();
+      b.mutable_cpu_diff();
+    }
+    // The first pass may fill the pool, the second must be served by it.
+    if (i > 0) {
+      EXPECT_EQ(system_allocations(), before);
+    }
+  }
+  HostAllocStats stats = Caffe::host_alloc_stats();
+  EXPECT_EQ(stats.allocations, stats.frees);
+  Caffe::release_host_cache();
+  Caffe::set_host_allocator("system");
+}
+
+}  // namespace caffe
@@ -0,0 +1,168 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/image_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Every test image is 4 x 5 x 3, with all pixels equal.
+const int kRows = 4;
+const int kCols = 5;
+const int kChannels = 3;
+const uint64_t kSize = kRows * kCols * kChannels;
+
+class ImageCacheTest : public ::testing::Test {
+  protected:
+  void Insert(ImageCache* cache, const string& key, uint8_t value) {
+    vector<uint8_t> pixels(kSize, value);
+    cache->Insert(key, kRows, kCols, kChannels, pixels.data());
+  }
+
+  void ExpectImage(ImageCache* cache, const string& key, uint8_t value) {
+    CachedImage image;
+    ASSERT_TRUE(cache->Lookup(key, &image)) << key;
+    EXPECT_EQ(kRows, image.rows);
+    EXPECT_EQ(kCols, image.cols);
+    EXPECT_EQ(kChannels, image.channels);
+    for (uint64_t i = 0; i < kSize; ++i) {
+      ASSERT_EQ(value, image.data[i]) << key << " " << i;
+    }
+  }
+};
+
+TEST_F(ImageCacheTest, TestKey) {
+  EXPECT_EQ(ImageCache::Key("a.jpg", 0, 0, true),
+            ImageCache::Key("a.jpg", 0, 0, true));
+  EXPECT_NE(ImageCache::Key("a.jpg", 0, 0, true),
+            ImageCache::Key("a.jpg", 0, 0, false));
+  EXPECT_NE(ImageCache::Key("a.jpg", 32, 32, true),
+            ImageCache::Key("a.jpg", 0, 0, true));
+  EXPECT_NE(ImageCache::Key("a1", 2, 3, true),
+            ImageCache::Key("a", 12, 3, true));
+}
+
+TEST_F(ImageCacheTest, TestLookup) {
+  ImageCache cache(10 * kSize);
+  CachedImage image;
+  EXPECT_FALSE(cache.Lookup("a", &image));
+  Insert(&cache, "a", 1);
+  ExpectImage(&cache, "a", 1);
+  // Inserting a cached key keeps the first pixels.
+  Insert(&cache, "a", 2);
+  ExpectImage(&cache, "a", 1);
+  ImageCacheStats stats = cache.stats();
+  EXPECT_EQ(2, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(kSize, stats.bytes_in_memory);
+  EXPECT_NEAR(2. / 3, stats.hit_rate(), 1e-9);
+}
+
+TEST_F(ImageCacheTest, TestEvictLeastRecentlyUsed) {
+  ImageCache cache(2 * kSize);
+  Insert(&cache, "a", 1);
+  Insert(&cache, "b", 2);
+  ExpectImage(&cache, "a", 1);
+  // b is now the least recently used and makes room for c.
+  Insert(&cache, "c", 3);
+  CachedImage image;
+  EXPECT_FALSE(cache.Lookup("b", &image));
+  ExpectImage(&cache, "a", 1);
+  ExpectImage(&cache, "c", 3);
+  ImageCacheStats stats = cache.stats();
+  EXPECT_EQ(1, stats.evictions);
+  EXPECT_EQ(0, stats.spills);
+  EXPECT_EQ(2 * kSize, stats.bytes_in_memory);
+}
+
+TEST_F(ImageCacheTest, TestHolderOutlivesEviction) {
+  ImageCache cache(kSize);
+  Insert(&cache, "a", 1);
+  CachedImage image;
+  ASSERT_TRUE(cache.Lookup("a", &image));
+  Insert(&cache, "b", 2);
+  cache.Clear();
+  for (uint64_t i = 0; i < kSize; ++i) {
+    ASSERT_EQ(1, image.data[i]);
+  }
+}
+
+TEST_F(ImageCacheTest, TestSpill) {
+  string filename;
+  MakeTempFilename(&filename);
+  // Room for one image in memory and two in the spill file.
+  ImageCache cache(kSize, filename, 2 * kSize);
+  Insert(&cache, "a", 1);
+  Insert(&cache, "b", 2);
+  Insert(&cache, "c", 3);
+  // Full spill file, d is dropped when evicted.
+  Insert(&cache, "d", 4);
+  ExpectImage(&cache, "a", 1);
+  ExpectImage(&cache, "b", 2);
+  ExpectImage(&cache, "d", 4);
+  CachedImage image;
+  EXPECT_FALSE(cache.Lookup("c", &image));
+  ImageCacheStats stats = cache.stats();
+  EXPECT_EQ(3, stats.hits);
+  EXPECT_EQ(2, stats.spill_hits);
+  EXPECT_EQ(2, stats.spills);
+  EXPECT_EQ(3, stats.evictions);
+  EXPECT_EQ(2 * kSize, stats.bytes_spilled);
+  EXPECT_EQ(kSize, stats.bytes_in_memory);
+}
+
+TEST_F(ImageCacheTest, TestConfigure) {
+  ImageCache cache;
+  CachedImage image;
+  Insert(&cache, "a", 1);
+  EXPECT_FALSE(cache.Lookup("a", &image));
+  ImageCacheParameter param;
+  EXPECT_FALSE(ImageCache::Enabled(param));
+  param.set_memory_bytes(2 * kSize);
+  EXPECT_TRUE(ImageCache::Enabled(param));
+  cache.Configure(param);
+  // A smaller bound requested later keeps the larger one.
+  param.set_memory_bytes(kSize);
+  cache.Configure(param);
+  EXPECT_EQ(2 * kSize, cache.memory_bytes());
+  Insert(&cache, "a", 1);
+  Insert(&cache, "b", 2);
+  ExpectImage(&cache, "a", 1);
+  ExpectImage(&cache, "b", 2);
+}
+
+}  // namespace caffe
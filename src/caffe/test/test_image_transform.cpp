@@ -0,0 +1,234 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/image_transform.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ImageTransformTest : public ::testing::Test {
+  protected:
+  // An image of channels x height x width pixels in the layout of
+  // interleaved, and a mean of the same size.
+  void Init(const int channels, const int height, const int width,
+            const bool interleaved) {
+    channels_ = channels;
+    height_ = height;
+    width_ = width;
+    interleaved_ = interleaved;
+    image_.resize(channels * height * width);
+    mean_.resize(image_.size());
+    mean_values_.resize(channels);
+    for (int i = 0; i < image_.size(); ++i) {
+      image_[i] = (i * 37 + 11) % 256;
+      mean_[i] = Dtype((i * 13) % 255) / 3;
+    }
+    for (int c = 0; c < channels; ++c) {
+      mean_values_[c] = Dtype(100 + 7 * c) / 3;
+    }
+  }
+
+  ImageTransform<Dtype> Window(const int h_off, const int w_off,
+      const int rows, const int cols, const bool mean, const bool values,
+      const bool mirror, const bool mean_at_dst = false) {
+    ImageTransform<Dtype> t;
+    t.interleaved = interleaved_;
+    t.channels = channels_;
+    t.rows = rows;
+    t.cols = cols;
+    if (interleaved_) {
+      t.src = &image_[(h_off * width_ + w_off) * channels_];
+      t.row_step = width_ * channels_;
+      t.plane_step = 0;
+    } else {
+      t.src = &image_[h_off * width_ + w_off];
+      t.row_step = width_;
+      t.plane_step = height_ * width_;
+    }
+    t.mean = mean ? &mean_[h_off * width_ + w_off] : NULL;
+    t.mean_row_step = width_;
+    t.mean_plane_step = height_ * width_;
+    t.mean_values = values ? &mean_values_[0] : NULL;
+    t.scale = Dtype(0.017);
+    t.mirror = mirror;
+    t.mean_at_dst = mean_at_dst;
+    return t;
+  }
+
+  // The per pixel loop DataTransformer ran before.
+  void Reference(const ImageTransform<Dtype>& t, Dtype* dst) {
+    for (int h = 0; h < t.rows; ++h) {
+      for (int w = 0; w < t.cols; ++w) {
+        const int w_idx = t.mirror ? t.cols - 1 - w : w;
+        for (int c = 0; c < t.channels; ++c) {
+          const int src_index = t.interleaved ?
+              h * t.row_step + w * t.channels + c :
+              c * t.plane_step + h * t.row_step + w;
+          const Dtype pixel = static_cast<Dtype>(t.src[src_index]);
+          Dtype* top = dst + (c * t.rows + h) * t.cols + w_idx;
+          if (t.mean) {
+            const int mean_w = t.mean_at_dst ? w_idx : w;
+            *top = (pixel - t.mean[c * t.mean_plane_step +
+                                   h * t.mean_row_step + mean_w]) * t.scale;
+          } else if (t.mean_values) {
+            *top = (pixel - t.mean_values[c]) * t.scale;
+          } else {
+            *top = pixel * t.scale;
+          }
+        }
+      }
+    }
+  }
+
+  void TestAll() {
+    for (int mirror = 0; mirror < 2; ++mirror) {
+      // No mean, mean file at the source or destination column, values.
+      for (int mean = 0; mean < 4; ++mean) {
+        const int rows = height_ - 3;
+        const int cols = width_ - 5;
+        ImageTransform<Dtype> t = Window(1, 2, rows, cols,
+            mean == 1 || mean == 2, mean == 3, mirror, mean == 2);
+        vector<Dtype> expected(channels_ * rows * cols);
+        vector<Dtype> result(expected.size(), Dtype(-1));
+        Reference(t, &expected[0]);
+        caffe_cpu_transform_image(t, &result[0]);
+        for (int i = 0; i < expected.size(); ++i) {
+          // The same bits, not merely close.
+          ASSERT_EQ(expected[i], result[i]) << "mirror " << mirror
+              << " mean " << mean << " at " << i;
+        }
+      }
+    }
+  }
+
+  int channels_;
+  int height_;
+  int width_;
+  bool interleaved_;
+  vector<uint8_t> image_;
+  vector<Dtype> mean_;
+  vector<Dtype> mean_values_;
+};
+
+TYPED_TEST_CASE(ImageTransformTest, TestDtypes);
+
+TYPED_TEST(ImageTransformTest, TestPlanar) {
+  for (int channels = 1; channels <= 3; channels += 2) {
+    this->Init(channels, 9, 37, false);
+    this->TestAll();
+  }
+}
+
+TYPED_TEST(ImageTransformTest, TestInterleaved) {
+  for (int channels = 1; channels <= 4; ++channels) {
+    this->Init(channels, 9, 37, true);
+    this->TestAll();
+  }
+}
+
+TYPED_TEST(ImageTransformTest, TestNarrow) {
+  // Rows shorter than a vector
+  this->Init(3, 6, 13, true);
+  this->TestAll();
+  this->Init(3, 6, 13, false);
+  this->TestAll();
+}
+
+TYPED_TEST(ImageTransformTest, TestMatMirrorMeanFile) {
+  typedef TypeParam Dtype;
+  // The interleaved loop DataTransformer ran on a cv::Mat crop before, which
+  // subtracts the mean at the mirrored column.
+  for (int channels = 1; channels <= 4; ++channels) {
+    this->Init(channels, 9, 37, true);
+    const int img_height = this->height_;
+    const int img_width = this->width_;
+    const int h_off = 1;
+    const int w_off = 2;
+    const int height = img_height - 3;
+    const int width = img_width - 5;
+    const Dtype scale = Dtype(0.017);
+    const Dtype* mean = &this->mean_[0];
+    vector<Dtype> expected(channels * height * width);
+    for (int h = 0; h < height; ++h) {
+      const uint8_t* ptr =
+          &this->image_[((h_off + h) * img_width + w_off) * channels];
+      int img_index = 0;
+      for (int w = 0; w < width; ++w) {
+        const int w_idx = width - 1 - w;
+        for (int c = 0; c < channels; ++c) {
+          const int top_index = (c * height + h) * width + w_idx;
+          const Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
+          const int mean_index = (c * img_height + h_off + h) * img_width +
+                                 w_off + w_idx;
+          expected[top_index] = (pixel - mean[mean_index]) * scale;
+        }
+      }
+    }
+    ImageTransform<Dtype> t = this->Window(h_off, w_off, height, width, true,
+                                           false, true, true);
+    vector<Dtype> result(expected.size(), Dtype(-1));
+    caffe_cpu_transform_image(t, &result[0]);
+    EXPECT_EQ(expected, result) << channels << " channels";
+  }
+}
+
+TYPED_TEST(ImageTransformTest, TestBenchmark) {
+  typedef TypeParam Dtype;
+  // A 224 x 224 random crop of a 256 x 256 color image; timings are logged,
+  // not checked.
+  this->Init(3, 256, 256, true);
+  ImageTransform<Dtype> t = this->Window(13, 21, 224, 224, false, true, true);
+  vector<Dtype> expected(3 * 224 * 224);
+  vector<Dtype> result(expected.size());
+  const int iterations = 50;
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < iterations; ++i) {
+    this->Reference(t, &expected[0]);
+  }
+  const float reference_us = timer.MicroSeconds() / iterations;
+  timer.Start();
+  for (int i = 0; i < iterations; ++i) {
+    caffe_cpu_transform_image(t, &result[0]);
+  }
+  const float kernel_us = timer.MicroSeconds() / iterations;
+  LOG(INFO) << "transform 3x224x224 (" << image_transform_isa() << "): "
+            << kernel_us << " us, per pixel loop: " << reference_us << " us";
+  EXPECT_EQ(expected, result);
+}
+
+}  // namespace caffe
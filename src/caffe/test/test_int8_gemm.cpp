@@ -0,0 +1,298 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/conv_depthwise_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The position generate_quantized_pt would pick for values up to absmax.
+static int Int8Position(const float absmax) {
+  return static_cast<int>(std::ceil(std::log2(absmax / 127)));
+}
+
+template <typename Dtype>
+static float AbsMax(const Blob<Dtype>& blob) {
+  float absmax = 0;
+  for (int i = 0; i < blob.count(); ++i) {
+    absmax = std::max(absmax,
+                      static_cast<float>(std::fabs(blob.cpu_data()[i])));
+  }
+  return absmax;
+}
+
+// Rounds the values of blob to multiples of step within [-128, 127] steps,
+// so that a float forward computes what the int8 one does.
+template <typename Dtype>
+static void FakeQuantize(const float step, Blob<Dtype>* blob) {
+  Dtype* data = blob->mutable_cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    const float q = std::nearbyint(data[i] / step);
+    data[i] = std::min(127.f, std::max(-128.f, q)) * step;
+  }
+}
+
+TEST(Int8GemmTest, TestQuantize) {
+  const float x[] = {0.f, 0.4f, 0.5f, 1.5f, -2.5f, 126.6f, 300.f, -300.f};
+  const int8_t expected[] = {0, 0, 0, 2, -2, 127, 127, -128};
+  int8_t q[8];
+  int8_quantize(8, x, 1.f, q);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(expected[i], q[i]) << i;
+  }
+}
+
+TEST(Int8GemmTest, TestStep) {
+  BlobDataType dtype;
+  dtype.set_type(DT_INT8);
+  dtype.add_position(-3);
+  EXPECT_EQ(0.125f, Int8Step(dtype));
+  EXPECT_EQ(0.125f, Int8Step(dtype, 5));
+  dtype.add_position(1);
+  dtype.add_scale(2.f);
+  EXPECT_EQ(0.0625f, Int8Step(dtype, 0));
+  EXPECT_EQ(1.f, Int8Step(dtype, 1));
+}
+
+TEST(Int8GemmTest, TestGemm) {
+  Caffe::set_random_seed(1701);
+  // Odd sizes cover the tails of the tiles and of the 32 byte rows.
+  const int sizes[][3] = {{1, 1, 1}, {7, 5, 33}, {70, 67, 100}, {5, 130, 9}};
+  for (int t = 0; t < 4; ++t) {
+    const int rows = sizes[t][0], n = sizes[t][1], k = sizes[t][2];
+    vector<float> w(rows * k), x(n * k), bias(rows), y(rows * n);
+    caffe_rng_uniform(rows * k, -1.f, 1.f, &w[0]);
+    caffe_rng_uniform(n * k, -1.f, 1.f, &x[0]);
+    caffe_rng_uniform(rows, -1.f, 1.f, &bias[0]);
+    BlobDataType dtype;
+    dtype.set_type(DT_INT8);
+    dtype.add_position(-7);
+    Int8Weights packed;
+    int8_pack_weights(&w[0], rows, k, k, 1, dtype, &packed);
+    EXPECT_EQ(0, packed.stride % 32);
+    // x is stored transposed, k x n, as a convolution column buffer.
+    vector<float> xt(k * n);
+    for (int j = 0; j < n; ++j) {
+      for (int c = 0; c < k; ++c) {
+        xt[c * n + j] = x[j * k + c];
+      }
+    }
+    const float x_step = 1.f / 64;
+    vector<uint8_t> qx(n * packed.stride);
+    int8_quantize_rows(&xt[0], n, k, 1, n, x_step, packed.stride, &qx[0]);
+    int8_gemm(packed, 0, rows, &qx[0], n, x_step, &bias[0], &y[0], n, 1);
+    vector<int8_t> qw(k), qxr(k);
+    for (int r = 0; r < rows; ++r) {
+      int8_quantize(k, &w[r * k], 1.f / 128, &qw[0]);
+      for (int j = 0; j < n; ++j) {
+        int8_quantize(k, &x[j * k], x_step, &qxr[0]);
+        int32_t sum = 0;
+        for (int c = 0; c < k; ++c) {
+          sum += qw[c] * qxr[c];
+        }
+        const float expected = sum / 128.f * x_step + bias[r];
+        EXPECT_NEAR(expected, y[r * n + j], 1e-5 * (1 + std::fabs(expected)))
+            << "rows " << rows << " n " << n << " k " << k;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class Int8LayerTest : public CPUDeviceTest<Dtype> {
+  protected:
+  Int8LayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 9, 7)),
+        blob_top_(new Blob<Dtype>()),
+        ref_bottom_(new Blob<Dtype>()),
+        ref_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    filler_param.set_min(-2);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ref_bottom_vec_.push_back(ref_bottom_);
+    ref_top_vec_.push_back(ref_top_);
+  }
+  virtual ~Int8LayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete ref_bottom_;
+    delete ref_top_;
+  }
+
+  // Runs param in int8 and in float on fake quantized weights and input, and
+  // checks that both agree. per_channel gives each output its own position.
+  template <typename LayerType>
+  void TestInt8(LayerParameter param, const bool per_channel) {
+    const int x_position = Int8Position(AbsMax(*blob_bottom_));
+    const float x_step = std::ldexp(1.f, x_position);
+    param.set_cpu_int8(true);
+    param.add_bottom_mlu_dtype()->add_position(x_position);
+    LayerType ref_layer(param);
+    ref_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype>* weights = ref_layer.blobs()[0].get();
+    BlobDataType* dtype = param.add_blobs_dtype();
+    dtype->set_type(DT_INT8);
+    const int outputs = per_channel ? weights->shape(0) : 1;
+    const int dim = weights->count() / outputs;
+    for (int c = 0; c < outputs; ++c) {
+      // Channels of different magnitudes.
+      Dtype* w = weights->mutable_cpu_data() + c * dim;
+      caffe_scal(dim, Dtype(1 + c % 3), w);
+      float absmax = 0;
+      for (int i = 0; i < dim; ++i) {
+        absmax = std::max(absmax, static_cast<float>(std::fabs(w[i])));
+      }
+      dtype->add_position(Int8Position(absmax));
+      Blob<Dtype> channel(1, 1, 1, dim);
+      caffe_copy(dim, w, channel.mutable_cpu_data());
+      FakeQuantize(std::ldexp(1.f, dtype->position(c)), &channel);
+      caffe_copy(dim, channel.cpu_data(), w);
+    }
+    LayerType layer(param);
+    layer.blobs() = ref_layer.blobs();
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_TRUE(UseCpuInt8(layer.layer_param()));
+    ref_bottom_->CopyFrom(*blob_bottom_, false, true);
+    FakeQuantize(x_step, ref_bottom_);
+    // The second round negates the weights, which keeps them on the same
+    // grid, to check that the packed copy follows them.
+    for (int round = 0; round < 2; ++round) {
+      if (round > 0) {
+        caffe_scal(weights->count(), Dtype(-1), weights->mutable_cpu_data());
+      }
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      ref_layer.Forward(ref_bottom_vec_, ref_top_vec_);
+      ASSERT_EQ(ref_top_->shape(), blob_top_->shape());
+      const float absmax = AbsMax(*ref_top_);
+      EXPECT_GT(absmax, 0);
+      for (int i = 0; i < ref_top_->count(); ++i) {
+        EXPECT_NEAR(ref_top_->cpu_data()[i], blob_top_->cpu_data()[i],
+                    1e-5 * absmax);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const ref_bottom_;
+  Blob<Dtype>* const ref_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> ref_bottom_vec_;
+  vector<Blob<Dtype>*> ref_top_vec_;
+};
+
+TYPED_TEST_CASE(Int8LayerTest, TestDtypes);
+
+static LayerParameter ConvParam(const int num_output, const int kernel,
+                                const int group) {
+  LayerParameter param;
+  ConvolutionParameter* conv = param.mutable_convolution_param();
+  conv->set_num_output(num_output);
+  conv->add_kernel_size(kernel);
+  conv->add_pad(kernel / 2);
+  conv->set_group(group);
+  conv->mutable_weight_filler()->set_type("gaussian");
+  conv->mutable_bias_filler()->set_type("uniform");
+  conv->mutable_bias_filler()->set_min(-1);
+  conv->mutable_bias_filler()->set_max(1);
+  return param;
+}
+
+TYPED_TEST(Int8LayerTest, TestConvolution) {
+  this->template TestInt8<ConvolutionLayer<TypeParam> >(
+      ConvParam(6, 3, 1), false);
+}
+
+TYPED_TEST(Int8LayerTest, TestConvolutionPerChannel) {
+  this->template TestInt8<ConvolutionLayer<TypeParam> >(
+      ConvParam(6, 3, 1), true);
+}
+
+TYPED_TEST(Int8LayerTest, TestConvolution1x1Group) {
+  this->template TestInt8<ConvolutionLayer<TypeParam> >(
+      ConvParam(6, 1, 2), true);
+}
+
+TYPED_TEST(Int8LayerTest, TestWinograd1x1) {
+  // The WINOGRAD engine would otherwise take its float 1x1 path.
+  LayerParameter param = ConvParam(6, 1, 1);
+  param.mutable_convolution_param()->set_engine(
+      ConvolutionParameter_Engine_WINOGRAD);
+  this->template TestInt8<WinogradConvolutionLayer<TypeParam> >(param, true);
+}
+
+TYPED_TEST(Int8LayerTest, TestDepthwise) {
+  LayerParameter param = ConvParam(8, 3, 4);
+  param.set_type("ConvolutionDepthwise");
+  this->template TestInt8<ConvolutionDepthwiseLayer<TypeParam> >(param, true);
+}
+
+TYPED_TEST(Int8LayerTest, TestInnerProduct) {
+  LayerParameter param;
+  InnerProductParameter* ip = param.mutable_inner_product_param();
+  ip->set_num_output(10);
+  ip->mutable_weight_filler()->set_type("gaussian");
+  ip->mutable_weight_filler()->set_std(0.1);
+  ip->mutable_bias_filler()->set_type("uniform");
+  this->template TestInt8<InnerProductLayer<TypeParam> >(param, true);
+}
+
+TYPED_TEST(Int8LayerTest, TestInnerProductTranspose) {
+  LayerParameter param;
+  InnerProductParameter* ip = param.mutable_inner_product_param();
+  ip->set_num_output(10);
+  ip->set_transpose(true);
+  ip->mutable_weight_filler()->set_type("gaussian");
+  ip->mutable_weight_filler()->set_std(0.1);
+  this->template TestInt8<InnerProductLayer<TypeParam> >(param, false);
+}
+
+}  // namespace caffe
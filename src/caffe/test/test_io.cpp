@@ -449,5 +449,44 @@ TEST_F(IOTest, TestDecodeDatumToCVMatContentNative) {
   }
 }
 
+TEST_F(IOTest, TestParseDatumInPlace) {
+  Datum datum;
+  datum.set_channels(3);
+  datum.set_height(2);
+  datum.set_width(2);
+  datum.set_label(7);
+  const string pixels("abcdefghijkl");
+  datum.set_data(pixels);
+  datum.add_float_data(1.5);
+  string record;
+  ASSERT_TRUE(datum.SerializeToString(&record));
+
+  Datum parsed;
+  const char* data;
+  size_t size;
+  ASSERT_TRUE(ParseDatumInPlace(record.data(), record.size(), &parsed, &data,
+                                &size));
+  EXPECT_EQ(3, parsed.channels());
+  EXPECT_EQ(2, parsed.height());
+  EXPECT_EQ(2, parsed.width());
+  EXPECT_EQ(7, parsed.label());
+  ASSERT_EQ(1, parsed.float_data_size());
+  EXPECT_EQ(1.5, parsed.float_data(0));
+  EXPECT_TRUE(parsed.data().empty());
+  // The values are left in the record
+  EXPECT_GE(data, record.data());
+  EXPECT_LE(data + size, record.data() + record.size());
+  EXPECT_EQ(pixels, string(data, size));
+
+  datum.clear_data();
+  ASSERT_TRUE(datum.SerializeToString(&record));
+  ASSERT_TRUE(ParseDatumInPlace(record.data(), record.size(), &parsed, &data,
+                                &size));
+  EXPECT_TRUE(data == NULL);
+  EXPECT_EQ(7, parsed.label());
+  EXPECT_FALSE(ParseDatumInPlace(record.data(), record.size() - 1, &parsed,
+                                 &data, &size));
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -0,0 +1,183 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static const char* kMappedNet =
+    "name: 'MappedNet' "
+    "state { phase: TEST } "
+    "layer { "
+    "  name: 'data' type: 'Input' top: 'data' "
+    "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+    "} "
+    "layer { "
+    "  name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+    "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+    "    weight_filler { type: 'gaussian' std: 0.3 } "
+    "    bias_filler { type: 'gaussian' std: 0.1 } } "
+    "} "
+    "layer { name: 'scale' type: 'Scale' bottom: 'conv' top: 'conv' "
+    "  scale_param { bias_term: true "
+    "    filler { type: 'uniform' min: 0.5 max: 1.5 } "
+    "    bias_filler { type: 'uniform' min: -0.5 max: 0.5 } } } "
+    "layer { "
+    "  name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+    "  inner_product_param { num_output: 3 "
+    "    weight_filler { type: 'gaussian' std: 0.1 } "
+    "    bias_filler { type: 'gaussian' std: 0.1 } } "
+    "} ";
+
+template <typename Dtype>
+class MappedWeightsTest : public ::testing::Test {
+  protected:
+  MappedWeightsTest() {
+    Caffe::set_mode(Caffe::CPU);
+    MakeTempFilename(&filename_);
+  }
+
+  shared_ptr<Net<Dtype> > InitNet(int opt_level, int seed) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(kMappedNet, &param));
+    param.set_opt_level(opt_level);
+    Caffe::set_random_seed(seed);
+    shared_ptr<Net<Dtype> > net(new Net<Dtype>(param));
+    Blob<Dtype>* data = net->input_blobs()[0];
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = Dtype(i % 7) / 7 - 0.5;
+    }
+    return net;
+  }
+
+  void ExpectSameOutput(Net<Dtype>* expected, Net<Dtype>* result) {
+    expected->Forward();
+    result->Forward();
+    const Blob<Dtype>* x = expected->output_blobs()[0];
+    const Blob<Dtype>* y = result->output_blobs()[0];
+    ASSERT_EQ(x->count(), y->count());
+    for (int i = 0; i < x->count(); ++i) {
+      EXPECT_NEAR(x->cpu_data()[i], y->cpu_data()[i], 1e-4);
+    }
+  }
+
+  string filename_;
+};
+
+TYPED_TEST_CASE(MappedWeightsTest, TestDtypes);
+
+TYPED_TEST(MappedWeightsTest, TestIndex) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > net = this->InitNet(0, 1701);
+  NetParameter weights;
+  net->ToProto(&weights);
+  WriteMappedWeights(weights, this->filename_);
+  EXPECT_TRUE(IsMappedWeightsFile(this->filename_));
+  MappedWeights mapped(this->filename_);
+  // conv, scale and ip have two blobs each
+  ASSERT_EQ(6, mapped.index().tensor_size());
+  for (int i = 0; i < mapped.index().tensor_size(); ++i) {
+    const MappedWeightsIndex::Tensor& tensor = mapped.index().tensor(i);
+    const Blob<Dtype>* blob =
+        net->layer_by_name(tensor.layer())->blobs()[tensor.blob()].get();
+    ASSERT_EQ(blob->num_axes(), tensor.shape().dim_size());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(mapped.data(tensor)) % 64);
+    for (int j = 0; j < blob->count(); ++j) {
+      EXPECT_EQ(static_cast<float>(blob->cpu_data()[j]),
+                mapped.data(tensor)[j]);
+    }
+  }
+}
+
+TYPED_TEST(MappedWeightsTest, TestCopyTrainedLayers) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > reference = this->InitNet(0, 1701);
+  NetParameter weights;
+  reference->ToProto(&weights);
+  WriteMappedWeights(weights, this->filename_);
+  for (int opt_level = 0; opt_level <= 1; ++opt_level) {
+    shared_ptr<Net<Dtype> > net = this->InitNet(opt_level, 1702);
+    net->CopyTrainedLayersFrom(this->filename_);
+    if (sizeof(Dtype) == sizeof(float)) {
+      // float weights are used in place, nothing was copied
+      ASSERT_EQ(1, net->mapped_weights().size());
+      const MappedWeights& mapped = *net->mapped_weights()[0];
+      for (int i = 0; i < net->params().size(); ++i) {
+        EXPECT_TRUE(mapped.Contains(net->params()[i]->cpu_data())) << i;
+      }
+    }
+    this->ExpectSameOutput(reference.get(), net.get());
+  }
+}
+
+TYPED_TEST(MappedWeightsTest, TestShareTrainedLayers) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > reference = this->InitNet(0, 1701);
+  NetParameter weights;
+  reference->ToProto(&weights);
+  WriteMappedWeights(weights, this->filename_);
+  shared_ptr<Net<Dtype> > net = this->InitNet(0, 1702);
+  net->CopyTrainedLayersFrom(this->filename_);
+  shared_ptr<Net<Dtype> > shared = this->InitNet(0, 1703);
+  shared->ShareTrainedLayersWith(net.get());
+  // The mapping stays alive with the net sharing the weights.
+  net.reset();
+  this->ExpectSameOutput(reference.get(), shared.get());
+}
+
+TYPED_TEST(MappedWeightsTest, TestCopyOnWrite) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > reference = this->InitNet(0, 1701);
+  NetParameter weights;
+  reference->ToProto(&weights);
+  WriteMappedWeights(weights, this->filename_);
+  shared_ptr<Net<Dtype> > written = this->InitNet(0, 1702);
+  written->CopyTrainedLayersFrom(this->filename_);
+  Blob<Dtype>* blob = written->layer_by_name("ip")->blobs()[0].get();
+  caffe_set(blob->count(), Dtype(0), blob->mutable_cpu_data());
+  // Writing the weights of one net changes neither the file nor other nets.
+  shared_ptr<Net<Dtype> > net = this->InitNet(0, 1702);
+  net->CopyTrainedLayersFrom(this->filename_);
+  this->ExpectSameOutput(reference.get(), net.get());
+}
+
+}  // namespace caffe
@@ -0,0 +1,227 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/memory_planner.hpp"
+#include "caffe/util/rng.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Two buffers collide when both their lifetimes and their bytes intersect.
+static bool Collide(const MemoryPlanner& plan, int a, int b) {
+  if (plan.last(a) < plan.first(b) || plan.last(b) < plan.first(a)) {
+    return false;
+  }
+  return plan.offset(a) < plan.offset(b) + plan.buffer_size(b) &&
+         plan.offset(b) < plan.offset(a) + plan.buffer_size(a);
+}
+
+TEST(MemoryPlannerTest, TestChain) {
+  // a chain of layers only needs two buffers alive at a time.
+  MemoryPlanner plan;
+  for (int i = 0; i < 8; ++i) {
+    plan.Add(1024, i, i + 1);
+  }
+  plan.Plan();
+  EXPECT_EQ(plan.naive_size(), 8 * 1024);
+  EXPECT_EQ(plan.arena_size(), 2 * 1024);
+  for (int i = 0; i < plan.size(); ++i) {
+    for (int j = i + 1; j < plan.size(); ++j) {
+      EXPECT_FALSE(Collide(plan, i, j)) << i << " " << j;
+    }
+  }
+}
+
+TEST(MemoryPlannerTest, TestAlignment) {
+  MemoryPlanner plan(64);
+  plan.Add(100, 0, 2);
+  plan.Add(10, 1, 2);
+  plan.Add(30, 2, 3);
+  plan.Plan();
+  for (int i = 0; i < plan.size(); ++i) {
+    EXPECT_EQ(plan.offset(i) % 64, 0);
+    for (int j = i + 1; j < plan.size(); ++j) {
+      EXPECT_FALSE(Collide(plan, i, j)) << i << " " << j;
+    }
+  }
+  EXPECT_EQ(plan.arena_size(), 192 + 10);
+}
+
+TEST(MemoryPlannerTest, TestRandom) {
+  MemoryPlanner plan;
+  caffe::rng_t rng(1701);
+  for (int i = 0; i < 200; ++i) {
+    int first = rng() % 100;
+    plan.Add(1 + rng() % 4096, first, first + rng() % 10);
+  }
+  plan.Plan();
+  EXPECT_LE(plan.arena_size(), plan.naive_size());
+  for (int i = 0; i < plan.size(); ++i) {
+    for (int j = i + 1; j < plan.size(); ++j) {
+      EXPECT_FALSE(Collide(plan, i, j)) << i << " " << j;
+    }
+  }
+}
+
+template <typename Dtype>
+class MemoryPlanNetTest : public ::testing::Test {
+  protected:
+  MemoryPlanNetTest() {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  shared_ptr<Net<Dtype> > InitNet(bool plan_memory) {
+    string proto =
+        "name: 'PlanNet' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' "
+        "  inner_product_param { num_output: 16 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } "
+        "} "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'ip1' top: 'ip1' } "
+        "layer { name: 'split' type: 'Split' bottom: 'ip1' "
+        "  top: 'ip1_a' top: 'ip1_b' } "
+        "layer { "
+        "  name: 'ip2' type: 'InnerProduct' bottom: 'ip1_a' top: 'ip2' "
+        "  inner_product_param { num_output: 16 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } "
+        "} "
+        "layer { name: 'sig' type: 'Sigmoid' bottom: 'ip2' top: 'sig' } "
+        "layer { name: 'sig_flat' type: 'Flatten' bottom: 'sig' "
+        "  top: 'sig_flat' } "
+        "layer { "
+        "  name: 'ip3' type: 'InnerProduct' bottom: 'sig_flat' top: 'ip3' "
+        "  inner_product_param { num_output: 16 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } "
+        "} "
+        "layer { name: 'sum' type: 'Eltwise' bottom: 'ip3' bottom: 'ip1_b' "
+        "  top: 'sum' } "
+        "layer { name: 'flat' type: 'Flatten' bottom: 'sum' top: 'flat' } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    param.set_plan_memory(plan_memory);
+    Caffe::set_random_seed(1701);
+    shared_ptr<Net<Dtype> > net(new Net<Dtype>(param));
+    Blob<Dtype>* data = net->input_blobs().size() ?
+        net->input_blobs()[0] : net->blob_by_name("data").get();
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = Dtype(i % 7) / 7 - 0.5;
+    }
+    return net;
+  }
+};
+
+TYPED_TEST_CASE(MemoryPlanNetTest, TestDtypes);
+
+TYPED_TEST(MemoryPlanNetTest, TestForward) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > naive = this->InitNet(false);
+  shared_ptr<Net<Dtype> > planned = this->InitNet(true);
+  EXPECT_FALSE(naive->memory_plan());
+  ASSERT_TRUE(planned->memory_plan());
+  const shared_ptr<MemoryPlanner>& plan = planned->memory_plan();
+  // ip1 (shared in place by relu1 and by the split tops), ip2, sig (shared
+  // by sig_flat) and ip3 are planned, sum is the memory of the output flat.
+  EXPECT_EQ(plan->size(), 4);
+  EXPECT_LT(plan->arena_size(), plan->naive_size());
+
+  // The first pass runs on the plan made before Forward shared any data,
+  // the second one would show stale values from the first.
+  for (int iter = 0; iter < 2; ++iter) {
+    naive->Forward();
+    planned->Forward();
+    const Blob<Dtype>* expected = naive->output_blobs()[0];
+    const Blob<Dtype>* result = planned->output_blobs()[0];
+    ASSERT_EQ(expected->count(), result->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], result->cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(MemoryPlanNetTest, TestReshape) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > naive = this->InitNet(false);
+  shared_ptr<Net<Dtype> > planned = this->InitNet(true);
+  size_t arena_size = planned->memory_plan()->arena_size();
+  for (auto net : {naive, planned}) {
+    Blob<Dtype>* data = net->blob_by_name("data").get();
+    data->Reshape(4, 3, 4, 5);
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = Dtype(i % 5) / 5 - 0.5;
+    }
+  }
+  // grown blobs fall back to their own memory, then get planned again.
+  for (int iter = 0; iter < 2; ++iter) {
+    naive->Forward();
+    planned->Forward();
+    const Blob<Dtype>* expected = naive->output_blobs()[0];
+    const Blob<Dtype>* result = planned->output_blobs()[0];
+    ASSERT_EQ(expected->count(), result->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], result->cpu_data()[i]);
+    }
+    planned->PlanMemory();
+  }
+  EXPECT_GT(planned->memory_plan()->arena_size(), arena_size);
+}
+
+TYPED_TEST(MemoryPlanNetTest, TestReshapeKeepsPlan) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > planned = this->InitNet(true);
+  const MemoryPlanner* plan = planned->memory_plan().get();
+  // Forward reshapes, which only plans again once a buffer grew.
+  planned->Forward();
+  EXPECT_EQ(plan, planned->memory_plan().get());
+  Blob<Dtype>* data = planned->blob_by_name("data").get();
+  data->Reshape(1, 3, 4, 5);
+  planned->Forward();
+  EXPECT_EQ(plan, planned->memory_plan().get());
+  data->Reshape(4, 3, 4, 5);
+  planned->Forward();
+  EXPECT_NE(plan, planned->memory_plan().get());
+}
+
+}  // namespace caffe
@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -593,8 +594,9 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
-  virtual void InitReshapableNet() {
+  virtual void InitReshapableNet(Phase phase = caffe::TRAIN) {
     const string& proto =
+        string(phase == caffe::TEST ? "state { phase: TEST } " : "") +
         "name: 'ReshapableNetwork' "
         "layer { "
         "  name: 'data' "
@@ -2475,6 +2477,155 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestBindBlob) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  Caffe::set_mode(Caffe::CPU);
+  this->InitReshapableNet();
+  shared_ptr<Blob<Dtype> > input_blob = this->net_->blob_by_name("data");
+  Blob<Dtype>* output_blob = this->net_->output_blobs()[0];
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(input_blob->shape());
+  filler.Fill(&input);
+
+  // Forward straight out of the caller's buffer.
+  vector<Dtype> buffer(input.cpu_data(), input.cpu_data() + input.count());
+  this->net_->BindBlob("data", &buffer[0], buffer.size());
+  EXPECT_TRUE(this->net_->is_bound("data"));
+  EXPECT_FALSE(this->net_->is_bound("conv1"));
+  EXPECT_EQ(input_blob->cpu_data(), &buffer[0]);
+  this->net_->Forward();
+  EXPECT_EQ(input_blob->cpu_data(), &buffer[0]);
+  Blob<Dtype> output(output_blob->shape());
+  caffe_copy(output.count(), output_blob->cpu_data(),
+      output.mutable_cpu_data());
+
+  // Unbinding hands the blob its own copy of the buffer contents and leaves
+  // the buffer alone.
+  this->net_->UnbindBlob("data");
+  EXPECT_FALSE(this->net_->is_bound("data"));
+  Dtype* own_data = input_blob->mutable_cpu_data();
+  EXPECT_NE(own_data, &buffer[0]);
+  for (int i = 0; i < input.count(); ++i) {
+    EXPECT_EQ(own_data[i], buffer[i]);
+  }
+  caffe_copy(input.count(), input.cpu_data(), own_data);
+  this->net_->Forward();
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_FLOAT_EQ(output.cpu_data()[i], output_blob->cpu_data()[i]);
+  }
+
+  // Rebinding picks up new contents without a copy; a smaller shape keeps
+  // fitting in the bound buffer.
+  caffe_scal(static_cast<int>(buffer.size()), Dtype(0), &buffer[0]);
+  this->net_->BindBlob("data", &buffer[0], buffer.size());
+  input_blob->Reshape(1, 3, 50, 50);
+  EXPECT_EQ(input_blob->cpu_data(), &buffer[0]);
+  this->net_->Forward();
+  EXPECT_EQ(output_blob->num(), 1);
+  this->net_->UnbindBlobs();
+  EXPECT_FALSE(this->net_->is_bound("data"));
+  for (int i = 0; i < buffer.size(); ++i) {
+    EXPECT_EQ(buffer[i], Dtype(0));
+  }
+}
+
+TYPED_TEST(NetTest, TestCreateReplica) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  Caffe::set_mode(Caffe::CPU);
+  this->InitReshapableNet(caffe::TEST);
+  shared_ptr<Net<Dtype> > replica = this->net_->CreateReplica();
+  // The parameters are the same blobs, the activations are not.
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(params.size(), replica->params().size());
+  ASSERT_GT(params.size(), 0);
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_EQ(params[i].get(), replica->params()[i].get());
+  }
+  shared_ptr<Blob<Dtype> > input_blob = this->net_->blob_by_name("data");
+  shared_ptr<Blob<Dtype> > replica_input = replica->blob_by_name("data");
+  EXPECT_NE(input_blob.get(), replica_input.get());
+  EXPECT_NE(input_blob->mutable_cpu_data(), replica_input->mutable_cpu_data());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(input_blob.get());
+  this->net_->Forward();
+  const Blob<Dtype>* output_blob = this->net_->output_blobs()[0];
+
+  // A replica forwards on its own thread with the net's settings.
+  std::thread thread([&]() {
+    Caffe::set_thread_state(replica->thread_state());
+    caffe_copy(input_blob->count(), input_blob->cpu_data(),
+        replica_input->mutable_cpu_data());
+    replica->Forward();
+  });
+  thread.join();
+  const Blob<Dtype>* replica_output = replica->output_blobs()[0];
+  ASSERT_EQ(output_blob->count(), replica_output->count());
+  EXPECT_NE(output_blob->cpu_data(), replica_output->cpu_data());
+  for (int i = 0; i < output_blob->count(); ++i) {
+    EXPECT_EQ(output_blob->cpu_data()[i], replica_output->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestCreateReplicaHalfWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  Caffe::set_mode(Caffe::CPU);
+  this->InitNetFromProtoString(
+      "state { phase: TEST } "
+      "cpu_weight_dtype: DT_FLOAT16 "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 1 dim: 2 dim: 6 dim: 6 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  engine: CAFFE convolution_param { num_output: 2 kernel_size: 3 "
+      "  pad: 1 weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'winograd' type: 'Convolution' bottom: 'conv' "
+      "  top: 'winograd' convolution_param { num_output: 2 kernel_size: 3 "
+      "  pad: 1 engine: WINOGRAD weight_filler { type: 'gaussian' } } } ");
+  Blob<Dtype>* conv_weights =
+      this->net_->layer_by_name("conv")->blobs()[0].get();
+  Blob<Dtype>* winograd_weights =
+      this->net_->layer_by_name("winograd")->blobs()[0].get();
+  ASSERT_EQ(DT_FLOAT16, conv_weights->half_type());
+  ASSERT_EQ(DT_INVALID, winograd_weights->half_type());
+  // Weights read through half_data() stay in 16 bits only.
+  this->net_->CreateReplica();
+  EXPECT_EQ(SyncedMemory::UNINITIALIZED, conv_weights->data()->head());
+  // Once a layer reading cpu_data() holds them too, they are expanded
+  // before any replica runs.
+  winograd_weights->ShareData(*conv_weights);
+  ASSERT_EQ(DT_FLOAT16, winograd_weights->half_type());
+  shared_ptr<Net<Dtype> > replica = this->net_->CreateReplica();
+  EXPECT_EQ(SyncedMemory::HEAD_AT_CPU, winograd_weights->data()->head());
+  EXPECT_EQ(DT_FLOAT16, winograd_weights->half_type());
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->blob_by_name("data").get());
+  caffe_copy(replica->blob_by_name("data")->count(),
+      this->net_->blob_by_name("data")->cpu_data(),
+      replica->blob_by_name("data")->mutable_cpu_data());
+  std::thread thread([&]() {
+    Caffe::set_thread_state(replica->thread_state());
+    replica->Forward();
+  });
+  this->net_->Forward();
+  thread.join();
+  const Blob<Dtype>* output_blob = this->net_->output_blobs()[0];
+  const Blob<Dtype>* replica_output = replica->output_blobs()[0];
+  ASSERT_EQ(output_blob->count(), replica_output->count());
+  for (int i = 0; i < output_blob->count(); ++i) {
+    EXPECT_EQ(output_blob->cpu_data()[i], replica_output->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
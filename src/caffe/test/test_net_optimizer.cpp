@@ -0,0 +1,241 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/net_optimizer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static NetParameter ParseNet(const string& proto) {
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  return param;
+}
+
+static const char* kConvNet =
+    "name: 'ConvNet' "
+    "state { phase: TEST } "
+    "layer { "
+    "  name: 'data' type: 'Input' top: 'data' "
+    "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+    "} "
+    "layer { "
+    "  name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+    "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+    "    bias_term: false weight_filler { type: 'gaussian' std: 0.3 } } "
+    "} "
+    "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' "
+    "  batch_norm_param { eps: 0.001 } } "
+    "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+    "  scale_param { bias_term: true "
+    "    filler { type: 'uniform' min: 0.5 max: 1.5 } "
+    "    bias_filler { type: 'uniform' min: -0.5 max: 0.5 } } } "
+    "layer { name: 'prelu1' type: 'PReLU' bottom: 'conv1' top: 'prelu1' "
+    "  prelu_param { filler { type: 'uniform' min: 0.1 max: 0.3 } } } "
+    "layer { "
+    "  name: 'conv2' type: 'Convolution' bottom: 'prelu1' top: 'conv2' "
+    "  convolution_param { num_output: 4 kernel_size: 1 "
+    "    weight_filler { type: 'gaussian' std: 0.3 } "
+    "    bias_filler { type: 'gaussian' std: 0.1 } } "
+    "} "
+    "layer { name: 'drop2' type: 'Dropout' bottom: 'conv2' top: 'drop2' } "
+    "layer { name: 'sum' type: 'Eltwise' bottom: 'drop2' bottom: 'prelu1' "
+    "  top: 'sum' } "
+    "layer { name: 'relu' type: 'ReLU' bottom: 'sum' top: 'relu' } "
+    "layer { "
+    "  name: 'ip' type: 'InnerProduct' bottom: 'relu' top: 'ip' "
+    "  inner_product_param { num_output: 3 "
+    "    weight_filler { type: 'gaussian' std: 0.1 } } "
+    "} "
+    "layer { name: 'bn2' type: 'BatchNorm' bottom: 'ip' top: 'bn2' "
+    "  batch_norm_param { use_alpha_beta: true } } "
+    "layer { name: 'sig' type: 'Sigmoid' bottom: 'bn2' top: 'sig' } ";
+
+static int LayerIndex(const NetParameter& param, const string& name) {
+  for (int i = 0; i < param.layer_size(); ++i) {
+    if (param.layer(i).name() == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+TEST(NetOptimizerTest, TestRemoveIdentityLayers) {
+  NetParameter param = ParseNet(kConvNet);
+  EXPECT_TRUE(RemoveIdentityLayers(&param));
+  EXPECT_EQ(LayerIndex(param, "drop2"), -1);
+  const LayerParameter& sum = param.layer(LayerIndex(param, "sum"));
+  EXPECT_EQ(sum.bottom(0), "conv2");
+  EXPECT_FALSE(RemoveIdentityLayers(&param));
+}
+
+TEST(NetOptimizerTest, TestKeepsOutputs) {
+  // the tops of a Dropout and of an element-wise layer keep their names when
+  // they are outputs of the net.
+  const string data =
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 1 dim: 2 } } } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'data' top: 'ip' "
+      "  inner_product_param { num_output: 2 } } ";
+  NetParameter param = ParseNet(data +
+      "layer { name: 'drop' type: 'Dropout' bottom: 'ip' top: 'drop' } ");
+  EXPECT_FALSE(RemoveIdentityLayers(&param));
+  EXPECT_EQ(param.layer_size(), 3);
+  param = ParseNet(data +
+      "layer { name: 'sig' type: 'Sigmoid' bottom: 'ip' top: 'sig' } ");
+  EXPECT_FALSE(MakeInPlace(&param));
+  EXPECT_EQ(param.layer(2).top(0), "sig");
+}
+
+TEST(NetOptimizerTest, TestFoldAndFuse) {
+  NetParameter param = ParseNet(kConvNet);
+  NetOptimizer(2).Run(&param);
+  for (const char* name : {"bn1", "scale1", "prelu1", "drop2", "relu",
+                           "bn2"}) {
+    EXPECT_EQ(LayerIndex(param, name), -1) << name;
+  }
+  const LayerParameter& conv1 = param.layer(LayerIndex(param, "conv1"));
+  ASSERT_EQ(conv1.folded_layer_size(), 2);
+  EXPECT_EQ(conv1.folded_layer(0), "bn1");
+  EXPECT_EQ(conv1.folded_layer(1), "scale1");
+  EXPECT_TRUE(conv1.convolution_param().bias_term());
+  EXPECT_EQ(conv1.fused_activation(), "PReLU");
+  EXPECT_EQ(conv1.fused_layer(), "prelu1");
+  EXPECT_EQ(conv1.top(0), "prelu1");
+  const LayerParameter& sum = param.layer(LayerIndex(param, "sum"));
+  EXPECT_EQ(sum.fused_activation(), "ReLU");
+  EXPECT_EQ(sum.top(0), "relu");
+  const LayerParameter& ip = param.layer(LayerIndex(param, "ip"));
+  ASSERT_EQ(ip.folded_layer_size(), 1);
+  EXPECT_EQ(ip.top(0), "bn2");
+  // the sigmoid is the only reader of the folded ip
+  const LayerParameter& sig = param.layer(LayerIndex(param, "sig"));
+  EXPECT_EQ(sig.bottom(0), "bn2");
+  EXPECT_EQ(sig.top(0), "sig");
+}
+
+TEST(NetOptimizerTest, TestNoFuseActivation) {
+  // nets for devices without fused activations keep their ReLU and PReLU
+  NetParameter param = ParseNet(kConvNet);
+  NetOptimizer(2, false).Run(&param);
+  EXPECT_NE(LayerIndex(param, "prelu1"), -1);
+  EXPECT_NE(LayerIndex(param, "relu"), -1);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    EXPECT_FALSE(param.layer(i).has_fused_activation())
+        << param.layer(i).name();
+  }
+}
+
+TEST(NetOptimizerTest, TestInPlace) {
+  NetParameter param = ParseNet(
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 1 dim: 2 } } } "
+      "layer { name: 'tanh' type: 'TanH' bottom: 'data' top: 'tanh' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'tanh' top: 'ip' "
+      "  inner_product_param { num_output: 2 } } "
+      "layer { name: 'sig' type: 'Sigmoid' bottom: 'ip' top: 'sig' } "
+      "layer { name: 'abs' type: 'AbsVal' bottom: 'sig' top: 'abs' } "
+      "layer { name: 'sum' type: 'Eltwise' bottom: 'abs' bottom: 'ip' "
+      "  top: 'sum' } ");
+  EXPECT_TRUE(MakeInPlace(&param));
+  // the input is not overwritten, ip is still read by sum
+  EXPECT_EQ(param.layer(1).top(0), "tanh");
+  EXPECT_EQ(param.layer(3).top(0), "sig");
+  EXPECT_EQ(param.layer(4).bottom(0), "sig");
+  EXPECT_EQ(param.layer(4).top(0), "sig");
+  EXPECT_EQ(param.layer(5).bottom(0), "sig");
+}
+
+template <typename Dtype>
+class NetOptimizerNetTest : public ::testing::Test {
+  protected:
+  NetOptimizerNetTest() {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  shared_ptr<Net<Dtype> > InitNet(int opt_level) {
+    NetParameter param = ParseNet(kConvNet);
+    param.set_opt_level(opt_level);
+    Caffe::set_random_seed(1701);
+    shared_ptr<Net<Dtype> > net(new Net<Dtype>(param));
+    Blob<Dtype>* data = net->input_blobs()[0];
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = Dtype(i % 7) / 7 - 0.5;
+    }
+    return net;
+  }
+};
+
+TYPED_TEST_CASE(NetOptimizerNetTest, TestDtypes);
+
+TYPED_TEST(NetOptimizerNetTest, TestForward) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > reference = this->InitNet(0);
+  // give the BatchNorm layers trained statistics
+  for (const char* name : {"bn1", "bn2"}) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        reference->layer_by_name(name)->blobs();
+    FillerParameter filler_param;
+    filler_param.set_min(0.5);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < blobs.size(); ++i) {
+      filler.Fill(blobs[i].get());
+    }
+  }
+  NetParameter weights;
+  reference->ToProto(&weights);
+
+  for (int opt_level = 1; opt_level <= 2; ++opt_level) {
+    shared_ptr<Net<Dtype> > optimized = this->InitNet(opt_level);
+    EXPECT_LT(optimized->layers().size(), reference->layers().size());
+    optimized->CopyTrainedLayersFrom(weights);
+    reference->Forward();
+    optimized->Forward();
+    const Blob<Dtype>* expected = reference->output_blobs()[0];
+    const Blob<Dtype>* result = optimized->output_blobs()[0];
+    ASSERT_EQ(expected->count(), result->count());
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], result->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+}  // namespace caffe
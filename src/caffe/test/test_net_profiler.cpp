@@ -0,0 +1,176 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class NetProfilerTest : public ::testing::Test {
+  protected:
+  NetProfilerTest() {
+    Caffe::set_mode(Caffe::CPU);
+    string proto =
+        "name: 'ProfiledNet' "
+        "layer { "
+        "  name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'ip' type: 'InnerProduct' bottom: 'data' top: 'ip' "
+        "  inner_product_param { num_output: 8 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } "
+        "} "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'ip' top: 'ip' } "
+        "layer { name: 'prob' type: 'Softmax' bottom: 'ip' top: 'prob' } ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  static string ReadFile(const string& filename) {
+    std::ifstream in(filename.c_str());
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypes);
+
+TYPED_TEST(NetProfilerTest, TestSpans) {
+  typedef TypeParam Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get());
+  for (int iter = 0; iter < 3; ++iter) {
+    this->net_->Forward();
+  }
+  const int num_layers = this->net_->layers().size();
+  ASSERT_EQ(3 * num_layers, profiler.spans().size());
+  for (int i = 0; i < profiler.spans().size(); ++i) {
+    const typename NetProfiler<Dtype>::Span& span = profiler.spans()[i];
+    EXPECT_EQ(i % num_layers, span.id);
+    EXPECT_FALSE(span.subnet);
+    EXPECT_GE(span.duration_ns, 0);
+    if (i > 0) {
+      EXPECT_GE(span.start_ns, profiler.spans()[i - 1].start_ns);
+    }
+  }
+  // ip reads 2x60 inputs and 8x60 + 8 parameters, and writes 2x8 outputs.
+  const int ip = 1;
+  EXPECT_EQ("ip", this->net_->layer_names()[ip]);
+  EXPECT_EQ((120 + 488 + 16) * sizeof(Dtype),
+            profiler.spans()[ip].bytes_touched);
+  for (int i = 0; i < num_layers; ++i) {
+    EXPECT_EQ(3, profiler.layer_summary(i).calls);
+    EXPECT_LE(profiler.layer_summary(i).min_ns,
+              profiler.layer_summary(i).max_ns);
+  }
+  EXPECT_TRUE(profiler.subnet_summaries().empty());
+}
+
+TYPED_TEST(NetProfilerTest, TestDisableAndDetach) {
+  typedef TypeParam Dtype;
+  {
+    NetProfiler<Dtype> profiler(this->net_.get());
+    EXPECT_EQ(1, this->net_->before_forward().size());
+    profiler.set_enabled(false);
+    this->net_->Forward();
+    EXPECT_TRUE(profiler.spans().empty());
+    profiler.set_enabled(true);
+    this->net_->Forward();
+    EXPECT_EQ(this->net_->layers().size(), profiler.spans().size());
+    profiler.Clear();
+    EXPECT_TRUE(profiler.spans().empty());
+    EXPECT_EQ(0, profiler.layer_summary(0).calls);
+  }
+  EXPECT_TRUE(this->net_->before_forward().empty());
+  EXPECT_TRUE(this->net_->after_forward().empty());
+  this->net_->Forward();
+}
+
+TYPED_TEST(NetProfilerTest, TestMaxSpans) {
+  typedef TypeParam Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get(), 5);
+  for (int iter = 0; iter < 3; ++iter) {
+    this->net_->Forward();
+  }
+  EXPECT_EQ(5, profiler.spans().size());
+  EXPECT_EQ(3, profiler.layer_summary(0).calls);
+}
+
+TYPED_TEST(NetProfilerTest, TestWrite) {
+  typedef TypeParam Dtype;
+  NetProfiler<Dtype> profiler(this->net_.get());
+  this->net_->Forward();
+  this->net_->Forward();
+  string trace_file, csv_file;
+  MakeTempFilename(&trace_file);
+  MakeTempFilename(&csv_file);
+  profiler.WriteChromeTrace(trace_file);
+  profiler.WriteCsv(csv_file);
+
+  const string trace = this->ReadFile(trace_file);
+  EXPECT_EQ(0, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(string::npos, trace.find("\"name\":\"ProfiledNet\""));
+  EXPECT_NE(string::npos, trace.find("\"name\":\"ip\",\"cat\":\"layer\""));
+  EXPECT_NE(string::npos, trace.find("\"type\":\"Softmax\""));
+  EXPECT_NE(string::npos, trace.find("\"name\":\"host memory\""));
+  EXPECT_EQ("]}\n", trace.substr(trace.size() - 3));
+
+  std::ifstream csv(csv_file.c_str());
+  string line;
+  ASSERT_TRUE(static_cast<bool>(std::getline(csv, line)));
+  EXPECT_EQ(0, line.find("kind,index,name,type,calls,total_ms"));
+  int rows = 0;
+  while (std::getline(csv, line)) {
+    EXPECT_EQ(0, line.find("layer,"));
+    EXPECT_NE(string::npos, line.find("," + this->net_->layer_names()[rows] +
+        "," + this->net_->layers()[rows]->type() + ",2,"));
+    ++rows;
+  }
+  EXPECT_EQ(this->net_->layers().size(), rows);
+}
+
+}  // namespace caffe
@@ -0,0 +1,276 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/nms.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class NMSTest : public ::testing::Test {
+  protected:
+  NMSTest() : rng_(1701) {}
+
+  // Random boxes in clusters, so that many of them overlap.
+  void FillBoxes(int num, bool normalized, NMSBoxes* boxes,
+                 vector<float>* scores) {
+    const float extent = normalized ? 1.f : 600.f;
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    boxes->clear();
+    boxes->normalized = normalized;
+    scores->clear();
+    float cx = 0, cy = 0;
+    for (int i = 0; i < num; ++i) {
+      if (i % 8 == 0) {
+        cx = unit(rng_) * extent;
+        cy = unit(rng_) * extent;
+      }
+      const float x = cx + (unit(rng_) - 0.5f) * extent * 0.05f;
+      const float y = cy + (unit(rng_) - 0.5f) * extent * 0.05f;
+      const float w = (0.02f + unit(rng_) * 0.2f) * extent;
+      const float h = (0.02f + unit(rng_) * 0.2f) * extent;
+      boxes->push_back(x, y, x + w, y + h);
+      // Quantized scores give ties.
+      scores->push_back(std::floor(unit(rng_) * 64) / 64);
+    }
+  }
+
+  // The erase-from-front NMS over a stable sort that NonMaxSuppression
+  // replaces.
+  void ReferenceNMS(const NMSBoxes& boxes, const vector<float>& scores,
+                    const NMSParam& param, vector<int>* indices) {
+    vector<pair<float, int> > order;
+    for (int i = 0; i < scores.size(); ++i) {
+      if (scores[i] > param.score_threshold) {
+        order.push_back(std::make_pair(scores[i], i));
+      }
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [](const pair<float, int>& a, const pair<float, int>& b) {
+          return a.first > b.first;
+        });
+    if (param.top_k > -1 && param.top_k < order.size()) {
+      order.resize(param.top_k);
+    }
+    indices->clear();
+    for (int c = 0; c < order.size(); ++c) {
+      const int i = order[c].second;
+      if (boxes.area[i] < param.min_area) {
+        continue;
+      }
+      bool keep = true;
+      for (int k = 0; k < indices->size() && keep; ++k) {
+        const float overlap = Overlap(boxes, i, (*indices)[k]);
+        keep = param.suppress_equal ? overlap < param.overlap_threshold
+                                    : overlap <= param.overlap_threshold;
+      }
+      if (keep) {
+        indices->push_back(i);
+        if (param.keep_top_k > -1 && indices->size() >= param.keep_top_k) {
+          break;
+        }
+      }
+    }
+  }
+
+  float Overlap(const NMSBoxes& boxes, int a, int b) {
+    const float offset = boxes.normalized ? 0 : 1;
+    const float w = std::min(boxes.x2[a], boxes.x2[b]) -
+                    std::max(boxes.x1[a], boxes.x1[b]) + offset;
+    const float h = std::min(boxes.y2[a], boxes.y2[b]) -
+                    std::max(boxes.y1[a], boxes.y1[b]) + offset;
+    if (w <= 0 || h <= 0) {
+      return 0;
+    }
+    return w * h / (boxes.area[a] + boxes.area[b] - w * h);
+  }
+
+  std::mt19937 rng_;
+};
+
+TEST_F(NMSTest, TestMatchesReference) {
+  NMSBoxes boxes;
+  vector<float> scores;
+  vector<int> indices, expected;
+  for (int normalized = 0; normalized < 2; ++normalized) {
+    FillBoxes(500, normalized, &boxes, &scores);
+    const float thresholds[] = {0.f, 0.3f, 0.45f, 0.7f, 1.f};
+    for (int t = 0; t < 5; ++t) {
+      for (int top_k = -1; top_k < 400; top_k += 100) {
+        NMSParam param;
+        param.score_threshold = 0.1f;
+        param.overlap_threshold = thresholds[t];
+        param.top_k = top_k;
+        param.keep_top_k = top_k < 0 ? -1 : top_k / 3;
+        param.suppress_equal = t % 2;
+        NonMaxSuppression(boxes, scores.data(), param, &indices);
+        ReferenceNMS(boxes, scores, param, &expected);
+        EXPECT_EQ(indices, expected);
+      }
+    }
+  }
+}
+
+TEST_F(NMSTest, TestKeptScores) {
+  NMSBoxes boxes;
+  vector<float> scores;
+  FillBoxes(100, true, &boxes, &scores);
+  NMSParam param;
+  vector<int> indices;
+  vector<float> kept_scores;
+  NonMaxSuppression(boxes, scores.data(), param, &indices, &kept_scores);
+  ASSERT_EQ(indices.size(), kept_scores.size());
+  for (int i = 0; i < indices.size(); ++i) {
+    EXPECT_EQ(kept_scores[i], scores[indices[i]]);
+    if (i > 0) {
+      EXPECT_GE(kept_scores[i - 1], kept_scores[i]);
+    }
+  }
+}
+
+TEST_F(NMSTest, TestMinArea) {
+  NMSBoxes boxes;
+  boxes.push_back(0.1f, 0.1f, 0.1f, 0.1f);
+  boxes.push_back(0.1f, 0.1f, 0.3f, 0.3f);
+  boxes.push_back(0.3f, 0.3f, 0.2f, 0.2f);
+  EXPECT_EQ(boxes.area[0], 0);
+  EXPECT_EQ(boxes.area[2], 0);
+  const float scores[] = {0.9f, 0.5f, 0.8f};
+  NMSParam param;
+  param.min_area = 1e-5;
+  vector<int> indices;
+  NonMaxSuppression(boxes, scores, param, &indices);
+  ASSERT_EQ(indices.size(), 1);
+  EXPECT_EQ(indices[0], 1);
+}
+
+TEST_F(NMSTest, TestOrdered) {
+  NMSBoxes boxes(false);
+  vector<float> scores;
+  FillBoxes(300, false, &boxes, &scores);
+  // Visiting by descending score matches NonMaxSuppression.
+  vector<int> order(scores.size());
+  for (int i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&scores](int a, int b) { return scores[a] > scores[b]; });
+  NMSParam param;
+  param.overlap_threshold = 0.4f;
+  param.keep_top_k = 50;
+  vector<int> indices, expected;
+  NonMaxSuppressionOrdered(boxes, order, param, &indices);
+  NonMaxSuppression(boxes, scores.data(), param, &expected);
+  EXPECT_EQ(indices, expected);
+  // The first box in the order is always kept.
+  std::reverse(order.begin(), order.end());
+  NonMaxSuppressionOrdered(boxes, order, param, &indices);
+  ASSERT_FALSE(indices.empty());
+  EXPECT_EQ(indices[0], order[0]);
+}
+
+TEST_F(NMSTest, TestBatched) {
+  const int num_classes = 21;
+  NMSBoxes boxes;
+  vector<float> scores;
+  FillBoxes(200, true, &boxes, &scores);
+  vector<vector<float> > class_scores(num_classes);
+  vector<const float*> class_ptrs(num_classes);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  for (int c = 0; c < num_classes; ++c) {
+    for (int i = 0; i < boxes.size(); ++i) {
+      class_scores[c].push_back(unit(rng_));
+    }
+    class_ptrs[c] = c == 0 ? NULL : class_scores[c].data();
+  }
+  NMSParam param;
+  param.score_threshold = 0.3f;
+  param.overlap_threshold = 0.45f;
+  param.top_k = 100;
+  for (int threads = 1; threads <= 4; threads += 3) {
+    Caffe::set_cpu_threads(threads);
+    vector<vector<int> > indices;
+    NonMaxSuppressionBatched(boxes, class_ptrs, param, &indices);
+    ASSERT_EQ(indices.size(), num_classes);
+    EXPECT_TRUE(indices[0].empty());
+    vector<int> expected;
+    for (int c = 1; c < num_classes; ++c) {
+      NonMaxSuppression(boxes, class_ptrs[c], param, &expected);
+      EXPECT_EQ(indices[c], expected);
+    }
+  }
+  Caffe::set_cpu_threads(1);
+}
+
+TEST_F(NMSTest, TestSoftNMS) {
+  NMSBoxes boxes;
+  boxes.push_back(0.f, 0.f, 0.4f, 0.4f);
+  boxes.push_back(0.f, 0.f, 0.4f, 0.2f);
+  boxes.push_back(0.6f, 0.6f, 0.9f, 0.9f);
+  const float scores[] = {0.9f, 0.8f, 0.7f};
+  NMSParam param;
+  param.score_threshold = 0.01f;
+  param.overlap_threshold = 0.3f;
+  vector<int> indices;
+  vector<float> kept_scores;
+  // Hard NMS drops the box covering half of the best one.
+  NonMaxSuppression(boxes, scores, param, &indices, &kept_scores);
+  ASSERT_EQ(indices.size(), 2);
+  // Soft NMS keeps it with a decayed score, ranked after the disjoint box.
+  param.method = NMS_SOFT_LINEAR;
+  NonMaxSuppression(boxes, scores, param, &indices, &kept_scores);
+  ASSERT_EQ(indices.size(), 3);
+  EXPECT_EQ(indices[0], 0);
+  EXPECT_EQ(indices[1], 2);
+  EXPECT_EQ(indices[2], 1);
+  EXPECT_FLOAT_EQ(kept_scores[1], 0.7f);
+  EXPECT_FLOAT_EQ(kept_scores[2], 0.8f * 0.5f);
+  param.method = NMS_SOFT_GAUSSIAN;
+  NonMaxSuppression(boxes, scores, param, &indices, &kept_scores);
+  ASSERT_EQ(indices.size(), 3);
+  EXPECT_FLOAT_EQ(kept_scores[0], 0.9f);
+  EXPECT_FLOAT_EQ(kept_scores[1], 0.7f);
+  EXPECT_FLOAT_EQ(kept_scores[2], 0.8f * std::exp(-0.25f / param.sigma));
+  // Decayed scores below the threshold are dropped.
+  param.score_threshold = 0.5f;
+  NonMaxSuppression(boxes, scores, param, &indices, &kept_scores);
+  EXPECT_EQ(indices.size(), 2);
+}
+
+}  // namespace caffe
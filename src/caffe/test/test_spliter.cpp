@@ -40,6 +40,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layer.hpp"
 #include "caffe/layers/absval_layer.hpp"
 #include "caffe/mlu/spliter.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -100,6 +102,144 @@ TYPED_TEST(SpliterTest, TestInitialization) {
   EXPECT_EQ(this->subnets_.size(), 1);
 }
 
+/**
+ * A small SSD-like net with mocked mfus_supported() flags:
+ *
+ *   in -> [0 sup] -> a -> [2 sup] -> b -> [3 sup] -> c -> [4 cpu] -> out
+ *                    a -> [1 cpu] -> p --------------------^
+ *
+ * Layer 1 is an unsupported side branch, like PriorBox, sitting between
+ * supported layers in prototxt order.
+ */
+template <typename Dtype>
+class SpliterTopologyTest : public ::testing::Test {
+  protected:
+  SpliterTopologyTest() {
+    Caffe::set_mode(Caffe::CPU);
+    LayerParameter layer_param;
+    for (int i = 0; i < 5; i++) {
+      layers_.push_back(shared_ptr<Layer<Dtype> >(
+          new AbsValLayer<Dtype>(layer_param)));
+    }
+    for (int i = 0; i < 6; i++) {
+      blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(1, 2, 3, 4)));
+    }
+    Blob<Dtype>* in = blobs_[0].get();
+    Blob<Dtype>* a = blobs_[1].get();
+    Blob<Dtype>* p = blobs_[2].get();
+    Blob<Dtype>* b = blobs_[3].get();
+    Blob<Dtype>* c = blobs_[4].get();
+    Blob<Dtype>* out = blobs_[5].get();
+    bottom_vecs_ = {{in}, {a}, {a}, {b}, {p, c}};
+    top_vecs_ = {{a}, {p}, {b}, {c}, {out}};
+    net_outputs_.push_back(out);
+    mfus_supported_ = {true, false, true, true, false};
+    net_data_.reset(new NetData<Dtype>(&layers_, &bottom_vecs_, &top_vecs_,
+                                       &net_outputs_));
+  }
+  virtual ~SpliterTopologyTest() {
+    Caffe::setSplitMode(Caffe::SplitMode::LINEAR);
+  }
+
+  SplitStats split(Caffe::SplitMode mode) {
+    Caffe::setSplitMode(mode);
+    subnets_.clear();
+    Spliter<Dtype> spliter(net_data_, mfus_supported_);
+    spliter.split(&subnets_);
+    return spliter.stats(subnets_);
+  }
+
+  vector<shared_ptr<Layer<Dtype> > > layers_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  vector<vector<Blob<Dtype>* > > bottom_vecs_;
+  vector<vector<Blob<Dtype>* > > top_vecs_;
+  vector<Blob<Dtype>* > net_outputs_;
+  vector<bool> mfus_supported_;
+  shared_ptr<NetData<Dtype> > net_data_;
+  vector<shared_ptr<SubNet<Dtype> > > subnets_;
+};
+
+TYPED_TEST_CASE(SpliterTopologyTest, TestDtypes);
+
+TYPED_TEST(SpliterTopologyTest, TestLinear) {
+  SplitStats stats = this->split(Caffe::SplitMode::LINEAR);
+  EXPECT_EQ(this->subnets_.size(), 4);
+  EXPECT_EQ(stats.subnets, 4);
+  EXPECT_EQ(stats.mfus_subnets, 2);
+  EXPECT_EQ(stats.boundary_blobs, 3);
+}
+
+TYPED_TEST(SpliterTopologyTest, TestTopology) {
+  SplitStats linear = this->split(Caffe::SplitMode::LINEAR);
+  SplitStats stats = this->split(Caffe::SplitMode::TOPOLOGY);
+  ASSERT_EQ(this->subnets_.size(), 2);
+  EXPECT_TRUE(this->subnets_[0]->mfus_supported());
+  EXPECT_EQ(this->subnets_[0]->layers(), vector<int>({0, 2, 3}));
+  EXPECT_FALSE(this->subnets_[1]->mfus_supported());
+  EXPECT_EQ(this->subnets_[1]->layers(), vector<int>({1, 4}));
+  EXPECT_EQ(stats.mfus_subnets, 1);
+  EXPECT_EQ(stats.boundary_blobs, 2);
+  EXPECT_LT(stats.boundary_bytes, linear.boundary_bytes);
+}
+
+TYPED_TEST(SpliterTopologyTest, TestTopologyInPlace) {
+  // make layer 3 work in place on b, and a cpu layer 5 read b in place
+  // after it. Layer 5 must not be scheduled before layer 3.
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->layers_.push_back(shared_ptr<Layer<Dtype> >(
+      new AbsValLayer<Dtype>(layer_param)));
+  Blob<Dtype>* b = this->blobs_[3].get();
+  this->top_vecs_[3] = {b};
+  this->bottom_vecs_[4] = {this->blobs_[2].get(), b};
+  this->bottom_vecs_.push_back({b});
+  this->top_vecs_.push_back({b});
+  this->mfus_supported_.push_back(false);
+  this->net_data_.reset(new NetData<Dtype>(&this->layers_,
+      &this->bottom_vecs_, &this->top_vecs_, &this->net_outputs_));
+  this->split(Caffe::SplitMode::TOPOLOGY);
+  ASSERT_EQ(this->subnets_.size(), 2);
+  EXPECT_EQ(this->subnets_[0]->layers(), vector<int>({0, 2, 3}));
+  EXPECT_EQ(this->subnets_[1]->layers(), vector<int>({1, 4, 5}));
+}
+
+// Measure partition quality on a zoo model, mocking ReLU as unsupported.
+// Inception branches let the topology split batch the ReLUs of a module.
+TYPED_TEST(SpliterTopologyTest, TestZooModel) {
+  typedef TypeParam Dtype;
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(
+      CMAKE_SOURCE_DIR "models/bvlc_googlenet/deploy.prototxt", &param);
+  param.mutable_layer(0)->mutable_input_param()->mutable_shape(0)->set_dim(
+      0, 1);
+  Net<Dtype> net(param);
+  vector<shared_ptr<Layer<Dtype> > > layers = net.layers();
+  vector<vector<Blob<Dtype>* > > bottom_vecs = net.bottom_vecs();
+  vector<vector<Blob<Dtype>* > > top_vecs = net.top_vecs();
+  vector<Blob<Dtype>* > outputs = net.output_blobs();
+  vector<bool> mfus_supported;
+  for (auto layer : layers) {
+    mfus_supported.push_back(string(layer->type()) != "ReLU");
+  }
+  shared_ptr<NetData<Dtype> > net_data(new NetData<Dtype>(
+      &layers, &bottom_vecs, &top_vecs, &outputs));
+
+  SplitStats stats[2];
+  Caffe::SplitMode modes[2] = {Caffe::SplitMode::LINEAR,
+                               Caffe::SplitMode::TOPOLOGY};
+  for (int i = 0; i < 2; i++) {
+    Caffe::setSplitMode(modes[i]);
+    vector<shared_ptr<SubNet<Dtype> > > subnets;
+    Spliter<Dtype> spliter(net_data, mfus_supported);
+    spliter.split(&subnets);
+    stats[i] = spliter.stats(subnets);
+    LOG(INFO) << "subnets: " << stats[i].subnets
+              << ", boundary blobs: " << stats[i].boundary_blobs
+              << ", boundary bytes: " << stats[i].boundary_bytes;
+  }
+  EXPECT_LT(stats[1].subnets, stats[0].subnets);
+  EXPECT_LE(stats[1].boundary_bytes, stats[0].boundary_bytes);
+}
 
 }  // namespace caffe
 
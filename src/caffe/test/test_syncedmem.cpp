@@ -96,6 +96,39 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  uint64_t version = mem.version();
+  mem.mutable_cpu_data();
+  EXPECT_NE(mem.version(), version);
+  version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), version);
+  char buffer[10];
+  mem.set_cpu_data(buffer);
+  EXPECT_NE(mem.version(), version);
+}
+
+TEST_F(SyncedMemoryTest, TestResetCPUData) {
+  SyncedMemory mem(10);
+  char buffer[10];
+  mem.set_cpu_data(buffer);
+  caffe_memset(mem.size(), 3, mem.mutable_cpu_data());
+  // The bound buffer held the newest contents, they must survive the reset.
+  mem.reset_cpu_data();
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+  const void* cpu_data = mem.cpu_data();
+  EXPECT_NE(cpu_data, buffer);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ((static_cast<const char*>(cpu_data))[i], 3);
+  }
+  // Later writes go to the owned copy only.
+  caffe_memset(mem.size(), 4, mem.mutable_cpu_data());
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(buffer[i], 3);
+  }
+}
+
 #ifdef USE_CUDA  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,212 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(ThreadPoolTest, TestRun) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.num_threads(), 4);
+  for (int tasks = 0; tasks < 20; ++tasks) {
+    vector<std::atomic<int> > runs(tasks);
+    for (int i = 0; i < tasks; ++i) {
+      runs[i] = 0;
+    }
+    pool.Run(tasks, [&](int i) { runs[i]++; });
+    for (int i = 0; i < tasks; ++i) {
+      EXPECT_EQ(runs[i], 1);
+    }
+  }
+}
+
+TEST(ThreadPoolTest, TestNested) {
+  // Nested jobs run on the thread of their task.
+  ThreadPool pool(3);
+  std::atomic<int> runs(0);
+  pool.Run(3, [&](int i) {
+    pool.Run(5, [&](int j) { runs++; });
+  });
+  EXPECT_EQ(runs, 15);
+}
+
+TEST(ThreadPoolTest, TestParallelFor) {
+  Caffe::set_cpu_threads(4);
+  EXPECT_EQ(Caffe::cpu_threads(), 4);
+  for (int n = 1; n < 100; n += 7) {
+    vector<int> hits(n, 0);
+    std::atomic<int> chunks(0);
+    caffe_parallel_for(n, 1 << 20, [&](int begin, int end) {
+      EXPECT_LT(begin, end);
+      for (int i = begin; i < end; ++i) {
+        hits[i]++;
+      }
+      chunks++;
+    });
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(hits[i], 1);
+    }
+    EXPECT_EQ(chunks, std::min(n, 4));
+  }
+  // Small loops stay on the calling thread.
+  std::atomic<int> chunks(0);
+  caffe_parallel_for(64, 1, [&](int begin, int end) { chunks++; });
+  EXPECT_EQ(chunks, 1);
+  Caffe::set_cpu_threads(1);
+  EXPECT_EQ(Caffe::cpu_threads(), 1);
+}
+
+template <typename Dtype>
+class ParallelLayerTest : public ::testing::Test {
+  protected:
+  ParallelLayerTest() {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  virtual ~ParallelLayerTest() {
+    Caffe::set_cpu_threads(1);
+  }
+
+  // Runs the layer with one and with four threads and expects the very same
+  // bits in every top.
+  void CheckBitIdentical(const string& proto,
+                         const vector<vector<int> >& shapes) {
+    LayerParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    vector<shared_ptr<Blob<Dtype> > > bottoms;
+    vector<Blob<Dtype>*> bottom_vec;
+    FillerParameter filler_param;
+    filler_param.set_min(0.1);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < shapes.size(); ++i) {
+      bottoms.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shapes[i])));
+      filler.Fill(bottoms[i].get());
+      bottom_vec.push_back(bottoms[i].get());
+    }
+    vector<vector<Dtype> > serial;
+    for (int threads = 1; threads <= 4; threads += 3) {
+      Caffe::set_cpu_threads(threads);
+      shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+      Blob<Dtype> top;
+      vector<Blob<Dtype>*> top_vec(1, &top);
+      layer->SetUp(bottom_vec, top_vec);
+      layer->Forward(bottom_vec, top_vec);
+      if (threads == 1) {
+        serial.push_back(vector<Dtype>(top.cpu_data(),
+                                       top.cpu_data() + top.count()));
+      } else {
+        ASSERT_EQ(top.count(), serial[0].size());
+        EXPECT_EQ(0, memcmp(top.cpu_data(), &serial[0][0],
+                            top.count() * sizeof(Dtype))) << proto;
+      }
+    }
+  }
+
+  vector<vector<int> > Shapes(int num) {
+    vector<int> shape;
+    shape.push_back(4);
+    shape.push_back(8);
+    shape.push_back(32);
+    shape.push_back(32);
+    return vector<vector<int> >(num, shape);
+  }
+};
+
+TYPED_TEST_CASE(ParallelLayerTest, TestDtypes);
+
+TYPED_TEST(ParallelLayerTest, TestPooling) {
+  this->CheckBitIdentical("type: 'Pooling' pooling_param { pool: MAX "
+                          "kernel_size: 3 stride: 2 }", this->Shapes(1));
+  this->CheckBitIdentical("type: 'Pooling' pooling_param { pool: AVE "
+                          "kernel_size: 3 stride: 2 pad: 1 }", this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestLRN) {
+  this->CheckBitIdentical("type: 'LRN' lrn_param { local_size: 5 }",
+                          this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestEltwise) {
+  this->CheckBitIdentical("type: 'Eltwise' eltwise_param { operation: SUM "
+                          "coeff: 0.5 coeff: -2 coeff: 3 }", this->Shapes(3));
+  this->CheckBitIdentical("type: 'Eltwise' eltwise_param { operation: MAX }",
+                          this->Shapes(3));
+  this->CheckBitIdentical("type: 'Eltwise' eltwise_param { operation: PROD }",
+                          this->Shapes(2));
+}
+
+TYPED_TEST(ParallelLayerTest, TestScale) {
+  vector<vector<int> > shapes = this->Shapes(2);
+  shapes[1].resize(2);
+  this->CheckBitIdentical("type: 'Scale' scale_param { axis: 0 }", shapes);
+}
+
+TYPED_TEST(ParallelLayerTest, TestPermute) {
+  this->CheckBitIdentical("type: 'Permute' permute_param { order: 0 order: 2 "
+                          "order: 3 order: 1 }", this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestReorg) {
+  this->CheckBitIdentical("type: 'Reorg' reorg_param { stride: 2 }",
+                          this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestInterp) {
+  this->CheckBitIdentical("type: 'Interp' interp_param { zoom_factor: 2 }",
+                          this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestNormalize) {
+  this->CheckBitIdentical("type: 'Normalize' norm_param { "
+                          "across_spatial: false }", this->Shapes(1));
+  this->CheckBitIdentical("type: 'Normalize' norm_param { "
+                          "across_spatial: true channel_shared: true }",
+                          this->Shapes(1));
+}
+
+TYPED_TEST(ParallelLayerTest, TestSoftmax) {
+  this->CheckBitIdentical("type: 'Softmax'", this->Shapes(1));
+}
+
+}  // namespace caffe
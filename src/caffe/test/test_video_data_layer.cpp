@@ -0,0 +1,228 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/video_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class VideoDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+  protected:
+  VideoDataLayerTest()
+      : seed_(1701),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    // Two image sequences of 12 flat 16 x 20 frames, frame i of sequence s
+    // having the value 20 * i + 10 * s in every channel.
+    for (int s = 0; s < 2; ++s) {
+      MakeTempDir(&dirs_[s]);
+      for (int i = 1; i <= 12; ++i) {
+        cv::Mat frame(16, 20, CV_8UC3, cv::Scalar::all(20 * i + 10 * s));
+        cv::imwrite(dirs_[s] + "/" + format_int(i, 6) + ".jpg", frame);
+      }
+    }
+    // Clips of 4 frames starting at frames 1, 5 and 9, labelled 0 to 5.
+    MakeTempFilename(&filename_);
+    std::ofstream outfile(filename_.c_str(), std::ofstream::out);
+    for (int i = 0; i < 6; ++i) {
+      outfile << dirs_[i % 2] << " " << 1 + 4 * (i / 2) << " " << i
+              << std::endl;
+    }
+    outfile.close();
+  }
+
+  virtual ~VideoDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  void InitParam(LayerParameter* param) {
+    VideoDataParameter* video_data_param = param->mutable_video_data_param();
+    video_data_param->set_batch_size(6);
+    video_data_param->set_source(filename_.c_str());
+    video_data_param->set_new_length(4);
+    video_data_param->set_use_image(true);
+  }
+
+  int seed_;
+  string dirs_[2];
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(VideoDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(VideoDataLayerTest, TestRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  this->InitParam(&param);
+  param.mutable_video_data_param()->set_decode_threads(2);
+  VideoDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Blob<Dtype>* data = this->blob_top_data_;
+  EXPECT_EQ(6, data->shape(0));
+  EXPECT_EQ(3, data->shape(1));
+  EXPECT_EQ(4, data->shape(2));
+  EXPECT_EQ(16, data->shape(3));
+  EXPECT_EQ(20, data->shape(4));
+  for (int iter = 0; iter < 2; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 6; ++i) {
+      EXPECT_EQ(i, this->blob_top_label_->cpu_data()[i]);
+      for (int c = 0; c < 3; ++c) {
+        for (int l = 0; l < 4; ++l) {
+          const int frame = 1 + 4 * (i / 2) + l;
+          vector<int> index(5, 0);
+          index[0] = i;
+          index[1] = c;
+          index[2] = l;
+          // Flat frames survive jpeg up to rounding.
+          EXPECT_NEAR(20 * frame + 10 * (i % 2), data->data_at(index), 2);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(VideoDataLayerTest, TestDecodeThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  this->InitParam(&param);
+  param.mutable_video_data_param()->set_shuffle(true);
+  param.mutable_video_data_param()->set_use_sampling_rate_jitter(true);
+  param.mutable_video_data_param()->set_max_sampling_rate(2);
+  param.mutable_transform_param()->set_crop_size(8);
+  param.mutable_transform_param()->set_mirror(true);
+  // The batches must not depend on the number of decode threads.
+  vector<vector<Dtype> > batches[2];
+  vector<vector<Dtype> > labels[2];
+  for (int run = 0; run < 2; ++run) {
+    param.mutable_video_data_param()->set_decode_threads(run == 0 ? 1 : 3);
+    Caffe::set_random_seed(this->seed_);
+    VideoDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int iter = 0; iter < 3; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const Blob<Dtype>* data = this->blob_top_data_;
+      const Blob<Dtype>* label = this->blob_top_label_;
+      batches[run].push_back(vector<Dtype>(data->cpu_data(),
+          data->cpu_data() + data->count()));
+      labels[run].push_back(vector<Dtype>(label->cpu_data(),
+          label->cpu_data() + label->count()));
+    }
+  }
+  for (int iter = 0; iter < 3; ++iter) {
+    EXPECT_EQ(labels[0][iter], labels[1][iter]) << "iter " << iter;
+    EXPECT_EQ(batches[0][iter], batches[1][iter]) << "iter " << iter;
+  }
+}
+
+TYPED_TEST(VideoDataLayerTest, TestReadVideo) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A video of 20 flat 16 x 24 frames, frame i having the value 10 * i + 20.
+  string video;
+  MakeTempFilename(&video);
+  video += ".avi";
+  {
+    cv::VideoWriter writer(video, CV_FOURCC('M', 'J', 'P', 'G'), 25,
+                           cv::Size(24, 16));
+    if (!writer.isOpened()) {
+      LOG(INFO) << "No MJPG encoder, skipping";
+      return;
+    }
+    for (int i = 0; i < 20; ++i) {
+      writer << cv::Mat(16, 24, CV_8UC3, cv::Scalar::all(10 * i + 20));
+    }
+  }
+  // Clips of 4 frames read in turn from the same file: from the start,
+  // overlapping the previous one, just ahead, far ahead and backward. The
+  // second pass goes back to the start again.
+  const int starts[] = {0, 2, 7, 16, 1};
+  std::ofstream outfile(this->filename_.c_str(), std::ofstream::out);
+  for (int i = 0; i < 5; ++i) {
+    outfile << video << " " << starts[i] << " " << i << std::endl;
+  }
+  outfile.close();
+  LayerParameter param;
+  this->InitParam(&param);
+  param.mutable_video_data_param()->set_batch_size(5);
+  param.mutable_video_data_param()->set_use_image(false);
+  VideoDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Blob<Dtype>* data = this->blob_top_data_;
+  EXPECT_EQ(5, data->shape(0));
+  EXPECT_EQ(4, data->shape(2));
+  EXPECT_EQ(16, data->shape(3));
+  EXPECT_EQ(24, data->shape(4));
+  for (int iter = 0; iter < 2; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(i, this->blob_top_label_->cpu_data()[i]);
+      for (int l = 0; l < 4; ++l) {
+        vector<int> index(5, 0);
+        index[0] = i;
+        index[2] = l;
+        index[3] = 8;
+        index[4] = 12;
+        // Flat frames survive MJPG up to rounding.
+        EXPECT_NEAR(10 * (starts[i] + l) + 20, data->data_at(index), 3)
+            << "clip " << i << " frame " << l;
+      }
+    }
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
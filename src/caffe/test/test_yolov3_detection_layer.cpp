@@ -37,12 +37,122 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/mlu_yolov3_detection_layer.hpp"
+#include "caffe/layers/yolov3_detection_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/test/test_caffe_main.hpp"
 #include "gtest/gtest.h"
+#ifdef USE_MLU
 #include "yolov3_detection_input_data.hpp"
+#endif
 
 namespace caffe {
 
+// Two images of a 2x2 grid with two anchors and two classes on an 8x8
+// input, so every cell is 4 pixels wide and an anchor of 4x4 decoded with
+// zero offsets covers exactly one cell.
+template <typename Dtype>
+class Yolov3DetectionLayerTest : public CPUDeviceTest<Dtype> {
+  protected:
+  Yolov3DetectionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 14, 2, 2)),
+        blob_top_(new Blob<Dtype>()) {
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~Yolov3DetectionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+  // Attribute t (x, y, w, h, objectness, class scores) of anchor a at cell c
+  // of image n.
+  Dtype& logit(int n, int a, int t, int c) {
+    return blob_bottom_->mutable_cpu_data()[
+        blob_bottom_->offset(n, a * 7 + t) + c];
+  }
+  void CheckDetection(const Dtype* det, int n, int k, Dtype score,
+                      Dtype x1, Dtype y1, Dtype x2, Dtype y2) {
+    EXPECT_EQ(det[0], n);
+    EXPECT_EQ(det[1], k);
+    EXPECT_NEAR(det[2], score, 1e-5);
+    EXPECT_NEAR(det[3], x1, 1e-5);
+    EXPECT_NEAR(det[4], y1, 1e-5);
+    EXPECT_NEAR(det[5], x2, 1e-5);
+    EXPECT_NEAR(det[6], y2, 1e-5);
+  }
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(Yolov3DetectionLayerTest, TestDtypes);
+
+TYPED_TEST(Yolov3DetectionLayerTest, TestForward) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  Yolov3DetectionParameter* yolov3_param = layer_param.mutable_yolov3_param();
+  yolov3_param->set_num_classes(2);
+  yolov3_param->set_num_box(8);
+  yolov3_param->set_confidence_threshold(0.5);
+  yolov3_param->set_nms_threshold(0.45);
+  yolov3_param->set_anchor_num(2);
+  yolov3_param->set_im_w(8);
+  yolov3_param->set_im_h(8);
+  for (int i = 0; i < 4; ++i) {
+    yolov3_param->add_biases(4);
+  }
+  // Offsets and sizes decode to whole cells, objectness and class scores
+  // are below the threshold unless set otherwise.
+  Blob<Dtype>* bottom = this->blob_bottom_;
+  caffe_set(bottom->count(), Dtype(0), bottom->mutable_cpu_data());
+  for (int n = 0; n < 2; ++n) {
+    for (int a = 0; a < 2; ++a) {
+      for (int t = 4; t < 7; ++t) {
+        for (int c = 0; c < 4; ++c) {
+          this->logit(n, a, t, c) = -10;
+        }
+      }
+    }
+  }
+  // Image 0, top left cell: both anchors find the same box, class 0 is
+  // suppressed for the weaker one while its class 1 is the only candidate.
+  this->logit(0, 0, 4, 0) = 10;
+  this->logit(0, 0, 5, 0) = 10;
+  this->logit(0, 1, 4, 0) = 10;
+  this->logit(0, 1, 5, 0) = 1;
+  this->logit(0, 1, 6, 0) = 3;
+  // Image 0, bottom right cell: class 0 barely overlapping the first box.
+  this->logit(0, 0, 4, 3) = 10;
+  this->logit(0, 0, 5, 3) = 10;
+  // Its second anchor sits exactly on the objectness threshold.
+  this->logit(0, 1, 4, 3) = 0;
+  this->logit(0, 1, 5, 3) = 10;
+  // Image 1, top right cell: class 1.
+  this->logit(1, 0, 4, 1) = 10;
+  this->logit(1, 0, 6, 1) = 10;
+
+  Yolov3DetectionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->count(), 2 * (7 * 8 + 64));
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype s10 = 1 / (1 + std::exp(Dtype(-10)));
+  const Dtype s3 = 1 / (1 + std::exp(Dtype(-3)));
+  ASSERT_EQ(top_data[0], 4);
+  for (int i = 1; i < 64; ++i) {
+    EXPECT_EQ(top_data[i], -1);
+  }
+  const Dtype* det = top_data + 64;
+  this->CheckDetection(det, 0, 0, s10 * s10, 0, 0, 0.5, 0.5);
+  this->CheckDetection(det + 7, 0, 1, s10 * s3, 0, 0, 0.5, 0.5);
+  this->CheckDetection(det + 14, 0, 0, s10 * s10, 0.5, 0.5, 1, 1);
+  this->CheckDetection(det + 21, 1, 1, s10 * s10, 0.5, 0, 1, 0.5);
+  for (int i = 64 + 4 * 7; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(top_data[i], -1);
+  }
+}
+
 #ifdef USE_MLU
 // yolov3_detection should have the same result with detection_out
 // using the same input data scrap from example/yolov3 detecting one picture
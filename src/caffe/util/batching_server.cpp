@@ -0,0 +1,253 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/batching_server.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Latencies kept for the percentiles of BatchingServer::stats().
+const size_t kLatencyWindow = 8192;
+
+// Nearest rank percentile, reorders values.
+double Percentile(vector<double>* values, double q) {
+  if (values->empty()) {
+    return 0;
+  }
+  const int rank = static_cast<int>(std::ceil(q * values->size())) - 1;
+  const size_t k = std::min<size_t>(std::max(rank, 0), values->size() - 1);
+  std::nth_element(values->begin(), values->begin() + k, values->end());
+  return (*values)[k];
+}
+
+}  // namespace
+
+template <typename Dtype>
+BatchingServer<Dtype>::BatchingServer(const vector<Net<Dtype>*>& nets,
+    int max_batch, double max_delay_ms)
+  : max_batch_(max_batch),
+    max_delay_(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(max_delay_ms))),
+    stop_(false) {
+  CHECK(!nets.empty()) << "A BatchingServer needs at least one net";
+  CHECK_GT(max_batch, 0);
+  CHECK_GE(max_delay_ms, 0);
+  const vector<Blob<Dtype>*>& inputs = nets[0]->input_blobs();
+  CHECK(!inputs.empty()) << "The net has no Input layers";
+  for (int i = 0; i < inputs.size(); ++i) {
+    CHECK_GE(inputs[i]->num_axes(), 1) << "Input " << i << " has no batch";
+    input_counts_.push_back(inputs[i]->count(1));
+  }
+  for (int n = 0; n < nets.size(); ++n) {
+    CHECK_EQ(nets[n]->phase(), TEST) << "Only TEST nets can be served";
+    CHECK_EQ(nets[n]->input_blobs().size(), input_counts_.size())
+        << "All nets must take the same inputs";
+    for (int i = 0; i < input_counts_.size(); ++i) {
+      CHECK_EQ(nets[n]->input_blobs()[i]->count(1), input_counts_[i])
+          << "All nets must take the same inputs";
+    }
+  }
+  ResetStats();
+  for (int n = 0; n < nets.size(); ++n) {
+    workers_.push_back(std::thread(&BatchingServer::Work, this, nets[n]));
+  }
+}
+
+template <typename Dtype>
+BatchingServer<Dtype>::~BatchingServer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  ready_.notify_all();
+  // The workers answer the queued requests before they leave.
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+template <typename Dtype>
+std::future<typename BatchingServer<Dtype>::Sample>
+BatchingServer<Dtype>::Submit(Sample inputs) {
+  CHECK_EQ(inputs.size(), input_counts_.size()) << "One sample per input";
+  for (int i = 0; i < inputs.size(); ++i) {
+    CHECK_EQ(inputs[i].size(), input_counts_[i])
+        << "Input " << i << " takes " << input_counts_[i] << " values";
+  }
+  Request request;
+  request.inputs.swap(inputs);
+  request.arrival = Clock::now();
+  std::future<Sample> result = request.result.get_future();
+  size_t queued;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(!stop_);
+    queue_.push_back(std::move(request));
+    queued = queue_.size();
+  }
+  // Wake an idle worker for a new batch, or the one waiting on a full one.
+  if (queued == 1 || queued >= static_cast<size_t>(max_batch_)) {
+    ready_.notify_all();
+  }
+  return result;
+}
+
+template <typename Dtype>
+void BatchingServer<Dtype>::Work(Net<Dtype>* net) {
+  Caffe::set_thread_state(net->thread_state());
+  vector<Request> batch;
+  while (true) {
+    bool more;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      // Wait for a full batch until the oldest request is due.
+      const Clock::time_point due = queue_.front().arrival + max_delay_;
+      const size_t full = max_batch_;
+      ready_.wait_until(lock, due, [this, full]() {
+        return stop_ || queue_.empty() || queue_.size() >= full;
+      });
+      if (queue_.empty()) {
+        continue;  // another worker took them
+      }
+      const int num = std::min<size_t>(queue_.size(), max_batch_);
+      for (int i = 0; i < num; ++i) {
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+      more = !queue_.empty();
+    }
+    if (more) {
+      ready_.notify_all();
+    }
+    Forward(net, &batch);
+    batch.clear();
+  }
+}
+
+template <typename Dtype>
+void BatchingServer<Dtype>::Forward(Net<Dtype>* net,
+                                    vector<Request>* batch) {
+  const int num = batch->size();
+  const vector<Blob<Dtype>*>& inputs = net->input_blobs();
+  const bool resized = inputs[0]->shape(0) != num;
+  for (int i = 0; i < inputs.size(); ++i) {
+    vector<int> shape = inputs[i]->shape();
+    shape[0] = num;
+    inputs[i]->Reshape(shape);
+    const int count = input_counts_[i];
+    Dtype* data = inputs[i]->mutable_cpu_data();
+    for (int r = 0; r < num; ++r) {
+      caffe_copy(count, (*batch)[r].inputs[i].data(), data + r * count);
+    }
+  }
+  // Resize the activations, and their memory plan, for the new batch size.
+  if (resized) {
+    net->Reshape();
+  }
+  net->Forward();
+  const vector<Blob<Dtype>*>& outputs = net->output_blobs();
+  for (int o = 0; o < outputs.size(); ++o) {
+    CHECK(outputs[o]->num_axes() >= 1 && outputs[o]->shape(0) == num)
+        << "Output " << o << " is not batched along its first axis";
+  }
+  vector<Sample> results(num, Sample(outputs.size()));
+  for (int r = 0; r < num; ++r) {
+    for (int o = 0; o < outputs.size(); ++o) {
+      const int count = outputs[o]->count(1);
+      const Dtype* data = outputs[o]->cpu_data() + r * count;
+      results[r][o].assign(data, data + count);
+    }
+  }
+  // Count the batch before answering, so that the counters cover every
+  // result a caller has got.
+  const Clock::time_point done = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.requests += num;
+    stats_.batches++;
+    if (num == max_batch_) {
+      stats_.full_batches++;
+    }
+    for (int r = 0; r < num; ++r) {
+      const double ms = std::chrono::duration<double, std::milli>(
+          done - (*batch)[r].arrival).count();
+      if (latencies_ms_.size() < kLatencyWindow) {
+        latencies_ms_.push_back(ms);
+      } else {
+        latencies_ms_[next_latency_] = ms;
+      }
+      next_latency_ = (next_latency_ + 1) % kLatencyWindow;
+    }
+  }
+  for (int r = 0; r < num; ++r) {
+    (*batch)[r].result.set_value(std::move(results[r]));
+  }
+}
+
+template <typename Dtype>
+BatchingStats BatchingServer<Dtype>::stats() {
+  BatchingStats stats;
+  vector<double> latencies;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats = stats_;
+    latencies = latencies_ms_;
+  }
+  stats.p50_ms = Percentile(&latencies, 0.5);
+  stats.p99_ms = Percentile(&latencies, 0.99);
+  return stats;
+}
+
+template <typename Dtype>
+void BatchingServer<Dtype>::ResetStats() {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.requests = 0;
+  stats_.batches = 0;
+  stats_.full_batches = 0;
+  stats_.max_batch = max_batch_;
+  stats_.p50_ms = 0;
+  stats_.p99_ms = 0;
+  latencies_ms_.clear();
+  next_latency_ = 0;
+}
+
+INSTANTIATE_CLASS(BatchingServer);
+
+}  // namespace caffe
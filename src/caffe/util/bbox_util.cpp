@@ -904,72 +904,15 @@ void ApplyNMS(const vector<NormalizedBBox>& bboxes, const vector<float>& scores,
   CHECK_EQ(bboxes.size(), scores.size())
       << "bboxes and scores have different size.";
 
-  // Get top_k scores (with corresponding indices).
-  vector<int> idx(boost::counting_iterator<int>(0),
-                  boost::counting_iterator<int>(scores.size()));
-  vector<pair<float, int> > score_index_vec;
-  GetTopKScoreIndex(scores, idx, top_k, &score_index_vec);
-
-  // Do nms.
-  indices->clear();
-  while (score_index_vec.size() != 0) {
-    // Get the current highest score box.
-    int best_idx = score_index_vec.front().second;
-    const NormalizedBBox& best_bbox = bboxes[best_idx];
-    if (BBoxSize(best_bbox) < 1e-5) {
-      // Erase small box.
-      score_index_vec.erase(score_index_vec.begin());
-      continue;
-    }
-    indices->push_back(best_idx);
-    // Erase the best box.
-    score_index_vec.erase(score_index_vec.begin());
-
-    if (top_k > -1 && indices->size() >= top_k) {
-      // Stop if finding enough bboxes for nms.
-      break;
-    }
-
-    // Compute overlap between best_bbox and other remaining bboxes.
-    // Remove a bbox if the overlap with best_bbox is larger than nms_threshold.
-    for (vector<pair<float, int> >::iterator it = score_index_vec.begin();
-         it != score_index_vec.end(); ) {
-      int cur_idx = it->second;
-      const NormalizedBBox& cur_bbox = bboxes[cur_idx];
-      if (BBoxSize(cur_bbox) < 1e-5) {
-        // Erase small box.
-        it = score_index_vec.erase(it);
-        continue;
-      }
-      float cur_overlap = 0.;
-      if (reuse_overlaps) {
-        if (overlaps->find(best_idx) != overlaps->end() &&
-            overlaps->find(best_idx)->second.find(cur_idx) !=
-            (*overlaps)[best_idx].end()) {
-          // Use the computed overlap.
-          cur_overlap = (*overlaps)[best_idx][cur_idx];
-        } else if (overlaps->find(cur_idx) != overlaps->end() &&
-                   overlaps->find(cur_idx)->second.find(best_idx) !=
-                   (*overlaps)[cur_idx].end()) {
-          // Use the computed overlap.
-          cur_overlap = (*overlaps)[cur_idx][best_idx];
-        } else {
-          cur_overlap = JaccardOverlap(best_bbox, cur_bbox);
-          // Store the overlap for future use.
-          (*overlaps)[best_idx][cur_idx] = cur_overlap;
-        }
-      } else {
-        cur_overlap = JaccardOverlap(best_bbox, cur_bbox);
-      }
-
-      // Remove it if necessary
-      if (cur_overlap > threshold) {
-        it = score_index_vec.erase(it);
-      } else {
-        ++it;
-      }
-    }
-  }
+  NMSBoxes boxes;
+  GetNMSBoxes(bboxes, &boxes);
+  NMSParam param;
+  param.overlap_threshold = threshold;
+  param.top_k = top_k;
+  param.keep_top_k = top_k;
+  // Small boxes are erased rather than kept.
+  param.min_area = 1e-5;
+  NonMaxSuppression(boxes, scores.data(), param, indices);
 }
 
 void ApplyNMS(const bool* overlapped, const int num, vector<int>* indices) {
@@ -1023,28 +966,23 @@ void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
   CHECK_EQ(bboxes.size(), scores.size())
       << "bboxes and scores have different size.";
 
-  // Get top_k scores (with corresponding indices).
-  vector<pair<float, int> > score_index_vec;
-  GetMaxScoreIndex(scores, score_threshold, top_k, &score_index_vec);
+  NMSBoxes boxes;
+  GetNMSBoxes(bboxes, &boxes);
+  NMSParam param;
+  param.score_threshold = score_threshold;
+  param.overlap_threshold = nms_threshold;
+  param.top_k = top_k;
+  NonMaxSuppression(boxes, scores.data(), param, indices);
+}
 
-  // Do nms.
-  indices->clear();
-  while (score_index_vec.size() != 0) {
-    const int idx = score_index_vec.front().second;
-    bool keep = true;
-    for (int k = 0; k < indices->size(); ++k) {
-      if (keep) {
-        const int kept_idx = (*indices)[k];
-        float overlap = JaccardOverlap(bboxes[idx], bboxes[kept_idx]);
-        keep = overlap <= nms_threshold;
-      } else {
-        break;
-      }
-    }
-    if (keep) {
-      indices->push_back(idx);
-    }
-    score_index_vec.erase(score_index_vec.begin());
+void GetNMSBoxes(const vector<NormalizedBBox>& bboxes, NMSBoxes* boxes) {
+  boxes->clear();
+  boxes->normalized = true;
+  boxes->reserve(bboxes.size());
+  for (int i = 0; i < bboxes.size(); ++i) {
+    const NormalizedBBox& bbox = bboxes[i];
+    boxes->push_back(bbox.xmin(), bbox.ymin(), bbox.xmax(), bbox.ymax(),
+                     BBoxSize(bbox));
   }
 }
 
@@ -122,6 +122,7 @@ template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
 template class BlockingQueue<void**>;
 template class BlockingQueue<float*>;
+template class BlockingQueue<int>;
 template class BlockingQueue<vector<string>>;
 
 }  // namespace caffe
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/util/db.hpp"
 #include "caffe/util/db_leveldb.hpp"
 #include "caffe/util/db_lmdb.hpp"
+#include "caffe/util/format.hpp"
 
 #include <string>
 
@@ -66,5 +67,14 @@ DB* GetDB(const string& backend) {
   return NULL;
 }
 
+string ShardSource(const string& source, int shard, int shards) {
+  CHECK_GE(shard, 0);
+  CHECK_LT(shard, shards);
+  if (shards == 1) {
+    return source;
+  }
+  return source + "-" + format_int(shard, 5) + "-of-" + format_int(shards, 5);
+}
+
 }  // namespace db
 }  // namespace caffe
@@ -0,0 +1,453 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DEPTHWISE_CONV_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/util/depthwise_conv.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// [*begin, *end) are the outputs o whose input o * stride - pad + offset
+// falls inside [0, size).
+inline void valid_range(const int out_size, const int size, const int pad,
+    const int stride, const int offset, int* begin, int* end) {
+  const int lo = pad - offset;
+  const int hi = size - 1 + pad - offset;
+  *begin = lo <= 0 ? 0 : std::min(out_size, (lo + stride - 1) / stride);
+  *end = hi < 0 ? 0 : std::min(out_size, hi / stride + 1);
+  *end = std::max(*begin, *end);
+}
+
+// Adds weight * input to every output it reaches, one kernel tap at a time,
+// so the inner loops run without bounds checks. The sums are of type Acc,
+// int32_t for int8 inputs.
+template <typename Dtype, typename Acc>
+void forward_plane_scalar(const Dtype* in, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const Dtype* weight, const Acc bias, Acc* out) {
+  std::fill(out, out + output_h * output_w, bias);
+  for (int kh = 0; kh < kernel_h; ++kh) {
+    int oh_begin, oh_end;
+    valid_range(output_h, height, pad_htop, stride_h, kh * dilation_h,
+                &oh_begin, &oh_end);
+    for (int kw = 0; kw < kernel_w; ++kw) {
+      int ow_begin, ow_end;
+      valid_range(output_w, width, pad_wleft, stride_w, kw * dilation_w,
+                  &ow_begin, &ow_end);
+      const Acc w = weight[kh * kernel_w + kw];
+      for (int oh = oh_begin; oh < oh_end; ++oh) {
+        const Dtype* in_row = in + (oh * stride_h - pad_htop +
+            kh * dilation_h) * width;
+        Acc* out_row = out + oh * output_w;
+        const int iw = kw * dilation_w - pad_wleft;
+        if (stride_w == 1) {
+          for (int ow = ow_begin; ow < ow_end; ++ow) {
+            out_row[ow] += w * in_row[ow + iw];
+          }
+        } else {
+          for (int ow = ow_begin; ow < ow_end; ++ow) {
+            out_row[ow] += w * in_row[ow * stride_w + iw];
+          }
+        }
+      }
+    }
+  }
+}
+
+// Computes out[i] for i in [0, n) of one output row whose kernel rows
+// [kh_begin, kh_end) are inside the image and whose kernel columns are all
+// inside the row; output i reads column iw0 + i * stride_w + kw * dilation_w.
+// Returns how many outputs were computed, the caller finishes the rest.
+typedef int (*RowKernel)(const float* in, const int width, const int ih0,
+    const int dilation_h, const int kh_begin, const int kh_end,
+    const float* weight, const int kernel_w, const int stride_w,
+    const int dilation_w, const int iw0, const int n, const float bias,
+    float* out);
+
+#ifdef DEPTHWISE_CONV_X86
+__attribute__((target("avx2,fma")))
+int row_kernel_avx2(const float* in, const int width, const int ih0,
+    const int dilation_h, const int kh_begin, const int kh_end,
+    const float* weight, const int kernel_w, const int stride_w,
+    const int dilation_w, const int iw0, const int n, const float bias,
+    float* out) {
+  if (stride_w > 2) {
+    return 0;
+  }
+  // A stride 2 block loads one column past its last input.
+  const int last = iw0 + (kernel_w - 1) * dilation_w + stride_w - 1;
+  int i = 0;
+  for (; i + 8 <= n && last + (i + 7) * stride_w < width; i += 8) {
+    __m256 acc = _mm256_set1_ps(bias);
+    for (int kh = kh_begin; kh < kh_end; ++kh) {
+      const float* row = in + (ih0 + kh * dilation_h) * width + iw0 +
+          i * stride_w;
+      const float* w = weight + kh * kernel_w;
+      for (int kw = 0; kw < kernel_w; ++kw) {
+        const float* p = row + kw * dilation_w;
+        __m256 v;
+        if (stride_w == 1) {
+          v = _mm256_loadu_ps(p);
+        } else {
+          // a0 a2 b0 b2 | a4 a6 b4 b6, then reorder the 64-bit lanes.
+          __m256 t = _mm256_shuffle_ps(_mm256_loadu_ps(p),
+              _mm256_loadu_ps(p + 8), _MM_SHUFFLE(2, 0, 2, 0));
+          v = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(t),
+              _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(w[kw]), v, acc);
+      }
+    }
+    _mm256_storeu_ps(out + i, acc);
+  }
+  return i;
+}
+
+__attribute__((target("avx512f")))
+int row_kernel_avx512(const float* in, const int width, const int ih0,
+    const int dilation_h, const int kh_begin, const int kh_end,
+    const float* weight, const int kernel_w, const int stride_w,
+    const int dilation_w, const int iw0, const int n, const float bias,
+    float* out) {
+  if (stride_w > 2) {
+    return 0;
+  }
+  const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18,
+                                         20, 22, 24, 26, 28, 30);
+  const int last = iw0 + (kernel_w - 1) * dilation_w + stride_w - 1;
+  int i = 0;
+  for (; i + 16 <= n && last + (i + 15) * stride_w < width; i += 16) {
+    __m512 acc = _mm512_set1_ps(bias);
+    for (int kh = kh_begin; kh < kh_end; ++kh) {
+      const float* row = in + (ih0 + kh * dilation_h) * width + iw0 +
+          i * stride_w;
+      const float* w = weight + kh * kernel_w;
+      for (int kw = 0; kw < kernel_w; ++kw) {
+        const float* p = row + kw * dilation_w;
+        __m512 v;
+        if (stride_w == 1) {
+          v = _mm512_loadu_ps(p);
+        } else {
+          v = _mm512_permutex2var_ps(_mm512_loadu_ps(p), even,
+                                     _mm512_loadu_ps(p + 16));
+        }
+        acc = _mm512_fmadd_ps(_mm512_set1_ps(w[kw]), v, acc);
+      }
+    }
+    _mm512_storeu_ps(out + i, acc);
+  }
+  return i;
+}
+#endif  // DEPTHWISE_CONV_X86
+
+struct RowKernelInfo {
+  RowKernel kernel;
+  const char* isa;
+};
+
+RowKernelInfo select_row_kernel() {
+  RowKernelInfo info = {NULL, "scalar"};
+#ifdef DEPTHWISE_CONV_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    info.kernel = row_kernel_avx512;
+    info.isa = "avx512";
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    info.kernel = row_kernel_avx2;
+    info.isa = "avx2";
+  }
+#endif
+  return info;
+}
+
+const RowKernelInfo& row_kernel() {
+  static const RowKernelInfo info = select_row_kernel();
+  return info;
+}
+
+// One output of a row whose kernel rows [kh_begin, kh_end) are inside the
+// image, checking the columns.
+inline float forward_point(const float* in, const int width, const int ih0,
+    const int dilation_h, const int kh_begin, const int kh_end,
+    const float* weight, const int kernel_w, const int dilation_w,
+    const int iw, const float bias) {
+  float acc = bias;
+  for (int kh = kh_begin; kh < kh_end; ++kh) {
+    const float* row = in + (ih0 + kh * dilation_h) * width;
+    for (int kw = 0; kw < kernel_w; ++kw) {
+      const int col = iw + kw * dilation_w;
+      if (col >= 0 && col < width) {
+        acc += weight[kh * kernel_w + kw] * row[col];
+      }
+    }
+  }
+  return acc;
+}
+
+// Row by row: the borders go through forward_point, the interior through
+// the vector kernel.
+void forward_plane_simd(RowKernel kernel, const float* in, const int height,
+    const int width, const int kernel_h, const int kernel_w,
+    const int pad_htop, const int pad_wleft, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, const float* weight,
+    const float bias, float* out) {
+  // Outputs whose first and last kernel column are both inside the row.
+  int ow_begin, ow_end, unused;
+  valid_range(output_w, width, pad_wleft, stride_w, 0, &ow_begin, &unused);
+  valid_range(output_w, width, pad_wleft, stride_w,
+              (kernel_w - 1) * dilation_w, &unused, &ow_end);
+  ow_end = std::max(ow_begin, ow_end);
+  for (int oh = 0; oh < output_h; ++oh) {
+    const int ih0 = oh * stride_h - pad_htop;
+    int kh_begin = 0;
+    int kh_end = kernel_h;
+    while (kh_begin < kernel_h && ih0 + kh_begin * dilation_h < 0) {
+      ++kh_begin;
+    }
+    while (kh_end > kh_begin && ih0 + (kh_end - 1) * dilation_h >= height) {
+      --kh_end;
+    }
+    float* out_row = out + oh * output_w;
+    int ow = 0;
+    for (; ow < ow_begin; ++ow) {
+      out_row[ow] = forward_point(in, width, ih0, dilation_h, kh_begin,
+          kh_end, weight, kernel_w, dilation_w, ow * stride_w - pad_wleft,
+          bias);
+    }
+    ow += kernel(in, width, ih0, dilation_h, kh_begin, kh_end, weight,
+                 kernel_w, stride_w, dilation_w, ow * stride_w - pad_wleft,
+                 ow_end - ow, bias, out_row + ow);
+    for (; ow < output_w; ++ow) {
+      out_row[ow] = forward_point(in, width, ih0, dilation_h, kh_begin,
+          kh_end, weight, kernel_w, dilation_w, ow * stride_w - pad_wleft,
+          bias);
+    }
+  }
+}
+
+template <typename Dtype>
+void forward_plane(const Dtype* in, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const Dtype* weight, const Dtype bias, Dtype* out) {
+  forward_plane_scalar(in, height, width, kernel_h, kernel_w, pad_htop,
+      pad_wleft, stride_h, stride_w, dilation_h, dilation_w, output_h,
+      output_w, weight, bias, out);
+}
+
+template <>
+void forward_plane<float>(const float* in, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const float* weight, const float bias, float* out) {
+  RowKernel kernel = row_kernel().kernel;
+  if (kernel && stride_w <= 2) {
+    forward_plane_simd(kernel, in, height, width, kernel_h, kernel_w,
+        pad_htop, pad_wleft, stride_h, stride_w, dilation_h, dilation_w,
+        output_h, output_w, weight, bias, out);
+  } else {
+    forward_plane_scalar(in, height, width, kernel_h, kernel_w, pad_htop,
+        pad_wleft, stride_h, stride_w, dilation_h, dilation_w, output_h,
+        output_w, weight, bias, out);
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void depthwise_conv_cpu(const Dtype* data_im, const int channels,
+    const int multiplier, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const Dtype* weight, const Dtype* bias,
+    Dtype* data_out) {
+  const int kernel_dim = kernel_h * kernel_w;
+  const int output_dim = output_h * output_w;
+  caffe_parallel_for(channels * multiplier, output_dim * kernel_dim,
+      [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      forward_plane(data_im + (c / multiplier) * height * width, height,
+          width, kernel_h, kernel_w, pad_htop, pad_wleft, stride_h, stride_w,
+          dilation_h, dilation_w, output_h, output_w,
+          weight + c * kernel_dim, bias ? bias[c] : Dtype(0),
+          data_out + c * output_dim);
+    }
+  });
+}
+
+void depthwise_conv_int8_cpu(const int8_t* data_im, const int channels,
+    const int multiplier, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_htop,
+    const int pad_wleft, const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, const int output_h,
+    const int output_w, const int8_t* weight, int32_t* data_out) {
+  const int kernel_dim = kernel_h * kernel_w;
+  const int output_dim = output_h * output_w;
+  caffe_parallel_for(channels * multiplier, output_dim * kernel_dim,
+      [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      forward_plane_scalar(data_im + (c / multiplier) * height * width,
+          height, width, kernel_h, kernel_w, pad_htop, pad_wleft, stride_h,
+          stride_w, dilation_h, dilation_w, output_h, output_w,
+          weight + c * kernel_dim, int32_t(0), data_out + c * output_dim);
+    }
+  });
+}
+
+template <typename Dtype>
+void depthwise_conv_backward_data_cpu(const Dtype* top_diff,
+    const int channels, const int multiplier, const int height,
+    const int width, const int kernel_h, const int kernel_w,
+    const int pad_htop, const int pad_wleft, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int output_h, const int output_w, const Dtype* weight,
+    Dtype* data_im_diff) {
+  const int kernel_dim = kernel_h * kernel_w;
+  const int output_dim = output_h * output_w;
+  // Each input channel gathers from its own multiplier output channels.
+  caffe_parallel_for(channels, multiplier * output_dim * kernel_dim,
+      [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      Dtype* in_diff = data_im_diff + c * height * width;
+      caffe_set(height * width, Dtype(0), in_diff);
+      for (int m = 0; m < multiplier; ++m) {
+        const int o = c * multiplier + m;
+        const Dtype* out_diff = top_diff + o * output_dim;
+        for (int kh = 0; kh < kernel_h; ++kh) {
+          int oh_begin, oh_end;
+          valid_range(output_h, height, pad_htop, stride_h, kh * dilation_h,
+                      &oh_begin, &oh_end);
+          for (int kw = 0; kw < kernel_w; ++kw) {
+            int ow_begin, ow_end;
+            valid_range(output_w, width, pad_wleft, stride_w,
+                        kw * dilation_w, &ow_begin, &ow_end);
+            const Dtype w = weight[o * kernel_dim + kh * kernel_w + kw];
+            const int iw = kw * dilation_w - pad_wleft;
+            for (int oh = oh_begin; oh < oh_end; ++oh) {
+              Dtype* in_row = in_diff + (oh * stride_h - pad_htop +
+                  kh * dilation_h) * width;
+              const Dtype* out_row = out_diff + oh * output_w;
+              for (int ow = ow_begin; ow < ow_end; ++ow) {
+                in_row[ow * stride_w + iw] += w * out_row[ow];
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void depthwise_conv_backward_weight_cpu(const Dtype* top_diff,
+    const Dtype* data_im, const int channels, const int multiplier,
+    const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_htop, const int pad_wleft,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, const int output_h, const int output_w,
+    Dtype* weight_diff) {
+  const int kernel_dim = kernel_h * kernel_w;
+  const int output_dim = output_h * output_w;
+  caffe_parallel_for(channels * multiplier, output_dim * kernel_dim,
+      [&](int begin, int end) {
+    for (int o = begin; o < end; ++o) {
+      const Dtype* in = data_im + (o / multiplier) * height * width;
+      const Dtype* out_diff = top_diff + o * output_dim;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int oh_begin, oh_end;
+        valid_range(output_h, height, pad_htop, stride_h, kh * dilation_h,
+                    &oh_begin, &oh_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int ow_begin, ow_end;
+          valid_range(output_w, width, pad_wleft, stride_w, kw * dilation_w,
+                      &ow_begin, &ow_end);
+          const int iw = kw * dilation_w - pad_wleft;
+          Dtype sum = 0;
+          for (int oh = oh_begin; oh < oh_end; ++oh) {
+            const Dtype* in_row = in + (oh * stride_h - pad_htop +
+                kh * dilation_h) * width;
+            const Dtype* out_row = out_diff + oh * output_w;
+            for (int ow = ow_begin; ow < ow_end; ++ow) {
+              sum += out_row[ow] * in_row[ow * stride_w + iw];
+            }
+          }
+          weight_diff[o * kernel_dim + kh * kernel_w + kw] += sum;
+        }
+      }
+    }
+  });
+}
+
+const char* depthwise_conv_isa() {
+  return row_kernel().isa;
+}
+
+// Explicit instantiation
+#define INSTANTIATE_DEPTHWISE_CONV(Dtype) \
+template void depthwise_conv_cpu<Dtype>(const Dtype* data_im, \
+    const int channels, const int multiplier, const int height, \
+    const int width, const int kernel_h, const int kernel_w, \
+    const int pad_htop, const int pad_wleft, const int stride_h, \
+    const int stride_w, const int dilation_h, const int dilation_w, \
+    const int output_h, const int output_w, const Dtype* weight, \
+    const Dtype* bias, Dtype* data_out); \
+template void depthwise_conv_backward_data_cpu<Dtype>(const Dtype* top_diff, \
+    const int channels, const int multiplier, const int height, \
+    const int width, const int kernel_h, const int kernel_w, \
+    const int pad_htop, const int pad_wleft, const int stride_h, \
+    const int stride_w, const int dilation_h, const int dilation_w, \
+    const int output_h, const int output_w, const Dtype* weight, \
+    Dtype* data_im_diff); \
+template void depthwise_conv_backward_weight_cpu<Dtype>( \
+    const Dtype* top_diff, const Dtype* data_im, const int channels, \
+    const int multiplier, const int height, const int width, \
+    const int kernel_h, const int kernel_w, const int pad_htop, \
+    const int pad_wleft, const int stride_h, const int stride_w, \
+    const int dilation_h, const int dilation_w, const int output_h, \
+    const int output_w, Dtype* weight_diff)
+
+INSTANTIATE_DEPTHWISE_CONV(float);
+INSTANTIATE_DEPTHWISE_CONV(double);
+
+}  // namespace caffe
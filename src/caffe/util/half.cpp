@@ -0,0 +1,245 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HALF_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+namespace {
+
+inline uint32_t float_bits(const float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+inline float bits_float(const uint32_t bits) {
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// The branchless conversions of the FP16 library by Marat Dukhan: float
+// arithmetic does the rounding and the subnormals.
+inline uint16_t fp16_from_float(const float f) {
+  const float scale_to_inf = bits_float(0x77800000);   // 2^112
+  const float scale_to_zero = bits_float(0x08800000);  // 2^-110
+  float base = (std::fabs(f) * scale_to_inf) * scale_to_zero;
+  const uint32_t w = float_bits(f);
+  const uint32_t shl1_w = w + w;
+  const uint32_t sign = w & 0x80000000u;
+  uint32_t bias = shl1_w & 0xFF000000u;
+  if (bias < 0x71000000u) {
+    bias = 0x71000000u;
+  }
+  base = bits_float((bias >> 1) + 0x07800000u) + base;
+  const uint32_t bits = float_bits(base);
+  const uint32_t exp_bits = (bits >> 13) & 0x00007C00u;
+  const uint32_t mantissa_bits = bits & 0x00000FFFu;
+  const uint32_t nonsign = exp_bits + mantissa_bits;
+  return (sign >> 16) | (shl1_w > 0xFF000000u ? 0x7E00u : nonsign);
+}
+
+inline float fp16_to_float(const uint16_t h) {
+  const uint32_t w = static_cast<uint32_t>(h) << 16;
+  const uint32_t sign = w & 0x80000000u;
+  const uint32_t two_w = w + w;
+  const float normalized =
+      bits_float((two_w >> 4) + (0xE0u << 23)) * bits_float(0x07800000);
+  const float denormalized = bits_float((two_w >> 17) | (126u << 23)) - 0.5f;
+  return bits_float(sign | (two_w < (1u << 27) ? float_bits(denormalized)
+                                               : float_bits(normalized)));
+}
+
+inline uint16_t bf16_from_float(const float f) {
+  const uint32_t bits = float_bits(f);
+  if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+    return (bits >> 16) | 0x40;  // quiet NaN
+  }
+  return (bits + 0x7FFFu + ((bits >> 16) & 1)) >> 16;
+}
+
+inline float bf16_to_float(const uint16_t h) {
+  return bits_float(static_cast<uint32_t>(h) << 16);
+}
+
+template <typename Dtype>
+void to_half_scalar(const int n, const Dtype* x, const BaseDataType type,
+    uint16_t* y) {
+  if (type == DT_FLOAT16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = fp16_from_float(static_cast<float>(x[i]));
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = bf16_from_float(static_cast<float>(x[i]));
+    }
+  }
+}
+
+template <typename Dtype>
+void from_half_scalar(const int n, const uint16_t* x, const BaseDataType type,
+    Dtype* y) {
+  if (type == DT_FLOAT16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = fp16_to_float(x[i]);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = bf16_to_float(x[i]);
+    }
+  }
+}
+
+#ifdef HALF_X86
+// Returns how many values were converted, the rest is left to the scalar
+// loop.
+__attribute__((target("avx2,f16c")))
+int to_half_avx2(const int n, const float* x, const BaseDataType type,
+    uint16_t* y) {
+  int i = 0;
+  if (type == DT_FLOAT16) {
+    for (; i + 8 <= n; i += 8) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+          _mm256_cvtps_ph(_mm256_loadu_ps(x + i),
+                          _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    return i;
+  }
+  const __m256i round = _mm256_set1_epi32(0x7FFF);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i quiet = _mm256_set1_epi32(0x40);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_loadu_ps(x + i);
+    const __m256i bits = _mm256_castps_si256(v);
+    const __m256i upper = _mm256_srli_epi32(bits, 16);
+    const __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits,
+        _mm256_add_epi32(round, _mm256_and_si256(upper, one))), 16);
+    const __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q));
+    const __m256i r = _mm256_blendv_epi8(rounded,
+        _mm256_or_si256(upper, quiet), nan);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+        _mm_packus_epi32(_mm256_castsi256_si128(r),
+                         _mm256_extracti128_si256(r, 1)));
+  }
+  return i;
+}
+
+__attribute__((target("avx2,f16c")))
+int from_half_avx2(const int n, const uint16_t* x, const BaseDataType type,
+    float* y) {
+  int i = 0;
+  if (type == DT_FLOAT16) {
+    for (; i + 8 <= n; i += 8) {
+      _mm256_storeu_ps(y + i, _mm256_cvtph_ps(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(x + i))));
+    }
+    return i;
+  }
+  for (; i + 8 <= n; i += 8) {
+    const __m256i h = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+    _mm256_storeu_ps(y + i, _mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+  }
+  return i;
+}
+
+// Every x86 CPU with AVX2 has F16C as well.
+bool use_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif  // HALF_X86
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_to_half(const int n, const Dtype* x, const BaseDataType type,
+    uint16_t* y) {
+  CHECK(IsHalfType(type)) << "Not a 16 bit type: " << BaseDataType_Name(type);
+  to_half_scalar(n, x, type, y);
+}
+
+template <>
+void caffe_cpu_to_half(const int n, const float* x, const BaseDataType type,
+    uint16_t* y) {
+  CHECK(IsHalfType(type)) << "Not a 16 bit type: " << BaseDataType_Name(type);
+  int done = 0;
+#ifdef HALF_X86
+  if (use_avx2()) {
+    done = to_half_avx2(n, x, type, y);
+  }
+#endif
+  to_half_scalar(n - done, x + done, type, y + done);
+}
+
+template <typename Dtype>
+void caffe_cpu_from_half(const int n, const uint16_t* x,
+    const BaseDataType type, Dtype* y) {
+  CHECK(IsHalfType(type)) << "Not a 16 bit type: " << BaseDataType_Name(type);
+  from_half_scalar(n, x, type, y);
+}
+
+template <>
+void caffe_cpu_from_half(const int n, const uint16_t* x,
+    const BaseDataType type, float* y) {
+  CHECK(IsHalfType(type)) << "Not a 16 bit type: " << BaseDataType_Name(type);
+  int done = 0;
+#ifdef HALF_X86
+  if (use_avx2()) {
+    done = from_half_avx2(n, x, type, y);
+  }
+#endif
+  from_half_scalar(n - done, x + done, type, y + done);
+}
+
+const char* half_conversion_isa() {
+#ifdef HALF_X86
+  if (use_avx2()) {
+    return "avx2";
+  }
+#endif
+  return "scalar";
+}
+
+template void caffe_cpu_to_half<double>(const int n, const double* x,
+    const BaseDataType type, uint16_t* y);
+template void caffe_cpu_from_half<double>(const int n, const uint16_t* x,
+    const BaseDataType type, double* y);
+
+}  // namespace caffe
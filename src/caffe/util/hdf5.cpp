@@ -35,11 +35,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob, bool reshape) {
+vector<int> hdf5_get_nd_dataset_shape(hid_t file_id, const char* dataset_name_,
+                                      int min_dim, int max_dim) {
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -91,7 +88,16 @@ void hdf5_load_nd_dataset_helper(
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
   }
+  return blob_dims;
+}
 
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob, bool reshape) {
+  vector<int> blob_dims =
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim);
   if (reshape) {
     blob->Reshape(blob_dims);
   } else {
@@ -133,6 +139,59 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads a hyperslab of whole rows, converted to mem_type.
+template <typename Dtype>
+static void hdf5_load_rows_helper(hid_t file_id, const char* dataset_name_,
+                                  const vector<int>& shape, int start,
+                                  int rows, hid_t mem_type, Blob<Dtype>* blob) {
+  CHECK_GE(start, 0);
+  CHECK_LE(start + rows, shape[0]) << "Rows out of range for "
+                                   << dataset_name_;
+  vector<int> blob_shape(shape);
+  blob_shape[0] = rows;
+  blob->Reshape(blob_shape);
+  vector<hsize_t> offset(shape.size(), 0);
+  vector<hsize_t> count(shape.begin(), shape.end());
+  offset[0] = start;
+  count[0] = rows;
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset);
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+                                      offset.data(), NULL, count.data(),
+                                      NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(count.size(), count.data(), NULL);
+  status = H5Dread(dataset, mem_type, mem_space, file_space, H5P_DEFAULT,
+                   blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id, const char* dataset_name_,
+                                      const vector<int>& shape, int start,
+                                      int rows, Blob<float>* blob) {
+  hdf5_load_rows_helper(file_id, dataset_name_, shape, start, rows,
+                        H5T_NATIVE_FLOAT, blob);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+                                       const char* dataset_name_,
+                                       const vector<int>& shape, int start,
+                                       int rows, Blob<double>* blob) {
+  hdf5_load_rows_helper(file_id, dataset_name_, shape, start, rows,
+                        H5T_NATIVE_DOUBLE, blob);
+}
+
+std::mutex& hdf5_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
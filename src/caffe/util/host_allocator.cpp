@@ -0,0 +1,372 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>  // NOLINT(build/c++11)
+#include <typeinfo>
+#include <vector>
+
+#ifdef USE_MKL
+  #include "mkl.h"
+#endif
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct GlobalPool {
+  std::mutex mutex;
+  std::vector<void*> blocks[PooledHostAllocator::kNumClasses];
+  bool dead;  // set once the allocator is gone
+
+  GlobalPool() : dead(false) {}
+};
+
+// Every block starts with kAlignment bytes of bookkeeping, the user pointer
+// follows them and so keeps the alignment of the system block.
+struct BlockHeader {
+  size_t size;       // usable bytes
+  GlobalPool* pool;  // the pool of the allocator that made the block
+  int size_class;    // -1 when the block bypasses the pool
+  uint32_t magic;
+};
+const uint32_t kBlockMagic = 0xCAFFE64u;
+const size_t kHugePageSize = 2 << 20;
+// Bytes a thread may cache before spilling freed blocks to the global pool.
+const size_t kThreadCacheBytes = 16 << 20;
+
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> frees(0);
+std::atomic<uint64_t> system_allocations(0);
+std::atomic<uint64_t> system_frees(0);
+std::atomic<uint64_t> bytes_in_use(0);
+std::atomic<uint64_t> bytes_cached(0);
+
+inline BlockHeader* header(void* ptr) {
+  return reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(ptr) - HostAllocator::kAlignment);
+}
+
+void* SystemAllocate(size_t size, GlobalPool* pool, int size_class,
+                     bool huge_pages) {
+  const size_t bytes = size + HostAllocator::kAlignment;
+  const bool huge = huge_pages && bytes >= kHugePageSize;
+  const size_t alignment = huge ? kHugePageSize : HostAllocator::kAlignment;
+  void* base = NULL;
+#ifdef USE_MKL
+  base = mkl_malloc(bytes, alignment);
+#else
+  if (posix_memalign(&base, alignment, bytes) != 0) {
+    base = NULL;
+  }
+#endif
+  CHECK(base) << "host allocation of size " << size << " failed";
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    // Only advisory, the kernel may still back the block with small pages.
+    madvise(base, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  system_allocations++;
+  BlockHeader* h = static_cast<BlockHeader*>(base);
+  h->size = size;
+  h->pool = pool;
+  h->size_class = size_class;
+  h->magic = kBlockMagic;
+  return static_cast<char*>(base) + HostAllocator::kAlignment;
+}
+
+void SystemFree(void* ptr) {
+  void* base = header(ptr);
+#ifdef USE_MKL
+  mkl_free(base);
+#else
+  free(base);
+#endif
+  system_frees++;
+}
+
+void PushGlobal(GlobalPool* pool, void* ptr, int size_class) {
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (!pool->dead) {
+      pool->blocks[size_class].push_back(ptr);
+      return;
+    }
+  }
+  bytes_cached -= header(ptr)->size;
+  SystemFree(ptr);
+}
+
+void* PopGlobal(GlobalPool* pool, int size_class) {
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  std::vector<void*>& blocks = pool->blocks[size_class];
+  if (blocks.empty()) {
+    return NULL;
+  }
+  void* ptr = blocks.back();
+  blocks.pop_back();
+  return ptr;
+}
+
+// What one thread caches for one pool.
+struct ThreadCache {
+  GlobalPool* pool;
+  std::vector<void*> blocks[PooledHostAllocator::kNumClasses];
+  size_t bytes;
+
+  explicit ThreadCache(GlobalPool* pool) : pool(pool), bytes(0) {}
+  void Flush() {
+    for (int c = 0; c < PooledHostAllocator::kNumClasses; ++c) {
+      for (int i = 0; i < blocks[c].size(); ++i) {
+        PushGlobal(pool, blocks[c][i], c);
+      }
+      blocks[c].clear();
+    }
+    bytes = 0;
+  }
+};
+
+// The caches of a thread, one per pool it used; there are only a few pools.
+struct ThreadCaches {
+  std::vector<ThreadCache*> caches;
+
+  ~ThreadCaches();
+  ThreadCache* Find(GlobalPool* pool) {
+    for (int i = 0; i < caches.size(); ++i) {
+      if (caches[i]->pool == pool) {
+        return caches[i];
+      }
+    }
+    caches.push_back(new ThreadCache(pool));
+    return caches.back();
+  }
+};
+
+// The caches of an exiting thread hand their blocks to the global pools;
+// frees issued after that, e.g. by thread-local blobs, go there directly.
+thread_local bool thread_cache_dead = false;
+thread_local ThreadCaches thread_caches;
+
+ThreadCaches::~ThreadCaches() {
+  for (int i = 0; i < caches.size(); ++i) {
+    caches[i]->Flush();
+    delete caches[i];
+  }
+  caches.clear();
+  thread_cache_dead = true;
+}
+
+// Frees a block of any built-in allocator: pooled blocks go back to the
+// pool that made them, so blocks never move between pools.
+void FreeBlock(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  BlockHeader* h = header(ptr);
+  CHECK_EQ(h->magic, kBlockMagic) << "not a host allocator block";
+  frees++;
+  bytes_in_use -= h->size;
+  const int c = h->size_class;
+  if (c < 0) {
+    SystemFree(ptr);
+    return;
+  }
+  bytes_cached += h->size;
+  if (!thread_cache_dead) {
+    ThreadCache* cache = thread_caches.Find(h->pool);
+    if (cache->bytes + h->size <= kThreadCacheBytes) {
+      cache->blocks[c].push_back(ptr);
+      cache->bytes += h->size;
+      return;
+    }
+  }
+  PushGlobal(h->pool, ptr, c);
+}
+
+// Subclasses may manage blocks their own way, so only the exact classes.
+bool IsBuiltIn(HostAllocator* allocator) {
+  return typeid(*allocator) == typeid(SystemHostAllocator) ||
+         typeid(*allocator) == typeid(PooledHostAllocator);
+}
+
+SystemHostAllocator* system_allocator() {
+  static SystemHostAllocator* allocator = new SystemHostAllocator();
+  return allocator;
+}
+
+// Function local so that static objects of other files can allocate.
+std::atomic<HostAllocator*>& active_allocator() {
+  static std::atomic<HostAllocator*> allocator(system_allocator());
+  return allocator;
+}
+
+}  // namespace
+
+const size_t HostAllocator::kAlignment;
+const int PooledHostAllocator::kNumClasses;
+
+HostAllocator* HostAllocator::Get() {
+  return active_allocator().load(std::memory_order_acquire);
+}
+
+bool HostAllocator::Set(HostAllocator* allocator) {
+  CHECK(allocator);
+  HostAllocator* active = Get();
+  // Built-in allocators free each other's blocks, any other allocator only
+  // takes over or hands over while no block is alive.
+  if (active != allocator && !(IsBuiltIn(active) && IsBuiltIn(allocator)) &&
+      allocations.load() != frees.load()) {
+    LOG(ERROR) << "Host allocator " << active->type() << " kept: it can not "
+               << "be replaced by " << allocator->type() << " while "
+               << allocations.load() - frees.load()
+               << " host blocks are allocated.";
+    return false;
+  }
+  active_allocator().store(allocator, std::memory_order_release);
+  return true;
+}
+
+bool HostAllocator::Set(const std::string& type, bool huge_pages) {
+  if (type == "system") {
+    return Set(system_allocator());
+  } else if (type == "pooled") {
+    static PooledHostAllocator* pooled = new PooledHostAllocator(false);
+    static PooledHostAllocator* pooled_huge = new PooledHostAllocator(true);
+    return Set(huge_pages ? pooled_huge : pooled);
+  }
+  LOG(FATAL) << "Unknown host allocator: " << type;
+  return false;
+}
+
+HostAllocStats HostAllocator::stats() {
+  HostAllocStats stats;
+  stats.allocations = allocations.load();
+  stats.frees = frees.load();
+  stats.system_allocations = system_allocations.load();
+  stats.system_frees = system_frees.load();
+  stats.bytes_in_use = bytes_in_use.load();
+  stats.bytes_cached = bytes_cached.load();
+  return stats;
+}
+
+void* SystemHostAllocator::Allocate(size_t size) {
+  void* ptr = SystemAllocate(size, NULL, -1, false);
+  allocations++;
+  bytes_in_use += size;
+  return ptr;
+}
+
+void SystemHostAllocator::Free(void* ptr) {
+  FreeBlock(ptr);
+}
+
+// The pool is leaked on purpose: caches of threads still running when the
+// allocator goes away hand their blocks to it when they exit, and it then
+// returns them to the system.
+PooledHostAllocator::PooledHostAllocator(bool huge_pages)
+  : huge_pages_(huge_pages), pool_(new GlobalPool()) {}
+
+PooledHostAllocator::~PooledHostAllocator() {
+  Release();
+  GlobalPool* pool = static_cast<GlobalPool*>(pool_);
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  pool->dead = true;
+}
+
+int PooledHostAllocator::SizeClass(size_t size, size_t* class_size) {
+  if (size <= 1024) {
+    size_t n = size ? (size + 63) / 64 : 1;
+    *class_size = n * 64;
+    return n - 1;
+  }
+  // 2^k < size <= 2^(k+1), split into four steps of 2^k / 4.
+  int k = 63 - __builtin_clzll(size - 1);
+  if (k >= 10 + (kNumClasses - 16) / 4) {
+    *class_size = size;
+    return -1;
+  }
+  size_t base = static_cast<size_t>(1) << k;
+  size_t step = base / 4;
+  size_t n = (size - 1 - base) / step + 1;
+  *class_size = base + n * step;
+  return 16 + (k - 10) * 4 + (n - 1);
+}
+
+void* PooledHostAllocator::Allocate(size_t size) {
+  GlobalPool* pool = static_cast<GlobalPool*>(pool_);
+  size_t class_size;
+  int c = SizeClass(size, &class_size);
+  void* ptr = NULL;
+  if (c >= 0) {
+    ThreadCache* cache = thread_cache_dead ? NULL : thread_caches.Find(pool);
+    if (cache && !cache->blocks[c].empty()) {
+      ptr = cache->blocks[c].back();
+      cache->blocks[c].pop_back();
+      cache->bytes -= class_size;
+    } else {
+      ptr = PopGlobal(pool, c);
+    }
+    if (ptr) {
+      bytes_cached -= class_size;
+    }
+  }
+  if (!ptr) {
+    ptr = SystemAllocate(class_size, pool, c, huge_pages_);
+  }
+  allocations++;
+  bytes_in_use += class_size;
+  return ptr;
+}
+
+void PooledHostAllocator::Free(void* ptr) {
+  FreeBlock(ptr);
+}
+
+void PooledHostAllocator::Release() {
+  GlobalPool* pool = static_cast<GlobalPool*>(pool_);
+  if (!thread_cache_dead) {
+    thread_caches.Find(pool)->Flush();
+  }
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  for (int c = 0; c < kNumClasses; ++c) {
+    for (int i = 0; i < pool->blocks[c].size(); ++i) {
+      bytes_cached -= header(pool->blocks[c][i])->size;
+      SystemFree(pool->blocks[c][i]);
+    }
+    pool->blocks[c].clear();
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,214 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/format.hpp"
+#include "caffe/util/image_cache.hpp"
+
+namespace caffe {
+
+/// Shared mapping of the spill file, released with the last CachedImage.
+class ImageCache::SpillFile {
+  public:
+  SpillFile(const string& filename, size_t size) : data_(NULL), size_(size) {
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK_GE(fd, 0) << "Failed to create " << filename << ": "
+                    << strerror(errno);
+    CHECK_EQ(ftruncate(fd, size), 0) << "Failed to size " << filename << ": "
+                                     << strerror(errno);
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK(data != MAP_FAILED) << "Failed to map " << filename << ": "
+                              << strerror(errno);
+    close(fd);
+    // The mapping keeps the pages, the name would only leak the file.
+    unlink(filename.c_str());
+    data_ = static_cast<uint8_t*>(data);
+  }
+  ~SpillFile() { munmap(data_, size_); }
+
+  inline uint8_t* data() { return data_; }
+  inline size_t size() const { return size_; }
+
+  private:
+  uint8_t* data_;
+  size_t size_;
+
+  DISABLE_COPY_AND_ASSIGN(SpillFile);
+};
+
+ImageCache::ImageCache(size_t memory_bytes, const string& spill_file,
+                       size_t spill_bytes)
+    : memory_bytes_(memory_bytes), spill_bytes_(0), spill_used_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  if (!spill_file.empty() && spill_bytes > 0) {
+    OpenSpill(spill_file, spill_bytes);
+  }
+}
+
+ImageCache::~ImageCache() {}
+
+ImageCache* ImageCache::Get() {
+  // Never destroyed, prefetch threads may still read from it at exit.
+  static ImageCache* cache = new ImageCache();
+  return cache;
+}
+
+string ImageCache::Key(const string& filename, int height, int width,
+                       bool is_color) {
+  // The size comes first, so that no filename can make two keys collide.
+  return format_int(height) + "x" + format_int(width) +
+      (is_color ? "c:" : "g:") + filename;
+}
+
+bool ImageCache::Enabled(const ImageCacheParameter& param) {
+  return param.memory_bytes() > 0 ||
+      (!param.spill_file().empty() && param.spill_bytes() > 0);
+}
+
+void ImageCache::Configure(const ImageCacheParameter& param) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (param.memory_bytes() > memory_bytes_) {
+    memory_bytes_ = param.memory_bytes();
+  }
+  if (param.spill_file().empty() || param.spill_bytes() == 0) {
+    return;
+  }
+  if (spill_) {
+    LOG_IF(WARNING, param.spill_bytes() > spill_bytes_)
+        << "Image cache already spills to a file of " << spill_bytes_
+        << " bytes, ignoring " << param.spill_file();
+    return;
+  }
+  OpenSpill(param.spill_file(), param.spill_bytes());
+}
+
+void ImageCache::OpenSpill(const string& filename, size_t bytes) {
+  spill_.reset(new SpillFile(filename, bytes));
+  spill_file_ = filename;
+  spill_bytes_ = bytes;
+  spill_used_ = 0;
+}
+
+bool ImageCache::Lookup(const string& key, CachedImage* image) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<string, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  Entry& entry = it->second;
+  image->rows = entry.rows;
+  image->cols = entry.cols;
+  image->channels = entry.channels;
+  if (entry.pixels) {
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    image->data = entry.pixels->data();
+    image->holder = entry.pixels;
+  } else {
+    image->data = spill_->data() + entry.spill_offset;
+    image->holder = spill_;
+    ++stats_.spill_hits;
+  }
+  ++stats_.hits;
+  return true;
+}
+
+void ImageCache::Insert(const string& key, int rows, int cols, int channels,
+                        const uint8_t* data) {
+  const size_t size = static_cast<size_t>(rows) * cols * channels;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.count(key)) {
+    // Another thread decoded the same image meanwhile.
+    return;
+  }
+  Entry& entry = entries_[key];
+  entry.rows = rows;
+  entry.cols = cols;
+  entry.channels = channels;
+  entry.pixels.reset(new vector<uint8_t>(data, data + size));
+  entry.spill_offset = -1;
+  lru_.push_front(key);
+  entry.lru = lru_.begin();
+  stats_.bytes_in_memory += size;
+  EvictLocked();
+}
+
+void ImageCache::EvictLocked() {
+  while (stats_.bytes_in_memory > memory_bytes_ && !lru_.empty()) {
+    std::unordered_map<string, Entry>::iterator it =
+        entries_.find(lru_.back());
+    Entry& entry = it->second;
+    stats_.bytes_in_memory -= entry.pixels->size();
+    ++stats_.evictions;
+    lru_.pop_back();
+    if (entry.spill_offset >= 0 || SpillLocked(&entry)) {
+      entry.pixels.reset();
+    } else {
+      entries_.erase(it);
+    }
+  }
+}
+
+bool ImageCache::SpillLocked(Entry* entry) {
+  const size_t size = entry->pixels->size();
+  if (!spill_ || spill_used_ + size > spill_bytes_) {
+    return false;
+  }
+  memcpy(spill_->data() + spill_used_, entry->pixels->data(), size);
+  entry->spill_offset = spill_used_;
+  spill_used_ += size;
+  ++stats_.spills;
+  stats_.bytes_spilled += size;
+  return true;
+}
+
+void ImageCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  lru_.clear();
+  // Images handed out keep the old mapping alive through their holder.
+  if (spill_) {
+    OpenSpill(spill_file_, spill_bytes_);
+  }
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+ImageCacheStats ImageCache::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace caffe
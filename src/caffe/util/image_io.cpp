@@ -390,6 +390,146 @@ bool ReadImageSequenceToVolumeDatum(const char* img_dir, const int start_frm,
   return true;
 }
 
+bool VideoClipReader::Open(const string& filename) {
+  filename_.clear();
+  cap_.release();
+  if (!cap_.open(filename)) {
+    LOG(ERROR) << "Cannot open " << filename;
+    return false;
+  }
+  filename_ = filename;
+  position_ = 0;
+  num_frames_ = cap_.get(CV_CAP_PROP_FRAME_COUNT);
+  return true;
+}
+
+bool VideoClipReader::ReadVideo(const string& filename, int start_frm,
+                                unsigned int rand, int length, int height,
+                                int width, int sampling_rate,
+                                VolumeDatum* datum, vector<char>* data) {
+  if (filename != filename_ && !Open(filename)) {
+    return false;
+  }
+  const int span = length * sampling_rate;
+  if (num_frames_ < span) {
+    LOG(INFO) << filename << " does not have enough frames; having "
+              << num_frames_;
+    return false;
+  }
+  if (start_frm < 0) {
+    start_frm = rand % (num_frames_ - span + 1);
+  }
+  CHECK_LE(start_frm + span, num_frames_)
+      << "end frame must be less or equal to num of frames";
+  // Frames up to one clip ahead are skipped by reading on, further ones or
+  // earlier ones by seeking.
+  if (start_frm < position_ || start_frm - position_ > span) {
+    if (start_frm < position_ && !Open(filename)) {
+      return false;
+    }
+    if (start_frm > 0) {
+      cap_.set(CV_CAP_PROP_POS_FRAMES, start_frm);
+      position_ = start_frm;
+    }
+  }
+  if (ReadFrames(start_frm, length, height, width, sampling_rate, datum,
+                 data)) {
+    return true;
+  }
+  // Seeking is inaccurate with some codecs, read from the start instead.
+  if (!Open(filename)) {
+    return false;
+  }
+  if (ReadFrames(start_frm, length, height, width, sampling_rate, datum,
+                 data)) {
+    return true;
+  }
+  LOG(ERROR) << "Could not read " << length << " frames of " << filename
+             << " from frame " << start_frm;
+  filename_.clear();
+  return false;
+}
+
+bool VideoClipReader::ReadFrames(int start_frm, int length, int height,
+                                 int width, int sampling_rate,
+                                 VolumeDatum* datum, vector<char>* data) {
+  while (position_ < start_frm) {
+    if (!cap_.grab()) {
+      return false;
+    }
+    ++position_;
+  }
+  for (int l = 0; l < length; ++l) {
+    if (l > 0) {
+      for (int i = 1; i < sampling_rate; ++i, ++position_) {
+        if (!cap_.grab()) {
+          return false;
+        }
+      }
+    }
+    ++position_;
+    if (!cap_.read(frame_) || !frame_.data ||
+        !AddFrame(frame_, l, length, height, width, datum, data)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool VideoClipReader::ReadImageSequence(const string& img_dir, int start_frm,
+                                        int length, int height, int width,
+                                        int sampling_rate, VolumeDatum* datum,
+                                        vector<char>* data) {
+  char fn_im[256];
+  for (int l = 0; l < length; ++l) {
+    snprintf(fn_im, sizeof(fn_im), "%s/%06d.jpg", img_dir.c_str(),
+             start_frm + l * sampling_rate);
+    frame_ = cv::imread(fn_im, CV_LOAD_IMAGE_COLOR);
+    if (!frame_.data) {
+      LOG(ERROR) << "Could not open or find file " << fn_im;
+      return false;
+    }
+    if (!AddFrame(frame_, l, length, height, width, datum, data)) {
+      LOG(ERROR) << "Frame size of " << fn_im << " differs from the first";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool VideoClipReader::AddFrame(const cv::Mat& frame, int index, int length,
+                               int height, int width, VolumeDatum* datum,
+                               vector<char>* data) {
+  const cv::Mat* img = &frame;
+  if (height > 0 && width > 0) {
+    cv::resize(frame, resized_, cv::Size(width, height));
+    img = &resized_;
+  }
+  CHECK_EQ(img->type(), CV_8UC3);
+  if (index == 0) {
+    datum->set_channels(3);
+    datum->set_length(length);
+    datum->set_height(img->rows);
+    datum->set_width(img->cols);
+    // Keeps its capacity, so clips of one size allocate only once.
+    data->resize(3 * length * img->rows * img->cols);
+  } else if (img->rows != datum->height() || img->cols != datum->width()) {
+    return false;
+  }
+  const int image_size = img->rows * img->cols;
+  const int channel_size = image_size * length;
+  char* dst = data->data() + index * image_size;
+  for (int h = 0; h < img->rows; ++h) {
+    const uchar* src = img->ptr<uchar>(h);
+    for (int w = 0; w < img->cols; ++w, ++dst, src += 3) {
+      dst[0] = src[0];
+      dst[channel_size] = src[1];
+      dst[2 * channel_size] = src[2];
+    }
+  }
+  return true;
+}
+
 template <>
 bool load_blob_from_binary<float>(const string fn_blob, Blob<float>* blob) {
   FILE* f;
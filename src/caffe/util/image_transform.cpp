@@ -0,0 +1,232 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define IMAGE_TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/image_transform.hpp"
+
+namespace caffe {
+
+namespace {
+
+// kDstMeanFile reads the mean file at the destination column, which only
+// differs from kMeanFile when mirroring.
+enum MeanType { kNoMean, kMeanValue, kMeanFile, kDstMeanFile };
+
+// A row of one channel: n pixels step bytes apart, its mean row and value.
+template <typename Dtype>
+struct Row {
+  typedef void (*Scalar)(const int begin, const int n, const uint8_t* src,
+      const int step, const Dtype* mean, const Dtype mean_value,
+      const Dtype scale, Dtype* dst);
+  // Returns how many pixels were transformed, the rest is left to Scalar.
+  typedef int (*Simd)(const int n, const uint8_t* src, const int step,
+      const Dtype* mean, const Dtype mean_value, const Dtype scale,
+      Dtype* dst);
+};
+
+template <typename Dtype, MeanType kMean, bool kMirror>
+void transform_row_scalar(const int begin, const int n, const uint8_t* src,
+    const int step, const Dtype* mean, const Dtype mean_value,
+    const Dtype scale, Dtype* dst) {
+  for (int w = begin; w < n; ++w) {
+    const Dtype pixel = static_cast<Dtype>(src[w * step]);
+    Dtype value;
+    if (kMean == kMeanFile) {
+      value = (pixel - mean[w]) * scale;
+    } else if (kMean == kDstMeanFile) {
+      value = (pixel - mean[kMirror ? n - 1 - w : w]) * scale;
+    } else if (kMean == kMeanValue) {
+      value = (pixel - mean_value) * scale;
+    } else {
+      value = pixel * scale;
+    }
+    dst[kMirror ? n - 1 - w : w] = value;
+  }
+}
+
+template <typename Dtype, MeanType kMean>
+typename Row<Dtype>::Scalar scalar_kernel(const bool mirror) {
+  return mirror ? transform_row_scalar<Dtype, kMean, true> :
+                  transform_row_scalar<Dtype, kMean, false>;
+}
+
+template <typename Dtype>
+typename Row<Dtype>::Scalar scalar_kernel(const MeanType mean,
+                                          const bool mirror) {
+  switch (mean) {
+  case kMeanFile:
+    return scalar_kernel<Dtype, kMeanFile>(mirror);
+  case kDstMeanFile:
+    return scalar_kernel<Dtype, kDstMeanFile>(mirror);
+  case kMeanValue:
+    return scalar_kernel<Dtype, kMeanValue>(mirror);
+  default:
+    return scalar_kernel<Dtype, kNoMean>(mirror);
+  }
+}
+
+#ifdef IMAGE_TRANSFORM_X86
+// Eight pixels at a time, gathered from planar (step 1) or 3 channel
+// interleaved rows, with the same float operations as the scalar loop.
+template <MeanType kMean, bool kMirror>
+__attribute__((target("avx2")))
+int transform_row_avx2(const int n, const uint8_t* src, const int step,
+    const float* mean, const float mean_value, const float scale,
+    float* dst) {
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 m = _mm256_set1_ps(mean_value);
+  const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m128i gather_lo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i gather_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5,
+      -1, -1, -1, -1, -1, -1, -1, -1);
+  // 3 channel loads read 24 bytes from the first byte of the channel, so
+  // they stop a pixel early to stay in the row.
+  const int last = step == 1 ? n - 8 : n - 9;
+  int w = 0;
+  for (; w <= last; w += 8) {
+    __m128i pixels;
+    if (step == 1) {
+      pixels = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + w));
+    } else {
+      const uint8_t* p = src + w * 3;
+      pixels = _mm_or_si128(
+          _mm_shuffle_epi8(_mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(p)), gather_lo),
+          _mm_shuffle_epi8(_mm_loadl_epi64(
+              reinterpret_cast<const __m128i*>(p + 16)), gather_hi));
+    }
+    __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pixels));
+    if (kMean == kMeanFile || (kMean == kDstMeanFile && !kMirror)) {
+      v = _mm256_sub_ps(v, _mm256_loadu_ps(mean + w));
+    } else if (kMean == kDstMeanFile) {
+      v = _mm256_sub_ps(v, _mm256_permutevar8x32_ps(
+          _mm256_loadu_ps(mean + n - 8 - w), reverse));
+    } else if (kMean == kMeanValue) {
+      v = _mm256_sub_ps(v, m);
+    }
+    v = _mm256_mul_ps(v, s);
+    if (kMirror) {
+      _mm256_storeu_ps(dst + n - 8 - w, _mm256_permutevar8x32_ps(v, reverse));
+    } else {
+      _mm256_storeu_ps(dst + w, v);
+    }
+  }
+  return w;
+}
+
+template <MeanType kMean>
+Row<float>::Simd avx2_kernel(const bool mirror) {
+  return mirror ? transform_row_avx2<kMean, true> :
+                  transform_row_avx2<kMean, false>;
+}
+
+bool use_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif  // IMAGE_TRANSFORM_X86
+
+template <typename Dtype>
+typename Row<Dtype>::Simd simd_kernel(const MeanType mean, const bool mirror,
+                                      const int step) {
+  return NULL;
+}
+
+template <>
+Row<float>::Simd simd_kernel<float>(const MeanType mean, const bool mirror,
+                                    const int step) {
+#ifdef IMAGE_TRANSFORM_X86
+  if (use_avx2() && (step == 1 || step == 3)) {
+    switch (mean) {
+    case kMeanFile:
+      return avx2_kernel<kMeanFile>(mirror);
+    case kDstMeanFile:
+      return avx2_kernel<kDstMeanFile>(mirror);
+    case kMeanValue:
+      return avx2_kernel<kMeanValue>(mirror);
+    default:
+      return avx2_kernel<kNoMean>(mirror);
+    }
+  }
+#endif
+  return NULL;
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_transform_image(const ImageTransform<Dtype>& t, Dtype* dst) {
+  MeanType mean = kNoMean;
+  if (t.mean) {
+    mean = t.mean_at_dst && t.mirror ? kDstMeanFile : kMeanFile;
+  } else if (t.mean_values) {
+    mean = kMeanValue;
+  }
+  const int step = t.interleaved ? t.channels : 1;
+  const typename Row<Dtype>::Scalar scalar = scalar_kernel<Dtype>(mean,
+                                                                   t.mirror);
+  const typename Row<Dtype>::Simd simd = simd_kernel<Dtype>(mean, t.mirror,
+                                                            step);
+  for (int c = 0; c < t.channels; ++c) {
+    const uint8_t* src = t.src + (t.interleaved ? c : c * t.plane_step);
+    const Dtype mean_value = t.mean_values ? t.mean_values[c] : Dtype(0);
+    for (int h = 0; h < t.rows; ++h) {
+      const uint8_t* src_row = src + h * t.row_step;
+      const Dtype* mean_row = t.mean ?
+          t.mean + c * t.mean_plane_step + h * t.mean_row_step : NULL;
+      Dtype* dst_row = dst + (c * t.rows + h) * t.cols;
+      const int done = simd ? simd(t.cols, src_row, step, mean_row,
+                                   mean_value, t.scale, dst_row) : 0;
+      scalar(done, t.cols, src_row, step, mean_row, mean_value, t.scale,
+             dst_row);
+    }
+  }
+}
+
+const char* image_transform_isa() {
+#ifdef IMAGE_TRANSFORM_X86
+  if (use_avx2()) {
+    return "avx2";
+  }
+#endif
+  return "scalar";
+}
+
+template void caffe_cpu_transform_image<float>(
+    const ImageTransform<float>& t, float* dst);
+template void caffe_cpu_transform_image<double>(
+    const ImageTransform<double>& t, double* dst);
+
+}  // namespace caffe
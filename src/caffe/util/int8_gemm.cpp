@@ -0,0 +1,478 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define INT8_GEMM_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/common.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Largest tile of weight rows times activation rows a kernel computes.
+const int kMaxTile = 4;
+// Rows of weights and of activations visited together, small enough for
+// both blocks to stay in cache.
+const int kBlock = 64;
+
+// sums[r * kMaxTile + c] = dot(w row r, x row c) over k bytes, k a multiple
+// of 32, for r < rows and c < cols.
+typedef void (*DotKernel)(const int8_t* w, const int w_stride,
+    const uint8_t* x, const int x_stride, const int k, int32_t* sums);
+
+struct Kernels {
+  int rows;   // tile rows
+  int cols;   // tile columns
+  DotKernel kernel[kMaxTile][kMaxTile];  // by rows - 1 and cols - 1
+  const char* isa;
+};
+
+template <int R, int C>
+void dot_scalar(const int8_t* w, const int w_stride, const uint8_t* x,
+    const int x_stride, const int k, int32_t* sums) {
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < C; ++c) {
+      const int8_t* wr = w + r * w_stride;
+      const uint8_t* xc = x + c * x_stride;
+      int32_t sum = 0;
+      for (int i = 0; i < k; ++i) {
+        sum += int32_t(wr[i]) * int32_t(xc[i]);
+      }
+      sums[r * kMaxTile + c] = sum;
+    }
+  }
+}
+
+#ifdef INT8_GEMM_X86
+__attribute__((target("avx2")))
+inline int32_t hsum_avx2(__m256i v) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+// Bytes widened to 16 bits, pairs multiplied and added into 32 bits.
+template <int R, int C>
+__attribute__((target("avx2")))
+void dot_avx2(const int8_t* w, const int w_stride, const uint8_t* x,
+    const int x_stride, const int k, int32_t* sums) {
+  __m256i acc[R][C];
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < C; ++c) {
+      acc[r][c] = _mm256_setzero_si256();
+    }
+  }
+  for (int i = 0; i < k; i += 16) {
+    __m256i wv[R];
+    for (int r = 0; r < R; ++r) {
+      wv[r] = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(w + r * w_stride + i)));
+    }
+    for (int c = 0; c < C; ++c) {
+      const __m256i xv = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(x + c * x_stride + i)));
+      for (int r = 0; r < R; ++r) {
+        acc[r][c] = _mm256_add_epi32(acc[r][c], _mm256_madd_epi16(wv[r], xv));
+      }
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < C; ++c) {
+      sums[r * kMaxTile + c] = hsum_avx2(acc[r][c]);
+    }
+  }
+}
+
+// Four unsigned times signed byte products added into each 32 bit lane.
+template <int R, int C>
+__attribute__((target("avx2,avx512vl,avx512vnni")))
+void dot_vnni(const int8_t* w, const int w_stride, const uint8_t* x,
+    const int x_stride, const int k, int32_t* sums) {
+  __m256i acc[R][C];
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < C; ++c) {
+      acc[r][c] = _mm256_setzero_si256();
+    }
+  }
+  for (int i = 0; i < k; i += 32) {
+    __m256i wv[R];
+    for (int r = 0; r < R; ++r) {
+      wv[r] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(w + r * w_stride + i));
+    }
+    for (int c = 0; c < C; ++c) {
+      const __m256i xv = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(x + c * x_stride + i));
+      for (int r = 0; r < R; ++r) {
+        acc[r][c] = _mm256_dpbusd_epi32(acc[r][c], xv, wv[r]);
+      }
+    }
+  }
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < C; ++c) {
+      sums[r * kMaxTile + c] = hsum_avx2(acc[r][c]);
+    }
+  }
+}
+#endif  // INT8_GEMM_X86
+
+// Fills the kernel table of a tile of R x C with K<r, c> for every r <= R
+// and c <= C.
+template <template <int, int> class K, int R, int C>
+struct FillKernels {
+  static void Fill(Kernels* kernels) {
+    kernels->kernel[R - 1][C - 1] = K<R, C>::run;
+    FillKernels<K, R, C - 1>::Fill(kernels);
+  }
+};
+template <template <int, int> class K, int R>
+struct FillKernels<K, R, 0> {
+  static void Fill(Kernels* kernels) {
+    FillKernels<K, R - 1, kMaxTile>::Fill(kernels);
+  }
+};
+template <template <int, int> class K, int C>
+struct FillKernels<K, 0, C> {
+  static void Fill(Kernels*) {}
+};
+template <template <int, int> class K>
+struct FillKernels<K, 0, 0> {
+  static void Fill(Kernels*) {}
+};
+
+template <int R, int C>
+struct ScalarKernel {
+  static void run(const int8_t* w, const int w_stride, const uint8_t* x,
+      const int x_stride, const int k, int32_t* sums) {
+    dot_scalar<R, C>(w, w_stride, x, x_stride, k, sums);
+  }
+};
+
+#ifdef INT8_GEMM_X86
+template <int R, int C>
+struct Avx2Kernel {
+  static void run(const int8_t* w, const int w_stride, const uint8_t* x,
+      const int x_stride, const int k, int32_t* sums) {
+    dot_avx2<R, C>(w, w_stride, x, x_stride, k, sums);
+  }
+};
+
+template <int R, int C>
+struct VnniKernel {
+  static void run(const int8_t* w, const int w_stride, const uint8_t* x,
+      const int x_stride, const int k, int32_t* sums) {
+    dot_vnni<R, C>(w, w_stride, x, x_stride, k, sums);
+  }
+};
+#endif  // INT8_GEMM_X86
+
+Kernels select_kernels() {
+  Kernels kernels;
+  // The whole table is filled, only rows x cols tiles are used: AVX2 has 16
+  // vector registers for 2 x 4 sums, AVX-512 has 32 for 4 x 4.
+  FillKernels<ScalarKernel, kMaxTile, kMaxTile>::Fill(&kernels);
+  kernels.rows = 2;
+  kernels.cols = 4;
+  kernels.isa = "scalar";
+#ifdef INT8_GEMM_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vnni") &&
+      __builtin_cpu_supports("avx512vl")) {
+    FillKernels<VnniKernel, kMaxTile, kMaxTile>::Fill(&kernels);
+    kernels.rows = 4;
+    kernels.isa = "avx512_vnni";
+  } else if (__builtin_cpu_supports("avx2")) {
+    FillKernels<Avx2Kernel, kMaxTile, kMaxTile>::Fill(&kernels);
+    kernels.isa = "avx2";
+  }
+#endif
+  return kernels;
+}
+
+const Kernels& kernels() {
+  static const Kernels kernels = select_kernels();
+  return kernels;
+}
+
+// Rounds to nearest even like nearbyint, without a libm call: adding and
+// subtracting 1.5 * 2^23 drops the fraction of a float this small.
+inline int quantize(const float x, const float inv_step) {
+  const float q = std::min(127.f, std::max(-128.f, x * inv_step));
+  return static_cast<int>((q + 12582912.f) - 12582912.f);
+}
+
+#ifdef INT8_GEMM_X86
+// Quantizes rows [j_begin, j_end) of the transposed float matrix x (row
+// stride 1) 8 x 8 values at a time: 8 columns are loaded, transposed in
+// registers and stored as 8 bytes of each row. Returns the first row left.
+__attribute__((target("avx2")))
+int quantize_transposed_avx2(const float* x, const int j_begin,
+    const int j_end, const int k, const int col_stride, const float inv_step,
+    const int stride, uint8_t* q) {
+  const __m256 inv = _mm256_set1_ps(inv_step);
+  const __m256 lo = _mm256_set1_ps(-128.f);
+  const __m256 hi = _mm256_set1_ps(127.f);
+  const __m128i offset = _mm_set1_epi32(128);
+  const int k8 = k / 8 * 8;
+  int j = j_begin;
+  for (; j + 8 <= j_end; j += 8) {
+    for (int c = 0; c < k8; c += 8) {
+      __m256 v[8];
+      for (int i = 0; i < 8; ++i) {
+        const float* xc = x + static_cast<size_t>(c + i) * col_stride + j;
+        v[i] = _mm256_min_ps(hi,
+            _mm256_max_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(xc), inv)));
+      }
+      const __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+      const __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+      const __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+      const __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+      const __m256 t4 = _mm256_unpacklo_ps(v[4], v[5]);
+      const __m256 t5 = _mm256_unpackhi_ps(v[4], v[5]);
+      const __m256 t6 = _mm256_unpacklo_ps(v[6], v[7]);
+      const __m256 t7 = _mm256_unpackhi_ps(v[6], v[7]);
+      const __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+      const __m256 s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+      const __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+      const __m256 s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+      const __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+      const __m256 s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+      const __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+      const __m256 s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+      v[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+      v[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+      v[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+      v[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+      v[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+      v[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+      v[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+      v[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+      for (int i = 0; i < 8; ++i) {
+        // Rounds to nearest even, the default MXCSR mode.
+        const __m256i r = _mm256_cvtps_epi32(v[i]);
+        const __m128i words = _mm_packus_epi32(
+            _mm_add_epi32(_mm256_castsi256_si128(r), offset),
+            _mm_add_epi32(_mm256_extracti128_si256(r, 1), offset));
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i*>(q + static_cast<size_t>(j + i) * stride
+                                       + c),
+            _mm_packus_epi16(words, words));
+      }
+    }
+    for (int c = k8; c < k; ++c) {
+      const float* xc = x + static_cast<size_t>(c) * col_stride;
+      for (int i = j; i < j + 8; ++i) {
+        q[static_cast<size_t>(i) * stride + c] =
+            quantize(xc[i], inv_step) + 128;
+      }
+    }
+  }
+  return j;
+}
+#endif
+
+template <typename Dtype>
+int quantize_rows_simd(const Dtype* x, const int j_begin, const int j_end,
+    const int k, const int row_stride, const int col_stride,
+    const float inv_step, const int stride, uint8_t* q) {
+  return j_begin;
+}
+
+template <>
+int quantize_rows_simd(const float* x, const int j_begin, const int j_end,
+    const int k, const int row_stride, const int col_stride,
+    const float inv_step, const int stride, uint8_t* q) {
+#ifdef INT8_GEMM_X86
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2 && row_stride == 1) {
+    return quantize_transposed_avx2(x, j_begin, j_end, k, col_stride,
+                                    inv_step, stride, q);
+  }
+#endif
+  return j_begin;
+}
+
+}  // namespace
+
+bool UseCpuInt8(const LayerParameter& param) {
+  // The positions of folded weights are those of the layer before folding.
+  if (!param.cpu_int8() || param.folded_layer_size() > 0 ||
+      param.blobs_dtype_size() == 0 || param.bottom_mlu_dtype_size() == 0) {
+    return false;
+  }
+  const BlobDataType& weights = param.blobs_dtype(0);
+  const BlobDataType& bottom = param.bottom_mlu_dtype(0);
+  return weights.type() == DT_INT8 && weights.position_size() > 0 &&
+         (!bottom.has_type() || bottom.type() == DT_INT8) &&
+         bottom.position_size() > 0;
+}
+
+float Int8Step(const BlobDataType& dtype, int channel) {
+  CHECK_GT(dtype.position_size(), 0) << "No int8 position";
+  const int position =
+      dtype.position(dtype.position_size() > channel ? channel : 0);
+  float scale = 1;
+  if (dtype.scale_size() > 0) {
+    scale = dtype.scale(dtype.scale_size() > channel ? channel : 0);
+  }
+  CHECK_GT(scale, 0) << "Invalid int8 scale";
+  return std::ldexp(1.f, position) / scale;
+}
+
+template <typename Dtype>
+void int8_pack_weights(const Dtype* w, const int rows, const int cols,
+    const int row_stride, const int col_stride, const BlobDataType& dtype,
+    Int8Weights* packed) {
+  packed->rows = rows;
+  packed->cols = cols;
+  packed->stride = (cols + 31) / 32 * 32;
+  packed->data.assign(static_cast<size_t>(rows) * packed->stride, 0);
+  packed->offset.resize(rows);
+  packed->step.resize(rows);
+  for (int r = 0; r < rows; ++r) {
+    const float step = Int8Step(dtype, r);
+    int8_t* row = &packed->data[static_cast<size_t>(r) * packed->stride];
+    int32_t sum = 0;
+    for (int c = 0; c < cols; ++c) {
+      row[c] = quantize(w[r * row_stride + c * col_stride], 1 / step);
+      sum += row[c];
+    }
+    packed->offset[r] = 128 * sum;
+    packed->step[r] = step;
+  }
+}
+
+template <typename Dtype>
+void int8_quantize(const int n, const Dtype* x, const float step, int8_t* q) {
+  const float inv_step = 1 / step;
+  for (int i = 0; i < n; ++i) {
+    q[i] = quantize(x[i], inv_step);
+  }
+}
+
+template <typename Dtype>
+void int8_quantize_rows(const Dtype* x, const int n, const int k,
+    const int row_stride, const int col_stride, const float step,
+    const int stride, uint8_t* q) {
+  const float inv_step = 1 / step;
+  // kBlock rows at a time, so that a transposed x (row_stride 1) is still
+  // read in runs of contiguous values.
+  const int blocks = (n + kBlock - 1) / kBlock;
+  caffe_parallel_for(blocks, static_cast<size_t>(kBlock) * stride,
+      [&](int begin, int end) {
+    for (int block = begin; block < end; ++block) {
+      const int j_begin = block * kBlock;
+      const int j_end = std::min(n, j_begin + kBlock);
+      const int j_rest = quantize_rows_simd(x, j_begin, j_end, k, row_stride,
+          col_stride, inv_step, stride, q);
+      for (int c = 0; c < k; ++c) {
+        const Dtype* xc = x + static_cast<size_t>(c) * col_stride;
+        for (int j = j_rest; j < j_end; ++j) {
+          q[static_cast<size_t>(j) * stride + c] =
+              quantize(xc[static_cast<size_t>(j) * row_stride], inv_step) + 128;
+        }
+      }
+      for (int j = j_begin; j < j_end; ++j) {
+        std::fill(q + static_cast<size_t>(j) * stride + k,
+                  q + static_cast<size_t>(j + 1) * stride, 128);
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void int8_gemm(const Int8Weights& w, const int row_begin, const int row_end,
+    const uint8_t* x, const int n, const float x_step, const Dtype* bias,
+    Dtype* y, const int y_row_stride, const int y_col_stride) {
+  const Kernels& k = kernels();
+  const int row_blocks = (row_end - row_begin + kBlock - 1) / kBlock;
+  const int col_blocks = (n + kBlock - 1) / kBlock;
+  const size_t work = static_cast<size_t>(kBlock) * kBlock * w.stride;
+  caffe_parallel_for(row_blocks * col_blocks, work, [&](int begin, int end) {
+    int32_t sums[kMaxTile * kMaxTile];
+    for (int block = begin; block < end; ++block) {
+      const int r_begin = row_begin + (block % row_blocks) * kBlock;
+      const int r_end = std::min(row_end, r_begin + kBlock);
+      const int j_begin = (block / row_blocks) * kBlock;
+      const int j_end = std::min(n, j_begin + kBlock);
+      for (int r0 = r_begin; r0 < r_end; r0 += k.rows) {
+        const int rows = std::min(k.rows, r_end - r0);
+        const int8_t* wr = &w.data[static_cast<size_t>(r0) * w.stride];
+        for (int j0 = j_begin; j0 < j_end; j0 += k.cols) {
+          const int cols = std::min(k.cols, j_end - j0);
+          k.kernel[rows - 1][cols - 1](wr, w.stride,
+              x + static_cast<size_t>(j0) * w.stride, w.stride, w.stride,
+              sums);
+          for (int r = 0; r < rows; ++r) {
+            const float scale = w.step[r0 + r] * x_step;
+            const Dtype b = bias ? bias[r0 + r] : Dtype(0);
+            for (int c = 0; c < cols; ++c) {
+              y[static_cast<size_t>(r0 + r) * y_row_stride +
+                static_cast<size_t>(j0 + c) * y_col_stride] =
+                  (sums[r * kMaxTile + c] - w.offset[r0 + r]) * scale + b;
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+const char* int8_gemm_isa() {
+  return kernels().isa;
+}
+
+#define INSTANTIATE_INT8(Dtype) \
+  template void int8_pack_weights<Dtype>(const Dtype* w, const int rows, \
+      const int cols, const int row_stride, const int col_stride, \
+      const BlobDataType& dtype, Int8Weights* packed); \
+  template void int8_quantize<Dtype>(const int n, const Dtype* x, \
+      const float step, int8_t* q); \
+  template void int8_quantize_rows<Dtype>(const Dtype* x, const int n, \
+      const int k, const int row_stride, const int col_stride, \
+      const float step, const int stride, uint8_t* q); \
+  template void int8_gemm<Dtype>(const Int8Weights& w, const int row_begin, \
+      const int row_end, const uint8_t* x, const int n, const float x_step, \
+      const Dtype* bias, Dtype* y, const int y_row_stride, \
+      const int y_col_stride);
+
+INSTANTIATE_INT8(float);
+INSTANTIATE_INT8(double);
+
+}  // namespace caffe
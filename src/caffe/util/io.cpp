@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #ifdef USE_OPENCV
@@ -73,6 +74,7 @@ using google::protobuf::io::ZeroCopyOutputStream;
 using google::protobuf::io::ArrayInputStream;
 using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
+using google::protobuf::internal::WireFormatLite;
 
 bool MapNameToLabel(const LabelMap& map, const bool strict_check,
                     std::map<string, int>* name_to_label) {
@@ -170,6 +172,56 @@ bool ReadProtoFromBinaryMem(void* buffer, int buffer_size, Message* proto) {
   return success;
 }
 
+bool ParseDatumInPlace(const char* buffer, size_t size, Datum* datum,
+                       const char** pixels, size_t* pixels_size) {
+  datum->Clear();
+  *pixels = NULL;
+  *pixels_size = 0;
+  const uint32_t data_tag = WireFormatLite::MakeTag(Datum::kDataFieldNumber,
+      WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(buffer), size);
+  // The fields around data are merged into datum as they are, in order.
+  int merged = 0;
+  for (;;) {
+    const int start = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      if (static_cast<size_t>(start) != size) {
+        return false;
+      }
+      break;
+    }
+    if (tag != data_tag) {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return false;
+      }
+      continue;
+    }
+    uint32_t length;
+    if (!input.ReadVarint32(&length) ||
+        length > size - input.CurrentPosition()) {
+      return false;
+    }
+    *pixels = buffer + input.CurrentPosition();
+    *pixels_size = length;
+    if (start > merged) {
+      CodedInputStream fields(
+          reinterpret_cast<const uint8_t*>(buffer + merged), start - merged);
+      if (!datum->MergeFromCodedStream(&fields)) {
+        return false;
+      }
+    }
+    input.Skip(length);
+    merged = input.CurrentPosition();
+  }
+  if (size > static_cast<size_t>(merged)) {
+    CodedInputStream fields(
+        reinterpret_cast<const uint8_t*>(buffer + merged), size - merged);
+    return datum->MergeFromCodedStream(&fields);
+  }
+  return true;
+}
+
 bool ReadProtoFromBinaryFile(const char* filename, Message* proto) {
   int fd = open(filename, O_RDONLY);
   CHECK_NE(fd, -1) << "File not found: " << filename;
@@ -252,6 +304,27 @@ cv::Mat ReadImageToCVMat(const string& filename) {
   return ReadImageToCVMat(filename, 0, 0, true);
 }
 
+cv::Mat ReadImageToCVMat(const string& filename, const int height,
+                         const int width, const bool is_color,
+                         ImageCache* cache, CachedImage* image) {
+  const string key = ImageCache::Key(filename, height, width, is_color);
+  if (cache->Lookup(key, image)) {
+    return cv::Mat(image->rows, image->cols, CV_8UC(image->channels),
+                   const_cast<uint8_t*>(image->data));
+  }
+  cv::Mat cv_img = ReadImageToCVMat(filename, height, width, is_color);
+  if (!cv_img.data) {
+    return cv_img;
+  }
+  CHECK_EQ(cv_img.depth(), CV_8U) << "Image cache only holds 8 bit images";
+  if (!cv_img.isContinuous()) {
+    cv_img = cv_img.clone();
+  }
+  cache->Insert(key, cv_img.rows, cv_img.cols, cv_img.channels(),
+                cv_img.data);
+  return cv_img;
+}
+
 // Do the file extension and encoding match?
 static bool matchExt(const std::string& fn, std::string en) {
   size_t p = fn.rfind('.');
@@ -0,0 +1,216 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+namespace {
+
+const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'M', 'A', 'P'};
+const uint32_t kVersion = 1;
+const uint32_t kByteOrder = 0x01020304;
+const uint64_t kAlignment = 64;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t index_offset;
+  uint64_t index_size;
+  char reserved[32];
+};
+static_assert(sizeof(Header) == kAlignment, "Header must be 64 bytes");
+
+uint64_t Align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+void WriteOrDie(FILE* file, const void* data, size_t size,
+                const string& filename) {
+  CHECK_EQ(fwrite(data, 1, size, file), size)
+      << "Failed to write " << filename;
+}
+
+uint64_t TensorCount(const MappedWeightsIndex::Tensor& tensor) {
+  uint64_t count = 1;
+  for (int i = 0; i < tensor.shape().dim_size(); ++i) {
+    count *= tensor.shape().dim(i);
+  }
+  return count;
+}
+
+}  // namespace
+
+void WriteMappedWeights(const NetParameter& param, const string& filename) {
+  FILE* file = fopen(filename.c_str(), "wb");
+  CHECK(file) << "Failed to open " << filename;
+  Header header;
+  memset(&header, 0, sizeof(header));
+  WriteOrDie(file, &header, sizeof(header), filename);
+  MappedWeightsIndex index;
+  uint64_t offset = sizeof(header);
+  const char padding[kAlignment] = {0};
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      // FromProto handles the legacy 4D shapes and double values.
+      Blob<float> blob;
+      blob.FromProto(layer.blobs(j));
+      MappedWeightsIndex::Tensor* tensor = index.add_tensor();
+      tensor->set_layer(layer.name());
+      tensor->set_blob(j);
+      for (int k = 0; k < blob.num_axes(); ++k) {
+        tensor->mutable_shape()->add_dim(blob.shape(k));
+      }
+      tensor->set_offset(offset);
+      const size_t size = blob.count() * sizeof(float);
+      WriteOrDie(file, blob.cpu_data(), size, filename);
+      WriteOrDie(file, padding, Align(offset + size) - offset - size,
+                 filename);
+      offset = Align(offset + size);
+    }
+  }
+  string serialized;
+  CHECK(index.SerializeToString(&serialized));
+  WriteOrDie(file, serialized.data(), serialized.size(), filename);
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.index_offset = offset;
+  header.index_size = serialized.size();
+  // The header goes last, a file cut short is not taken for mapped weights.
+  CHECK_EQ(fseek(file, 0, SEEK_SET), 0) << "Failed to write " << filename;
+  WriteOrDie(file, &header, sizeof(header), filename);
+  CHECK_EQ(fclose(file), 0) << "Failed to write " << filename;
+}
+
+bool IsMappedWeightsFile(const string& filename) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[sizeof(kMagic)];
+  const bool mapped = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+      memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+  fclose(file);
+  return mapped;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : filename_(filename), map_(NULL), size_(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Failed to open " << filename;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat " << filename;
+  size_ = st.st_size;
+  CHECK_GE(size_, sizeof(Header)) << filename << " is not mapped weights";
+  // Private and writable: blobs point into the mapping and may be written,
+  // which copies the pages written instead of changing the file.
+  map_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(map_ != MAP_FAILED) << "Failed to map " << filename << ": "
+      << strerror(errno);
+  const Header* header = static_cast<const Header*>(map_);
+  CHECK_EQ(memcmp(header->magic, kMagic, sizeof(kMagic)), 0)
+      << filename << " is not mapped weights";
+  CHECK_EQ(header->version, kVersion)
+      << "Unsupported mapped weights version in " << filename;
+  CHECK_EQ(header->byte_order, kByteOrder)
+      << filename << " was written on a host of another byte order";
+  CHECK_LE(header->index_offset + header->index_size, size_)
+      << filename << " is truncated";
+  CHECK(index_.ParseFromArray(
+      static_cast<const char*>(map_) + header->index_offset,
+      header->index_size)) << "Failed to parse the index of " << filename;
+  for (int i = 0; i < index_.tensor_size(); ++i) {
+    const MappedWeightsIndex::Tensor& tensor = index_.tensor(i);
+    const uint64_t count = TensorCount(tensor);
+    CHECK_EQ(tensor.offset() % kAlignment, 0) << "Misaligned tensor of "
+        << tensor.layer() << " in " << filename;
+    CHECK_LE(tensor.offset() + count * sizeof(float), header->index_offset)
+        << "Tensor of " << tensor.layer() << " out of " << filename;
+  }
+}
+
+MappedWeights::~MappedWeights() {
+  if (map_ && map_ != MAP_FAILED) {
+    munmap(map_, size_);
+  }
+}
+
+float* MappedWeights::data(const MappedWeightsIndex::Tensor& tensor) const {
+  return reinterpret_cast<float*>(static_cast<char*>(map_) + tensor.offset());
+}
+
+bool MappedWeights::Contains(const void* p) const {
+  const char* begin = static_cast<const char*>(map_);
+  const char* q = static_cast<const char*>(p);
+  return q >= begin && q < begin + size_;
+}
+
+void MappedWeights::ToProto(NetParameter* param) const {
+  param->clear_layer();
+  LayerParameter* layer = NULL;
+  for (int i = 0; i < index_.tensor_size(); ++i) {
+    const MappedWeightsIndex::Tensor& tensor = index_.tensor(i);
+    if (!layer || layer->name() != tensor.layer()) {
+      layer = param->add_layer();
+      layer->set_name(tensor.layer());
+    }
+    CHECK_EQ(tensor.blob(), layer->blobs_size())
+        << "Blobs of " << tensor.layer() << " out of order in " << filename_;
+    ToProto(tensor, layer->add_blobs());
+  }
+}
+
+void MappedWeights::ToProto(const MappedWeightsIndex::Tensor& tensor,
+                            BlobProto* proto) const {
+  proto->Clear();
+  proto->mutable_shape()->CopyFrom(tensor.shape());
+  const float* values = data(tensor);
+  const uint64_t count = TensorCount(tensor);
+  proto->mutable_data()->Reserve(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    proto->add_data(values[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,96 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/memory_planner.hpp"
+
+namespace caffe {
+
+MemoryPlanner::MemoryPlanner(size_t alignment)
+    : alignment_(alignment), planned_(false), arena_size_(0),
+      naive_size_(0) {
+  CHECK_GT(alignment_, 0);
+}
+
+int MemoryPlanner::Add(size_t size, int first, int last) {
+  CHECK_LE(first, last);
+  Buffer buffer = {size, first, last, 0};
+  buffers_.push_back(buffer);
+  naive_size_ += size;
+  planned_ = false;
+  return buffers_.size() - 1;
+}
+
+size_t MemoryPlanner::offset(int id) const {
+  CHECK(planned_) << "Plan() should be called before querying offsets.";
+  CHECK_GE(id, 0);
+  CHECK_LT(id, buffers_.size());
+  return buffers_[id].offset;
+}
+
+void MemoryPlanner::Plan() {
+  vector<int> order(buffers_.size());
+  for (int i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return buffers_[a].size > buffers_[b].size;
+  });
+
+  arena_size_ = 0;
+  vector<int> placed;
+  for (int id : order) {
+    Buffer& buffer = buffers_[id];
+    // [begin, end) ranges taken by buffers alive together with this one.
+    vector<pair<size_t, size_t> > taken;
+    for (int other_id : placed) {
+      const Buffer& other = buffers_[other_id];
+      if (other.last < buffer.first || other.first > buffer.last) continue;
+      taken.push_back(make_pair(other.offset, other.offset + other.size));
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (auto& range : taken) {
+      if (offset + buffer.size <= range.first) break;
+      if (range.second > offset) {
+        offset = (range.second + alignment_ - 1) / alignment_ * alignment_;
+      }
+    }
+    buffer.offset = offset;
+    arena_size_ = std::max(arena_size_, offset + buffer.size);
+    placed.push_back(id);
+  }
+  planned_ = true;
+}
+
+}  // namespace caffe
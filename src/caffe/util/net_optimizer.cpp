@@ -0,0 +1,479 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/net_optimizer.hpp"
+
+namespace caffe {
+
+namespace {
+
+bool Contains(const google::protobuf::RepeatedPtrField<string>& names,
+              const string& name) {
+  return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+inline bool Reads(const LayerParameter& layer, const string& blob) {
+  return Contains(layer.bottom(), blob);
+}
+
+inline bool Writes(const LayerParameter& layer, const string& blob) {
+  return Contains(layer.top(), blob);
+}
+
+// The layers after from reading the value that blob has after from runs,
+// including the values in-place layers compute from it, up to the layer
+// that produces blob anew.
+vector<int> Readers(const NetParameter& param, int from, const string& blob) {
+  vector<int> readers;
+  for (int i = from + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    const bool reads = Reads(layer, blob);
+    if (Writes(layer, blob) && !reads) {
+      break;
+    }
+    if (reads) {
+      readers.push_back(i);
+    }
+  }
+  return readers;
+}
+
+// Whether any layer after from writes blob, in place or not.
+bool WrittenAfter(const NetParameter& param, int from, const string& blob) {
+  for (int i = from + 1; i < param.layer_size(); ++i) {
+    if (Writes(param.layer(i), blob)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether the last value of blob computed from layer from onwards is not read
+// by any layer, which makes it an output of the net.
+bool IsNetOutput(const NetParameter& param, int from, const string& blob) {
+  bool read = false;
+  for (int i = from + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    const bool reads = Reads(layer, blob);
+    const bool writes = Writes(layer, blob);
+    if (writes && !reads) {
+      return false;
+    }
+    if (writes) {
+      read = false;
+    } else if (reads) {
+      read = true;
+    }
+  }
+  return !read;
+}
+
+// Renames blob to name in the layers after from, up to the layer that
+// produces blob anew.
+void RenameBlob(NetParameter* param, int from, const string& blob,
+                const string& name) {
+  for (int i = from + 1; i < param->layer_size(); ++i) {
+    LayerParameter* layer = param->mutable_layer(i);
+    const bool reads = Reads(*layer, blob);
+    const bool writes = Writes(*layer, blob);
+    if (writes && !reads) {
+      return;
+    }
+    for (int j = 0; j < layer->bottom_size(); ++j) {
+      if (layer->bottom(j) == blob) {
+        layer->set_bottom(j, name);
+      }
+    }
+    for (int j = 0; writes && j < layer->top_size(); ++j) {
+      if (layer->top(j) == blob) {
+        layer->set_top(j, name);
+      }
+    }
+  }
+}
+
+void DeleteLayer(NetParameter* param, int index) {
+  param->mutable_layer()->DeleteSubrange(index, 1);
+}
+
+bool SharesParams(const LayerParameter& layer) {
+  for (int i = 0; i < layer.param_size(); ++i) {
+    if (!layer.param(i).name().empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether layer index may take over the top of the single-input,
+// single-output layer next that reads its top 0: next is the first reader,
+// and if next is not in place nothing else reads the value it replaces.
+bool CanAbsorb(const NetParameter& param, int index, int next) {
+  const LayerParameter& layer = param.layer(index);
+  const LayerParameter& follower = param.layer(next);
+  if (follower.bottom_size() != 1 || follower.top_size() != 1 ||
+      follower.blobs_size() > 0 || SharesParams(follower)) {
+    return false;
+  }
+  const vector<int> readers = Readers(param, index, layer.top(0));
+  if (readers.empty() || readers[0] != next) {
+    return false;
+  }
+  return follower.top(0) == follower.bottom(0) || readers.size() == 1;
+}
+
+// Removes layer next after layer index took over its computation.
+void Absorb(NetParameter* param, int index, int next) {
+  const LayerParameter& follower = param->layer(next);
+  if (follower.top(0) != follower.bottom(0)) {
+    param->mutable_layer(index)->set_top(0, follower.top(0));
+  }
+  DeleteLayer(param, next);
+}
+
+// The first reader of top 0 of layer index, -1 if there is none.
+int FirstReader(const NetParameter& param, int index) {
+  const vector<int> readers = Readers(param, index, param.layer(index).top(0));
+  return readers.empty() ? -1 : readers[0];
+}
+
+void LoadBlob(const BlobProto& proto, Blob<float>* blob) {
+  const bool kReshape = true;
+  blob->FromProto(proto, kReshape);
+}
+
+// Accumulates into alpha and beta the per channel y = alpha * x + beta
+// computed by a trained BatchNorm or Scale layer after the current ones.
+void ComposeAffine(const LayerParameter& layer, vector<float>* alpha,
+                   vector<float>* beta) {
+  const int channels = alpha->size();
+  vector<float> a(channels, 1.f);
+  vector<float> b(channels, 0.f);
+  Blob<float> blob;
+  if (layer.type() == "BatchNorm") {
+    CHECK_GE(layer.blobs_size(), 3) << "BatchNorm layer " << layer.name()
+        << " has no trained statistics to fold";
+    LoadBlob(layer.blobs(2), &blob);
+    const float factor = blob.cpu_data()[0] == 0 ? 0 : 1 / blob.cpu_data()[0];
+    const float eps = layer.batch_norm_param().eps();
+    Blob<float> mean;
+    LoadBlob(layer.blobs(0), &mean);
+    LoadBlob(layer.blobs(1), &blob);
+    CHECK_EQ(mean.count(), channels) << "Cannot fold " << layer.name();
+    CHECK_EQ(blob.count(), channels) << "Cannot fold " << layer.name();
+    for (int c = 0; c < channels; ++c) {
+      a[c] = 1 / std::sqrt(blob.cpu_data()[c] * factor + eps);
+      b[c] = -mean.cpu_data()[c] * factor * a[c];
+    }
+    if (layer.blobs_size() == 5) {
+      Blob<float> gamma;
+      LoadBlob(layer.blobs(3), &gamma);
+      LoadBlob(layer.blobs(4), &blob);
+      for (int c = 0; c < channels; ++c) {
+        a[c] *= gamma.cpu_data()[c];
+        b[c] = b[c] * gamma.cpu_data()[c] + blob.cpu_data()[c];
+      }
+    }
+  } else if (layer.type() == "Scale") {
+    CHECK_GE(layer.blobs_size(), 1) << "Scale layer " << layer.name()
+        << " has no trained parameters to fold";
+    LoadBlob(layer.blobs(0), &blob);
+    CHECK_EQ(blob.count(), channels) << "Cannot fold " << layer.name();
+    std::copy(blob.cpu_data(), blob.cpu_data() + channels, a.begin());
+    if (layer.blobs_size() > 1) {
+      LoadBlob(layer.blobs(1), &blob);
+      CHECK_EQ(blob.count(), channels) << "Cannot fold " << layer.name();
+      std::copy(blob.cpu_data(), blob.cpu_data() + channels, b.begin());
+    }
+  } else {
+    LOG(FATAL) << "Cannot fold layer " << layer.name() << " of type "
+               << layer.type();
+  }
+  for (int c = 0; c < channels; ++c) {
+    (*alpha)[c] *= a[c];
+    (*beta)[c] = (*beta)[c] * a[c] + b[c];
+  }
+}
+
+void FoldLayers(const LayerParameter& optimized, const NetParameter& weights,
+                const map<string, int>& index, LayerParameter* target) {
+  CHECK_GE(target->blobs_size(), 1) << "Layer " << target->name()
+      << " has no trained weights to fold into";
+  Blob<float> weight;
+  LoadBlob(target->blobs(0), &weight);
+  // Output channels are the outer axis of the weights, except for a
+  // transposed InnerProduct where they are the inner one.
+  const bool transposed = optimized.type() == "InnerProduct" &&
+      optimized.inner_product_param().transpose();
+  const int channels = transposed ? weight.shape(1) : weight.shape(0);
+  vector<float> alpha(channels, 1.f);
+  vector<float> beta(channels, 0.f);
+  for (int i = 0; i < optimized.folded_layer_size(); ++i) {
+    map<string, int>::const_iterator it = index.find(optimized.folded_layer(i));
+    CHECK(it != index.end()) << "Trained weights have no layer "
+        << optimized.folded_layer(i) << " folded into " << optimized.name();
+    ComposeAffine(weights.layer(it->second), &alpha, &beta);
+  }
+  float* w = weight.mutable_cpu_data();
+  const int inner = weight.count() / channels;
+  for (int i = 0; i < weight.count(); ++i) {
+    w[i] *= alpha[transposed ? i % channels : i / inner];
+  }
+  Blob<float> bias(vector<int>(1, channels));
+  if (target->blobs_size() > 1) {
+    LoadBlob(target->blobs(1), &bias);
+    CHECK_EQ(bias.count(), channels) << "Cannot fold into " << target->name();
+  } else {
+    caffe_set(channels, 0.f, bias.mutable_cpu_data());
+    target->add_blobs();
+  }
+  float* b = bias.mutable_cpu_data();
+  for (int c = 0; c < channels; ++c) {
+    b[c] = b[c] * alpha[c] + beta[c];
+  }
+  weight.ToProto(target->mutable_blobs(0));
+  bias.ToProto(target->mutable_blobs(1));
+}
+
+}  // namespace
+
+NetOptimizer::NetOptimizer(int opt_level, bool fuse_activation) {
+  CHECK_GE(opt_level, 0) << "opt_level should be in: 0,1,2";
+  CHECK_LE(opt_level, 2) << "opt_level should be in: 0,1,2";
+  if (opt_level >= 1) {
+    AddPass("RemoveIdentityLayers", RemoveIdentityLayers);
+  }
+  if (opt_level >= 2) {
+    AddPass("FoldBatchNormScale", FoldBatchNormScale);
+  }
+  if (opt_level >= 1) {
+    if (fuse_activation) {
+      AddPass("FuseActivation", FuseActivation);
+    }
+    AddPass("MakeInPlace", MakeInPlace);
+  }
+}
+
+void NetOptimizer::AddPass(const string& name, Pass pass) {
+  passes_.push_back(std::make_pair(name, pass));
+}
+
+bool NetOptimizer::Run(NetParameter* param) const {
+  bool changed = false;
+  for (int i = 0; i < passes_.size(); ++i) {
+    const int layers = param->layer_size();
+    if (passes_[i].second(param)) {
+      changed = true;
+      LOG_IF(INFO, Caffe::root_solver()) << "Graph pass " << passes_[i].first
+          << ": " << layers << " -> " << param->layer_size() << " layers";
+    }
+  }
+  return changed;
+}
+
+bool RemoveIdentityLayers(NetParameter* param) {
+  bool changed = false;
+  for (int i = 0; i < param->layer_size(); ++i) {
+    const LayerParameter& layer = param->layer(i);
+    const bool identity = layer.type() == "Split" ||
+        (layer.type() == "Dropout" && layer.dropout_param().scale_train());
+    if (!identity || layer.bottom_size() != 1) {
+      continue;
+    }
+    // Tops other than the bottom are renamed to it, which needs both names
+    // to keep their current value for the rest of the net.
+    const string bottom = layer.bottom(0);
+    bool removable = !WrittenAfter(*param, i, bottom);
+    for (int j = 0; removable && j < layer.top_size(); ++j) {
+      const string& top = layer.top(j);
+      removable = top == bottom || (!WrittenAfter(*param, i, top) &&
+                                    !IsNetOutput(*param, i, top));
+    }
+    if (!removable) {
+      continue;
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      if (layer.top(j) != bottom) {
+        RenameBlob(param, i, layer.top(j), bottom);
+      }
+    }
+    DeleteLayer(param, i--);
+    changed = true;
+  }
+  return changed;
+}
+
+bool FoldBatchNormScale(NetParameter* param) {
+  bool changed = false;
+  for (int i = 0; i < param->layer_size(); ++i) {
+    const LayerParameter& layer = param->layer(i);
+    const bool conv = layer.type() == "Convolution";
+    if (!(conv || layer.type() == "InnerProduct") || layer.top_size() != 1 ||
+        layer.blobs_size() > 0 || SharesParams(layer) ||
+        layer.has_fused_activation()) {
+      continue;
+    }
+    if (conv ? layer.convolution_param().axis() != 1
+             : layer.inner_product_param().axis() != 1) {
+      continue;
+    }
+    int next = FirstReader(*param, i);
+    while (next >= 0 && CanAbsorb(*param, i, next)) {
+      const LayerParameter& follower = param->layer(next);
+      bool foldable = false;
+      if (follower.type() == "BatchNorm") {
+        const BatchNormParameter& bn = follower.batch_norm_param();
+        foldable = !bn.has_use_global_stats() || bn.use_global_stats();
+      } else if (follower.type() == "Scale") {
+        const ScaleParameter& scale = follower.scale_param();
+        foldable = scale.axis() == 1 && scale.num_axes() == 1;
+      }
+      if (!foldable) {
+        break;
+      }
+      LayerParameter* target = param->mutable_layer(i);
+      target->add_folded_layer(follower.name());
+      if (conv) {
+        target->mutable_convolution_param()->set_bias_term(true);
+      } else {
+        target->mutable_inner_product_param()->set_bias_term(true);
+      }
+      Absorb(param, i, next);
+      changed = true;
+      next = FirstReader(*param, i);
+    }
+  }
+  return changed;
+}
+
+bool FuseActivation(NetParameter* param) {
+  bool changed = false;
+  for (int i = 0; i < param->layer_size(); ++i) {
+    const LayerParameter& layer = param->layer(i);
+    if (!(layer.type() == "Convolution" || layer.type() == "InnerProduct" ||
+          layer.type() == "Eltwise") || layer.top_size() != 1 ||
+        layer.blobs_size() > 0 || layer.has_fused_activation()) {
+      continue;
+    }
+    const int next = FirstReader(*param, i);
+    if (next < 0 || !CanAbsorb(*param, i, next)) {
+      continue;
+    }
+    const LayerParameter& follower = param->layer(next);
+    LayerParameter* target = param->mutable_layer(i);
+    if (follower.type() == "ReLU") {
+      target->mutable_relu_param()->CopyFrom(follower.relu_param());
+    } else if (follower.type() == "PReLU") {
+      target->mutable_prelu_param()->CopyFrom(follower.prelu_param());
+      target->set_fused_layer(follower.name());
+    } else {
+      continue;
+    }
+    target->set_fused_activation(follower.type());
+    Absorb(param, i, next);
+    changed = true;
+  }
+  return changed;
+}
+
+bool MakeInPlace(NetParameter* param) {
+  static const char* kElementWise[] = {"ReLU", "PReLU", "Sigmoid", "TanH",
+      "ELU", "AbsVal", "BNLL", "Power", "BatchNorm", "Scale"};
+  const vector<string> element_wise(kElementWise, kElementWise +
+      sizeof(kElementWise) / sizeof(kElementWise[0]));
+  bool changed = false;
+  for (int i = 0; i < param->layer_size(); ++i) {
+    const LayerParameter& layer = param->layer(i);
+    if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+        layer.top(0) == layer.bottom(0) ||
+        std::find(element_wise.begin(), element_wise.end(), layer.type()) ==
+        element_wise.end()) {
+      continue;
+    }
+    const string bottom = layer.bottom(0);
+    const string top = layer.top(0);
+    // The bottom is overwritten, so nothing may need it afterwards, and it
+    // must not be a net input filled by the caller.
+    int producer = i - 1;
+    while (producer >= 0 && !Writes(param->layer(producer), bottom)) {
+      --producer;
+    }
+    if (producer < 0 || param->layer(producer).bottom_size() == 0 ||
+        !Readers(*param, i, bottom).empty() ||
+        WrittenAfter(*param, i, bottom) || IsNetOutput(*param, i, top)) {
+      continue;
+    }
+    RenameBlob(param, i, top, bottom);
+    param->mutable_layer(i)->set_top(0, bottom);
+    changed = true;
+  }
+  return changed;
+}
+
+void FoldTrainedWeights(const NetParameter& optimized, NetParameter* weights) {
+  map<string, int> index;
+  for (int i = 0; i < weights->layer_size(); ++i) {
+    index[weights->layer(i).name()] = i;
+  }
+  for (int i = 0; i < optimized.layer_size(); ++i) {
+    const LayerParameter& layer = optimized.layer(i);
+    const bool prelu = layer.fused_activation() == "PReLU";
+    if (layer.folded_layer_size() == 0 && !prelu) {
+      continue;
+    }
+    map<string, int>::const_iterator it = index.find(layer.name());
+    if (it == index.end()) {
+      continue;
+    }
+    LayerParameter* target = weights->mutable_layer(it->second);
+    if (layer.folded_layer_size() > 0) {
+      FoldLayers(layer, *weights, index, target);
+    }
+    if (prelu) {
+      it = index.find(layer.fused_layer());
+      CHECK(it != index.end()) << "Trained weights have no layer "
+          << layer.fused_layer() << " fused into " << layer.name();
+      const LayerParameter& source = weights->layer(it->second);
+      CHECK_GE(source.blobs_size(), 1) << "PReLU layer " << source.name()
+          << " has no trained slopes";
+      target->add_blobs()->CopyFrom(source.blobs(0));
+    }
+  }
+}
+
+}  // namespace caffe
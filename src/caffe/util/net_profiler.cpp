@@ -0,0 +1,324 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/net_profiler.hpp"
+
+namespace caffe {
+
+namespace {
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Every profiler gets its own trace thread id, so traces of nets running in
+// different threads can be told apart once merged.
+int next_trace_tid() {
+  static std::atomic<int> tid(0);
+  return ++tid;
+}
+
+std::string json_escape(const std::string& s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); ++i) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out += ' ';
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+std::string csv_escape(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos) {
+    return s;
+  }
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '"') out += '"';
+    out += s[i];
+  }
+  return out + "\"";
+}
+
+}  // namespace
+
+template <typename Dtype>
+class NetProfiler<Dtype>::Hook : public Net<Dtype>::Callback {
+  public:
+  Hook(NetProfiler<Dtype>* profiler, bool before)
+      : profiler_(profiler), before_(before) {}
+  virtual ~Hook() {}
+
+  protected:
+  virtual void run(int layer) { Fire(layer, false); }
+  virtual void run_subnet(int subnet) { Fire(subnet, true); }
+
+  private:
+  void Fire(int id, bool subnet) {
+    if (!profiler_->enabled_) return;
+    if (before_) {
+      profiler_->Begin();
+    } else {
+      profiler_->End(id, subnet);
+    }
+  }
+
+  NetProfiler<Dtype>* profiler_;
+  bool before_;
+};
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(Net<Dtype>* net, size_t max_spans)
+    : net_(net), max_spans_(max_spans), spans_dropped_(false),
+      enabled_(true), tid_(next_trace_tid()), origin_ns_(now_ns()),
+      begin_ns_(0), begin_in_use_(0), begin_allocations_(0) {
+  before_ = new Hook(this, true);
+  after_ = new Hook(this, false);
+  net_->add_before_forward(before_);
+  net_->add_after_forward(after_);
+  Clear();
+}
+
+template <typename Dtype>
+NetProfiler<Dtype>::~NetProfiler() {
+  net_->remove_forward_callback(before_);
+  net_->remove_forward_callback(after_);
+  delete before_;
+  delete after_;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Clear() {
+  Summary empty = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  spans_.clear();
+  spans_dropped_ = false;
+  layer_summaries_.assign(net_->layers().size(), empty);
+  subnet_summaries_.clear();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Begin() {
+  const HostAllocStats alloc = HostAllocator::stats();
+  begin_in_use_ = alloc.bytes_in_use;
+  begin_allocations_ = alloc.allocations;
+  begin_sync_ = SyncedMemory::sync_stats();
+  begin_ns_ = now_ns();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::End(int id, bool subnet) {
+  const int64_t end_ns = now_ns();
+  const HostAllocStats alloc = HostAllocator::stats();
+  const MemorySyncStats sync = SyncedMemory::sync_stats();
+  Span span;
+  span.id = id;
+  span.subnet = subnet;
+  span.start_ns = begin_ns_ - origin_ns_;
+  span.duration_ns = end_ns - begin_ns_;
+  span.bytes_touched = 0;
+#ifdef USE_MLU
+  if (subnet) {
+    const vector<int>& layers = net_->subnets()[id]->layers();
+    for (int i = 0; i < layers.size(); ++i) {
+      span.bytes_touched += BytesTouched(layers[i]);
+    }
+  } else {
+    span.bytes_touched = BytesTouched(id);
+  }
+#else
+  span.bytes_touched = BytesTouched(id);
+#endif
+  span.alloc_bytes = static_cast<int64_t>(alloc.bytes_in_use) -
+      static_cast<int64_t>(begin_in_use_);
+  span.allocations = alloc.allocations - begin_allocations_;
+  span.host_bytes_in_use = alloc.bytes_in_use;
+  span.host_to_device = sync.host_to_device - begin_sync_.host_to_device;
+  span.device_to_host = sync.device_to_host - begin_sync_.device_to_host;
+  span.sync_bytes =
+      sync.host_to_device_bytes - begin_sync_.host_to_device_bytes +
+      sync.device_to_host_bytes - begin_sync_.device_to_host_bytes;
+
+  if (spans_.size() < max_spans_) {
+    spans_.push_back(span);
+  } else if (!spans_dropped_) {
+    LOG(WARNING) << "NetProfiler keeps at most " << max_spans_
+                 << " spans, later ones only go to the summary.";
+    spans_dropped_ = true;
+  }
+  if (subnet && subnet_summaries_.size() <= id) {
+    Summary empty = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    subnet_summaries_.resize(id + 1, empty);
+  }
+  Summary& sum = subnet ? subnet_summaries_[id] : layer_summaries_[id];
+  sum.min_ns = sum.calls ? std::min(sum.min_ns, span.duration_ns)
+                         : span.duration_ns;
+  sum.max_ns = std::max(sum.max_ns, span.duration_ns);
+  ++sum.calls;
+  sum.total_ns += span.duration_ns;
+  sum.bytes_touched += span.bytes_touched;
+  sum.alloc_bytes += span.alloc_bytes;
+  sum.allocations += span.allocations;
+  sum.host_to_device += span.host_to_device;
+  sum.device_to_host += span.device_to_host;
+  sum.sync_bytes += span.sync_bytes;
+}
+
+template <typename Dtype>
+uint64_t NetProfiler<Dtype>::BytesTouched(int layer) const {
+  uint64_t count = 0;
+  const vector<Blob<Dtype>*>& bottom = net_->bottom_vecs()[layer];
+  for (int i = 0; i < bottom.size(); ++i) {
+    count += bottom[i]->count();
+  }
+  const vector<Blob<Dtype>*>& top = net_->top_vecs()[layer];
+  for (int i = 0; i < top.size(); ++i) {
+    count += top[i]->count();
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& params =
+      net_->layers()[layer]->blobs();
+  for (int i = 0; i < params.size(); ++i) {
+    count += params[i]->count();
+  }
+  return count * sizeof(Dtype);
+}
+
+template <typename Dtype>
+std::string NetProfiler<Dtype>::SpanName(int id, bool subnet) const {
+  if (!subnet) {
+    return net_->layer_names()[id];
+  }
+  std::ostringstream name;
+  name << "SubNet " << id;
+#ifdef USE_MLU
+  const vector<int>& layers = net_->subnets()[id]->layers();
+  if (!layers.empty()) {
+    name << " (" << net_->layer_names()[layers.front()] << " .. "
+         << net_->layer_names()[layers.back()] << ")";
+  }
+#endif
+  return name.str();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteChromeTrace(const std::string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  const int pid = getpid();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+      << ",\"tid\":" << tid_ << ",\"args\":{\"name\":\""
+      << json_escape(net_->name()) << "\"}}";
+  out.setf(std::ios::fixed);
+  out.precision(3);
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    const Span& span = spans_[i];
+    const double ts = span.start_ns / 1e3;
+    const char* type = span.subnet ? "SubNet" :
+        net_->layers()[span.id]->type();
+    out << ",\n{\"name\":\"" << json_escape(SpanName(span.id, span.subnet))
+        << "\",\"cat\":\"" << (span.subnet ? "subnet" : "layer")
+        << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid_
+        << ",\"ts\":" << ts << ",\"dur\":" << span.duration_ns / 1e3
+        << ",\"args\":{\"type\":\"" << json_escape(type)
+        << "\",\"index\":" << span.id
+        << ",\"bytes_touched\":" << span.bytes_touched
+        << ",\"alloc_bytes\":" << span.alloc_bytes
+        << ",\"allocations\":" << span.allocations
+        << ",\"host_to_device\":" << span.host_to_device
+        << ",\"device_to_host\":" << span.device_to_host
+        << ",\"sync_bytes\":" << span.sync_bytes << "}}";
+    out << ",\n{\"name\":\"host memory\",\"ph\":\"C\",\"pid\":" << pid
+        << ",\"tid\":" << tid_ << ",\"ts\":"
+        << (span.start_ns + span.duration_ns) / 1e3
+        << ",\"args\":{\"bytes_in_use\":" << span.host_bytes_in_use << "}}";
+  }
+  out << "\n]}\n";
+  CHECK(out) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteCsv(const std::string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  int64_t total_ns = 0;
+  for (int i = 0; i < layer_summaries_.size(); ++i) {
+    total_ns += layer_summaries_[i].total_ns;
+  }
+  for (int i = 0; i < subnet_summaries_.size(); ++i) {
+    total_ns += subnet_summaries_[i].total_ns;
+  }
+  out << "kind,index,name,type,calls,total_ms,mean_ms,min_ms,max_ms,percent,"
+      << "bytes_touched,alloc_bytes,allocations,host_to_device,"
+      << "device_to_host,sync_bytes\n";
+  out.setf(std::ios::fixed);
+  out.precision(4);
+  for (int pass = 0; pass < 2; ++pass) {
+    const bool subnet = pass == 1;
+    const vector<Summary>& summaries =
+        subnet ? subnet_summaries_ : layer_summaries_;
+    for (int i = 0; i < summaries.size(); ++i) {
+      const Summary& sum = summaries[i];
+      if (sum.calls == 0) continue;
+      const char* type = subnet ? "SubNet" : net_->layers()[i]->type();
+      out << (subnet ? "subnet" : "layer") << ',' << i << ','
+          << csv_escape(SpanName(i, subnet)) << ',' << csv_escape(type) << ','
+          << sum.calls << ',' << sum.total_ns / 1e6 << ','
+          << sum.total_ns / 1e6 / sum.calls << ',' << sum.min_ns / 1e6 << ','
+          << sum.max_ns / 1e6 << ','
+          << (total_ns ? 100.0 * sum.total_ns / total_ns : 0.0) << ','
+          << sum.bytes_touched / sum.calls << ','
+          << sum.alloc_bytes << ',' << sum.allocations << ','
+          << sum.host_to_device << ',' << sum.device_to_host << ','
+          << sum.sync_bytes << '\n';
+    }
+  }
+  CHECK(out) << "Failed to write " << filename;
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
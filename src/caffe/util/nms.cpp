@@ -0,0 +1,391 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NMS_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/util/nms.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+inline float Overlap(float ax1, float ay1, float ax2, float ay2, float aarea,
+    float bx1, float by1, float bx2, float by2, float barea, float offset) {
+  const float w = std::max(std::min(ax2, bx2) - std::max(ax1, bx1) + offset,
+                           0.f);
+  const float h = std::max(std::min(ay2, by2) - std::max(ay1, by1) + offset,
+                           0.f);
+  const float inter = w * h;
+  const float uni = aarea + barea - inter;
+  return uni > 0 ? inter / uni : 0.f;
+}
+
+inline bool Exceeds(float overlap, float threshold, bool suppress_equal) {
+  return overlap > threshold || (suppress_equal && overlap == threshold);
+}
+
+// Whether box b overlaps any of the n boxes of the arrays by more than
+// threshold (or exactly threshold with suppress_equal).
+typedef bool (*SuppressKernel)(const float* x1, const float* y1,
+    const float* x2, const float* y2, const float* area, const int n,
+    const float bx1, const float by1, const float bx2, const float by2,
+    const float barea, const float offset, const float threshold,
+    const bool suppress_equal);
+
+bool suppress_scalar(const float* x1, const float* y1, const float* x2,
+    const float* y2, const float* area, const int n, const float bx1,
+    const float by1, const float bx2, const float by2, const float barea,
+    const float offset, const float threshold, const bool suppress_equal) {
+  for (int k = 0; k < n; ++k) {
+    if (Exceeds(Overlap(x1[k], y1[k], x2[k], y2[k], area[k], bx1, by1, bx2,
+                        by2, barea, offset), threshold, suppress_equal)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#ifdef NMS_X86
+// Same operations as Overlap in the same order, so the decisions are those
+// of the scalar kernel.
+__attribute__((target("avx2")))
+bool suppress_avx2(const float* x1, const float* y1, const float* x2,
+    const float* y2, const float* area, const int n, const float bx1,
+    const float by1, const float bx2, const float by2, const float barea,
+    const float offset, const float threshold, const bool suppress_equal) {
+  const __m256 vbx1 = _mm256_set1_ps(bx1);
+  const __m256 vby1 = _mm256_set1_ps(by1);
+  const __m256 vbx2 = _mm256_set1_ps(bx2);
+  const __m256 vby2 = _mm256_set1_ps(by2);
+  const __m256 vbarea = _mm256_set1_ps(barea);
+  const __m256 voffset = _mm256_set1_ps(offset);
+  const __m256 vthreshold = _mm256_set1_ps(threshold);
+  const __m256 zero = _mm256_setzero_ps();
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256 w = _mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(x2 + k), vbx2),
+                             _mm256_max_ps(_mm256_loadu_ps(x1 + k), vbx1));
+    __m256 h = _mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(y2 + k), vby2),
+                             _mm256_max_ps(_mm256_loadu_ps(y1 + k), vby1));
+    w = _mm256_max_ps(_mm256_add_ps(w, voffset), zero);
+    h = _mm256_max_ps(_mm256_add_ps(h, voffset), zero);
+    const __m256 inter = _mm256_mul_ps(w, h);
+    const __m256 uni = _mm256_sub_ps(
+        _mm256_add_ps(_mm256_loadu_ps(area + k), vbarea), inter);
+    const __m256 overlap = _mm256_and_ps(_mm256_div_ps(inter, uni),
+        _mm256_cmp_ps(uni, zero, _CMP_GT_OQ));
+    const __m256 exceeds = suppress_equal ?
+        _mm256_cmp_ps(overlap, vthreshold, _CMP_GE_OQ) :
+        _mm256_cmp_ps(overlap, vthreshold, _CMP_GT_OQ);
+    if (_mm256_movemask_ps(exceeds)) {
+      return true;
+    }
+  }
+  return suppress_scalar(x1 + k, y1 + k, x2 + k, y2 + k, area + k, n - k,
+      bx1, by1, bx2, by2, barea, offset, threshold, suppress_equal);
+}
+#endif  // NMS_X86
+
+SuppressKernel select_suppress_kernel() {
+#ifdef NMS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return suppress_avx2;
+  }
+#endif
+  return suppress_scalar;
+}
+
+SuppressKernel suppress_kernel() {
+  static const SuppressKernel kernel = select_suppress_kernel();
+  return kernel;
+}
+
+typedef std::pair<float, int> ScoreIndex;
+
+// True if a is visited before b: higher score first, then lower index.
+inline bool Precedes(const ScoreIndex& a, const ScoreIndex& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+inline bool FollowedBy(const ScoreIndex& a, const ScoreIndex& b) {
+  return Precedes(b, a);
+}
+
+// Collects the candidates above the score threshold, trimmed to the top_k
+// best with a partial selection.
+void GatherCandidates(const float* scores, int n, const NMSParam& param,
+                      vector<ScoreIndex>* candidates) {
+  candidates->clear();
+  for (int i = 0; i < n; ++i) {
+    if (scores[i] > param.score_threshold) {
+      candidates->push_back(std::make_pair(scores[i], i));
+    }
+  }
+  if (param.top_k > -1 && param.top_k < candidates->size()) {
+    std::nth_element(candidates->begin(), candidates->begin() + param.top_k,
+                     candidates->end(), Precedes);
+    candidates->resize(param.top_k);
+  }
+}
+
+// The boxes kept so far, copied into contiguous arrays.
+class KeptSet {
+  public:
+  explicit KeptSet(const NMSBoxes& boxes)
+      : boxes_(boxes), offset_(boxes.normalized ? 0.f : 1.f) {}
+
+  bool Suppresses(int i, float threshold, bool suppress_equal) const {
+    return suppress_kernel()(x1_.data(), y1_.data(), x2_.data(), y2_.data(),
+        area_.data(), x1_.size(), boxes_.x1[i], boxes_.y1[i], boxes_.x2[i],
+        boxes_.y2[i], boxes_.area[i], offset_, threshold, suppress_equal);
+  }
+
+  void Add(int i) {
+    x1_.push_back(boxes_.x1[i]);
+    y1_.push_back(boxes_.y1[i]);
+    x2_.push_back(boxes_.x2[i]);
+    y2_.push_back(boxes_.y2[i]);
+    area_.push_back(boxes_.area[i]);
+  }
+
+  private:
+  const NMSBoxes& boxes_;
+  const float offset_;
+  vector<float> x1_, y1_, x2_, y2_, area_;
+};
+
+// Greedy hard NMS; next(&i) yields the candidates in visiting order.
+template <typename Next>
+void HardNMS(const NMSBoxes& boxes, const float* scores,
+             const NMSParam& param, Next next, vector<int>* indices,
+             vector<float>* kept_scores) {
+  KeptSet kept(boxes);
+  int i;
+  while (next(&i)) {
+    if (boxes.area[i] < param.min_area ||
+        kept.Suppresses(i, param.overlap_threshold, param.suppress_equal)) {
+      continue;
+    }
+    kept.Add(i);
+    indices->push_back(i);
+    if (kept_scores) {
+      kept_scores->push_back(scores[i]);
+    }
+    if (param.keep_top_k > -1 && indices->size() >= param.keep_top_k) {
+      break;
+    }
+  }
+}
+
+void SoftNMS(const NMSBoxes& boxes, const float* scores,
+             const NMSParam& param, vector<int>* indices,
+             vector<float>* kept_scores) {
+  vector<ScoreIndex> candidates;
+  GatherCandidates(scores, boxes.size(), param, &candidates);
+  // The remaining boxes, removed by swapping in the last one.
+  vector<float> x1, y1, x2, y2, area, score;
+  vector<int> index;
+  for (int c = 0; c < candidates.size(); ++c) {
+    const int i = candidates[c].second;
+    if (boxes.area[i] < param.min_area) {
+      continue;
+    }
+    x1.push_back(boxes.x1[i]);
+    y1.push_back(boxes.y1[i]);
+    x2.push_back(boxes.x2[i]);
+    y2.push_back(boxes.y2[i]);
+    area.push_back(boxes.area[i]);
+    score.push_back(candidates[c].first);
+    index.push_back(i);
+  }
+  const float offset = boxes.normalized ? 0.f : 1.f;
+  int n = index.size();
+  while (n > 0) {
+    int best = 0;
+    for (int r = 1; r < n; ++r) {
+      if (Precedes(std::make_pair(score[r], index[r]),
+                   std::make_pair(score[best], index[best]))) {
+        best = r;
+      }
+    }
+    indices->push_back(index[best]);
+    if (kept_scores) {
+      kept_scores->push_back(score[best]);
+    }
+    if (param.keep_top_k > -1 && indices->size() >= param.keep_top_k) {
+      break;
+    }
+    const float bx1 = x1[best], by1 = y1[best];
+    const float bx2 = x2[best], by2 = y2[best];
+    const float barea = area[best];
+    --n;
+    x1[best] = x1[n];
+    y1[best] = y1[n];
+    x2[best] = x2[n];
+    y2[best] = y2[n];
+    area[best] = area[n];
+    score[best] = score[n];
+    index[best] = index[n];
+    for (int r = 0; r < n; ++r) {
+      const float overlap = Overlap(x1[r], y1[r], x2[r], y2[r], area[r],
+                                    bx1, by1, bx2, by2, barea, offset);
+      if (param.method == NMS_SOFT_LINEAR) {
+        score[r] *= overlap > param.overlap_threshold ? 1.f - overlap : 1.f;
+      } else {
+        score[r] *= std::exp(-overlap * overlap / param.sigma);
+      }
+    }
+    int m = 0;
+    for (int r = 0; r < n; ++r) {
+      if (score[r] > param.score_threshold) {
+        x1[m] = x1[r];
+        y1[m] = y1[r];
+        x2[m] = x2[r];
+        y2[m] = y2[r];
+        area[m] = area[r];
+        score[m] = score[r];
+        index[m] = index[r];
+        ++m;
+      }
+    }
+    n = m;
+  }
+}
+
+}  // namespace
+
+void NMSBoxes::clear() {
+  x1.clear();
+  y1.clear();
+  x2.clear();
+  y2.clear();
+  area.clear();
+}
+
+void NMSBoxes::reserve(int n) {
+  x1.reserve(n);
+  y1.reserve(n);
+  x2.reserve(n);
+  y2.reserve(n);
+  area.reserve(n);
+}
+
+void NMSBoxes::push_back(float xmin, float ymin, float xmax, float ymax) {
+  float box_area = 0;
+  if (xmax >= xmin && ymax >= ymin) {
+    const float offset = normalized ? 0.f : 1.f;
+    box_area = (xmax - xmin + offset) * (ymax - ymin + offset);
+  }
+  push_back(xmin, ymin, xmax, ymax, box_area);
+}
+
+void NMSBoxes::push_back(float xmin, float ymin, float xmax, float ymax,
+                         float box_area) {
+  x1.push_back(xmin);
+  y1.push_back(ymin);
+  x2.push_back(xmax);
+  y2.push_back(ymax);
+  area.push_back(box_area);
+}
+
+void NonMaxSuppression(const NMSBoxes& boxes, const float* scores,
+    const NMSParam& param, vector<int>* indices, vector<float>* kept_scores) {
+  CHECK(indices);
+  indices->clear();
+  if (kept_scores) {
+    kept_scores->clear();
+  }
+  if (param.method != NMS_HARD) {
+    CHECK(param.method != NMS_SOFT_GAUSSIAN || param.sigma > 0)
+        << "Gaussian soft NMS needs a positive sigma.";
+    SoftNMS(boxes, scores, param, indices, kept_scores);
+    return;
+  }
+  vector<ScoreIndex> heap;
+  GatherCandidates(scores, boxes.size(), param, &heap);
+  std::make_heap(heap.begin(), heap.end(), FollowedBy);
+  HardNMS(boxes, scores, param, [&heap](int* i) {
+    if (heap.empty()) {
+      return false;
+    }
+    std::pop_heap(heap.begin(), heap.end(), FollowedBy);
+    *i = heap.back().second;
+    heap.pop_back();
+    return true;
+  }, indices, kept_scores);
+}
+
+void NonMaxSuppressionOrdered(const NMSBoxes& boxes, const vector<int>& order,
+    const NMSParam& param, vector<int>* indices) {
+  CHECK(indices);
+  CHECK_EQ(param.method, NMS_HARD) << "Only hard NMS takes a fixed order.";
+  indices->clear();
+  int next = 0;
+  HardNMS(boxes, static_cast<const float*>(NULL), param,
+      [&order, &next](int* i) {
+    if (next == order.size()) {
+      return false;
+    }
+    *i = order[next++];
+    return true;
+  }, indices, NULL);
+}
+
+void NonMaxSuppressionBatched(const NMSBoxes& boxes,
+    const vector<const float*>& scores, const NMSParam& param,
+    vector<vector<int> >* indices, vector<vector<float> >* kept_scores) {
+  CHECK(indices);
+  indices->assign(scores.size(), vector<int>());
+  if (kept_scores) {
+    kept_scores->assign(scores.size(), vector<float>());
+  }
+  // A class touches every box, and some of them many times.
+  caffe_parallel_for(scores.size(), boxes.size() * 16,
+                     [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      if (scores[c]) {
+        NonMaxSuppression(boxes, scores[c], param, &(*indices)[c],
+                          kept_scores ? &(*kept_scores)[c] : NULL);
+      }
+    }
+  });
+}
+
+}  // namespace caffe
@@ -0,0 +1,174 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <memory>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Set on pool workers and on a thread while it runs a job, so that nested
+// parallel loops stay on their thread.
+thread_local bool in_parallel_region = false;
+
+// Below this many elements a loop is not worth splitting.
+const size_t kMinParallelWork = 16384;
+
+std::mutex intra_op_mutex;
+std::shared_ptr<ThreadPool> intra_op_pool;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads)
+  : fn_(NULL), tasks_(0), next_(0), pending_(0), active_(0), generation_(0),
+    stop_(false) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::Work, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void ThreadPool::RunTasks(const std::function<void(int)>& fn, int tasks) {
+  int i;
+  while ((i = next_.fetch_add(1)) < tasks) {
+    fn(i);
+    pending_--;
+  }
+}
+
+void ThreadPool::Work() {
+  in_parallel_region = true;
+  unsigned long long seen = 0;  // NOLINT(runtime/int)
+  while (true) {
+    const std::function<void(int)>* fn;
+    int tasks;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+      fn = fn_;
+      tasks = tasks_;
+      active_++;
+    }
+    if (tasks > 0) {
+      RunTasks(*fn, tasks);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      active_--;
+    }
+    done_.notify_one();
+  }
+}
+
+void ThreadPool::Run(int tasks, const std::function<void(int)>& fn) {
+  std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+  if (workers_.empty() || tasks <= 1 || in_parallel_region ||
+      !run_lock.owns_lock()) {
+    for (int i = 0; i < tasks; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    tasks_ = tasks;
+    next_ = 0;
+    pending_ = tasks;
+    generation_++;
+  }
+  start_.notify_all();
+  in_parallel_region = true;
+  RunTasks(fn, tasks);
+  in_parallel_region = false;
+  // Wait for the workers to finish their tasks and to leave this job, then
+  // retire it so that a worker waking up late finds nothing to do.
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&]() { return pending_ == 0 && active_ == 0; });
+  fn_ = NULL;
+  tasks_ = 0;
+}
+
+void caffe_set_cpu_threads(int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::lock_guard<std::mutex> lock(intra_op_mutex);
+  if (!intra_op_pool || intra_op_pool->num_threads() != num_threads) {
+    intra_op_pool.reset(num_threads > 1 ? new ThreadPool(num_threads) : NULL);
+  }
+}
+
+int caffe_cpu_threads() {
+  std::lock_guard<std::mutex> lock(intra_op_mutex);
+  return intra_op_pool ? intra_op_pool->num_threads() : 1;
+}
+
+void caffe_parallel_for(int n, size_t work,
+                        const std::function<void(int, int)>& fn) {
+  if (n <= 0) {
+    return;
+  }
+  std::shared_ptr<ThreadPool> pool;
+  if (!in_parallel_region) {
+    std::lock_guard<std::mutex> lock(intra_op_mutex);
+    pool = intra_op_pool;
+  }
+  int chunks = pool ? std::min(n, pool->num_threads()) : 1;
+  chunks = std::min<size_t>(chunks, n * work / kMinParallelWork);
+  if (chunks <= 1) {
+    fn(0, n);
+    return;
+  }
+  pool->Run(chunks, [&](int t) {
+    fn(static_cast<long long>(n) * t / chunks,  // NOLINT(runtime/int)
+       static_cast<long long>(n) * (t + 1) / chunks);  // NOLINT(runtime/int)
+  });
+}
+
+}  // namespace caffe
@@ -0,0 +1,322 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Transform matrices of Lavin & Gray, "Fast Algorithms for Convolutional
+// Neural Networks": Y = AT [(G g GT) .* (BT d B)] A.
+template <int M> struct WinogradMatrices;
+
+template <> struct WinogradMatrices<2> {
+  static const double BT[4][4];
+  static const double G[4][3];
+  static const double AT[2][4];
+};
+
+const double WinogradMatrices<2>::BT[4][4] = {
+  {1,  0, -1,  0},
+  {0,  1,  1,  0},
+  {0, -1,  1,  0},
+  {0,  1,  0, -1}};
+const double WinogradMatrices<2>::G[4][3] = {
+  {1.0,  0.0, 0.0},
+  {0.5,  0.5, 0.5},
+  {0.5, -0.5, 0.5},
+  {0.0,  0.0, 1.0}};
+const double WinogradMatrices<2>::AT[2][4] = {
+  {1, 1,  1,  0},
+  {0, 1, -1, -1}};
+
+template <> struct WinogradMatrices<4> {
+  static const double BT[6][6];
+  static const double G[6][3];
+  static const double AT[4][6];
+};
+
+const double WinogradMatrices<4>::BT[6][6] = {
+  {4,  0, -5,  0, 1, 0},
+  {0, -4, -4,  1, 1, 0},
+  {0,  4, -4, -1, 1, 0},
+  {0, -2, -1,  2, 1, 0},
+  {0,  2, -1, -2, 1, 0},
+  {0,  4,  0, -5, 0, 1}};
+const double WinogradMatrices<4>::G[6][3] = {
+  { 1.0 / 4,  0.0,       0.0},
+  {-1.0 / 6, -1.0 / 6,  -1.0 / 6},
+  {-1.0 / 6,  1.0 / 6,  -1.0 / 6},
+  { 1.0 / 24, 1.0 / 12,  1.0 / 6},
+  { 1.0 / 24, -1.0 / 12, 1.0 / 6},
+  { 0.0,      0.0,       1.0}};
+const double WinogradMatrices<4>::AT[4][6] = {
+  {1, 1,  1, 1,  1, 0},
+  {0, 1, -1, 2, -2, 0},
+  {0, 1,  1, 4,  4, 0},
+  {0, 1, -1, 8, -8, 1}};
+
+// The matrices above converted to Dtype once per call.
+template <typename Dtype, int M>
+struct WinogradTables {
+  static const int A = M + 2;
+  Dtype bt[A * A];
+  Dtype g[A * 3];
+  Dtype at[M * A];
+  WinogradTables() {
+    typedef WinogradMatrices<M> W;
+    for (int i = 0; i < A; ++i) {
+      for (int j = 0; j < A; ++j) bt[i * A + j] = W::BT[i][j];
+      for (int j = 0; j < 3; ++j) g[i * 3 + j] = W::G[i][j];
+    }
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < A; ++j) at[i * A + j] = W::AT[i][j];
+    }
+  }
+};
+
+// out (R x R) = L in LT, with L an R x S matrix and in S x S.
+template <typename Dtype, int R, int S>
+inline void sandwich(const Dtype* L, const Dtype* in, Dtype* out) {
+  Dtype tmp[R * S];
+  for (int i = 0; i < R; ++i) {
+    for (int j = 0; j < S; ++j) {
+      Dtype sum = 0;
+      for (int k = 0; k < S; ++k) {
+        sum += L[i * S + k] * in[k * S + j];
+      }
+      tmp[i * S + j] = sum;
+    }
+  }
+  for (int i = 0; i < R; ++i) {
+    for (int j = 0; j < R; ++j) {
+      Dtype sum = 0;
+      for (int k = 0; k < S; ++k) {
+        sum += tmp[i * S + k] * L[j * S + k];
+      }
+      out[i * R + j] = sum;
+    }
+  }
+}
+
+template <typename Dtype, int M>
+void transform_weight(const Dtype* weight, const int num_output,
+    const int channels, const int group, Dtype* weight_tf) {
+  const int A = M + 2;
+  const int out_per_group = num_output / group;
+  const int in_per_group = channels / group;
+  const WinogradTables<Dtype, M> t;
+  caffe_parallel_for(num_output, in_per_group * A * A * 3 * 2,
+      [&](int begin, int end) {
+    Dtype u[A * A];
+    for (int k = begin; k < end; ++k) {
+      const int g = k / out_per_group;
+      Dtype* dst = weight_tf + g * A * A * out_per_group * in_per_group +
+          (k % out_per_group) * in_per_group;
+      for (int c = 0; c < in_per_group; ++c) {
+        sandwich<Dtype, A, 3>(t.g, weight + (k * in_per_group + c) * 9, u);
+        for (int xi = 0; xi < A * A; ++xi) {
+          dst[xi * out_per_group * in_per_group + c] = u[xi];
+        }
+      }
+    }
+  });
+}
+
+// Scatters the transformed input patches: frequency xi of tile t in channel
+// c lands at input_tf[(xi * channels + c) * num_tiles + t].
+template <typename Dtype, int M>
+void transform_input(const WinogradTables<Dtype, M>& t,
+    const Dtype* data_im, const int channels, const int height,
+    const int width, const int pad_htop, const int pad_wleft,
+    const int tiles_h, const int tiles_w, Dtype* input_tf) {
+  const int A = M + 2;
+  const int num_tiles = tiles_h * tiles_w;
+  const int xi_stride = channels * num_tiles;
+  caffe_parallel_for(channels, num_tiles * A * A * A * 2,
+      [&](int begin, int end) {
+    Dtype d[A * A];
+    Dtype v[A * A];
+    for (int c = begin; c < end; ++c) {
+      const Dtype* im = data_im + c * height * width;
+      Dtype* dst = input_tf + c * num_tiles;
+      for (int th = 0; th < tiles_h; ++th) {
+        const int h0 = th * M - pad_htop;
+        for (int tw = 0; tw < tiles_w; ++tw) {
+          const int w0 = tw * M - pad_wleft;
+          if (h0 >= 0 && w0 >= 0 && h0 + A <= height && w0 + A <= width) {
+            for (int i = 0; i < A; ++i) {
+              const Dtype* row = im + (h0 + i) * width + w0;
+              for (int j = 0; j < A; ++j) d[i * A + j] = row[j];
+            }
+          } else {
+            for (int i = 0; i < A; ++i) {
+              const int h = h0 + i;
+              for (int j = 0; j < A; ++j) {
+                const int w = w0 + j;
+                d[i * A + j] = (h >= 0 && h < height && w >= 0 && w < width)
+                    ? im[h * width + w] : Dtype(0);
+              }
+            }
+          }
+          sandwich<Dtype, A, A>(t.bt, d, v);
+          const int tile = th * tiles_w + tw;
+          for (int xi = 0; xi < A * A; ++xi) {
+            dst[xi * xi_stride + tile] = v[xi];
+          }
+        }
+      }
+    }
+  });
+}
+
+// Gathers the per-frequency GEMM results of every tile, maps them back to
+// M x M outputs and adds the bias, dropping what falls past the border.
+template <typename Dtype, int M>
+void transform_output(const WinogradTables<Dtype, M>& t,
+    const Dtype* output_tf, const int num_output, const int tiles_h,
+    const int tiles_w, const int output_h, const int output_w,
+    const Dtype* bias, Dtype* data_out) {
+  const int A = M + 2;
+  const int num_tiles = tiles_h * tiles_w;
+  const int xi_stride = num_output * num_tiles;
+  caffe_parallel_for(num_output, num_tiles * A * A * M * 2,
+      [&](int begin, int end) {
+    Dtype m[A * A];
+    Dtype y[M * M];
+    for (int k = begin; k < end; ++k) {
+      const Dtype* src = output_tf + k * num_tiles;
+      Dtype* out = data_out + k * output_h * output_w;
+      const Dtype b = bias ? bias[k] : Dtype(0);
+      for (int th = 0; th < tiles_h; ++th) {
+        const int rows = std::min(M, output_h - th * M);
+        for (int tw = 0; tw < tiles_w; ++tw) {
+          const int cols = std::min(M, output_w - tw * M);
+          const int tile = th * tiles_w + tw;
+          for (int xi = 0; xi < A * A; ++xi) {
+            m[xi] = src[xi * xi_stride + tile];
+          }
+          sandwich<Dtype, M, A>(t.at, m, y);
+          for (int i = 0; i < rows; ++i) {
+            Dtype* row = out + (th * M + i) * output_w + tw * M;
+            for (int j = 0; j < cols; ++j) row[j] = y[i * M + j] + b;
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype, int M>
+void conv(const Dtype* data_im, const int channels, const int height,
+    const int width, const int pad_htop, const int pad_wleft,
+    const int num_output, const int group, const int output_h,
+    const int output_w, const Dtype* weight_tf, const Dtype* bias,
+    Dtype* input_tf, Dtype* output_tf, Dtype* data_out) {
+  const int A = M + 2;
+  const int tiles_h = winograd_tiles(output_h, M);
+  const int tiles_w = winograd_tiles(output_w, M);
+  const int num_tiles = tiles_h * tiles_w;
+  const int out_per_group = num_output / group;
+  const int in_per_group = channels / group;
+  const WinogradTables<Dtype, M> t;
+  transform_input<Dtype, M>(t, data_im, channels, height, width, pad_htop,
+      pad_wleft, tiles_h, tiles_w, input_tf);
+  // One (num_output / group) x (channels / group) x num_tiles GEMM per
+  // frequency and group, which is where nearly all the arithmetic goes.
+  for (int xi = 0; xi < A * A; ++xi) {
+    for (int g = 0; g < group; ++g) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_per_group,
+          num_tiles, in_per_group, (Dtype)1.,
+          weight_tf + (g * A * A + xi) * out_per_group * in_per_group,
+          input_tf + (xi * channels + g * in_per_group) * num_tiles,
+          (Dtype)0.,
+          output_tf + (xi * num_output + g * out_per_group) * num_tiles);
+    }
+  }
+  transform_output<Dtype, M>(t, output_tf, num_output, tiles_h, tiles_w,
+      output_h, output_w, bias, data_out);
+}
+
+}  // namespace
+
+template <typename Dtype>
+void winograd_transform_weight_cpu(const int tile, const Dtype* weight,
+    const int num_output, const int channels, const int group,
+    Dtype* weight_tf) {
+  if (tile == 2) {
+    transform_weight<Dtype, 2>(weight, num_output, channels, group,
+                               weight_tf);
+  } else {
+    CHECK_EQ(tile, 4) << "Winograd supports 2x2 and 4x4 output tiles.";
+    transform_weight<Dtype, 4>(weight, num_output, channels, group,
+                               weight_tf);
+  }
+}
+
+template <typename Dtype>
+void winograd_conv_cpu(const int tile, const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const int pad_htop, const int pad_wleft, const int num_output,
+    const int group, const int output_h, const int output_w,
+    const Dtype* weight_tf, const Dtype* bias, Dtype* input_tf,
+    Dtype* output_tf, Dtype* data_out) {
+  if (tile == 2) {
+    conv<Dtype, 2>(data_im, channels, height, width, pad_htop, pad_wleft,
+        num_output, group, output_h, output_w, weight_tf, bias, input_tf,
+        output_tf, data_out);
+  } else {
+    CHECK_EQ(tile, 4) << "Winograd supports 2x2 and 4x4 output tiles.";
+    conv<Dtype, 4>(data_im, channels, height, width, pad_htop, pad_wleft,
+        num_output, group, output_h, output_w, weight_tf, bias, input_tf,
+        output_tf, data_out);
+  }
+}
+
+// Explicit instantiation
+#define INSTANTIATE_WINOGRAD(Dtype) \
+template void winograd_transform_weight_cpu<Dtype>(const int tile, \
+    const Dtype* weight, const int num_output, const int channels, \
+    const int group, Dtype* weight_tf); \
+template void winograd_conv_cpu<Dtype>(const int tile, \
+    const Dtype* data_im, const int channels, const int height, \
+    const int width, const int pad_htop, const int pad_wleft, \
+    const int num_output, const int group, const int output_h, \
+    const int output_w, const Dtype* weight_tf, const Dtype* bias, \
+    Dtype* input_tf, Dtype* output_tf, Dtype* data_out)
+
+INSTANTIATE_WINOGRAD(float);
+INSTANTIATE_WINOGRAD(double);
+
+}  // namespace caffe
@@ -0,0 +1,184 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Load generator for BatchingServer: clients send single sample requests to
+// replicas of a TEST net in CPU mode, and the latency percentiles, the
+// throughput and how full the batches ran are reported, next to forwarding
+// the same requests one at a time.
+// Usage:
+//    batching_benchmark --model=deploy.prototxt [--weights=net.caffemodel]
+//        [--replicas=1] [--max_batch=8] [--max_delay_ms=2] [--clients=16]
+//        [--qps=0] [--requests=2000]
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <future>  // NOLINT(build/c++11)
+#include <random>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/batching_server.hpp"
+#include "caffe/util/benchmark.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "", "The model definition protocol buffer text file.");
+DEFINE_string(weights, "", "Optional; the trained weights, random if unset.");
+DEFINE_int32(replicas, 1, "Nets sharing the weights, one worker thread each.");
+DEFINE_int32(max_batch, 8, "Largest batch the server forms.");
+DEFINE_double(max_delay_ms, 2, "Longest a request waits for a batch to fill.");
+DEFINE_int32(clients, 16, "Closed loop clients, each waiting for its answer "
+    "before sending the next request; unused with --qps.");
+DEFINE_double(qps, 0, "Optional; send requests open loop at this rate, with "
+    "exponential gaps between them.");
+DEFINE_int32(requests, 2000, "Number of requests sent.");
+DEFINE_int32(cpu_threads, 1, "Threads CPU layers split their loops over.");
+
+typedef BatchingServer<float>::Sample Sample;
+
+// Sends FLAGS_requests copies of sample and returns the seconds it took.
+double RunLoad(BatchingServer<float>* server, const Sample& sample) {
+  CPUTimer timer;
+  timer.Start();
+  if (FLAGS_qps > 0) {
+    std::mt19937 rng(1701);
+    std::exponential_distribution<double> gap(FLAGS_qps);
+    vector<std::future<Sample> > results;
+    std::chrono::steady_clock::time_point next =
+        std::chrono::steady_clock::now();
+    for (int i = 0; i < FLAGS_requests; ++i) {
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(gap(rng)));
+      std::this_thread::sleep_until(next);
+      results.push_back(server->Submit(sample));
+    }
+    for (int i = 0; i < results.size(); ++i) {
+      results[i].wait();
+    }
+  } else {
+    vector<std::thread> clients;
+    for (int c = 0; c < FLAGS_clients; ++c) {
+      const int requests = FLAGS_requests / FLAGS_clients +
+                           (c < FLAGS_requests % FLAGS_clients);
+      clients.push_back(std::thread([server, &sample, requests]() {
+        for (int i = 0; i < requests; ++i) {
+          server->Submit(sample).wait();
+        }
+      }));
+    }
+    for (int c = 0; c < clients.size(); ++c) {
+      clients[c].join();
+    }
+  }
+  return timer.Seconds();
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Benchmarks batching single sample requests.\n"
+      "Usage:\n"
+      "    batching_benchmark --model=deploy.prototxt [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  CHECK_GT(FLAGS_replicas, 0);
+  CHECK_GT(FLAGS_clients, 0);
+  CHECK_GT(FLAGS_requests, 0);
+
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  Net<float> net(FLAGS_model, TEST);
+  if (FLAGS_weights.size()) {
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
+  vector<shared_ptr<Net<float> > > replicas;
+  vector<Net<float>*> nets(1, &net);
+  for (int i = 1; i < FLAGS_replicas; ++i) {
+    replicas.push_back(net.CreateReplica());
+    nets.push_back(replicas.back().get());
+  }
+
+  // Every request carries the same random sample.
+  Sample sample(net.input_blobs().size());
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<float> filler(filler_param);
+  for (int i = 0; i < sample.size(); ++i) {
+    vector<int> shape = net.input_blobs()[i]->shape();
+    CHECK_GE(shape.size(), 1) << "Input " << i << " has no batch axis";
+    shape[0] = 1;
+    Blob<float> blob(shape);
+    filler.Fill(&blob);
+    sample[i].assign(blob.cpu_data(), blob.cpu_data() + blob.count());
+  }
+
+  // The same requests forwarded one at a time, for reference.
+  for (int i = 0; i < sample.size(); ++i) {
+    Blob<float>* input = net.input_blobs()[i];
+    vector<int> shape = input->shape();
+    shape[0] = 1;
+    input->Reshape(shape);
+    std::copy(sample[i].begin(), sample[i].end(), input->mutable_cpu_data());
+  }
+  net.Forward();  // warm up
+  const int single_requests = std::min(FLAGS_requests, 200);
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < single_requests; ++i) {
+    net.Forward();
+  }
+  const double single_ms = timer.MilliSeconds() / single_requests;
+  LOG(INFO) << "Unbatched: " << single_ms << " ms per request, "
+            << 1000 / single_ms << " requests/s on one thread";
+
+  BatchingServer<float> server(nets, FLAGS_max_batch, FLAGS_max_delay_ms);
+  const double seconds = RunLoad(&server, sample);
+  const BatchingStats stats = server.stats();
+  LOG(INFO) << "Batched:   " << stats.requests << " requests in "
+            << stats.batches << " batches over " << seconds << " s, "
+            << stats.requests / seconds << " requests/s on "
+            << FLAGS_replicas << " replicas";
+  LOG(INFO) << "Latency:   p50 " << stats.p50_ms << " ms, p99 "
+            << stats.p99_ms << " ms";
+  LOG(INFO) << "Batches:   " << stats.mean_batch() << " requests each, "
+            << stats.batch_fill() * 100 << "% of max_batch "
+            << FLAGS_max_batch << ", " << stats.full_batches
+            << " sent full";
+  return 0;
+}
@@ -35,9 +35,11 @@ namespace bp = boost::python;
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <cstring>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -45,6 +47,7 @@ namespace bp = boost::python;
 #include "caffe/caffe.hpp"
 #include "caffe/compile.hpp"
 #include "caffe/util/format.hpp"
+#include "caffe/util/net_profiler.hpp"
 #include "caffe/util/signal_handler.h"
 #ifdef USE_MLU
 #include "cnrt.h" //NOLINT
@@ -76,6 +79,10 @@ DEFINE_string(mreshape, "SETUPONLY",
     "SETUPONLY - reshape only when layerSetUp and Init\n"
     "DETECT    - let caffe detects when need to reshape\n"
     "            Note: DETECT is under *alpha* version not recomended");
+DEFINE_string(msplit, "LINEAR",
+    "Optional; specify the SplitMode when running in MFUS mode.\n"
+    "LINEAR   - cut subnets whenever MLU support flips in layer order\n"
+    "TOPOLOGY - group MLU supported layers along the network topology");
 DEFINE_string(mname, "offline",
     "The name for the offline model to be generated.");
 DEFINE_int32(batchsize, 1, "Read images size every batch for inference");
@@ -111,6 +118,24 @@ DEFINE_string(dataorder, "0,0",
 DEFINE_string(output_dtype, "INVALID",
     "Specifies the type of output in the middle of the model.");
 DEFINE_int32(opt_level, 1, "Optimized the model.");
+DEFINE_string(host_allocator, "system",
+    "Optional; host memory allocator: system or pooled.");
+DEFINE_bool(host_huge_pages, false,
+    "Optional; back large pooled host blocks with transparent huge pages.");
+DEFINE_int32(cpu_threads, 1,
+    "Optional; threads CPU layers split their work over, 0 for all cores.");
+DEFINE_string(profile, "",
+    "Optional; for time, profile the forward passes once more and write a "
+    "Chrome trace to <profile>.json and a per-layer summary to <profile>.csv.");
+DEFINE_string(dump_optimized, "",
+    "Optional; for test and time, write the net as built, after the graph "
+    "optimization passes of --opt_level, to this prototxt file.");
+DEFINE_bool(cpu_int8, false,
+    "Optional; for test and time in CPU mode, run the layers quantized by "
+    "generate_quantized_pt in int8.");
+DEFINE_string(cpu_weight_dtype, "",
+    "Optional; for test and time in CPU mode, store the weights of "
+    "Convolution and InnerProduct layers in FLOAT16 or BFLOAT16.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -179,6 +204,40 @@ vector<string> get_stages_from_flags() {
   return stages;
 }
 
+// Read the model for test and time. The graph optimization passes run when
+// the prototxt or an explicit --opt_level asks for them.
+NetParameter get_net_param_from_flags(caffe::Phase phase,
+                                      const vector<string>& stages) {
+  NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(phase);
+  param.mutable_state()->set_level(FLAGS_level);
+  for (int i = 0; i < stages.size(); i++) {
+    param.mutable_state()->add_stage(stages[i]);
+  }
+  if (!gflags::GetCommandLineFlagInfoOrDie("opt_level").is_default) {
+    param.set_opt_level(FLAGS_opt_level);
+  }
+  if (FLAGS_cpu_int8) {
+    param.set_cpu_int8(true);
+  }
+  if (FLAGS_cpu_weight_dtype.size()) {
+    caffe::BaseDataType dtype;
+    CHECK(caffe::BaseDataType_Parse("DT_" + FLAGS_cpu_weight_dtype, &dtype))
+        << "Unknown --cpu_weight_dtype " << FLAGS_cpu_weight_dtype;
+    param.set_cpu_weight_dtype(dtype);
+  }
+  return param;
+}
+
+// Write the net as built for --dump_optimized.
+void dump_optimized_from_flags(const Net<float>& net) {
+  if (FLAGS_dump_optimized.size()) {
+    caffe::WriteProtoToTextFile(net.optimized_param(), FLAGS_dump_optimized);
+    LOG(INFO) << "Optimized net written to " << FLAGS_dump_optimized;
+  }
+}
+
 // caffe commands to call by
 //     caffe <command> <args>
 //
@@ -333,6 +392,7 @@ void parse_mlu_args_for_test() {
 
   parse_mlu_device_args();
   Caffe::setReshapeMode(FLAGS_mreshape);
+  Caffe::setSplitMode(FLAGS_msplit);
   Caffe::set_mode(FLAGS_mmode);
 }
 #endif  // USE_MLU
@@ -363,7 +423,8 @@ int test() {
   #endif  // USE_MLU
   }
   // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, caffe::TEST, FLAGS_level, &stages);
+  Net<float> caffe_net(get_net_param_from_flags(caffe::TEST, stages));
+  dump_optimized_from_flags(caffe_net);
   if (FLAGS_weights.size()) caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
@@ -433,6 +494,7 @@ int genoff() {
   Caffe::set_rt_core(FLAGS_mcore);
   Caffe::set_mode(Caffe::MFUS);
   Caffe::setReshapeMode(Caffe::ReshapeMode::SETUPONLY);
+  Caffe::setSplitMode(FLAGS_msplit);
   Caffe::setDetectOpMode(FLAGS_Bangop);
   if (FLAGS_output_dtype != "INVALID")
     caffe::Caffe::setTopDataType(FLAGS_output_dtype);
@@ -513,7 +575,8 @@ int time() {
     parse_mlu_args_for_test();
   #endif
   // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
+  Net<float> caffe_net(get_net_param_from_flags(phase, stages));
+  dump_optimized_from_flags(caffe_net);
 
   // Do a clean forward and backward pass, so that memory allocation are done
   // and future iterations will be more stable.
@@ -584,10 +647,70 @@ int time() {
             << total_timer.MilliSeconds() / FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_profile.size()) {
+    // Whole Forward passes run the net callbacks, so MFUS SubNets show too.
+    caffe::NetProfiler<float> profiler(&caffe_net);
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      caffe_net.Forward(&initial_loss);
+    }
+    profiler.WriteChromeTrace(FLAGS_profile + ".json");
+    profiler.WriteCsv(FLAGS_profile + ".csv");
+    LOG(INFO) << "Profile written to " << FLAGS_profile << ".json and "
+              << FLAGS_profile << ".csv";
+  }
   return 0;
 }
 RegisterBrewFunction(time);
 
+// memory: report the planned activation memory of an inference net.
+int memory() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to plan.";
+  vector<string> stages = get_stages_from_flags();
+  LOG(INFO) << "Use CPU.";
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(caffe::TEST);
+  param.mutable_state()->set_level(FLAGS_level);
+  for (int i = 0; i < stages.size(); i++) {
+    param.mutable_state()->add_stage(stages[i]);
+  }
+  param.set_plan_memory(true);
+  Net<float> caffe_net(param);
+
+  // every distinct data memory of the net is an allocation without planning
+  std::set<caffe::SyncedMemory*> mems;
+  size_t naive_bytes = 0;
+  for (auto blob : caffe_net.blobs()) {
+    if (mems.insert(blob->data().get()).second) {
+      naive_bytes += blob->data()->size();
+    }
+  }
+  const shared_ptr<caffe::MemoryPlanner>& plan = caffe_net.memory_plan();
+  CHECK(plan) << "Memory planning was skipped.";
+  const vector<string>& layer_names = caffe_net.layer_names();
+  LOG(INFO) << "*** Memory plan begins ***";
+  for (int i = 0; i < plan->size(); ++i) {
+    LOG(INFO) << std::setfill(' ') << std::setw(10) << plan->offset(i)
+              << "\tsize: " << plan->buffer_size(i)
+              << "\tlive: " << layer_names[plan->first(i)]
+              << " -> " << layer_names[plan->last(i)];
+  }
+  size_t pinned_bytes = naive_bytes - plan->naive_size();
+  size_t planned_bytes = pinned_bytes + plan->arena_size();
+  LOG(INFO) << "Planned activations: " << plan->size() << ", "
+            << plan->naive_size() << " bytes -> " << plan->arena_size()
+            << " bytes.";
+  LOG(INFO) << "Inputs/outputs: " << pinned_bytes << " bytes.";
+  LOG(INFO) << "Naive footprint: " << naive_bytes << " bytes.";
+  LOG(INFO) << "Planned peak: " << planned_bytes << " bytes ("
+            << 100.0 * planned_bytes / std::max<size_t>(naive_bytes, 1)
+            << "%).";
+  LOG(INFO) << "*** Memory plan ends ***";
+  return 0;
+}
+RegisterBrewFunction(memory);
+
 int main(int argc, char** argv) {
   // Print output to stderr (while still logging).
   FLAGS_alsologtostderr = 1;
@@ -602,9 +725,12 @@ int main(int argc, char** argv) {
       "  test            score a model\n"
       "  device_query    show GPU diagnostic information\n"
       "  genoff          generate offline model\n"
+      "  memory          report planned activation memory of a model\n"
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_host_allocator(FLAGS_host_allocator, FLAGS_host_huge_pages);
+  Caffe::set_cpu_threads(FLAGS_cpu_threads);
   if (argc == 2) {
   #ifdef WITH_PYTHON_LAYER
     try {
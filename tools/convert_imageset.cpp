@@ -36,10 +36,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// Images are read, resized and encoded by --threads threads and spread over
+// --shards databases, see DataParameter shards. The progress is kept in
+// DB_NAME.progress, so that running the same command again after a crash
+// resumes where the last commit left off.
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -47,10 +58,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
@@ -67,6 +80,138 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 1, "Threads reading, resizing and encoding images");
+DEFINE_int32(shards, 1,
+    "Number of databases to write, image i of the list going to i % shards");
+DEFINE_bool(ordered, true, "Write the images in the order of the list; "
+    "otherwise as soon as they are ready, which a slow image doesn't hold up");
+DEFINE_int32(seed, 0, "Seed of --shuffle, 0 for a random one");
+
+#ifdef USE_OPENCV
+namespace {
+
+const int kCommitInterval = 1000;
+
+// An image converted by a worker, value is empty if it couldn't be read.
+struct Converted {
+  string value;
+  int data_size;   // size of the data of the datum
+  int pixels;      // channels * height * width
+};
+
+// Hands the lines to convert to the workers and their results to the
+// writer. Workers stay within window lines of the writer, which bounds what
+// waits in memory, e.g. behind a slow image when ordered.
+class ConvertQueue {
+  public:
+  ConvertQueue(int begin, int end, int window)
+      : next_(begin), end_(end), window_(window), expected_(begin),
+        consumed_(begin) {}
+
+  // The next line to convert, false when there is none left.
+  bool Take(int* line_id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] {
+      return next_ == end_ || next_ < consumed_ + window_;
+    });
+    if (next_ == end_) {
+      return false;
+    }
+    *line_id = next_++;
+    return true;
+  }
+
+  void Put(int line_id, Converted* converted) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(ready_[line_id], *converted);
+    ready_cond_.notify_one();
+  }
+
+  // The next result, in line order when ordered, false when all are out.
+  bool Get(bool ordered, int* line_id, Converted* converted) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (consumed_ == end_) {
+      return false;
+    }
+    ready_cond_.wait(lock, [this, ordered] {
+      return ordered ? ready_.count(expected_) > 0 : !ready_.empty();
+    });
+    std::map<int, Converted>::iterator it =
+        ordered ? ready_.find(expected_) : ready_.begin();
+    *line_id = it->first;
+    std::swap(*converted, it->second);
+    ready_.erase(it);
+    ++expected_;
+    ++consumed_;
+    space_.notify_all();
+    return true;
+  }
+
+  private:
+  std::mutex mutex_;
+  std::condition_variable space_;
+  std::condition_variable ready_cond_;
+  int next_;
+  const int end_;
+  const int window_;
+  int expected_;
+  int consumed_;
+  std::map<int, Converted> ready_;
+};
+
+// What DB_NAME.progress records: the lines before done are in the
+// databases. The rest is the command the databases were started with,
+// which a resumed run must repeat.
+struct Progress {
+  string list;
+  string backend;
+  int shards;
+  bool shuffle;
+  unsigned int seed;
+  int done;
+};
+
+bool ReadProgress(const string& filename, Progress* progress) {
+  std::ifstream file(filename.c_str());
+  if (!file) {
+    return false;
+  }
+  std::map<string, string> values;
+  string line;
+  while (std::getline(file, line)) {
+    const size_t space = line.find(' ');
+    CHECK_NE(space, string::npos) << "Malformed progress file " << filename;
+    values[line.substr(0, space)] = line.substr(space + 1);
+  }
+  CHECK_EQ(values.size(), 6) << "Malformed progress file " << filename;
+  progress->list = values["list"];
+  progress->backend = values["backend"];
+  progress->shards = atoi(values["shards"].c_str());
+  progress->shuffle = values["shuffle"] == "1";
+  progress->seed = strtoul(values["seed"].c_str(), NULL, 10);
+  progress->done = atoi(values["done"].c_str());
+  return true;
+}
+
+// Replaces the file in one step, so a crash leaves either version.
+void WriteProgress(const string& filename, const Progress& progress) {
+  const string tmp = filename + ".tmp";
+  {
+    std::ofstream file(tmp.c_str());
+    file << "list " << progress.list << "\n"
+         << "backend " << progress.backend << "\n"
+         << "shards " << progress.shards << "\n"
+         << "shuffle " << progress.shuffle << "\n"
+         << "seed " << progress.seed << "\n"
+         << "done " << progress.done << "\n";
+    CHECK(file.good()) << "Failed to write " << tmp;
+  }
+  CHECK_EQ(rename(tmp.c_str(), filename.c_str()), 0)
+      << "Failed to write " << filename;
+}
+
+}  // namespace
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -96,6 +241,29 @@ int main(int argc, char** argv) {
   const bool check_size = FLAGS_check_size;
   const bool encoded = FLAGS_encoded;
   const string encode_type = FLAGS_encode_type;
+  CHECK_GE(FLAGS_threads, 1) << "--threads must be positive";
+  CHECK_GE(FLAGS_shards, 1) << "--shards must be positive";
+
+  // Resume if the databases were started by the same command.
+  const string db_name(argv[3]);
+  const string progress_file = db_name + ".progress";
+  Progress progress;
+  const bool resume = ReadProgress(progress_file, &progress);
+  if (resume) {
+    CHECK(progress.list == argv[2] && progress.backend == FLAGS_backend &&
+          progress.shards == FLAGS_shards &&
+          progress.shuffle == FLAGS_shuffle)
+        << db_name << " was started with another list, backend, --shards or "
+        << "--shuffle, see " << progress_file;
+    LOG(INFO) << "Resuming after " << progress.done << " images";
+  } else {
+    progress.list = argv[2];
+    progress.backend = FLAGS_backend;
+    progress.shards = FLAGS_shards;
+    progress.shuffle = FLAGS_shuffle;
+    progress.seed = FLAGS_seed ? FLAGS_seed : caffe_rng_rand();
+    progress.done = 0;
+  }
 
   std::ifstream infile(argv[2]);
   std::vector<std::pair<std::string, int>> lines;
@@ -108,11 +276,15 @@ int main(int argc, char** argv) {
     lines.push_back(std::make_pair(line.substr(0, pos), label));
   }
   if (FLAGS_shuffle) {
-    // randomly shuffle data
+    // randomly shuffle data, the same way when resuming
     LOG(INFO) << "Shuffling data";
+    Caffe::set_random_seed(progress.seed);
     shuffle(lines.begin(), lines.end());
   }
   LOG(INFO) << "A total of " << lines.size() << " images.";
+  const int begin = progress.done;
+  const int end = lines.size();
+  CHECK_LE(begin, end) << "The list got shorter";
 
   if (encode_type.size() && !encoded)
     LOG(INFO) << "encode_type specified, assuming encoded=true.";
@@ -120,71 +292,105 @@ int main(int argc, char** argv) {
   int resize_height = std::max<int>(0, FLAGS_resize_height);
   int resize_width = std::max<int>(0, FLAGS_resize_width);
 
-  // Create new DB
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
-  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  // Create new DBs, or open those of the run resumed
+  const int shards = FLAGS_shards;
+  vector<shared_ptr<db::DB> > dbs(shards);
+  vector<shared_ptr<db::Transaction> > txns(shards);
+  for (int i = 0; i < shards; ++i) {
+    dbs[i].reset(db::GetDB(FLAGS_backend));
+    dbs[i]->Open(db::ShardSource(db_name, i, shards),
+                 resume ? db::WRITE : db::NEW);
+    txns[i].reset(dbs[i]->NewTransaction());
+  }
+  WriteProgress(progress_file, progress);
 
-  // Storing to db
+  // Read, resize and encode on the workers
   std::string root_folder(argv[1]);
-  Datum datum;
+  ConvertQueue queue(begin, end,
+                     std::max(kCommitInterval, 16 * FLAGS_threads));
+  vector<std::thread> workers;
+  for (int t = 0; t < FLAGS_threads; ++t) {
+    workers.push_back(std::thread([&] {
+      Datum datum;
+      int line_id;
+      while (queue.Take(&line_id)) {
+        std::string enc = encode_type;
+        if (encoded && !enc.size()) {
+          // Guess the encoding type from the file name
+          string fn = lines[line_id].first;
+          size_t p = fn.rfind('.');
+          if (p == fn.npos) {
+            LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+          }
+          enc = fn.substr(p);
+          std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+        }
+        Converted converted;
+        if (ReadImageToDatum(root_folder + lines[line_id].first,
+                             lines[line_id].second, resize_height,
+                             resize_width, is_color, enc, &datum)) {
+          CHECK(datum.SerializeToString(&converted.value));
+          converted.data_size = datum.data().size();
+          converted.pixels = datum.channels() * datum.height() *
+                             datum.width();
+        }
+        queue.Put(line_id, &converted);
+      }
+    }));
+  }
+
+  // Store to the DBs on this thread. The lines before done are all written
+  // even out of order; lines after it that are written again on resume get
+  // the same keys.
+  vector<bool> written(end - begin, false);
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
-
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if (p == fn.npos) {
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      }
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(
-        root_folder + lines[line_id].first,
-        lines[line_id].second,
-        resize_height,
-        resize_width,
-        is_color,
-        enc,
-        &datum);
-    if (status == false) {
+  int line_id;
+  Converted converted;
+  while (queue.Get(FLAGS_ordered, &line_id, &converted)) {
+    written[line_id - begin] = true;
+    if (converted.value.empty()) {
       continue;
     }
     if (check_size) {
       if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
+        data_size = converted.pixels;
         data_size_initialized = true;
       } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size " << data.size();
+        CHECK_EQ(converted.data_size, data_size)
+            << "Incorrect data field size " << converted.data_size;
       }
     }
     // sequential
     string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
 
     // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
+    txns[line_id % shards]->Put(key_str, converted.value);
 
-    if (++count % 1000 == 0) {
+    if (++count % kCommitInterval == 0) {
       // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
+      for (int i = 0; i < shards; ++i) {
+        txns[i]->Commit();
+        txns[i].reset(dbs[i]->NewTransaction());
+      }
+      while (progress.done < end && written[progress.done - begin]) {
+        ++progress.done;
+      }
+      WriteProgress(progress_file, progress);
       LOG(INFO) << "Processed " << count << " files.";
     }
   }
+  for (int t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
   // write the last batch
-  if (count % 1000 != 0) {
-    txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
+  for (int i = 0; i < shards; ++i) {
+    txns[i]->Commit();
   }
+  progress.done = end;
+  WriteProgress(progress_file, progress);
+  LOG(INFO) << "Processed " << count << " files.";
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
@@ -0,0 +1,190 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Reports how far the int8 CPU path of a quantized net (the output of
+// generate_quantized_pt) is from its float forward: the same net is run with
+// and without NetParameter cpu_int8 on the same inputs, and every blob is
+// compared. Data layers read in lockstep; Input blobs are filled with the
+// same uniform noise.
+// Usage:
+//    int8_accuracy --model=quantized.prototxt --weights=net.caffemodel
+//        [--iterations=10] [--input_range=1] [--threads=1]
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/int8_gemm.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "", "The quantized net prototxt.");
+DEFINE_string(weights, "", "The trained weights.");
+DEFINE_int32(iterations, 10, "Number of batches compared.");
+DEFINE_double(input_range, 1, "Input blobs are uniform in [-range, range].");
+DEFINE_int32(threads, 1, "Threads CPU layers split their work over.");
+
+// Differences between the float blob and the int8 one, over all batches.
+struct BlobError {
+  BlobError()
+      : count(0), max_abs(0), sum_abs(0), sum_ref2(0), sum_err2(0),
+        sum_q2(0), dot(0), rows(0), argmax_agree(0) {}
+
+  void Add(const Blob<float>& ref, const Blob<float>& q) {
+    CHECK_EQ(ref.count(), q.count());
+    const float* r = ref.cpu_data();
+    const float* x = q.cpu_data();
+    for (int i = 0; i < ref.count(); ++i) {
+      const double err = std::fabs(double(x[i]) - r[i]);
+      max_abs = std::max(max_abs, err);
+      sum_abs += err;
+      sum_err2 += err * err;
+      sum_ref2 += double(r[i]) * r[i];
+      sum_q2 += double(x[i]) * x[i];
+      dot += double(r[i]) * x[i];
+    }
+    count += ref.count();
+    // Classifier scores: does the int8 net pick the same class?
+    if (ref.num_axes() >= 2 && ref.count() > 0) {
+      const int dim = ref.count(1);
+      for (int n = 0; n < ref.shape(0); ++n) {
+        argmax_agree += std::max_element(r + n * dim, r + (n + 1) * dim) - r ==
+                        std::max_element(x + n * dim, x + (n + 1) * dim) - x;
+      }
+      rows += ref.shape(0);
+    }
+  }
+
+  int64_t count;
+  double max_abs;
+  double sum_abs;
+  double sum_ref2;
+  double sum_err2;
+  double sum_q2;
+  double dot;
+  int rows;
+  int argmax_agree;
+};
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Compares the int8 CPU forward of a quantized net "
+      "with its float forward.\n"
+      "Usage:\n"
+      "    int8_accuracy --model=quantized.prototxt --weights=net.caffemodel "
+      "[FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need trained weights.";
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_cpu_threads(FLAGS_threads);
+  LOG(INFO) << "int8 GEMM: " << int8_gemm_isa();
+
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(TEST);
+  param.set_cpu_int8(false);
+  Net<float> ref_net(param);
+  param.set_cpu_int8(true);
+  Net<float> int8_net(param);
+  ref_net.CopyTrainedLayersFrom(FLAGS_weights);
+  int8_net.CopyTrainedLayersFrom(FLAGS_weights);
+
+  int int8_layers = 0;
+  for (int i = 0; i < int8_net.layers().size(); ++i) {
+    int8_layers += UseCpuInt8(int8_net.layers()[i]->layer_param());
+  }
+  LOG(INFO) << int8_layers << " of " << int8_net.layers().size()
+            << " layers run in int8";
+  if (int8_layers == 0) {
+    LOG(WARNING) << "No layer has int8 blobs_dtype and bottom_mlu_dtype, "
+                 << "run generate_quantized_pt first";
+  }
+
+  const vector<string>& names = ref_net.blob_names();
+  vector<BlobError> errors(names.size());
+  double ref_ms = 0, int8_ms = 0;
+  CPUTimer timer;
+  Caffe::set_random_seed(1701);
+  for (int it = 0; it < FLAGS_iterations; ++it) {
+    for (int i = 0; i < ref_net.input_blobs().size(); ++i) {
+      Blob<float>* ref_input = ref_net.input_blobs()[i];
+      Blob<float>* int8_input = int8_net.input_blobs()[i];
+      caffe_rng_uniform<float>(ref_input->count(), -FLAGS_input_range,
+          FLAGS_input_range, ref_input->mutable_cpu_data());
+      int8_input->CopyFrom(*ref_input, false, true);
+    }
+    timer.Start();
+    ref_net.Forward();
+    ref_ms += timer.MilliSeconds();
+    timer.Start();
+    int8_net.Forward();
+    int8_ms += timer.MilliSeconds();
+    for (int i = 0; i < names.size(); ++i) {
+      errors[i].Add(*ref_net.blob_by_name(names[i]),
+                    *int8_net.blob_by_name(names[i]));
+    }
+  }
+
+  LOG(INFO) << "Forward: float " << ref_ms / FLAGS_iterations << " ms, int8 "
+            << int8_ms / FLAGS_iterations << " ms per batch";
+  LOG(INFO) << "blob: max abs error, mean abs error, relative L2 error, "
+            << "cosine similarity[, argmax agreement]";
+  for (int i = 0; i < names.size(); ++i) {
+    const BlobError& e = errors[i];
+    if (e.count == 0) {
+      continue;
+    }
+    const double norms = std::sqrt(e.sum_ref2 * e.sum_q2);
+    std::ostringstream line;
+    line << names[i] << ": " << e.max_abs << ", " << e.sum_abs / e.count
+         << ", " << std::sqrt(e.sum_err2 / std::max(e.sum_ref2, 1e-30))
+         << ", " << (norms > 0 ? e.dot / norms : 1.);
+    if (std::find(ref_net.output_blob_indices().begin(),
+                  ref_net.output_blob_indices().end(), i) !=
+        ref_net.output_blob_indices().end() && e.rows > 0) {
+      line << ", " << 100. * e.argmax_agree / e.rows << "%";
+    }
+    LOG(INFO) << line.str();
+  }
+  return 0;
+}
@@ -0,0 +1,164 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Times NonMaxSuppression against the sort-and-erase NMS it replaced, on
+// random clustered boxes scored for several classes sharing locations.
+// Usage:
+//    nms_benchmark [--boxes=12000] [--classes=21] [--iterations=10]
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/bbox_util.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/nms.hpp"
+#include "caffe/util/rng.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(boxes, 12000, "Number of candidate boxes per class.");
+DEFINE_int32(classes, 21, "Number of classes, the first one is background.");
+DEFINE_int32(iterations, 10, "Number of timed runs of each implementation.");
+DEFINE_int32(top_k, -1, "Candidates considered per class, -1 for all.");
+DEFINE_double(score_threshold, 0.01, "Minimum candidate score.");
+DEFINE_double(nms_threshold, 0.45, "Overlap threshold.");
+DEFINE_int32(threads, 1, "Threads running the classes in batched mode.");
+
+// The NMS of bbox_util before it moved to NonMaxSuppression.
+void LegacyNMS(const vector<NormalizedBBox>& bboxes,
+               const vector<float>& scores, vector<int>* indices) {
+  vector<pair<float, int> > score_index_vec;
+  GetMaxScoreIndex(scores, FLAGS_score_threshold, FLAGS_top_k,
+                   &score_index_vec);
+  indices->clear();
+  while (score_index_vec.size() != 0) {
+    const int idx = score_index_vec.front().second;
+    bool keep = true;
+    for (int k = 0; k < indices->size() && keep; ++k) {
+      keep = JaccardOverlap(bboxes[idx], bboxes[(*indices)[k]]) <=
+             FLAGS_nms_threshold;
+    }
+    if (keep) {
+      indices->push_back(idx);
+    }
+    score_index_vec.erase(score_index_vec.begin());
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Benchmarks non maximum suppression.\n"
+      "Usage:\n"
+      "    nms_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_boxes, 0);
+  CHECK_GT(FLAGS_classes, 1);
+
+  // Boxes come in clusters of 8, like the priors around one object.
+  Caffe::set_random_seed(1701);
+  const int num = FLAGS_boxes;
+  vector<float> rand(num * 4);
+  caffe_rng_uniform(num * 4, 0.f, 1.f, &rand[0]);
+  vector<NormalizedBBox> bboxes(num);
+  for (int i = 0; i < num; ++i) {
+    const int c = i / 8 * 8;
+    const float x = rand[4 * c] + (rand[4 * i] - 0.5f) * 0.05f;
+    const float y = rand[4 * c + 1] + (rand[4 * i + 1] - 0.5f) * 0.05f;
+    bboxes[i].set_xmin(x);
+    bboxes[i].set_ymin(y);
+    bboxes[i].set_xmax(x + 0.02f + rand[4 * i + 2] * 0.2f);
+    bboxes[i].set_ymax(y + 0.02f + rand[4 * i + 3] * 0.2f);
+  }
+  vector<vector<float> > scores(FLAGS_classes, vector<float>(num));
+  for (int c = 1; c < FLAGS_classes; ++c) {
+    caffe_rng_uniform(num, 0.f, 1.f, &scores[c][0]);
+    // Most candidates of a detector score close to zero.
+    for (int i = 0; i < num; ++i) {
+      scores[c][i] *= scores[c][i] * scores[c][i];
+    }
+  }
+
+  NMSParam param;
+  param.score_threshold = FLAGS_score_threshold;
+  param.overlap_threshold = FLAGS_nms_threshold;
+  param.top_k = FLAGS_top_k;
+  vector<const float*> class_scores(FLAGS_classes);
+  for (int c = 1; c < FLAGS_classes; ++c) {
+    class_scores[c] = scores[c].data();
+  }
+  vector<vector<int> > legacy(FLAGS_classes), serial(FLAGS_classes);
+  vector<vector<int> > batched;
+  double legacy_ms = 0, serial_ms = 0, batched_ms = 0;
+  CPUTimer timer;
+  Caffe::set_cpu_threads(FLAGS_threads);
+  for (int it = 0; it < FLAGS_iterations; ++it) {
+    timer.Start();
+    for (int c = 1; c < FLAGS_classes; ++c) {
+      LegacyNMS(bboxes, scores[c], &legacy[c]);
+    }
+    legacy_ms += timer.MilliSeconds();
+
+    timer.Start();
+    NMSBoxes boxes;
+    GetNMSBoxes(bboxes, &boxes);
+    for (int c = 1; c < FLAGS_classes; ++c) {
+      NonMaxSuppression(boxes, class_scores[c], param, &serial[c]);
+    }
+    serial_ms += timer.MilliSeconds();
+
+    timer.Start();
+    GetNMSBoxes(bboxes, &boxes);
+    NonMaxSuppressionBatched(boxes, class_scores, param, &batched);
+    batched_ms += timer.MilliSeconds();
+  }
+  int kept = 0;
+  for (int c = 1; c < FLAGS_classes; ++c) {
+    CHECK(legacy[c] == serial[c]) << "Class " << c << " differs.";
+    CHECK(legacy[c] == batched[c]) << "Class " << c << " differs.";
+    kept += legacy[c].size();
+  }
+  LOG(INFO) << num << " boxes, " << FLAGS_classes - 1 << " classes, "
+            << kept << " kept per run.";
+  LOG(INFO) << "Legacy:  " << legacy_ms / FLAGS_iterations << " ms";
+  LOG(INFO) << "Serial:  " << serial_ms / FLAGS_iterations << " ms ("
+            << legacy_ms / serial_ms << "x)";
+  LOG(INFO) << "Batched: " << batched_ms / FLAGS_iterations << " ms ("
+            << legacy_ms / batched_ms << "x) on " << Caffe::cpu_threads()
+            << " threads";
+  return 0;
+}